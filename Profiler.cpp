@@ -1,11 +1,116 @@
 
 #include "Profiler.h"
+#include "ProfilerCapture.h"
+#include "ProfilerControl.h"
+#include "ProfilerFlightRecorder.h"
+#include "ProfilerTransport.h"
 
 #if WITH_PROFILING
 
 CPUProfiler gCPUProfiler;
 GPUProfiler gGPUProfiler;
 
+//-----------------------------------------------------------------------------
+// [SECTION] Site Table
+//-----------------------------------------------------------------------------
+
+uint32 ProfilerSiteTable::Intern(const char* pName, const char* pFilePath, uint32 lineNumber)
+{
+	// 32-bit FNV hash of the name, combined with the line number.
+	// The file path is not hashed as it is mostly unique per name already.
+	uint32 hash = 0x811c9dc5;
+	for (const char* pChar = pName; *pChar; ++pChar)
+	{
+		hash ^= (uint8)*pChar;
+		hash *= 0x1000193;
+	}
+	hash ^= lineNumber * 0x9E3779B9;
+
+	// Keep the load factor below 0.5
+	if ((m_Sites.size() + 1) * 2 > m_Slots.size())
+		Grow();
+
+	uint32 mask = (uint32)m_Slots.size() - 1;
+	for (uint32 slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		uint32 slotValue = m_Slots[slot];
+		if (slotValue == 0)
+		{
+			uint32 siteIndex = (uint32)m_Sites.size();
+			m_Slots[slot] = siteIndex + 1;
+			m_Hashes.push_back(hash);
+			ProfilerSite& site = m_Sites.emplace_back();
+			site.pName = CopyString(pName);
+			site.pFilePath = pFilePath;
+			site.LineNumber = lineNumber;
+			return siteIndex;
+		}
+
+		uint32 siteIndex = slotValue - 1;
+		const ProfilerSite& site = m_Sites[siteIndex];
+		if (m_Hashes[siteIndex] == hash && site.LineNumber == lineNumber && strcmp(site.pName, pName) == 0)
+		{
+			if (site.pFilePath == pFilePath || (site.pFilePath && pFilePath && strcmp(site.pFilePath, pFilePath) == 0))
+				return siteIndex;
+		}
+	}
+}
+
+void ProfilerSiteTable::Reset()
+{
+	m_Sites.clear();
+	m_Hashes.clear();
+	m_Slots.clear();
+	m_StringBlocks.clear();
+	m_StringBlockOffset = STRING_BLOCK_SIZE;
+}
+
+const char* ProfilerSiteTable::CopyString(const char* pStr)
+{
+	uint32 len = (uint32)strlen(pStr) + 1;
+	if (len > STRING_BLOCK_SIZE)
+	{
+		// Oversized strings get a block of their own. Insert it before the current block so that block can still be filled.
+		auto it = m_StringBlocks.insert(m_StringBlocks.empty() ? m_StringBlocks.end() : m_StringBlocks.end() - 1, std::make_unique<char[]>(len));
+		strcpy_s(it->get(), len, pStr);
+		return it->get();
+	}
+
+	if (m_StringBlockOffset + len > STRING_BLOCK_SIZE)
+	{
+		m_StringBlocks.push_back(std::make_unique<char[]>(STRING_BLOCK_SIZE));
+		m_StringBlockOffset = 0;
+	}
+	char* pData = m_StringBlocks.back().get() + m_StringBlockOffset;
+	strcpy_s(pData, len, pStr);
+	m_StringBlockOffset += len;
+	return pData;
+}
+
+void ProfilerSiteTable::Grow()
+{
+	m_Slots.assign(max((uint32)m_Slots.size() * 2, 64u), 0);
+	uint32 mask = (uint32)m_Slots.size() - 1;
+	for (uint32 siteIndex = 0; siteIndex < (uint32)m_Sites.size(); ++siteIndex)
+	{
+		uint32 slot = m_Hashes[siteIndex] & mask;
+		while (m_Slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		m_Slots[slot] = siteIndex + 1;
+	}
+}
+
+// Write all sites that the capture writer or live transport has not seen yet
+template<typename Writer>
+static void WriteCaptureSites(Writer& writer, const ProfilerSiteTable& sites)
+{
+	for (uint32 i = writer.GetNumSites(); i < sites.GetNumSites(); ++i)
+	{
+		const ProfilerSite& site = sites.GetSite(i);
+		writer.AddSite(site.pName, site.pFilePath, site.LineNumber);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // [SECTION] GPU Profiler
 //-----------------------------------------------------------------------------
@@ -151,11 +256,15 @@ void GPUProfiler::Tick()
 			event.TicksEnd = queryRange.IsCopyQuery ? copyQueries[queryRange.QueryIndexEnd] : mainQueries[queryRange.QueryIndexEnd];
 		}
 
-		// Sort events by queue
+		// Sort events by queue, and by time within a queue so they are stored in pre-order (parents before their children)
 		std::vector<EventData::Event>& events = eventData.Events;
 		std::sort(events.begin(), events.begin() + numEvents, [](const EventData::Event& a, const EventData::Event& b)
 			{
-				return a.QueueIndex < b.QueueIndex;
+				if (a.QueueIndex != b.QueueIndex)
+					return a.QueueIndex < b.QueueIndex;
+				if (a.TicksBegin != b.TicksBegin)
+					return a.TicksBegin < b.TicksBegin;
+				return a.Depth < b.Depth;
 			});
 
 		URange eventRange(0, 0);
@@ -167,10 +276,26 @@ void GPUProfiler::Tick()
 			while (events[eventRange.End].QueueIndex == queueIndex && eventRange.End < numEvents)
 				++eventRange.End;
 
-			eventData.EventsPerQueue[queueIndex] = Span<const EventData::Event>(&events[eventRange.Begin], eventRange.End - eventRange.Begin);
+			Span<EventData::Event> queueEvents(&events[eventRange.Begin], eventRange.End - eventRange.Begin);
+			ComputeSelfTicks(queueEvents, m_SelfTimeStack);
+			eventData.EventsPerQueue[queueIndex] = queueEvents;
 			eventRange.Begin = eventRange.End;
 		}
 
+		// Assign each event its site. The name is redirected to the interned copy so it outlives the frame allocator.
+		ProfilerSiteTable& sites = gCPUProfiler.GetSiteTable();
+		for (uint32 i = 0; i < numEvents; ++i)
+		{
+			EventData::Event& event = events[i];
+			event.SiteIndex = sites.Intern(event.pName, event.pFilePath, event.LineNumber);
+			event.pName = sites.GetSite(event.SiteIndex).pName;
+		}
+
+		if (m_pCaptureWriter)
+			WriteCaptureFrame(*m_pCaptureWriter, m_FrameToReadback, eventData);
+		if (m_pLiveTransport && m_pLiveTransport->PollReader())
+			WriteCaptureFrame(*m_pLiveTransport, m_FrameToReadback, eventData);
+
 		++m_FrameToReadback;
 	}
 
@@ -241,6 +366,49 @@ void GPUProfiler::ExecuteCommandLists(ID3D12CommandQueue* pQueue, Span<ID3D12Com
 }
 
 
+template<typename Writer>
+void GPUProfiler::WriteCaptureFrame(Writer& writer, uint32 frameIndex, const EventData& frame)
+{
+	WriteCaptureSites(writer, gCPUProfiler.GetSiteTable());
+
+	for (uint32 i = writer.GetNumQueues(); i < (uint32)m_Queues.size(); ++i)
+	{
+		const QueueInfo& queue = m_Queues[i];
+		writer.AddQueue(queue.Name, queue.GetGPUCalibrationTicks(), queue.GetCPUCalibrationTicks(), queue.GetGPUFrequency(), queue.GetCPUFrequency());
+	}
+
+	// The frame range is stored in CPU ticks so GPU frames can be found on the same timeline as CPU frames
+	uint64 ticksBegin = ~0ull;
+	uint64 ticksEnd = 0;
+	for (uint32 queueIndex = 0; queueIndex < (uint32)m_Queues.size(); ++queueIndex)
+	{
+		const QueueInfo& queue = m_Queues[queueIndex];
+		for (const EventData::Event& event : frame.EventsPerQueue[queueIndex])
+		{
+			uint64 eventBegin = queue.GpuToCpuTicks(event.TicksBegin);
+			uint64 eventEnd = queue.GpuToCpuTicks(event.TicksEnd);
+			ticksBegin = eventBegin < ticksBegin ? eventBegin : ticksBegin;
+			ticksEnd = eventEnd > ticksEnd ? eventEnd : ticksEnd;
+		}
+	}
+	if (ticksBegin > ticksEnd)
+		ticksBegin = ticksEnd;
+
+	writer.BeginGPUFrame(frameIndex, ticksBegin, ticksEnd);
+	for (uint32 queueIndex = 0; queueIndex < (uint32)m_Queues.size(); ++queueIndex)
+	{
+		Span<const EventData::Event> events = frame.EventsPerQueue[queueIndex];
+		if (events.empty())
+			continue;
+
+		writer.BeginBlock(queueIndex, (uint32)events.size());
+		for (const EventData::Event& event : events)
+			writer.AddEvent(event.TicksBegin, event.TicksEnd, event.SiteIndex, event.Depth);
+	}
+	writer.EndFrame();
+}
+
+
 void GPUProfiler::QueryHeap::Initialize(ID3D12Device* pDevice, ID3D12CommandQueue* pResolveQueue, uint32 maxNumQueries, uint32 frameLatency)
 {
 	m_pResolveQueue = pResolveQueue;
@@ -344,12 +512,36 @@ void CPUProfiler::Initialize(uint32 historySize, uint32 maxEvents)
 
 	for (uint32 i = 0; i < historySize; ++i)
 		m_pEventData[i].Events.resize(maxEvents);
+
+	SetOutlierOptions(ProfilerOutlierOptions());
 }
 
 
 void CPUProfiler::Shutdown()
 {
+	if (m_pControlCapture)
+	{
+		SetCaptureWriter(nullptr);
+		gGPUProfiler.SetCaptureWriter(nullptr);
+		delete m_pControlCapture;
+		m_pControlCapture = nullptr;
+	}
+
+	// Finish the queued jobs
+	if (m_JobThread.joinable())
+	{
+		{
+			std::scoped_lock lock(m_JobLock);
+			m_StopJobs = true;
+		}
+		m_JobCondition.notify_one();
+		m_JobThread.join();
+		m_StopJobs = false;
+	}
+
 	delete[] m_pEventData;
+	m_pEventData = nullptr;
+	m_Sites.Reset();
 }
 
 
@@ -358,6 +550,13 @@ void CPUProfiler::BeginEvent(const char* pName, const char* pFilePath, uint32 li
 	if (m_EventCallback.OnEventBegin)
 		m_EventCallback.OnEventBegin(pName, m_EventCallback.pUserData);
 
+	if (m_pFlightRecorder)
+	{
+		uint64 ticks;
+		QueryPerformanceCounter((LARGE_INTEGER*)(&ticks));
+		m_pFlightRecorder->BeginEvent(GetTLS().ThreadIndex, pName, pFilePath, lineNumber, ticks);
+	}
+
 	if (m_Paused)
 		return;
 
@@ -385,6 +584,13 @@ void CPUProfiler::EndEvent()
 	if (m_EventCallback.OnEventEnd)
 		m_EventCallback.OnEventEnd(m_EventCallback.pUserData);
 
+	if (m_pFlightRecorder)
+	{
+		uint64 ticks;
+		QueryPerformanceCounter((LARGE_INTEGER*)(&ticks));
+		m_pFlightRecorder->EndEvent(GetTLS().ThreadIndex, ticks);
+	}
+
 	if (m_Paused)
 		return;
 
@@ -393,8 +599,23 @@ void CPUProfiler::EndEvent()
 }
 
 
+void CPUProfiler::SetFlightRecorder(FlightRecorder* pRecorder)
+{
+	std::scoped_lock lock(m_ThreadDataLock);
+	m_pFlightRecorder = pRecorder;
+	if (m_pFlightRecorder)
+	{
+		for (const ThreadData& thread : m_ThreadData)
+			m_pFlightRecorder->SetThread(thread.Index, thread.Name, thread.ThreadID);
+	}
+}
+
+
 void CPUProfiler::Tick()
 {
+	if (m_pControl)
+		ProcessControlCommands();
+
 	m_Paused = m_QueuedPaused;
 	if (m_Paused)
 		return;
@@ -406,12 +627,17 @@ void CPUProfiler::Tick()
 	for (auto& threadData : m_ThreadData)
 		check(threadData.pTLS->EventStack.GetSize() == 0);
 
-	// Sort the events by thread and group by thread
+	// Sort the events by thread and group by thread.
+	// Within a thread, sort by time so events are stored in pre-order (parents before their children)
 	EventData& frame = GetData();
 	std::vector<EventData::Event>& events = frame.Events;
 	std::sort(events.begin(), events.begin() + frame.NumEvents, [](const EventData::Event& a, const EventData::Event& b)
 		{
-			return a.ThreadIndex < b.ThreadIndex;
+			if (a.ThreadIndex != b.ThreadIndex)
+				return a.ThreadIndex < b.ThreadIndex;
+			if (a.TicksBegin != b.TicksBegin)
+				return a.TicksBegin < b.TicksBegin;
+			return a.Depth < b.Depth;
 		});
 
 	URange eventRange(0, 0);
@@ -423,10 +649,49 @@ void CPUProfiler::Tick()
 		while (events[eventRange.End].ThreadIndex == threadIndex && eventRange.End < frame.NumEvents)
 			++eventRange.End;
 
-		frame.EventsPerThread[threadIndex] = Span<const EventData::Event>(&events[eventRange.Begin], eventRange.End - eventRange.Begin);
+		Span<EventData::Event> threadEvents(&events[eventRange.Begin], eventRange.End - eventRange.Begin);
+		ComputeSelfTicks(threadEvents, m_SelfTimeStack);
+		frame.EventsPerThread[threadIndex] = threadEvents;
 		eventRange.Begin = eventRange.End;
 	}
 
+	// Assign each event its site. The name is redirected to the interned copy so it outlives the frame allocator.
+	frame.TicksBegin = frame.NumEvents > 0 ? ~0ull : 0;
+	frame.TicksEnd = 0;
+	for (uint32 i = 0; i < frame.NumEvents; ++i)
+	{
+		EventData::Event& event = events[i];
+		event.SiteIndex = m_Sites.Intern(event.pName, event.pFilePath, event.LineNumber);
+		event.pName = m_Sites.GetSite(event.SiteIndex).pName;
+		frame.TicksBegin = min(frame.TicksBegin, event.TicksBegin);
+		frame.TicksEnd = max(frame.TicksEnd, event.TicksEnd);
+	}
+
+	m_Statistics.BeginFrame(m_Sites.GetNumSites());
+	m_FrameSummaries.BeginFrame(m_Sites.GetNumSites());
+	m_Outliers.BeginFrame(m_Sites.GetNumSites());
+	for (uint32 threadIndex = 0; threadIndex < (uint32)m_ThreadData.size(); ++threadIndex)
+	{
+		m_Statistics.BeginTrack();
+		m_Outliers.BeginTrack();
+		for (const EventData::Event& event : frame.EventsPerThread[threadIndex])
+		{
+			m_Statistics.AddEvent(event.SiteIndex, event.Depth, event.TicksEnd - event.TicksBegin, event.SelfTicks);
+			m_FrameSummaries.AddEvent(event.SiteIndex, event.SelfTicks);
+			m_Outliers.AddEvent(event.SiteIndex, event.Depth, event.TicksEnd - event.TicksBegin);
+		}
+	}
+	m_Statistics.EndFrame();
+	m_FrameSummaries.EndFrame(m_FrameIndex, frame.TicksEnd - frame.TicksBegin);
+	m_Outliers.EndFrame(m_FrameIndex, frame.TicksEnd - frame.TicksBegin);
+
+	EvaluateHitchTrigger(frame);
+
+	if (m_pCaptureWriter)
+		WriteCaptureFrame(*m_pCaptureWriter, frame);
+	if (m_pLiveTransport && m_pLiveTransport->PollReader())
+		WriteCaptureFrame(*m_pLiveTransport, frame);
+
 	++m_FrameIndex;
 
 	EventData& newData = GetData();
@@ -437,6 +702,293 @@ void CPUProfiler::Tick()
 }
 
 
+// Write the events of a finalized frame. The events are sorted by thread.
+template<typename Writer>
+static void WriteCaptureEvents(Writer& writer, uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd, Span<const CPUProfiler::EventData::Event> events)
+{
+	writer.BeginCPUFrame(frameIndex, ticksBegin, ticksEnd);
+	for (size_t blockBegin = 0; blockBegin < events.size();)
+	{
+		uint32 threadIndex = events[blockBegin].ThreadIndex;
+		size_t blockEnd = blockBegin + 1;
+		while (blockEnd < events.size() && events[blockEnd].ThreadIndex == threadIndex)
+			++blockEnd;
+
+		writer.BeginBlock(threadIndex, (uint32)(blockEnd - blockBegin));
+		for (size_t i = blockBegin; i < blockEnd; ++i)
+			writer.AddEvent(events[i].TicksBegin, events[i].TicksEnd, events[i].SiteIndex, events[i].Depth);
+		blockBegin = blockEnd;
+	}
+	writer.EndFrame();
+}
+
+
+template<typename Writer>
+void CPUProfiler::WriteCaptureFrame(Writer& writer, const EventData& frame)
+{
+	WriteCaptureSites(writer, m_Sites);
+
+	{
+		std::scoped_lock lock(m_ThreadDataLock);
+		for (uint32 i = writer.GetNumThreads(); i < (uint32)m_ThreadData.size(); ++i)
+			writer.AddThread(m_ThreadData[i].Name, m_ThreadData[i].ThreadID);
+	}
+
+	WriteCaptureEvents(writer, m_FrameIndex, frame.TicksBegin, frame.TicksEnd, Span<const EventData::Event>(frame.Events.data(), frame.NumEvents));
+}
+
+
+void CPUProfiler::ProcessControlCommands()
+{
+	uint64 ticksPerSecond;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&ticksPerSecond);
+
+	ProfilerCommand command;
+	while (m_pControl->PopCommand(command))
+	{
+		switch (command.Type)
+		{
+		case ProfilerCommandType::Snapshot:
+			WriteSnapshot(command.Path.c_str(), GetFrameRange());
+			break;
+		case ProfilerCommandType::StartCapture:
+			if (!m_pControlCapture)
+			{
+				CaptureWriter* pWriter = new CaptureWriter();
+				if (pWriter->Open(command.Path.c_str(), ticksPerSecond))
+				{
+					m_pControlCapture = pWriter;
+					SetCaptureWriter(pWriter);
+					gGPUProfiler.SetCaptureWriter(pWriter);
+				}
+				else
+				{
+					delete pWriter;
+				}
+			}
+			break;
+		case ProfilerCommandType::StopCapture:
+			if (m_pControlCapture)
+			{
+				SetCaptureWriter(nullptr);
+				gGPUProfiler.SetCaptureWriter(nullptr);
+
+				// Closing waits for the remaining data to be written, which is done on the background thread
+				CaptureWriter* pWriter = m_pControlCapture;
+				m_pControlCapture = nullptr;
+				RunAsync([pWriter]() { delete pWriter; });
+			}
+			break;
+		case ProfilerCommandType::SetEnableMask:
+			SetPaused((command.EnableMask & ProfilerEnable_CPU) == 0);
+			gGPUProfiler.SetPaused((command.EnableMask & ProfilerEnable_GPU) == 0);
+			break;
+		}
+	}
+}
+
+
+void CPUProfiler::RunAsync(std::function<void()>&& job)
+{
+	if (m_pControl)
+	{
+		m_pControl->RunAsync(std::move(job));
+		return;
+	}
+
+	// Without a control surface, the profiler runs the job on its own thread, so Tick() never waits for the disk
+	{
+		std::scoped_lock lock(m_JobLock);
+		if (!m_JobThread.joinable())
+			m_JobThread = std::thread(&CPUProfiler::JobThread, this);
+		m_Jobs.push_back(std::move(job));
+	}
+	m_JobCondition.notify_one();
+}
+
+
+void CPUProfiler::JobThread()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock lock(m_JobLock);
+			m_JobCondition.wait(lock, [this]() { return m_StopJobs || !m_Jobs.empty(); });
+			if (m_Jobs.empty())
+				return;
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+		job();
+	}
+}
+
+
+void CPUProfiler::WriteSnapshot(const char* pPath, URange frames)
+{
+	// Copy the finalized frames. Only the copy is done on this thread, the capture is written on the background thread.
+	// The site names are copied too, as the job can still be queued when the profiler is shut down and the site table is freed.
+	struct Snapshot
+	{
+		struct Site
+		{
+			std::string					Name;
+			std::string					FilePath;
+			bool						HasFilePath;
+			uint32						LineNumber;
+		};
+
+		struct Frame
+		{
+			uint32						FrameIndex;
+			uint64						TicksBegin;
+			uint64						TicksEnd;
+			std::vector<EventData::Event> Events;
+		};
+
+		std::string					Path;
+		uint64						TicksPerSecond = 0;
+		std::vector<Site>			Sites;
+		std::vector<ThreadData>		Threads;
+		std::vector<Frame>			Frames;
+	};
+
+	std::shared_ptr<Snapshot> pSnapshot = std::make_shared<Snapshot>();
+	pSnapshot->Path = pPath;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&pSnapshot->TicksPerSecond);
+	pSnapshot->Sites.reserve(m_Sites.GetNumSites());
+	for (const ProfilerSite& site : m_Sites.GetSites())
+		pSnapshot->Sites.push_back({ site.pName, site.pFilePath ? site.pFilePath : "", site.pFilePath != nullptr, site.LineNumber });
+	{
+		std::scoped_lock lock(m_ThreadDataLock);
+		pSnapshot->Threads = m_ThreadData;
+	}
+
+	for (uint32 frameIndex = frames.Begin; frameIndex < frames.End; ++frameIndex)
+	{
+		const EventData& data = GetData(frameIndex);
+		pSnapshot->Frames.push_back({ frameIndex, data.TicksBegin, data.TicksEnd, std::vector<EventData::Event>(data.Events.begin(), data.Events.begin() + data.NumEvents) });
+	}
+
+	RunAsync([pSnapshot]()
+		{
+			CaptureWriter writer;
+			if (!writer.Open(pSnapshot->Path.c_str(), pSnapshot->TicksPerSecond, CaptureFormat::Compression::LZ, 1 << 18, ~0u))
+				return;
+
+			for (const Snapshot::Site& site : pSnapshot->Sites)
+				writer.AddSite(site.Name.c_str(), site.HasFilePath ? site.FilePath.c_str() : nullptr, site.LineNumber);
+			for (const ThreadData& thread : pSnapshot->Threads)
+				writer.AddThread(thread.Name, thread.ThreadID);
+			for (const Snapshot::Frame& frame : pSnapshot->Frames)
+				WriteCaptureEvents(writer, frame.FrameIndex, frame.TicksBegin, frame.TicksEnd, frame.Events);
+		});
+}
+
+
+void CPUProfiler::SetOutlierOptions(const ProfilerOutlierOptions& options)
+{
+	uint64 ticksPerSecond;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&ticksPerSecond);
+	m_Outliers.SetOptions(options, ticksPerSecond);
+}
+
+
+void CPUProfiler::SetHitchTrigger(const HitchTriggerOptions& options)
+{
+	uint64 ticksPerSecond;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&ticksPerSecond);
+
+	m_HitchTrigger = options;
+	m_HitchFrameTicks = options.FrameTimeMs > 0.0f ? (uint64)(options.FrameTimeMs * 0.001 * ticksPerSecond) : ~0ull;
+	m_HitchSiteTicks.clear();
+	m_IsHitchPending = false;
+}
+
+
+void CPUProfiler::EvaluateHitchTrigger(const EventData& frame)
+{
+	if (m_IsHitchPending)
+	{
+		if (m_FrameIndex >= m_PendingHitch.FrameIndex + m_HitchTrigger.FramesAfter)
+			ExecuteHitchTrigger();
+		return;
+	}
+
+	if (m_FrameIndex < m_HitchCooldownEnd || (m_HitchFrameTicks == ~0ull && m_HitchTrigger.WatchedSites.empty()))
+		return;
+
+	HitchInfo hitch;
+	hitch.FrameIndex = m_FrameIndex;
+	if (frame.TicksEnd - frame.TicksBegin > m_HitchFrameTicks)
+	{
+		hitch.Ticks = frame.TicksEnd - frame.TicksBegin;
+	}
+	else if (!m_HitchTrigger.WatchedSites.empty())
+	{
+		// Resolve the threshold of the sites added since the last frame
+		uint64 ticksPerSecond;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&ticksPerSecond);
+		for (uint32 siteIndex = (uint32)m_HitchSiteTicks.size(); siteIndex < m_Sites.GetNumSites(); ++siteIndex)
+		{
+			uint64 ticks = ~0ull;
+			for (const HitchTriggerOptions::WatchedSite& watched : m_HitchTrigger.WatchedSites)
+			{
+				if (watched.Name == m_Sites.GetSite(siteIndex).pName)
+					ticks = (uint64)(watched.TimeMs * 0.001 * ticksPerSecond);
+			}
+			m_HitchSiteTicks.push_back(ticks);
+		}
+
+		for (uint32 i = 0; i < frame.NumEvents; ++i)
+		{
+			const EventData::Event& event = frame.Events[i];
+			if (event.TicksEnd - event.TicksBegin > m_HitchSiteTicks[event.SiteIndex])
+			{
+				hitch.SiteIndex = event.SiteIndex;
+				hitch.Ticks = event.TicksEnd - event.TicksBegin;
+				break;
+			}
+		}
+	}
+
+	if (hitch.Ticks == 0)
+		return;
+
+	m_PendingHitch = hitch;
+	m_IsHitchPending = true;
+	if (m_HitchTrigger.FramesAfter == 0)
+		ExecuteHitchTrigger();
+}
+
+
+void CPUProfiler::ExecuteHitchTrigger()
+{
+	m_IsHitchPending = false;
+	m_LastHitch = m_PendingHitch;
+	++m_NumHitches;
+
+	// Don't trigger again on the frames that were kept
+	m_HitchCooldownEnd = m_FrameIndex + m_HitchTrigger.FramesBefore + 1;
+
+	if (m_HitchTrigger.TriggerAction == HitchTriggerOptions::Action::Freeze)
+	{
+		SetPaused(true);
+		gGPUProfiler.SetPaused(true);
+	}
+	else
+	{
+		// The current frame is finalized, so it is included. The oldest frames may already be overwritten.
+		uint32 oldestFrame = GetFrameRange().Begin;
+		uint32 firstFrame = m_PendingHitch.FrameIndex >= m_HitchTrigger.FramesBefore ? m_PendingHitch.FrameIndex - m_HitchTrigger.FramesBefore : 0;
+		char path[32];
+		snprintf(path, sizeof(path), "_%u.tlcap", m_PendingHitch.FrameIndex);
+		WriteSnapshot((m_HitchTrigger.SnapshotPrefix + path).c_str(), URange(max(firstFrame, oldestFrame), m_FrameIndex + 1));
+	}
+}
+
+
 void CPUProfiler::RegisterThread(const char* pName)
 {
 	TLS& tls = GetTLSUnsafe();
@@ -462,6 +1014,9 @@ void CPUProfiler::RegisterThread(const char* pName)
 	data.pTLS = &tls;
 	data.Index = (uint32)m_ThreadData.size() - 1;
 
+	if (m_pFlightRecorder)
+		m_pFlightRecorder->SetThread(data.Index, data.Name, data.ThreadID);
+
 	for (uint32 i = 0; i < m_HistorySize; ++i)
 		m_pEventData[i].EventsPerThread.resize(m_ThreadData.size());
 }
@@ -2,35 +2,22 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <vector>
-#include <cinttypes>
 #include <mutex>
+#include <thread>
 #include <array>
-#include <span>
+#include <memory>
+#include <string>
 #include <unordered_map>
-#include <assert.h>
 #include <d3d12.h>
 
-#define check(op, ...) assert(op)
-#define checkf(op, ...) assert(op)
-#define VERIFY_HR(op) assert(SUCCEEDED(op))
-
-#define _STRINGIFY(a) #a
-#define STRINGIFY(a) _STRINGIFY(a)
-#define CONCAT_IMPL( x, y ) x##y
-#define MACRO_CONCAT( x, y ) CONCAT_IMPL( x, y )
+#include "ProfilerTypes.h"
+#include "ProfilerStats.h"
 
-using uint64 = uint64_t;
-using uint32 = uint32_t;
-using uint16 = uint16_t;
-template<typename T>
-using Span = std::span<T>;
-
-struct URange
-{
-	uint32 Begin;
-	uint32 End;
-}; 
+#define VERIFY_HR(op) assert(SUCCEEDED(op))
 
 
 #ifndef WITH_PROFILING
@@ -158,8 +145,52 @@ private:
 	std::atomic<uint32> m_Offset;
 };
 
+// A unique event location: the combination of an event name and the source location it was recorded at
+struct ProfilerSite
+{
+	const char* pName = "";			// Interned name of the site
+	const char* pFilePath = nullptr;	// File path of the file in which the event is recorded
+	uint32		LineNumber = 0;			// Line number of the file in which the event is recorded
+};
+
+// Interns event names and source locations into a stable site index.
+// Sites are never removed, so a site index and its name remain valid until the table is reset.
+// Not thread-safe. Only accessed from the thread that calls Tick().
+class ProfilerSiteTable
+{
+public:
+	// Find or add the site. Returns the site index
+	uint32 Intern(const char* pName, const char* pFilePath, uint32 lineNumber);
+
+	void Reset();
+
+	const ProfilerSite& GetSite(uint32 index) const { return m_Sites[index]; }
+	Span<const ProfilerSite> GetSites() const { return m_Sites; }
+	uint32 GetNumSites() const { return (uint32)m_Sites.size(); }
+
+private:
+	static constexpr uint32 STRING_BLOCK_SIZE = 1 << 16;
+
+	const char* CopyString(const char* pStr);
+	void Grow();
+
+	std::vector<ProfilerSite>				m_Sites;								// All sites, indexed by site index
+	std::vector<uint32>						m_Hashes;								// Hash of each site
+	std::vector<uint32>						m_Slots;								// Open addressing hash table storing site index + 1. 0 if empty
+	std::vector<std::unique_ptr<char[]>>	m_StringBlocks;							// Storage for the interned names
+	uint32									m_StringBlockOffset = STRING_BLOCK_SIZE;	// Offset in the last string block
+};
+
+class CaptureWriter;
+class FlightRecorder;
+class LiveTransportWriter;
+class ProfilerControl;
+
 void DrawProfilerHUD();
 
+// Draw the frames another process publishes through its live transport in the HUD, instead of the own history
+bool AttachProfilerHUD(const char* pTransportName);
+
 //-----------------------------------------------------------------------------
 // [SECTION] GPU Profiler
 //-----------------------------------------------------------------------------
@@ -219,13 +250,15 @@ public:
 			const char* pFilePath = "";	// File path of location where event was started
 			uint64		TicksBegin = 0;	// Begin GPU ticks
 			uint64		TicksEnd = 0;	// End GPU ticks
+			uint64		SelfTicks = 0;	// GPU ticks not spent in child events. Assigned when the frame is resolved
 			uint32		LineNumber : 16;	// Line number of file where event was started
 			uint32		Index : 16;	// Index of event, to ensure stable sort when ordering
 			uint32		Depth : 8;	// Stack depth of event
 			uint32		QueueIndex : 8;	// Index of QueueInfo
 			uint32		padding : 16;
+			uint32		SiteIndex = 0;	// Index of the site in the site table. Assigned when the frame is resolved
 		};
-		static_assert(sizeof(Event) == sizeof(uint32) * 10);
+		static_assert(sizeof(Event) == sizeof(uint32) * 14);
 
 		LinearAllocator					Allocator;			// Scratch allocator for frame
 		std::vector<Span<const Event>>	EventsPerQueue;		// Span of events for each queue
@@ -244,6 +277,15 @@ public:
 			QueryPerformanceFrequency((LARGE_INTEGER*)&CPUFrequency);
 		}
 
+		// Initialize from previously recorded calibration data. Used to display queues loaded from a capture
+		void InitCalibration(uint64 gpuCalibrationTicks, uint64 cpuCalibrationTicks, uint64 gpuFrequency, uint64 cpuFrequency)
+		{
+			GPUCalibrationTicks = gpuCalibrationTicks;
+			CPUCalibrationTicks = cpuCalibrationTicks;
+			GPUFrequency = gpuFrequency;
+			CPUFrequency = cpuFrequency;
+		}
+
 		uint64 GpuToCpuTicks(uint64 gpuTicks) const
 		{
 			check(gpuTicks >= GPUCalibrationTicks);
@@ -255,6 +297,11 @@ public:
 			return (float)ticks / GPUFrequency * 1000.0f;
 		}
 
+		uint64 GetGPUCalibrationTicks() const { return GPUCalibrationTicks; }
+		uint64 GetCPUCalibrationTicks() const { return CPUCalibrationTicks; }
+		uint64 GetGPUFrequency() const { return GPUFrequency; }
+		uint64 GetCPUFrequency() const { return CPUFrequency; }
+
 		ID3D12CommandQueue* pQueue = nullptr;	// The D3D queue object
 		char Name[128];							// Name of the queue
 
@@ -284,6 +331,12 @@ public:
 
 	void SetEventCallback(const GPUProfilerCallbacks& inCallbacks) { m_EventCallback = inCallbacks; }
 
+	// Stream each resolved frame to the capture writer. Pass nullptr to stop streaming.
+	void SetCaptureWriter(CaptureWriter* pWriter) { m_pCaptureWriter = pWriter; }
+
+	// Publish each resolved frame to a viewer in another process, while one is attached. Pass nullptr to stop.
+	void SetLiveTransport(LiveTransportWriter* pTransport) { m_pLiveTransport = pTransport; }
+
 private:
 	struct QueryHeap
 	{
@@ -439,10 +492,17 @@ private:
 
 	QueryHeap					m_MainHeap;
 	QueryHeap					m_CopyHeap;
+	std::vector<uint32>			m_SelfTimeStack;	// Scratch memory to compute the self time of the events
+
+	// Write a frame to a CaptureWriter or LiveTransportWriter
+	template<typename Writer>
+	void WriteCaptureFrame(Writer& writer, uint32 frameIndex, const EventData& frame);
 
 	std::vector<QueueInfo>								m_Queues;
 	std::unordered_map<ID3D12CommandQueue*, uint32>		m_QueueIndexMap;
 	GPUProfilerCallbacks								m_EventCallback;
+	CaptureWriter*										m_pCaptureWriter = nullptr;
+	LiveTransportWriter*								m_pLiveTransport = nullptr;
 
 	bool						m_IsPaused = false;
 	bool						m_PauseQueued = false;
@@ -494,6 +554,33 @@ struct CPUProfilerCallbacks
 	void* pUserData = nullptr;
 };
 
+// Keeps the frames around a hitch. Evaluated when a frame is finalized, so it also works without the HUD.
+struct HitchTriggerOptions
+{
+	enum class Action
+	{
+		Freeze,		// Pause the profilers, so the frames stay in the history
+		Save,		// Write the frames to a capture
+	};
+
+	struct WatchedSite
+	{
+		std::string Name;			// Name of the event
+		float		TimeMs = 0.0f;	// Trigger when an event with this name is longer than this
+	};
+
+	float						FrameTimeMs = 0.0f;				// Trigger when a frame is longer than this. 0 to disable
+	std::vector<WatchedSite>	WatchedSites;
+	Action						TriggerAction = Action::Freeze;
+
+	// Frames kept before and after the frame with the hitch. The history must be large enough to hold all of them.
+	uint32						FramesBefore = 2;
+	uint32						FramesAfter = 1;
+
+	// Saved captures are written to "<SnapshotPrefix>_<frame>.tlcap"
+	std::string					SnapshotPrefix = "Hitch";
+};
+
 // CPU Profiler
 // Also responsible for updating GPU profiler
 // Also responsible for drawing HUD
@@ -532,15 +619,19 @@ public:
 			const char* pFilePath = nullptr;	// File path of file in which this event is recorded
 			uint64		TicksBegin = 0;		// The ticks at the start of this event
 			uint64		TicksEnd = 0;		// The ticks at the end of this event
+			uint64		SelfTicks = 0;		// The ticks not spent in child events. Assigned when the frame is finalized
 			uint32		LineNumber : 16;		// Line number of file in which this event is recorded
 			uint32		ThreadIndex : 11;		// Thread Index of the thread that recorderd this event
 			uint32		Depth : 5;		// Depth of the event
+			uint32		SiteIndex = 0;		// Index of the site in the site table. Assigned when the frame is finalized
 		};
 
 		std::vector<Span<const Event>>	EventsPerThread;	// Events per thread of the frame
 		std::vector<Event>				Events;				// All events of the frame
 		LinearAllocator					Allocator;			// Scratch allocator storing all dynamic allocations of the frame
 		std::atomic<uint32>				NumEvents = 0;		// The number of events
+		uint64							TicksBegin = 0;		// The ticks at the start of the earliest event. Assigned when the frame is finalized
+		uint64							TicksEnd = 0;		// The ticks at the end of the latest event. Assigned when the frame is finalized
 	};
 
 	// Thread-local storage to keep track of current depth and event stack
@@ -620,10 +711,59 @@ public:
 
 	Span<const ThreadData> GetThreads() const { return m_ThreadData; }
 
+	// Table of all event sites. Shared with the GPU profiler
+	const ProfilerSiteTable& GetSiteTable() const { return m_Sites; }
+	ProfilerSiteTable& GetSiteTable() { return m_Sites; }
+
+	// Statistics per site, updated with each finalized frame. Not updated while paused.
+	// Not thread safe. Query and configure from the thread calling Tick().
+	const ProfilerStatistics& GetStatistics() const { return m_Statistics; }
+	ProfilerStatistics& GetStatistics() { return m_Statistics; }
+
+	// Summary of each finalized frame over a much longer history than the full events. Not updated while paused.
+	// Frames in GetFrameRange() also have their full events. Not thread safe, like the statistics.
+	const ProfilerFrameSummaries& GetFrameSummaries() const { return m_FrameSummaries; }
+	ProfilerFrameSummaries& GetFrameSummaries() { return m_FrameSummaries; }
+
+	// Frames and sites of which the time deviated from their baseline, flagged as each frame is finalized. Not updated while paused.
+	// Not thread safe, like the statistics.
+	const ProfilerOutlierDetector& GetOutliers() const { return m_Outliers; }
+	void SetOutlierOptions(const ProfilerOutlierOptions& options);
+
 	void SetEventCallback(const CPUProfilerCallbacks& inCallbacks) { m_EventCallback = inCallbacks; }
 	void SetPaused(bool paused) { m_QueuedPaused = paused; }
 	bool IsPaused() const { return m_Paused; }
 
+	// Stream each finalized frame to the capture writer. Pass nullptr to stop streaming.
+	void SetCaptureWriter(CaptureWriter* pWriter) { m_pCaptureWriter = pWriter; }
+
+	// Publish each finalized frame to a viewer in another process, while one is attached. Pass nullptr to stop.
+	void SetLiveTransport(LiveTransportWriter* pTransport) { m_pLiveTransport = pTransport; }
+
+	// Record all events to the flight recorder, also while paused. Pass nullptr to stop recording.
+	// No other thread may record events while the recorder is changed, so set it before starting the worker threads.
+	void SetFlightRecorder(FlightRecorder* pRecorder);
+
+	// Set the conditions for automatically freezing or saving the frames around a hitch
+	void SetHitchTrigger(const HitchTriggerOptions& options);
+	const HitchTriggerOptions& GetHitchTrigger() const { return m_HitchTrigger; }
+
+	// Description of a triggered hitch
+	struct HitchInfo
+	{
+		uint32 FrameIndex = 0;		// Frame in which the hitch happened
+		uint32 SiteIndex = ~0u;		// Site of the watched event that triggered. ~0u if the frame was too long
+		uint64 Ticks = 0;			// Duration of the frame or event
+	};
+
+	// The number of hitches for which the trigger action was executed, and the last one
+	uint32 GetNumHitches() const { return m_NumHitches; }
+	const HitchInfo& GetLastHitch() const { return m_LastHitch; }
+
+	// Execute the commands of the control surface at the start of each Tick(). Pass nullptr to stop.
+	// Stop the control surface before shutting down the profiler, so queued snapshots are written.
+	void SetControl(ProfilerControl* pControl) { m_pControl = pControl; }
+
 private:
 	// Retrieve thread-local storage without initialization
 	static TLS& GetTLSUnsafe()
@@ -646,7 +786,45 @@ private:
 	EventData& GetData(uint32 frameIndex) { return m_pEventData[frameIndex % m_HistorySize]; }
 	const EventData& GetData(uint32 frameIndex)	const { return m_pEventData[frameIndex % m_HistorySize]; }
 
+	// Write a frame to a CaptureWriter or LiveTransportWriter
+	template<typename Writer>
+	void WriteCaptureFrame(Writer& writer, const EventData& frame);
+
+	void ProcessControlCommands();
+	void WriteSnapshot(const char* pPath, URange frames);
+	void RunAsync(std::function<void()>&& job);
+	void JobThread();
+
+	void EvaluateHitchTrigger(const EventData& frame);
+	void ExecuteHitchTrigger();
+
 	CPUProfilerCallbacks m_EventCallback;
+	ProfilerSiteTable		m_Sites;						// Interned event sites
+	ProfilerStatistics		m_Statistics;					// Statistics per site over the finalized frames
+	ProfilerFrameSummaries	m_FrameSummaries;				// Summary of the finalized frames over a long history
+	ProfilerOutlierDetector	m_Outliers;						// Frames and sites deviating from their baseline
+	std::vector<uint32>		m_SelfTimeStack;				// Scratch memory to compute the self time of the events
+	CaptureWriter*			m_pCaptureWriter = nullptr;		// Writer receiving each finalized frame
+	LiveTransportWriter*	m_pLiveTransport = nullptr;		// Transport publishing each finalized frame to a viewer
+	FlightRecorder*			m_pFlightRecorder = nullptr;	// Recorder receiving each event as it begins and ends
+	ProfilerControl*		m_pControl = nullptr;			// Control surface providing commands from outside the process
+	CaptureWriter*			m_pControlCapture = nullptr;	// Capture started by the control surface. Owned
+
+	// Jobs run without a control surface, eg. snapshots of the hitch trigger. The thread is started by the first job.
+	std::mutex							m_JobLock;
+	std::condition_variable				m_JobCondition;
+	std::deque<std::function<void()>>	m_Jobs;
+	bool								m_StopJobs = false;
+	std::thread							m_JobThread;
+
+	HitchTriggerOptions		m_HitchTrigger;
+	uint64					m_HitchFrameTicks = ~0ull;		// Frame time threshold in ticks
+	std::vector<uint64>		m_HitchSiteTicks;				// Threshold in ticks per site. ~0ull if the site is not watched
+	HitchInfo				m_PendingHitch;					// Hitch waiting for the frames after it
+	bool					m_IsHitchPending = false;
+	uint32					m_HitchCooldownEnd = 0;			// First frame in which a new hitch can trigger
+	uint32					m_NumHitches = 0;
+	HitchInfo				m_LastHitch;
 
 	std::mutex				m_ThreadDataLock;				// Mutex for accesing thread data
 	std::vector<ThreadData> m_ThreadData;					// Data describing each registered thread
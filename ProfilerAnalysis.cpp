@@ -0,0 +1,531 @@
+
+#include "ProfilerAnalysis.h"
+#include "ProfilerCapture.h"
+#include "ProfilerCriticalPath.h"
+#include "ProfilerTasks.h"
+
+#include <algorithm>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Analysis
+//-----------------------------------------------------------------------------
+
+// Number of frames a worker takes from its share at once. Workers only steal from each other once their share is done.
+static constexpr uint32 FramesPerBatch = 64;
+
+// Partial results of a worker thread, merged once all frames are done
+struct CaptureAnalysisWorker
+{
+	std::vector<CaptureSiteAnalysis>	Sites;
+	std::vector<CaptureThreadAnalysis>	Threads;
+	std::vector<uint32>					SiteFrames;			// Last frame in which each site was called
+	std::vector<uint64>					HitchSelfTicks;		// Self time per site in the current hitch
+	std::vector<uint32>					HitchSites;			// Sites with self time in the current hitch
+	std::vector<uint32>					SiteStack;			// Sites of the open events of the current track
+	CriticalPath						Path;				// Critical path of the current frame
+	std::vector<uint32>					PathSites;			// Site of each event of the path
+	CaptureFrame						Frame;				// Reused between frames to keep the allocations
+	uint64								NumEvents = 0;
+};
+
+static void AnalyzeFrame(const CaptureReader& capture, uint32 frameIndex, CaptureAnalysisWorker& worker, const std::vector<bool>* pWaitSites, CaptureHitch* pHitch, uint32 numHitchSites)
+{
+	CaptureFrame& frame = worker.Frame;
+	if (!capture.DecodeCPUFrame(frameIndex, frame))
+		return;
+
+	uint32 numSites = (uint32)worker.Sites.size();
+	uint64 frameTicks = frame.TicksEnd - frame.TicksBegin;
+	for (const CaptureFrame::Track& track : frame.Tracks)
+	{
+		uint64 busyTicks = 0;
+		worker.SiteStack.clear();
+		for (uint32 eventIndex = track.EventOffset; eventIndex < track.EventOffset + track.NumEvents; ++eventIndex)
+		{
+			const CaptureEvent& event = frame.Events[eventIndex];
+			if (event.SiteIndex >= numSites)
+				continue;
+
+			uint64 ticks = event.TicksEnd - event.TicksBegin;
+			CaptureSiteAnalysis& site = worker.Sites[event.SiteIndex];
+			if (worker.SiteFrames[event.SiteIndex] != frameIndex)
+			{
+				worker.SiteFrames[event.SiteIndex] = frameIndex;
+				++site.NumFrames;
+			}
+
+			if (PushSiteStack(worker.SiteStack, event.SiteIndex, event.Depth))
+				site.InclusiveTicks += ticks;
+			site.SelfTicks += event.SelfTicks;
+			site.MaxCallTicks = std::max(site.MaxCallTicks, ticks);
+			++site.NumCalls;
+
+			// Top-level events of a thread do not overlap
+			if (event.Depth == 0)
+				busyTicks += ticks;
+
+			if (pHitch && event.SelfTicks > 0)
+			{
+				if (worker.HitchSelfTicks[event.SiteIndex] == 0)
+					worker.HitchSites.push_back(event.SiteIndex);
+				worker.HitchSelfTicks[event.SiteIndex] += event.SelfTicks;
+			}
+		}
+
+		worker.NumEvents += track.NumEvents;
+		if (track.TrackIndex < worker.Threads.size() && track.NumEvents > 0)
+		{
+			CaptureThreadAnalysis& thread = worker.Threads[track.TrackIndex];
+			thread.NumEvents += track.NumEvents;
+			thread.BusyTicks += busyTicks;
+			++thread.NumFrames;
+			if (frameTicks > 0)
+				thread.PeakUtilization = std::max(thread.PeakUtilization, (double)busyTicks / frameTicks);
+		}
+	}
+
+	if (pWaitSites)
+	{
+		ComputeCriticalPath(frame, *pWaitSites, worker.Path, worker.PathSites);
+		for (const CriticalPath::Segment& segment : worker.Path.GetSegments())
+		{
+			uint32 siteIndex = worker.PathSites[segment.EventIndex];
+			if (siteIndex < numSites)
+				worker.Sites[siteIndex].CriticalPathTicks += segment.TicksEnd - segment.TicksBegin;
+		}
+	}
+
+	if (pHitch)
+	{
+		pHitch->FrameIndex = frame.FrameIndex;
+		uint32 numTopSites = std::min(numHitchSites, (uint32)worker.HitchSites.size());
+		std::partial_sort(worker.HitchSites.begin(), worker.HitchSites.begin() + numTopSites, worker.HitchSites.end(),
+			[&](uint32 a, uint32 b) {
+				return worker.HitchSelfTicks[a] != worker.HitchSelfTicks[b] ? worker.HitchSelfTicks[a] > worker.HitchSelfTicks[b] : a < b;
+			});
+		for (uint32 i = 0; i < numTopSites; ++i)
+			pHitch->TopSites.push_back({ worker.HitchSites[i], worker.HitchSelfTicks[worker.HitchSites[i]] });
+
+		for (uint32 siteIndex : worker.HitchSites)
+			worker.HitchSelfTicks[siteIndex] = 0;
+		worker.HitchSites.clear();
+	}
+}
+
+bool AnalyzeCapture(const CaptureReader& capture, const CaptureAnalysisOptions& options, CaptureAnalysis& outAnalysis)
+{
+	outAnalysis = CaptureAnalysis();
+	Span<const CaptureFormat::FrameEntry> frames = capture.GetCPUFrames();
+	if (frames.empty())
+		return false;
+
+	uint32 numFrames = (uint32)frames.size();
+	uint32 numSites = (uint32)capture.GetSites().size();
+	uint32 numThreads = (uint32)capture.GetThreads().size();
+	outAnalysis.TicksPerSecond = capture.GetTicksPerSecond();
+	outAnalysis.NumFrames = numFrames;
+
+	// The frame times are in the index, so the hitches are known before any frame is decoded
+	for (const CaptureFormat::FrameEntry& entry : frames)
+	{
+		outAnalysis.FrameTimes.Add(entry.TicksEnd - entry.TicksBegin);
+		outAnalysis.TotalTicks += entry.TicksEnd - entry.TicksBegin;
+	}
+
+	if (options.HitchThresholdMs > 0.0)
+		outAnalysis.HitchThresholdTicks = (uint64)(options.HitchThresholdMs * outAnalysis.TicksPerSecond / 1000.0);
+	else
+		outAnalysis.HitchThresholdTicks = (uint64)(options.HitchFactor * outAnalysis.FrameTimes.GetPercentile(50.0));
+
+	std::vector<uint32> hitchFrames;
+	for (uint32 frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+	{
+		if (frames[frameIndex].TicksEnd - frames[frameIndex].TicksBegin > outAnalysis.HitchThresholdTicks)
+			hitchFrames.push_back(frameIndex);
+	}
+	outAnalysis.NumHitches = (uint32)hitchFrames.size();
+	std::stable_sort(hitchFrames.begin(), hitchFrames.end(), [&](uint32 a, uint32 b) {
+		return frames[a].TicksEnd - frames[a].TicksBegin > frames[b].TicksEnd - frames[b].TicksBegin;
+	});
+	if (options.MaxHitches > 0 && hitchFrames.size() > options.MaxHitches)
+		hitchFrames.resize(options.MaxHitches);
+
+	// Each listed hitch has its own slot, so workers fill them in without locking
+	std::vector<uint32> hitchSlots(numFrames, ~0u);
+	outAnalysis.Hitches.resize(hitchFrames.size());
+	for (uint32 slot = 0; slot < (uint32)hitchFrames.size(); ++slot)
+	{
+		const CaptureFormat::FrameEntry& entry = frames[hitchFrames[slot]];
+		CaptureHitch& hitch = outAnalysis.Hitches[slot];
+		hitch.CaptureFrameIndex = hitchFrames[slot];
+		hitch.FrameIndex = entry.FrameIndex;
+		hitch.TicksBegin = entry.TicksBegin;
+		hitch.Ticks = entry.TicksEnd - entry.TicksBegin;
+		hitchSlots[hitchFrames[slot]] = slot;
+	}
+
+	TaskScheduler* pScheduler = options.pScheduler;
+	std::unique_ptr<TaskScheduler> pOwnScheduler;
+	if (!pScheduler)
+	{
+		uint32 numWorkers = options.NumThreads > 0 ? options.NumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+		pOwnScheduler = std::make_unique<TaskScheduler>(std::min(numWorkers, (numFrames + FramesPerBatch - 1) / FramesPerBatch));
+		pScheduler = pOwnScheduler.get();
+	}
+	outAnalysis.NumWorkerThreads = pScheduler->GetNumWorkers();
+
+	// Each worker starts with a contiguous share of the frames, which keeps its reads of the mapped file mostly sequential
+	std::vector<bool> waitSites = options.FindCriticalPaths ? GetWaitSites(capture) : std::vector<bool>();
+	std::vector<CaptureAnalysisWorker> workers(pScheduler->GetNumWorkers());
+	for (CaptureAnalysisWorker& worker : workers)
+	{
+		worker.Sites.resize(numSites);
+		worker.Threads.resize(numThreads);
+		worker.SiteFrames.assign(numSites, ~0u);
+		worker.HitchSelfTicks.assign(numSites, 0);
+	}
+
+	pScheduler->ParallelFor(numFrames, FramesPerBatch, [&](uint32 batchBegin, uint32 batchEnd, uint32 workerIndex) {
+		for (uint32 frameIndex = batchBegin; frameIndex < batchEnd; ++frameIndex)
+		{
+			CaptureHitch* pHitch = hitchSlots[frameIndex] != ~0u ? &outAnalysis.Hitches[hitchSlots[frameIndex]] : nullptr;
+			AnalyzeFrame(capture, frameIndex, workers[workerIndex], options.FindCriticalPaths ? &waitSites : nullptr, pHitch, options.NumHitchSites);
+		}
+	});
+
+	// Merge the partial results. Each frame was analyzed by a single worker, so the frame counts add up.
+	outAnalysis.Sites.resize(numSites);
+	outAnalysis.Threads.resize(numThreads);
+	for (const CaptureAnalysisWorker& worker : workers)
+	{
+		outAnalysis.NumEvents += worker.NumEvents;
+		for (uint32 siteIndex = 0; siteIndex < numSites; ++siteIndex)
+		{
+			const CaptureSiteAnalysis& source = worker.Sites[siteIndex];
+			CaptureSiteAnalysis& site = outAnalysis.Sites[siteIndex];
+			site.NumCalls += source.NumCalls;
+			site.NumFrames += source.NumFrames;
+			site.InclusiveTicks += source.InclusiveTicks;
+			site.SelfTicks += source.SelfTicks;
+			site.MaxCallTicks = std::max(site.MaxCallTicks, source.MaxCallTicks);
+			site.CriticalPathTicks += source.CriticalPathTicks;
+		}
+		for (uint32 threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+		{
+			const CaptureThreadAnalysis& source = worker.Threads[threadIndex];
+			CaptureThreadAnalysis& thread = outAnalysis.Threads[threadIndex];
+			thread.NumEvents += source.NumEvents;
+			thread.NumFrames += source.NumFrames;
+			thread.BusyTicks += source.BusyTicks;
+			thread.PeakUtilization = std::max(thread.PeakUtilization, source.PeakUtilization);
+		}
+	}
+
+	for (CaptureThreadAnalysis& thread : outAnalysis.Threads)
+		thread.Utilization = outAnalysis.TotalTicks > 0 ? (double)thread.BusyTicks / outAnalysis.TotalTicks : 0.0;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Report Output
+//-----------------------------------------------------------------------------
+
+enum class SiteOrder
+{
+	Inclusive,
+	Self,
+	CriticalPath,		// Only the sites on the critical path
+};
+
+// Site indices with calls, sorted by the given time
+static std::vector<uint32> GetSortedSites(const CaptureAnalysis& analysis, SiteOrder order)
+{
+	auto GetTicks = [&](uint32 siteIndex) {
+		const CaptureSiteAnalysis& site = analysis.Sites[siteIndex];
+		return order == SiteOrder::Inclusive ? site.InclusiveTicks : order == SiteOrder::Self ? site.SelfTicks : site.CriticalPathTicks;
+	};
+
+	std::vector<uint32> sites;
+	for (uint32 siteIndex = 0; siteIndex < (uint32)analysis.Sites.size(); ++siteIndex)
+	{
+		if (analysis.Sites[siteIndex].NumCalls > 0 && (order != SiteOrder::CriticalPath || GetTicks(siteIndex) > 0))
+			sites.push_back(siteIndex);
+	}
+	std::stable_sort(sites.begin(), sites.end(), [&](uint32 a, uint32 b) { return GetTicks(a) > GetTicks(b); });
+	return sites;
+}
+
+static const char* GetSiteName(const CaptureReader& capture, uint32 siteIndex)
+{
+	return siteIndex < capture.GetSites().size() ? capture.GetSites()[siteIndex].pName : "???";
+}
+
+struct FramePercentile
+{
+	const char* pName;
+	double		Percentile;
+};
+
+static constexpr FramePercentile FramePercentiles[] = {
+	{ "p50", 50.0 },
+	{ "p90", 90.0 },
+	{ "p99", 99.0 },
+	{ "p99.9", 99.9 },
+};
+
+/*
+	Site                               Incl ms/frame  Incl %  Self ms/frame  Self %  Path ms/frame  Path %  Calls/frame  Max call ms
+	Frame                                     15.912   95.1%          0.104    0.6%          0.104    0.6%          1.0       18.204
+*/
+static void WriteSiteTableText(const CaptureReader& capture, const CaptureAnalysis& analysis, Span<const uint32> sites, FILE* pFile)
+{
+	double frames = (double)analysis.NumFrames;
+	double totalMs = analysis.TicksToMs(analysis.TotalTicks);
+	fprintf(pFile, "%-34s %14s %7s %14s %7s %14s %7s %12s %12s\n", "Site", "Incl ms/frame", "Incl %", "Self ms/frame", "Self %", "Path ms/frame", "Path %", "Calls/frame", "Max call ms");
+	for (uint32 siteIndex : sites)
+	{
+		const CaptureSiteAnalysis& site = analysis.Sites[siteIndex];
+		char name[40];
+		snprintf(name, sizeof(name), "%s", GetSiteName(capture, siteIndex));
+		double inclusiveMs = analysis.TicksToMs(site.InclusiveTicks);
+		double selfMs = analysis.TicksToMs(site.SelfTicks);
+		double pathMs = analysis.TicksToMs(site.CriticalPathTicks);
+		fprintf(pFile, "%-34s %14.3f %6.1f%% %14.3f %6.1f%% %14.3f %6.1f%% %12.1f %12.3f\n",
+			name, inclusiveMs / frames, totalMs > 0.0 ? inclusiveMs / totalMs * 100.0 : 0.0, selfMs / frames, totalMs > 0.0 ? selfMs / totalMs * 100.0 : 0.0,
+			pathMs / frames, totalMs > 0.0 ? pathMs / totalMs * 100.0 : 0.0, site.NumCalls / frames, analysis.TicksToMs(site.MaxCallTicks));
+	}
+}
+
+void WriteAnalysisText(const CaptureReader& capture, const CaptureAnalysis& analysis, FILE* pFile, uint32 maxSites)
+{
+	double totalMs = analysis.TicksToMs(analysis.TotalTicks);
+	fprintf(pFile, "%u frames, %llu events, %.3f s. Percentages are relative to the duration of all frames.\n\n",
+		analysis.NumFrames, (unsigned long long)analysis.NumEvents, totalMs / 1000.0);
+
+	// Frame times
+	fprintf(pFile, "%-10s %9s %9s", "Frame ms", "mean", "min");
+	for (const FramePercentile& percentile : FramePercentiles)
+		fprintf(pFile, " %9s", percentile.pName);
+	fprintf(pFile, " %9s\n%-10s %9.3f %9.3f", "max", "", totalMs / analysis.NumFrames, analysis.TicksToMs(analysis.FrameTimes.GetMin()));
+	for (const FramePercentile& percentile : FramePercentiles)
+		fprintf(pFile, " %9.3f", analysis.TicksToMs(analysis.FrameTimes.GetPercentile(percentile.Percentile)));
+	fprintf(pFile, " %9.3f\n\n", analysis.TicksToMs(analysis.FrameTimes.GetMax()));
+
+	// Sites
+	for (SiteOrder order : { SiteOrder::Inclusive, SiteOrder::Self, SiteOrder::CriticalPath })
+	{
+		std::vector<uint32> sites = GetSortedSites(analysis, order);
+		if (sites.empty())
+			continue;
+		uint32 numSites = maxSites == 0 ? (uint32)sites.size() : std::min(maxSites, (uint32)sites.size());
+		fprintf(pFile, "Top sites by %s\n", order == SiteOrder::Inclusive ? "inclusive time" : order == SiteOrder::Self ? "self time" : "time on the critical path");
+		WriteSiteTableText(capture, analysis, Span<const uint32>(sites.data(), numSites), pFile);
+		if (numSites < sites.size())
+			fprintf(pFile, "... %zu more sites\n", sites.size() - numSites);
+		fprintf(pFile, "\n");
+	}
+
+	// Threads
+	fprintf(pFile, "%-34s %10s %12s %14s %7s %7s\n", "Thread", "ID", "Events", "Busy ms/frame", "Util %", "Peak %");
+	for (uint32 threadIndex = 0; threadIndex < (uint32)analysis.Threads.size(); ++threadIndex)
+	{
+		const CaptureThreadAnalysis& thread = analysis.Threads[threadIndex];
+		if (thread.NumEvents == 0)
+			continue;
+		const CaptureThread& captureThread = capture.GetThreads()[threadIndex];
+		char name[40];
+		snprintf(name, sizeof(name), "%s", captureThread.pName);
+		fprintf(pFile, "%-34s %10u %12llu %14.3f %6.1f%% %6.1f%%\n", name, captureThread.ThreadID, (unsigned long long)thread.NumEvents,
+			analysis.TicksToMs(thread.BusyTicks) / analysis.NumFrames, thread.Utilization * 100.0, thread.PeakUtilization * 100.0);
+	}
+
+	// Hitches
+	fprintf(pFile, "\n%u hitch%s longer than %.3f ms", analysis.NumHitches, analysis.NumHitches == 1 ? "" : "es", analysis.TicksToMs(analysis.HitchThresholdTicks));
+	if (analysis.Hitches.size() < analysis.NumHitches)
+		fprintf(pFile, ", %zu longest listed", analysis.Hitches.size());
+	fprintf(pFile, "\n");
+	if (!analysis.Hitches.empty())
+	{
+		uint64 ticksBegin = capture.GetCPUFrames()[0].TicksBegin;
+		fprintf(pFile, "%-10s %10s %10s %9s  %s\n", "Frame", "Capture", "Time s", "ms", "Top self time");
+		for (const CaptureHitch& hitch : analysis.Hitches)
+		{
+			fprintf(pFile, "%-10u %10u %10.3f %9.3f ", hitch.FrameIndex, hitch.CaptureFrameIndex,
+				analysis.TicksToMs(hitch.TicksBegin - ticksBegin) / 1000.0, analysis.TicksToMs(hitch.Ticks));
+			for (size_t i = 0; i < hitch.TopSites.size(); ++i)
+				fprintf(pFile, "%s %s %.3f", i == 0 ? "" : ",", GetSiteName(capture, hitch.TopSites[i].SiteIndex), analysis.TicksToMs(hitch.TopSites[i].SelfTicks));
+			fprintf(pFile, "\n");
+		}
+	}
+}
+
+static void WriteJSONString(const char* pStr, FILE* pFile)
+{
+	fputc('"', pFile);
+	for (const char* pChar = pStr ? pStr : ""; *pChar; ++pChar)
+	{
+		char c = *pChar;
+		if (c == '"' || c == '\\')
+			fprintf(pFile, "\\%c", c);
+		else if ((unsigned char)c < 0x20)
+			fprintf(pFile, "\\u%04x", c);
+		else
+			fputc(c, pFile);
+	}
+	fputc('"', pFile);
+}
+
+void WriteAnalysisJSON(const CaptureReader& capture, const CaptureAnalysis& analysis, FILE* pFile)
+{
+	double totalMs = analysis.TicksToMs(analysis.TotalTicks);
+	fprintf(pFile, "{\"frames\":%u,\"events\":%llu,\"duration_ms\":%.6f,\"ticks_per_second\":%llu,\n",
+		analysis.NumFrames, (unsigned long long)analysis.NumEvents, totalMs, (unsigned long long)analysis.TicksPerSecond);
+
+	fprintf(pFile, "\"frame_ms\":{\"mean\":%.6f,\"min\":%.6f", totalMs / analysis.NumFrames, analysis.TicksToMs(analysis.FrameTimes.GetMin()));
+	for (const FramePercentile& percentile : FramePercentiles)
+		fprintf(pFile, ",\"%s\":%.6f", percentile.pName, analysis.TicksToMs(analysis.FrameTimes.GetPercentile(percentile.Percentile)));
+	fprintf(pFile, ",\"max\":%.6f},\n", analysis.TicksToMs(analysis.FrameTimes.GetMax()));
+
+	fprintf(pFile, "\"sites\":[");
+	bool isFirst = true;
+	for (uint32 siteIndex : GetSortedSites(analysis, SiteOrder::Inclusive))
+	{
+		const CaptureSiteAnalysis& site = analysis.Sites[siteIndex];
+		const CaptureSite& captureSite = capture.GetSites()[siteIndex];
+		fprintf(pFile, isFirst ? "\n{\"name\":" : ",\n{\"name\":");
+		WriteJSONString(captureSite.pName, pFile);
+		fprintf(pFile, ",\"file\":");
+		WriteJSONString(captureSite.pFilePath, pFile);
+		fprintf(pFile, ",\"line\":%u,\"calls\":%llu,\"frames\":%u,\"inclusive_ms\":%.6f,\"self_ms\":%.6f,\"critical_path_ms\":%.6f,\"max_call_ms\":%.6f}",
+			captureSite.LineNumber, (unsigned long long)site.NumCalls, site.NumFrames, analysis.TicksToMs(site.InclusiveTicks),
+			analysis.TicksToMs(site.SelfTicks), analysis.TicksToMs(site.CriticalPathTicks), analysis.TicksToMs(site.MaxCallTicks));
+		isFirst = false;
+	}
+
+	fprintf(pFile, "\n],\n\"threads\":[");
+	isFirst = true;
+	for (uint32 threadIndex = 0; threadIndex < (uint32)analysis.Threads.size(); ++threadIndex)
+	{
+		const CaptureThreadAnalysis& thread = analysis.Threads[threadIndex];
+		const CaptureThread& captureThread = capture.GetThreads()[threadIndex];
+		fprintf(pFile, isFirst ? "\n{\"name\":" : ",\n{\"name\":");
+		WriteJSONString(captureThread.pName, pFile);
+		fprintf(pFile, ",\"id\":%u,\"events\":%llu,\"frames\":%u,\"busy_ms\":%.6f,\"utilization\":%.6f,\"peak_utilization\":%.6f}",
+			captureThread.ThreadID, (unsigned long long)thread.NumEvents, thread.NumFrames,
+			analysis.TicksToMs(thread.BusyTicks), thread.Utilization, thread.PeakUtilization);
+		isFirst = false;
+	}
+
+	uint64 ticksBegin = capture.GetCPUFrames()[0].TicksBegin;
+	fprintf(pFile, "\n],\n\"hitch_threshold_ms\":%.6f,\"hitches_total\":%u,\n\"hitches\":[", analysis.TicksToMs(analysis.HitchThresholdTicks), analysis.NumHitches);
+	for (size_t i = 0; i < analysis.Hitches.size(); ++i)
+	{
+		const CaptureHitch& hitch = analysis.Hitches[i];
+		fprintf(pFile, "%s{\"frame\":%u,\"capture_frame\":%u,\"begin_ms\":%.6f,\"ms\":%.6f,\"top_sites\":[", i == 0 ? "\n" : ",\n",
+			hitch.FrameIndex, hitch.CaptureFrameIndex, analysis.TicksToMs(hitch.TicksBegin - ticksBegin), analysis.TicksToMs(hitch.Ticks));
+		for (size_t siteIndex = 0; siteIndex < hitch.TopSites.size(); ++siteIndex)
+		{
+			fprintf(pFile, siteIndex == 0 ? "{\"name\":" : ",{\"name\":");
+			WriteJSONString(GetSiteName(capture, hitch.TopSites[siteIndex].SiteIndex), pFile);
+			fprintf(pFile, ",\"self_ms\":%.6f}", analysis.TicksToMs(hitch.TopSites[siteIndex].SelfTicks));
+		}
+		fprintf(pFile, "]}");
+	}
+	fprintf(pFile, "\n]}\n");
+}
+
+// Quote a field if it contains a separator, a quote or a line break
+static void WriteCSVString(const char* pStr, FILE* pFile)
+{
+	pStr = pStr ? pStr : "";
+	if (!strpbrk(pStr, ",\"\r\n"))
+	{
+		fputs(pStr, pFile);
+		return;
+	}
+	fputc('"', pFile);
+	for (const char* pChar = pStr; *pChar; ++pChar)
+	{
+		if (*pChar == '"')
+			fputc('"', pFile);
+		fputc(*pChar, pFile);
+	}
+	fputc('"', pFile);
+}
+
+void WriteAnalysisCSV(const CaptureReader& capture, const CaptureAnalysis& analysis, CaptureAnalysisTable table, FILE* pFile)
+{
+	switch (table)
+	{
+	case CaptureAnalysisTable::Frames:
+		fprintf(pFile, "statistic,ms\n");
+		fprintf(pFile, "mean,%.6f\n", analysis.TicksToMs(analysis.TotalTicks) / analysis.NumFrames);
+		fprintf(pFile, "min,%.6f\n", analysis.TicksToMs(analysis.FrameTimes.GetMin()));
+		for (const FramePercentile& percentile : FramePercentiles)
+			fprintf(pFile, "%s,%.6f\n", percentile.pName, analysis.TicksToMs(analysis.FrameTimes.GetPercentile(percentile.Percentile)));
+		fprintf(pFile, "max,%.6f\n", analysis.TicksToMs(analysis.FrameTimes.GetMax()));
+		break;
+
+	case CaptureAnalysisTable::Sites:
+		fprintf(pFile, "name,file,line,calls,frames,inclusive_ms,self_ms,critical_path_ms,max_call_ms\n");
+		for (uint32 siteIndex : GetSortedSites(analysis, SiteOrder::Inclusive))
+		{
+			const CaptureSiteAnalysis& site = analysis.Sites[siteIndex];
+			const CaptureSite& captureSite = capture.GetSites()[siteIndex];
+			WriteCSVString(captureSite.pName, pFile);
+			fputc(',', pFile);
+			WriteCSVString(captureSite.pFilePath, pFile);
+			fprintf(pFile, ",%u,%llu,%u,%.6f,%.6f,%.6f,%.6f\n", captureSite.LineNumber, (unsigned long long)site.NumCalls, site.NumFrames, analysis.TicksToMs(site.InclusiveTicks),
+				analysis.TicksToMs(site.SelfTicks), analysis.TicksToMs(site.CriticalPathTicks), analysis.TicksToMs(site.MaxCallTicks));
+		}
+		break;
+
+	case CaptureAnalysisTable::Threads:
+		fprintf(pFile, "name,id,events,frames,busy_ms,utilization,peak_utilization\n");
+		for (uint32 threadIndex = 0; threadIndex < (uint32)analysis.Threads.size(); ++threadIndex)
+		{
+			const CaptureThreadAnalysis& thread = analysis.Threads[threadIndex];
+			const CaptureThread& captureThread = capture.GetThreads()[threadIndex];
+			WriteCSVString(captureThread.pName, pFile);
+			fprintf(pFile, ",%u,%llu,%u,%.6f,%.6f,%.6f\n", captureThread.ThreadID, (unsigned long long)thread.NumEvents, thread.NumFrames,
+				analysis.TicksToMs(thread.BusyTicks), thread.Utilization, thread.PeakUtilization);
+		}
+		break;
+
+	case CaptureAnalysisTable::Hitches:
+	{
+		// The top sites are flattened into a fixed number of columns
+		uint32 numTopSites = 0;
+		for (const CaptureHitch& hitch : analysis.Hitches)
+			numTopSites = std::max(numTopSites, (uint32)hitch.TopSites.size());
+
+		fprintf(pFile, "frame,capture_frame,begin_ms,ms");
+		for (uint32 i = 0; i < numTopSites; ++i)
+			fprintf(pFile, ",site_%u,site_%u_self_ms", i + 1, i + 1);
+		fprintf(pFile, "\n");
+
+		uint64 ticksBegin = capture.GetCPUFrames().empty() ? 0 : capture.GetCPUFrames()[0].TicksBegin;
+		for (const CaptureHitch& hitch : analysis.Hitches)
+		{
+			fprintf(pFile, "%u,%u,%.6f,%.6f", hitch.FrameIndex, hitch.CaptureFrameIndex, analysis.TicksToMs(hitch.TicksBegin - ticksBegin), analysis.TicksToMs(hitch.Ticks));
+			for (uint32 i = 0; i < numTopSites; ++i)
+			{
+				fputc(',', pFile);
+				if (i < hitch.TopSites.size())
+				{
+					WriteCSVString(GetSiteName(capture, hitch.TopSites[i].SiteIndex), pFile);
+					fprintf(pFile, ",%.6f", analysis.TicksToMs(hitch.TopSites[i].SelfTicks));
+				}
+				else
+				{
+					fputc(',', pFile);
+				}
+			}
+			fprintf(pFile, "\n");
+		}
+		break;
+	}
+	}
+}
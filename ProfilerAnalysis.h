@@ -0,0 +1,110 @@
+#pragma once
+
+// Summarize a capture without the HUD: frame time percentiles, the most expensive sites, thread utilization and hitches.
+
+#include "ProfilerStats.h"
+
+#include <cstdio>
+#include <vector>
+
+class CaptureReader;
+class TaskScheduler;
+
+struct CaptureAnalysisOptions
+{
+	// Number of threads decoding frames. 0 to use a thread per core
+	uint32	NumThreads = 0;
+
+	// Run on the workers of an existing scheduler instead of starting NumThreads threads
+	TaskScheduler* pScheduler = nullptr;
+
+	// A frame is a hitch if it is longer than HitchThresholdMs.
+	// If the threshold is 0, a frame is a hitch if it is longer than HitchFactor times the median frame time.
+	double	HitchThresholdMs = 0.0;
+	double	HitchFactor = 2.0;
+
+	// Maximum number of hitches in the report, longest first. 0 for all.
+	uint32	MaxHitches = 100;
+
+	// Number of sites with the most self time listed for each hitch
+	uint32	NumHitchSites = 3;
+
+	// Find the critical path of each frame for the time of the sites on the path. About doubles the time per event.
+	bool	FindCriticalPaths = true;
+};
+
+// Totals of a site over all frames and threads
+struct CaptureSiteAnalysis
+{
+	uint64	NumCalls = 0;
+	uint32	NumFrames = 0;				// Frames in which the site was called
+	uint64	InclusiveTicks = 0;			// Recursive calls are only counted once
+	uint64	SelfTicks = 0;
+	uint64	MaxCallTicks = 0;			// Longest single call
+	uint64	CriticalPathTicks = 0;		// Time on the critical path of the frames, see CriticalPath. 0 unless FindCriticalPaths is set
+};
+
+// Time a thread spent in its top-level events
+struct CaptureThreadAnalysis
+{
+	uint64	NumEvents = 0;
+	uint32	NumFrames = 0;				// Frames in which the thread had events
+	uint64	BusyTicks = 0;
+	double	Utilization = 0.0;			// BusyTicks relative to the duration of all frames
+	double	PeakUtilization = 0.0;		// Highest utilization in a single frame
+};
+
+struct CaptureHitch
+{
+	struct SiteTime
+	{
+		uint32 SiteIndex;
+		uint64 SelfTicks;
+	};
+
+	uint32					CaptureFrameIndex = 0;	// Index in CaptureReader::GetCPUFrames()
+	uint32					FrameIndex = 0;			// Frame number of the profiler
+	uint64					TicksBegin = 0;
+	uint64					Ticks = 0;
+	std::vector<SiteTime>	TopSites;				// Most self time first
+};
+
+struct CaptureAnalysis
+{
+	uint64								TicksPerSecond = 0;
+	uint32								NumFrames = 0;
+	uint64								NumEvents = 0;
+	uint64								TotalTicks = 0;				// Sum of the frame durations
+	ProfilerHistogram					FrameTimes;					// Duration of each frame, in ticks
+	std::vector<CaptureSiteAnalysis>	Sites;						// Indexed like CaptureReader::GetSites()
+	std::vector<CaptureThreadAnalysis>	Threads;					// Indexed like CaptureReader::GetThreads()
+	std::vector<CaptureHitch>			Hitches;					// Longest first, at most MaxHitches
+	uint32								NumHitches = 0;				// Total number of hitches, including the ones not listed
+	uint64								HitchThresholdTicks = 0;
+	uint32								NumWorkerThreads = 0;
+
+	double TicksToMs(uint64 ticks) const { return TicksPerSecond > 0 ? (double)ticks * 1000.0 / TicksPerSecond : 0.0; }
+};
+
+// Analyze the CPU frames of a capture.
+// Frames are decoded one at a time per worker thread, so memory usage does not depend on the length of the capture.
+// The results do not depend on the number of threads.
+// Returns false if the capture has no CPU frames.
+bool AnalyzeCapture(const CaptureReader& capture, const CaptureAnalysisOptions& options, CaptureAnalysis& outAnalysis);
+
+// Write the analysis as aligned text tables, with the top maxSites sites by inclusive and by self time, or all sites if maxSites is 0
+void WriteAnalysisText(const CaptureReader& capture, const CaptureAnalysis& analysis, FILE* pFile, uint32 maxSites = 0);
+
+// Write the analysis as JSON, with all sites
+void WriteAnalysisJSON(const CaptureReader& capture, const CaptureAnalysis& analysis, FILE* pFile);
+
+enum class CaptureAnalysisTable
+{
+	Frames,		// Frame time percentiles
+	Sites,		// All sites, by inclusive time
+	Threads,
+	Hitches,
+};
+
+// Write a single table of the analysis as CSV, with a header row
+void WriteAnalysisCSV(const CaptureReader& capture, const CaptureAnalysis& analysis, CaptureAnalysisTable table, FILE* pFile);
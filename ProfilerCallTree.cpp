@@ -0,0 +1,166 @@
+
+#include "ProfilerCallTree.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Call Tree
+//-----------------------------------------------------------------------------
+
+void CallTree::Reset()
+{
+	m_Nodes.clear();
+	m_Nodes.emplace_back();
+	m_ChildLookup.clear();
+	m_Stack.clear();
+	m_SiteNames.clear();
+	m_NumFrames = 0;
+}
+
+
+void CallTree::SetSiteName(uint32 siteIndex, const char* pName)
+{
+	if (siteIndex >= m_SiteNames.size())
+		m_SiteNames.resize(siteIndex + 1);
+	if (m_SiteNames[siteIndex].empty())
+		m_SiteNames[siteIndex] = pName;
+}
+
+
+const char* CallTree::GetSiteName(uint32 siteIndex) const
+{
+	if (siteIndex >= m_SiteNames.size() || m_SiteNames[siteIndex].empty())
+		return "???";
+	return m_SiteNames[siteIndex].c_str();
+}
+
+
+void CallTree::BeginTrack()
+{
+	m_Stack.clear();
+}
+
+
+void CallTree::AddEvent(uint32 siteIndex, uint32 depth, uint64 ticksBegin, uint64 ticksEnd)
+{
+	// Events are in pre-order, so the stack only holds the ancestors of the event after truncating it to its depth
+	if (depth < m_Stack.size())
+		m_Stack.resize(depth);
+
+	uint32 parent = m_Stack.empty() ? RootNode : m_Stack.back();
+	uint32 nodeIndex = FindOrAddChild(parent, siteIndex);
+	uint64 ticks = ticksEnd - ticksBegin;
+
+	Node& node = m_Nodes[nodeIndex];
+	node.InclusiveTicks += ticks;
+	node.ExclusiveTicks += ticks;
+	++node.NumCalls;
+
+	// The time of the event is not part of the exclusive time of its parent
+	Node& parentNode = m_Nodes[parent];
+	if (parent == RootNode)
+		parentNode.InclusiveTicks += ticks;
+	else
+		parentNode.ExclusiveTicks -= std::min(parentNode.ExclusiveTicks, ticks);
+
+	m_Stack.push_back(nodeIndex);
+}
+
+
+void CallTree::Merge(const CallTree& other)
+{
+	for (uint32 siteIndex = 0; siteIndex < (uint32)other.m_SiteNames.size(); ++siteIndex)
+	{
+		if (!other.m_SiteNames[siteIndex].empty())
+			SetSiteName(siteIndex, other.m_SiteNames[siteIndex].c_str());
+	}
+	m_NumFrames += other.m_NumFrames;
+	m_Nodes[RootNode].InclusiveTicks += other.m_Nodes[RootNode].InclusiveTicks;
+
+	// Nodes are created after their parent, so the parent of each node of the other tree is already mapped
+	std::vector<uint32> nodeMap(other.m_Nodes.size(), RootNode);
+	for (uint32 otherIndex = 1; otherIndex < (uint32)other.m_Nodes.size(); ++otherIndex)
+	{
+		const Node& otherNode = other.m_Nodes[otherIndex];
+		uint32 nodeIndex = FindOrAddChild(nodeMap[otherNode.Parent], otherNode.SiteIndex);
+		Node& node = m_Nodes[nodeIndex];
+		node.InclusiveTicks += otherNode.InclusiveTicks;
+		node.ExclusiveTicks += otherNode.ExclusiveTicks;
+		node.NumCalls += otherNode.NumCalls;
+		nodeMap[otherIndex] = nodeIndex;
+	}
+}
+
+
+void CallTree::BuildBottomUp(const CallTree& topDown)
+{
+	Reset();
+	m_SiteNames = topDown.m_SiteNames;
+	m_NumFrames = topDown.m_NumFrames;
+	m_Nodes[RootNode].InclusiveTicks = topDown.m_Nodes[RootNode].InclusiveTicks;
+
+	for (uint32 topDownIndex = 1; topDownIndex < (uint32)topDown.m_Nodes.size(); ++topDownIndex)
+	{
+		const Node& topDownNode = topDown.m_Nodes[topDownIndex];
+
+		// A recursive call is already part of the inclusive time of the outermost call of the same site
+		bool isOutermost = true;
+		for (uint32 ancestor = topDownNode.Parent; ancestor != RootNode; ancestor = topDown.m_Nodes[ancestor].Parent)
+		{
+			if (topDown.m_Nodes[ancestor].SiteIndex == topDownNode.SiteIndex)
+			{
+				isOutermost = false;
+				break;
+			}
+		}
+
+		// Walk the path from the site up to the top level and add the time of the site to each node of the reversed path
+		uint32 nodeIndex = RootNode;
+		for (uint32 pathIndex = topDownIndex; pathIndex != RootNode; pathIndex = topDown.m_Nodes[pathIndex].Parent)
+		{
+			nodeIndex = FindOrAddChild(nodeIndex, topDown.m_Nodes[pathIndex].SiteIndex);
+			Node& node = m_Nodes[nodeIndex];
+			node.ExclusiveTicks += topDownNode.ExclusiveTicks;
+			node.NumCalls += topDownNode.NumCalls;
+			if (isOutermost)
+				node.InclusiveTicks += topDownNode.InclusiveTicks;
+		}
+	}
+}
+
+
+void CallTree::Finalize()
+{
+	std::vector<uint32> children;
+	for (Node& node : m_Nodes)
+	{
+		children.clear();
+		for (uint32 child = node.FirstChild; child != InvalidNode; child = m_Nodes[child].NextSibling)
+			children.push_back(child);
+		if (children.size() < 2)
+			continue;
+
+		std::sort(children.begin(), children.end(), [this](uint32 a, uint32 b) { return m_Nodes[a].InclusiveTicks > m_Nodes[b].InclusiveTicks; });
+		node.FirstChild = children[0];
+		for (size_t i = 0; i < children.size(); ++i)
+			m_Nodes[children[i]].NextSibling = i + 1 < children.size() ? children[i + 1] : InvalidNode;
+	}
+}
+
+
+uint32 CallTree::FindOrAddChild(uint32 parent, uint32 siteIndex)
+{
+	uint64 key = ((uint64)parent << 32) | siteIndex;
+	auto it = m_ChildLookup.find(key);
+	if (it != m_ChildLookup.end())
+		return it->second;
+
+	uint32 nodeIndex = (uint32)m_Nodes.size();
+	Node& node = m_Nodes.emplace_back();
+	node.SiteIndex = siteIndex;
+	node.Parent = parent;
+	node.NextSibling = m_Nodes[parent].FirstChild;
+	m_Nodes[parent].FirstChild = nodeIndex;
+	m_ChildLookup.emplace(key, nodeIndex);
+	return nodeIndex;
+}
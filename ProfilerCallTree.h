@@ -0,0 +1,77 @@
+#pragma once
+
+// Aggregated call trees over a range of frames.
+
+#include "ProfilerTypes.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Call Tree
+//-----------------------------------------------------------------------------
+
+// Merges the nested events of many frames and threads into a tree of call paths.
+// A top-down tree has a node per unique path of sites from the top level event, so the children of a node are its callees.
+// A bottom-up tree has a node per site at the first level, with its callers as children, so the time of a function
+// can be followed up to all the places it is called from.
+// Not thread safe. A tree can be built on a worker thread and read once it is done.
+class CallTree
+{
+public:
+	static constexpr uint32 InvalidNode = ~0u;
+	static constexpr uint32 RootNode = 0;
+
+	struct Node
+	{
+		uint32 SiteIndex = ~0u;				// ~0u for the root
+		uint32 Parent = InvalidNode;
+		uint32 FirstChild = InvalidNode;	// Children are sorted by inclusive time once the tree is finalized
+		uint32 NextSibling = InvalidNode;
+		uint64 InclusiveTicks = 0;			// Time in the calls, including their callees
+		uint64 ExclusiveTicks = 0;			// Time in the calls, excluding their callees
+		uint64 NumCalls = 0;
+	};
+
+	CallTree() { Reset(); }
+
+	// Remove all nodes and names
+	void Reset();
+
+	// Name of a site, copied into the tree. Set before the tree is used by another thread than the one building it.
+	void SetSiteName(uint32 siteIndex, const char* pName);
+	const char* GetSiteName(uint32 siteIndex) const;
+
+	// Add the events of a single thread of a single frame, in pre-order (parents before their children)
+	void BeginTrack();
+	void AddEvent(uint32 siteIndex, uint32 depth, uint64 ticksBegin, uint64 ticksEnd);
+
+	// Count a frame, for the averages per frame
+	void AddFrame() { ++m_NumFrames; }
+	uint32 GetNumFrames() const { return m_NumFrames; }
+
+	// Add the nodes, names and frames of another top-down tree, eg. built by another thread over other frames.
+	// Call before the trees are finalized or made bottom-up.
+	void Merge(const CallTree& other);
+
+	// Build the bottom-up tree of a top-down tree, replacing the contents of this tree.
+	// The nodes below a site are its callers. Each caller node holds the time and calls of the site when called through that path.
+	// The inclusive time of recursive calls is only counted for the outermost call.
+	void BuildBottomUp(const CallTree& topDown);
+
+	// Sort the children of all nodes by inclusive time, highest first
+	void Finalize();
+
+	const Node& GetNode(uint32 nodeIndex) const { return m_Nodes[nodeIndex]; }
+	uint32 GetNumNodes() const { return (uint32)m_Nodes.size(); }
+
+private:
+	uint32 FindOrAddChild(uint32 parent, uint32 siteIndex);
+
+	std::vector<Node>					m_Nodes;				// Node 0 is the root
+	std::unordered_map<uint64, uint32>	m_ChildLookup;			// Parent node and site index to child node
+	std::vector<uint32>					m_Stack;				// Nodes of the open events of the current track
+	std::vector<std::string>			m_SiteNames;			// Name per site index
+	uint32								m_NumFrames = 0;
+};
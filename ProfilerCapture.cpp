@@ -0,0 +1,1035 @@
+
+// Uses the portable CRT file functions, which are flagged by the MSVC SDL checks
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerCapture.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// [SECTION] Event Encoding
+//-----------------------------------------------------------------------------
+
+static uint64 ZigZagEncode(int64_t value) { return ((uint64)value << 1) ^ (uint64)(value >> 63); }
+static int64_t ZigZagDecode(uint64 value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+static uint8* WriteVarint(uint8* pDst, uint64 value)
+{
+	while (value >= 0x80)
+	{
+		*pDst++ = (uint8)(value | 0x80);
+		value >>= 7;
+	}
+	*pDst++ = (uint8)value;
+	return pDst;
+}
+
+// Longest encoding of a 64-bit varint
+constexpr uint32 MaxVarintSize = 10;
+
+// Read a varint without bounds checks. The caller guarantees there are at least MaxVarintSize bytes left.
+static const uint8* ReadVarintUnchecked(const uint8* pSrc, uint64& outValue)
+{
+	uint64 value = *pSrc++;
+	if (value < 0x80)
+	{
+		outValue = value;
+		return pSrc;
+	}
+	value &= 0x7F;
+	for (uint32 shift = 7; shift < 64; shift += 7)
+	{
+		uint64 byte = *pSrc++;
+		value |= (byte & 0x7F) << shift;
+		if (byte < 0x80)
+			break;
+	}
+	outValue = value;
+	return pSrc;
+}
+
+static const uint8* ReadVarint(const uint8* pSrc, const uint8* pEnd, uint64& outValue)
+{
+	uint64 value = 0;
+	for (uint32 shift = 0; shift < 64 && pSrc < pEnd; shift += 7)
+	{
+		uint64 byte = *pSrc++;
+		value |= (byte & 0x7F) << shift;
+		if (byte < 0x80)
+		{
+			outValue = value;
+			return pSrc;
+		}
+	}
+	return nullptr;
+}
+
+// Decode the events of a block. Returns the end of the block, or nullptr if the data is corrupt.
+static const uint8* DecodeEvents(const uint8* pSrc, const uint8* pEnd, uint32 numEvents, CaptureEvent* pOutEvents)
+{
+	uint64 previousTicks = 0;
+	for (uint32 i = 0; i < numEvents; ++i)
+	{
+		uint64 delta, duration, siteIndex, depth;
+
+		// Valid events take at most MaxEventSize bytes, but the site and depth of a corrupt event can take up to MaxVarintSize bytes too
+		if ((uint64)(pEnd - pSrc) >= 4 * MaxVarintSize)
+		{
+			pSrc = ReadVarintUnchecked(pSrc, delta);
+			pSrc = ReadVarintUnchecked(pSrc, duration);
+			pSrc = ReadVarintUnchecked(pSrc, siteIndex);
+			pSrc = ReadVarintUnchecked(pSrc, depth);
+		}
+		else
+		{
+			// Slow path near the end of the payload
+			if (!(pSrc = ReadVarint(pSrc, pEnd, delta)) || !(pSrc = ReadVarint(pSrc, pEnd, duration)) ||
+				!(pSrc = ReadVarint(pSrc, pEnd, siteIndex)) || !(pSrc = ReadVarint(pSrc, pEnd, depth)))
+				return nullptr;
+		}
+
+		previousTicks += (uint64)ZigZagDecode(delta);
+		CaptureEvent& event = pOutEvents[i];
+		event.TicksBegin = previousTicks;
+		event.TicksEnd = previousTicks + duration;
+		event.SiteIndex = (uint32)siteIndex;
+		event.Depth = (uint32)depth;
+	}
+	return pSrc;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Encoder
+//-----------------------------------------------------------------------------
+
+void CaptureEncoder::Reset()
+{
+	m_Buffer.clear();
+	m_ChunkOffset = 0;
+	m_PreviousTicks = 0;
+	m_NumSites = 0;
+	m_NumThreads = 0;
+	m_NumQueues = 0;
+}
+
+
+void CaptureEncoder::AddSite(const char* pName, const char* pFilePath, uint32 lineNumber)
+{
+	uint32 nameLength = (uint32)strlen(pName);
+	uint32 filePathLength = pFilePath ? (uint32)strlen(pFilePath) : 0;
+
+	BeginChunk(CaptureFormat::ChunkType::Site);
+	CaptureFormat::Site site;
+	site.LineNumber = lineNumber;
+	site.NameLength = (uint16)(nameLength + 1);
+	site.FilePathLength = pFilePath ? (uint16)(filePathLength + 1) : 0;
+	Append(site);
+	AppendString(pName, nameLength);
+	if (pFilePath)
+		AppendString(pFilePath, filePathLength);
+	EndChunk();
+
+	++m_NumSites;
+}
+
+
+void CaptureEncoder::AddThread(const char* pName, uint32 threadID)
+{
+	uint32 nameLength = (uint32)strlen(pName);
+
+	BeginChunk(CaptureFormat::ChunkType::Thread);
+	CaptureFormat::Thread thread;
+	thread.ThreadID = threadID;
+	thread.NameLength = (uint16)(nameLength + 1);
+	Append(thread);
+	AppendString(pName, nameLength);
+	EndChunk();
+
+	++m_NumThreads;
+}
+
+
+void CaptureEncoder::AddQueue(const char* pName, uint64 gpuCalibrationTicks, uint64 cpuCalibrationTicks, uint64 gpuFrequency, uint64 cpuFrequency)
+{
+	uint32 nameLength = (uint32)strlen(pName);
+
+	BeginChunk(CaptureFormat::ChunkType::Queue);
+	CaptureFormat::Queue queue;
+	queue.GPUCalibrationTicks = gpuCalibrationTicks;
+	queue.CPUCalibrationTicks = cpuCalibrationTicks;
+	queue.GPUFrequency = gpuFrequency;
+	queue.CPUFrequency = cpuFrequency;
+	queue.NameLength = (uint16)(nameLength + 1);
+	Append(queue);
+	AppendString(pName, nameLength);
+	EndChunk();
+
+	++m_NumQueues;
+}
+
+
+void CaptureEncoder::BeginFrame(CaptureFormat::ChunkType type, uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	BeginChunk(type);
+	CaptureFormat::Frame frame;
+	frame.FrameIndex = frameIndex;
+	frame.TicksBegin = ticksBegin;
+	frame.TicksEnd = ticksEnd;
+	frame.NumBlocks = 0;
+	frame.PayloadSize = 0;
+	frame.Compression = CaptureFormat::Compression::None;
+	Append(frame);
+}
+
+
+void CaptureEncoder::BeginBlock(uint32 trackIndex, uint32 numEvents)
+{
+	// Increment the block count in the frame header
+	char* pNumBlocks = &m_Buffer[m_ChunkOffset + sizeof(CaptureFormat::ChunkHeader) + offsetof(CaptureFormat::Frame, NumBlocks)];
+	uint32 numBlocks;
+	memcpy(&numBlocks, pNumBlocks, sizeof(uint32));
+	++numBlocks;
+	memcpy(pNumBlocks, &numBlocks, sizeof(uint32));
+
+	CaptureFormat::Block block;
+	block.TrackIndex = trackIndex;
+	block.NumEvents = numEvents;
+	Append(block);
+	m_PreviousTicks = 0;
+}
+
+
+void CaptureEncoder::AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, uint32 depth)
+{
+	check(siteIndex < m_NumSites);
+	size_t offset = m_Buffer.size();
+	m_Buffer.resize(offset + CaptureFormat::MaxEventSize);
+	uint8* pBegin = (uint8*)&m_Buffer[offset];
+	uint8* pEnd = pBegin;
+	pEnd = WriteVarint(pEnd, ZigZagEncode((int64_t)(ticksBegin - m_PreviousTicks)));
+	pEnd = WriteVarint(pEnd, ticksEnd - ticksBegin);
+	pEnd = WriteVarint(pEnd, siteIndex);
+	pEnd = WriteVarint(pEnd, depth);
+	m_Buffer.resize(offset + (pEnd - pBegin));
+	m_PreviousTicks = ticksBegin;
+}
+
+
+void CaptureEncoder::EndFrame()
+{
+	uint32 payloadSize = (uint32)(m_Buffer.size() - m_ChunkOffset - sizeof(CaptureFormat::ChunkHeader) - sizeof(CaptureFormat::Frame));
+	memcpy(&m_Buffer[m_ChunkOffset + sizeof(CaptureFormat::ChunkHeader) + offsetof(CaptureFormat::Frame, PayloadSize)], &payloadSize, sizeof(uint32));
+	EndChunk();
+}
+
+
+void CaptureEncoder::AddHistograms(Span<const ProfilerHistogram> histograms)
+{
+	BeginChunk(CaptureFormat::ChunkType::Histograms);
+	CaptureFormat::Histograms header;
+	header.NumHistograms = (uint32)std::count_if(histograms.begin(), histograms.end(), [](const ProfilerHistogram& histogram) { return histogram.GetCount() > 0; });
+	header.LinearBits = ProfilerHistogram::LinearBits;
+	Append(header);
+
+	for (uint32 siteIndex = 0; siteIndex < (uint32)histograms.size(); ++siteIndex)
+	{
+		const ProfilerHistogram& histogram = histograms[siteIndex];
+		if (histogram.GetCount() == 0)
+			continue;
+
+		uint32 numBuckets = 0;
+		for (uint32 bucketIndex = histogram.GetFirstBucket(); bucketIndex < histogram.GetEndBucket(); ++bucketIndex)
+			numBuckets += histogram.GetBucketCount(bucketIndex) > 0;
+
+		size_t offset = m_Buffer.size();
+		m_Buffer.resize(offset + 4 * 10 + (size_t)numBuckets * 2 * 10);
+		uint8* pBegin = (uint8*)&m_Buffer[offset];
+		uint8* pEnd = pBegin;
+		pEnd = WriteVarint(pEnd, siteIndex);
+		pEnd = WriteVarint(pEnd, histogram.GetMin());
+		pEnd = WriteVarint(pEnd, histogram.GetMax());
+		pEnd = WriteVarint(pEnd, numBuckets);
+		uint32 previousBucket = 0;
+		for (uint32 bucketIndex = histogram.GetFirstBucket(); bucketIndex < histogram.GetEndBucket(); ++bucketIndex)
+		{
+			uint64 count = histogram.GetBucketCount(bucketIndex);
+			if (count == 0)
+				continue;
+			pEnd = WriteVarint(pEnd, bucketIndex - previousBucket);
+			pEnd = WriteVarint(pEnd, count);
+			previousBucket = bucketIndex;
+		}
+		m_Buffer.resize(offset + (pEnd - pBegin));
+	}
+	EndChunk();
+}
+
+
+void CaptureEncoder::BeginChunk(CaptureFormat::ChunkType type)
+{
+	m_ChunkOffset = m_Buffer.size();
+	CaptureFormat::ChunkHeader header;
+	header.Type = type;
+	header.Size = 0;
+	Append(header);
+}
+
+
+void CaptureEncoder::EndChunk()
+{
+	uint32 size = (uint32)(m_Buffer.size() - m_ChunkOffset - sizeof(CaptureFormat::ChunkHeader));
+	memcpy(&m_Buffer[m_ChunkOffset + offsetof(CaptureFormat::ChunkHeader, Size)], &size, sizeof(uint32));
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Writer
+//-----------------------------------------------------------------------------
+
+bool CaptureWriter::Open(const char* pPath, uint64 ticksPerSecond, CaptureFormat::Compression compression, uint32 flushSize, uint32 maxBufferSize)
+{
+	Close();
+
+	m_pFile = fopen(pPath, "wb");
+	if (!m_pFile)
+		return false;
+
+	m_Compression = compression;
+	m_FlushSize = flushSize;
+	m_MaxBufferSize = maxBufferSize;
+	m_Encoder.Reset();
+	m_Encoder.GetBuffer().reserve(flushSize * 2);
+	m_BackBuffer.reserve(flushSize * 2);
+	m_BackBufferPending = false;
+	m_Exit = false;
+	m_DropFrame = false;
+	m_IsCPUFrame = false;
+	m_Histograms.clear();
+	m_NumFrames = 0;
+	m_NumDroppedFrames = 0;
+	m_NumBytesWritten = 0;
+	m_HasError = false;
+	m_SiteOffsets.clear();
+	m_ThreadOffsets.clear();
+	m_QueueOffsets.clear();
+	m_HistogramsOffset = 0;
+	m_CPUFrameEntries.clear();
+	m_GPUFrameEntries.clear();
+
+	// The header is written directly so the buffers only ever contain whole chunks
+	CaptureFormat::FileHeader header;
+	header.Magic = CaptureFormat::Magic;
+	header.Version = CaptureFormat::Version;
+	header.TicksPerSecond = ticksPerSecond;
+	if (fwrite(&header, sizeof(header), 1, m_pFile) != 1)
+	{
+		fclose(m_pFile);
+		m_pFile = nullptr;
+		return false;
+	}
+	m_FileOffset = sizeof(header);
+	m_NumBytesWritten = sizeof(header);
+
+	m_Thread = std::thread(&CaptureWriter::WriterThread, this);
+	return true;
+}
+
+
+void CaptureWriter::Close()
+{
+	if (!m_pFile)
+		return;
+
+	m_Encoder.AddHistograms(m_Histograms);
+
+	// Wait for the writer thread to finish the back buffer, then hand it the remainder and let it exit
+	{
+		std::unique_lock lock(m_Lock);
+		m_Signal.wait(lock, [this] { return !m_BackBufferPending; });
+		std::swap(m_Encoder.GetBuffer(), m_BackBuffer);
+		m_BackBufferPending = true;
+		m_Exit = true;
+	}
+	m_Signal.notify_all();
+	m_Thread.join();
+
+	WriteIndex();
+
+	fclose(m_pFile);
+	m_pFile = nullptr;
+	m_Encoder.Reset();
+	m_BackBuffer.clear();
+}
+
+
+void CaptureWriter::BeginCPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	BeginFrame(CaptureFormat::ChunkType::CPUFrame, frameIndex, ticksBegin, ticksEnd);
+}
+
+
+void CaptureWriter::BeginGPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	BeginFrame(CaptureFormat::ChunkType::GPUFrame, frameIndex, ticksBegin, ticksEnd);
+}
+
+
+void CaptureWriter::BeginFrame(CaptureFormat::ChunkType type, uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	// If the writer thread can not keep up, drop the frame instead of growing the buffer indefinitely.
+	// The full buffer is handed over as soon as the writer thread is done with the back buffer, so only frames recorded during a stall are dropped.
+	bool isFull = m_Encoder.GetBuffer().size() >= m_MaxBufferSize && !Submit();
+	m_DropFrame = isFull || m_HasError;
+	if (m_DropFrame)
+		return;
+
+	// Frames are always written uncompressed. The writer thread compresses them.
+	m_Encoder.BeginFrame(type, frameIndex, ticksBegin, ticksEnd);
+	m_IsCPUFrame = type == CaptureFormat::ChunkType::CPUFrame;
+}
+
+
+void CaptureWriter::BeginBlock(uint32 trackIndex, uint32 numEvents)
+{
+	if (m_DropFrame)
+		return;
+	m_Encoder.BeginBlock(trackIndex, numEvents);
+}
+
+
+void CaptureWriter::AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, uint32 depth)
+{
+	if (m_DropFrame)
+		return;
+	m_Encoder.AddEvent(ticksBegin, ticksEnd, siteIndex, depth);
+
+	// GPU events are in the ticks of their queue, so only CPU events are comparable across the capture
+	if (m_IsCPUFrame)
+	{
+		if (siteIndex >= m_Histograms.size())
+			m_Histograms.resize(siteIndex + 1);
+		m_Histograms[siteIndex].Add(ticksEnd - ticksBegin);
+	}
+}
+
+
+void CaptureWriter::EndFrame()
+{
+	if (m_DropFrame)
+	{
+		++m_NumDroppedFrames;
+		m_DropFrame = false;
+		return;
+	}
+
+	m_Encoder.EndFrame();
+	++m_NumFrames;
+
+	if (m_Encoder.GetBuffer().size() >= m_FlushSize)
+		Submit();
+}
+
+
+bool CaptureWriter::Submit()
+{
+	{
+		std::scoped_lock lock(m_Lock);
+		if (m_BackBufferPending)
+			return false;
+		std::swap(m_Encoder.GetBuffer(), m_BackBuffer);
+		m_BackBufferPending = true;
+	}
+	m_Signal.notify_all();
+	return true;
+}
+
+
+void CaptureWriter::WriterThread()
+{
+	std::unique_lock lock(m_Lock);
+	for (;;)
+	{
+		m_Signal.wait(lock, [this] { return m_BackBufferPending || m_Exit; });
+		if (m_BackBufferPending)
+		{
+			// The producer does not touch the back buffer while it is pending, so it can be written without holding the lock
+			lock.unlock();
+			if (!m_HasError && !m_BackBuffer.empty())
+			{
+				const std::vector<char>* pBuffer = &m_BackBuffer;
+				if (m_Compression != CaptureFormat::Compression::None)
+				{
+					CompressChunks(m_BackBuffer, m_CompressedBuffer);
+					pBuffer = &m_CompressedBuffer;
+				}
+
+				IndexChunks(*pBuffer);
+				size_t written = fwrite(pBuffer->data(), 1, pBuffer->size(), m_pFile);
+				m_NumBytesWritten += written;
+				m_FileOffset += written;
+				if (written != pBuffer->size())
+					m_HasError = true;
+			}
+			m_BackBuffer.clear();
+			lock.lock();
+			m_BackBufferPending = false;
+			m_Signal.notify_all();
+		}
+		else if (m_Exit)
+		{
+			break;
+		}
+	}
+}
+
+
+void CaptureWriter::CompressChunks(const std::vector<char>& buffer, std::vector<char>& outBuffer)
+{
+	outBuffer.clear();
+	size_t offset = 0;
+	while (offset < buffer.size())
+	{
+		CaptureFormat::ChunkHeader header;
+		memcpy(&header, &buffer[offset], sizeof(header));
+		const char* pChunk = &buffer[offset];
+		size_t chunkSize = sizeof(header) + header.Size;
+		offset += chunkSize;
+
+		if (header.Type != CaptureFormat::ChunkType::CPUFrame && header.Type != CaptureFormat::ChunkType::GPUFrame)
+		{
+			outBuffer.insert(outBuffer.end(), pChunk, pChunk + chunkSize);
+			continue;
+		}
+
+		CaptureFormat::Frame frame;
+		memcpy(&frame, pChunk + sizeof(header), sizeof(frame));
+		const char* pPayload = pChunk + sizeof(header) + sizeof(frame);
+
+		// Compress into the output buffer right after the headers, and patch the headers afterwards
+		size_t headerOffset = outBuffer.size();
+		uint32 maxCompressedSize = LZCompressor::GetMaxCompressedSize(frame.PayloadSize);
+		outBuffer.resize(headerOffset + sizeof(header) + sizeof(frame) + maxCompressedSize);
+		char* pOut = &outBuffer[headerOffset];
+		uint32 compressedSize = m_Compressor.Compress(pPayload, frame.PayloadSize, pOut + sizeof(header) + sizeof(frame), maxCompressedSize);
+
+		// Keep the frame uncompressed if compression does not help
+		if (compressedSize == 0 || compressedSize >= frame.PayloadSize)
+		{
+			memcpy(pOut + sizeof(header) + sizeof(frame), pPayload, frame.PayloadSize);
+			compressedSize = frame.PayloadSize;
+		}
+		else
+		{
+			frame.Compression = m_Compression;
+		}
+
+		header.Size = (uint32)sizeof(frame) + compressedSize;
+		memcpy(pOut, &header, sizeof(header));
+		memcpy(pOut + sizeof(header), &frame, sizeof(frame));
+		outBuffer.resize(headerOffset + sizeof(header) + header.Size);
+	}
+}
+
+
+void CaptureWriter::IndexChunks(const std::vector<char>& buffer)
+{
+	size_t offset = 0;
+	while (offset + sizeof(CaptureFormat::ChunkHeader) <= buffer.size())
+	{
+		CaptureFormat::ChunkHeader header;
+		memcpy(&header, &buffer[offset], sizeof(header));
+		uint64 fileOffset = m_FileOffset + offset;
+		const char* pData = &buffer[offset + sizeof(header)];
+
+		switch (header.Type)
+		{
+		case CaptureFormat::ChunkType::Site:	m_SiteOffsets.push_back(fileOffset);	break;
+		case CaptureFormat::ChunkType::Thread:	m_ThreadOffsets.push_back(fileOffset);	break;
+		case CaptureFormat::ChunkType::Queue:	m_QueueOffsets.push_back(fileOffset);	break;
+		case CaptureFormat::ChunkType::Histograms:	m_HistogramsOffset = fileOffset;	break;
+		case CaptureFormat::ChunkType::CPUFrame:
+		case CaptureFormat::ChunkType::GPUFrame:
+		{
+			CaptureFormat::Frame frame;
+			memcpy(&frame, pData, sizeof(frame));
+			std::vector<CaptureFormat::FrameEntry>& entries = header.Type == CaptureFormat::ChunkType::CPUFrame ? m_CPUFrameEntries : m_GPUFrameEntries;
+			entries.push_back({ fileOffset, frame.TicksBegin, frame.TicksEnd, frame.FrameIndex, header.Size });
+			break;
+		}
+		default:
+			break;
+		}
+
+		offset += sizeof(header) + header.Size;
+	}
+}
+
+
+void CaptureWriter::WriteIndex()
+{
+	if (m_HasError)
+		return;
+
+	// GPU frames are resolved a few frames late and may complete out of order between queues
+	std::stable_sort(m_GPUFrameEntries.begin(), m_GPUFrameEntries.end(), [](const CaptureFormat::FrameEntry& a, const CaptureFormat::FrameEntry& b) { return a.TicksBegin < b.TicksBegin; });
+
+	m_Encoder.GetBuffer().clear();
+	m_Encoder.BeginChunk(CaptureFormat::ChunkType::Index);
+	CaptureFormat::Index index;
+	index.HistogramsOffset = m_HistogramsOffset;
+	index.NumSites = (uint32)m_SiteOffsets.size();
+	index.NumThreads = (uint32)m_ThreadOffsets.size();
+	index.NumQueues = (uint32)m_QueueOffsets.size();
+	index.NumCPUFrames = (uint32)m_CPUFrameEntries.size();
+	index.NumGPUFrames = (uint32)m_GPUFrameEntries.size();
+	m_Encoder.Append(index);
+	m_Encoder.AppendArray(m_SiteOffsets);
+	m_Encoder.AppendArray(m_ThreadOffsets);
+	m_Encoder.AppendArray(m_QueueOffsets);
+	m_Encoder.AppendArray(m_CPUFrameEntries);
+	m_Encoder.AppendArray(m_GPUFrameEntries);
+	m_Encoder.EndChunk();
+
+	CaptureFormat::Trailer trailer;
+	trailer.IndexOffset = m_FileOffset;
+	trailer.Magic = CaptureFormat::Magic;
+	m_Encoder.Append(trailer);
+
+	const std::vector<char>& buffer = m_Encoder.GetBuffer();
+	size_t written = fwrite(buffer.data(), 1, buffer.size(), m_pFile);
+	m_NumBytesWritten += written;
+	if (written != buffer.size())
+		m_HasError = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Reader
+//-----------------------------------------------------------------------------
+
+// Bounds checked reads from the mapped file. A truncated or corrupt capture must not crash the reader.
+template<typename T>
+static bool ReadStruct(const char* pData, uint64 size, uint64 offset, T& outValue)
+{
+	if (offset > size || size - offset < sizeof(T))
+		return false;
+	memcpy(&outValue, pData + offset, sizeof(T));
+	return true;
+}
+
+// Strings are stored including their null terminator, so they can be used in place
+static const char* ReadString(const char* pData, uint64 size, uint64 offset, uint32 length)
+{
+	if (length == 0 || offset > size || size - offset < length || pData[offset + length - 1] != 0)
+		return nullptr;
+	return pData + offset;
+}
+
+
+bool CaptureReader::Open(const char* pPath)
+{
+	Close();
+
+	if (!MapFile(pPath))
+		return false;
+
+	CaptureFormat::FileHeader header;
+	if (!ReadStruct(m_pData, m_Size, 0, header) || header.Magic != CaptureFormat::Magic || header.Version != CaptureFormat::Version)
+	{
+		Close();
+		return false;
+	}
+	m_TicksPerSecond = header.TicksPerSecond;
+
+	if (!ReadIndex())
+	{
+		m_IsRecovered = true;
+		if (!RebuildIndex())
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void CaptureReader::Close()
+{
+	UnmapFile();
+	m_TicksPerSecond = 0;
+	m_IsRecovered = false;
+	m_Sites.clear();
+	m_Threads.clear();
+	m_Queues.clear();
+	m_CPUFrames.clear();
+	m_GPUFrames.clear();
+	m_Histograms.clear();
+}
+
+
+#ifdef _WIN32
+
+bool CaptureReader::MapFile(const char* pPath)
+{
+	HANDLE file = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_pFileHandle = file;
+	m_pMappingHandle = mapping;
+	m_pData = (const char*)pView;
+	m_Size = (uint64)size.QuadPart;
+	return true;
+}
+
+
+void CaptureReader::UnmapFile()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_pMappingHandle)
+		CloseHandle(m_pMappingHandle);
+	if (m_pFileHandle)
+		CloseHandle(m_pFileHandle);
+	m_pData = nullptr;
+	m_pMappingHandle = nullptr;
+	m_pFileHandle = nullptr;
+	m_Size = 0;
+}
+
+#else
+
+bool CaptureReader::MapFile(const char* pPath)
+{
+	int file = open(pPath, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps the file alive, the descriptor is not needed anymore
+	void* pView = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (pView == MAP_FAILED)
+		return false;
+
+	m_pData = (const char*)pView;
+	m_Size = (uint64)fileStat.st_size;
+	return true;
+}
+
+
+void CaptureReader::UnmapFile()
+{
+	if (m_pData)
+		munmap((void*)m_pData, (size_t)m_Size);
+	m_pData = nullptr;
+	m_Size = 0;
+}
+
+#endif
+
+
+bool CaptureReader::ReadIndex()
+{
+	CaptureFormat::Trailer trailer;
+	if (m_Size < sizeof(CaptureFormat::FileHeader) + sizeof(trailer))
+		return false;
+	if (!ReadStruct(m_pData, m_Size, m_Size - sizeof(trailer), trailer) || trailer.Magic != CaptureFormat::Magic)
+		return false;
+
+	CaptureFormat::ChunkHeader chunk;
+	CaptureFormat::Index index;
+	if (!ReadStruct(m_pData, m_Size, trailer.IndexOffset, chunk) || chunk.Type != CaptureFormat::ChunkType::Index)
+		return false;
+	uint64 offset = trailer.IndexOffset + sizeof(chunk);
+	if (!ReadStruct(m_pData, m_Size, offset, index))
+		return false;
+	offset += sizeof(index);
+
+	uint64 numOffsets = (uint64)index.NumSites + index.NumThreads + index.NumQueues;
+	uint64 numFrames = (uint64)index.NumCPUFrames + index.NumGPUFrames;
+	uint64 indexSize = sizeof(index) + numOffsets * sizeof(uint64) + numFrames * sizeof(CaptureFormat::FrameEntry);
+	if (chunk.Size != indexSize || offset + indexSize - sizeof(index) > m_Size - sizeof(trailer))
+		return false;
+
+	// The index is not aligned in the file, so copy it out instead of pointing into the mapping
+	std::vector<uint64> offsets(numOffsets);
+	memcpy(offsets.data(), m_pData + offset, numOffsets * sizeof(uint64));
+	offset += numOffsets * sizeof(uint64);
+
+	Span<const uint64> siteOffsets(offsets.data(), index.NumSites);
+	Span<const uint64> threadOffsets(offsets.data() + index.NumSites, index.NumThreads);
+	Span<const uint64> queueOffsets(offsets.data() + index.NumSites + index.NumThreads, index.NumQueues);
+	if (!ReadTables(siteOffsets, threadOffsets, queueOffsets))
+		return false;
+
+	m_CPUFrames.resize(index.NumCPUFrames);
+	memcpy(m_CPUFrames.data(), m_pData + offset, index.NumCPUFrames * sizeof(CaptureFormat::FrameEntry));
+	offset += index.NumCPUFrames * sizeof(CaptureFormat::FrameEntry);
+	m_GPUFrames.resize(index.NumGPUFrames);
+	memcpy(m_GPUFrames.data(), m_pData + offset, index.NumGPUFrames * sizeof(CaptureFormat::FrameEntry));
+
+	// Corrupt histograms are not needed to read the frames
+	if (index.HistogramsOffset != 0 && !ReadHistograms(index.HistogramsOffset))
+		m_Histograms.clear();
+	return true;
+}
+
+
+bool CaptureReader::RebuildIndex()
+{
+	std::vector<uint64> siteOffsets;
+	std::vector<uint64> threadOffsets;
+	std::vector<uint64> queueOffsets;
+	uint64 histogramsOffset = 0;
+	m_CPUFrames.clear();
+	m_GPUFrames.clear();
+
+	// Walk the chunks until the end of the file or the first incomplete chunk
+	uint64 offset = sizeof(CaptureFormat::FileHeader);
+	CaptureFormat::ChunkHeader chunk;
+	while (ReadStruct(m_pData, m_Size, offset, chunk) && m_Size - offset - sizeof(chunk) >= chunk.Size)
+	{
+		uint64 dataOffset = offset + sizeof(chunk);
+		switch (chunk.Type)
+		{
+		case CaptureFormat::ChunkType::Site:	siteOffsets.push_back(offset);		break;
+		case CaptureFormat::ChunkType::Thread:	threadOffsets.push_back(offset);	break;
+		case CaptureFormat::ChunkType::Queue:	queueOffsets.push_back(offset);		break;
+		case CaptureFormat::ChunkType::Histograms:	histogramsOffset = offset;		break;
+		case CaptureFormat::ChunkType::CPUFrame:
+		case CaptureFormat::ChunkType::GPUFrame:
+		{
+			CaptureFormat::Frame frame;
+			std::vector<CaptureFormat::FrameEntry>& entries = chunk.Type == CaptureFormat::ChunkType::CPUFrame ? m_CPUFrames : m_GPUFrames;
+			if (ReadStruct(m_pData, m_Size, dataOffset, frame))
+				entries.push_back({ offset, frame.TicksBegin, frame.TicksEnd, frame.FrameIndex, chunk.Size });
+			break;
+		}
+		default:
+			break;
+		}
+		offset = dataOffset + chunk.Size;
+	}
+
+	std::stable_sort(m_GPUFrames.begin(), m_GPUFrames.end(), [](const CaptureFormat::FrameEntry& a, const CaptureFormat::FrameEntry& b) { return a.TicksBegin < b.TicksBegin; });
+
+	if (!ReadTables(siteOffsets, threadOffsets, queueOffsets))
+		return false;
+
+	// Corrupt histograms are not needed to read the frames
+	if (histogramsOffset != 0 && !ReadHistograms(histogramsOffset))
+		m_Histograms.clear();
+	return true;
+}
+
+
+bool CaptureReader::ReadTables(Span<const uint64> siteOffsets, Span<const uint64> threadOffsets, Span<const uint64> queueOffsets)
+{
+	m_Sites.reserve(siteOffsets.size());
+	for (uint64 offset : siteOffsets)
+	{
+		CaptureFormat::Site site;
+		if (!ReadStruct(m_pData, m_Size, offset + sizeof(CaptureFormat::ChunkHeader), site))
+			return false;
+		uint64 stringOffset = offset + sizeof(CaptureFormat::ChunkHeader) + sizeof(site);
+
+		CaptureSite& outSite = m_Sites.emplace_back();
+		outSite.LineNumber = site.LineNumber;
+		outSite.pName = ReadString(m_pData, m_Size, stringOffset, site.NameLength);
+		if (!outSite.pName)
+			return false;
+		if (site.FilePathLength > 0)
+		{
+			outSite.pFilePath = ReadString(m_pData, m_Size, stringOffset + site.NameLength, site.FilePathLength);
+			if (!outSite.pFilePath)
+				return false;
+		}
+	}
+
+	m_Threads.reserve(threadOffsets.size());
+	for (uint64 offset : threadOffsets)
+	{
+		CaptureFormat::Thread thread;
+		if (!ReadStruct(m_pData, m_Size, offset + sizeof(CaptureFormat::ChunkHeader), thread))
+			return false;
+
+		CaptureThread& outThread = m_Threads.emplace_back();
+		outThread.ThreadID = thread.ThreadID;
+		outThread.pName = ReadString(m_pData, m_Size, offset + sizeof(CaptureFormat::ChunkHeader) + sizeof(thread), thread.NameLength);
+		if (!outThread.pName)
+			return false;
+	}
+
+	m_Queues.reserve(queueOffsets.size());
+	for (uint64 offset : queueOffsets)
+	{
+		CaptureFormat::Queue queue;
+		if (!ReadStruct(m_pData, m_Size, offset + sizeof(CaptureFormat::ChunkHeader), queue))
+			return false;
+
+		CaptureQueue& outQueue = m_Queues.emplace_back();
+		outQueue.GPUCalibrationTicks = queue.GPUCalibrationTicks;
+		outQueue.CPUCalibrationTicks = queue.CPUCalibrationTicks;
+		outQueue.GPUFrequency = queue.GPUFrequency ? queue.GPUFrequency : 1;
+		outQueue.CPUFrequency = queue.CPUFrequency ? queue.CPUFrequency : 1;
+		outQueue.pName = ReadString(m_pData, m_Size, offset + sizeof(CaptureFormat::ChunkHeader) + sizeof(queue), queue.NameLength);
+		if (!outQueue.pName)
+			return false;
+	}
+	return true;
+}
+
+
+bool CaptureReader::ReadHistograms(uint64 offset)
+{
+	CaptureFormat::ChunkHeader chunk;
+	CaptureFormat::Histograms header;
+	if (!ReadStruct(m_pData, m_Size, offset, chunk) || chunk.Type != CaptureFormat::ChunkType::Histograms || m_Size - offset - sizeof(chunk) < chunk.Size)
+		return false;
+	if (!ReadStruct(m_pData, m_Size, offset + sizeof(chunk), header) || header.LinearBits != ProfilerHistogram::LinearBits)
+		return false;
+
+	const uint8* pCurrent = (const uint8*)m_pData + offset + sizeof(chunk) + sizeof(header);
+	const uint8* pEnd = (const uint8*)m_pData + offset + sizeof(chunk) + chunk.Size;
+	m_Histograms.resize(m_Sites.size());
+	for (uint32 i = 0; i < header.NumHistograms; ++i)
+	{
+		uint64 siteIndex, min, max, numBuckets;
+		if (!(pCurrent = ReadVarint(pCurrent, pEnd, siteIndex)) || !(pCurrent = ReadVarint(pCurrent, pEnd, min)) ||
+			!(pCurrent = ReadVarint(pCurrent, pEnd, max)) || !(pCurrent = ReadVarint(pCurrent, pEnd, numBuckets)))
+			return false;
+		if (siteIndex >= m_Histograms.size())
+			return false;
+
+		ProfilerHistogram& histogram = m_Histograms[siteIndex];
+		uint64 bucketIndex = 0;
+		for (uint64 bucket = 0; bucket < numBuckets; ++bucket)
+		{
+			uint64 delta, count;
+			if (!(pCurrent = ReadVarint(pCurrent, pEnd, delta)) || !(pCurrent = ReadVarint(pCurrent, pEnd, count)))
+				return false;
+			bucketIndex += delta;
+			if (bucketIndex >= ProfilerHistogram::NumBuckets)
+				return false;
+			histogram.AddBucket((uint32)bucketIndex, count);
+		}
+		histogram.SetRange(min, max);
+	}
+	return true;
+}
+
+
+uint32 CaptureReader::FindFrame(Span<const CaptureFormat::FrameEntry> frames, uint64 ticks)
+{
+	auto it = std::lower_bound(frames.begin(), frames.end(), ticks, [](const CaptureFormat::FrameEntry& frame, uint64 ticks) { return frame.TicksEnd < ticks; });
+	return (uint32)(it - frames.begin());
+}
+
+
+bool CaptureReader::DecodeFrame(const CaptureFormat::FrameEntry& entry, CaptureFrame& outFrame) const
+{
+	CaptureFormat::ChunkHeader chunk;
+	if (!ReadStruct(m_pData, m_Size, entry.Offset, chunk) || chunk.Size != entry.Size || m_Size - entry.Offset - sizeof(chunk) < chunk.Size)
+		return false;
+	if (chunk.Type != CaptureFormat::ChunkType::CPUFrame && chunk.Type != CaptureFormat::ChunkType::GPUFrame)
+		return false;
+
+	return DecodeFrameChunk(m_pData + entry.Offset + sizeof(chunk), chunk.Size, outFrame);
+}
+
+
+bool CaptureReader::DecodeFrameChunk(const void* pData, uint32 size, CaptureFrame& outFrame)
+{
+	outFrame.Tracks.clear();
+	outFrame.Events.clear();
+
+	CaptureFormat::Frame frame;
+	if (!ReadStruct((const char*)pData, size, 0, frame))
+		return false;
+	outFrame.FrameIndex = frame.FrameIndex;
+	outFrame.TicksBegin = frame.TicksBegin;
+	outFrame.TicksEnd = frame.TicksEnd;
+	uint32 storedSize = size - (uint32)sizeof(frame);
+
+	const uint8* pPayload = (const uint8*)pData + sizeof(frame);
+	if (frame.Compression == CaptureFormat::Compression::LZ)
+	{
+		outFrame.Payload.resize(frame.PayloadSize);
+		if (!LZCompressor::Decompress(pPayload, storedSize, outFrame.Payload.data(), frame.PayloadSize))
+			return false;
+		pPayload = outFrame.Payload.data();
+	}
+	else if (frame.Compression != CaptureFormat::Compression::None || frame.PayloadSize != storedSize)
+	{
+		return false;
+	}
+
+	const uint8* pCurrent = pPayload;
+	const uint8* pEnd = pPayload + frame.PayloadSize;
+	outFrame.Tracks.reserve(frame.NumBlocks);
+	for (uint32 blockIndex = 0; blockIndex < frame.NumBlocks; ++blockIndex)
+	{
+		CaptureFormat::Block block;
+		if (pEnd - pCurrent < (int64_t)sizeof(block))
+			return false;
+		memcpy(&block, pCurrent, sizeof(block));
+		pCurrent += sizeof(block);
+
+		// Each event takes at least 4 bytes
+		if ((uint64)(pEnd - pCurrent) / 4 < block.NumEvents)
+			return false;
+
+		uint32 eventOffset = (uint32)outFrame.Events.size();
+		outFrame.Tracks.push_back({ block.TrackIndex, eventOffset, block.NumEvents });
+		outFrame.Events.resize(eventOffset + block.NumEvents);
+		pCurrent = DecodeEvents(pCurrent, pEnd, block.NumEvents, outFrame.Events.data() + eventOffset);
+		if (!pCurrent)
+			return false;
+		ComputeSelfTicks(Span<CaptureEvent>(outFrame.Events.data() + eventOffset, block.NumEvents), outFrame.SelfTimeStack);
+	}
+	return true;
+}
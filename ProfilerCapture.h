@@ -0,0 +1,508 @@
+#pragma once
+
+// Capture file format and streaming writer.
+
+#include "ProfilerTypes.h"
+#include "ProfilerCompression.h"
+#include "ProfilerStats.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Format
+//-----------------------------------------------------------------------------
+
+/*
+	A capture is a file header followed by a stream of chunks:
+
+	[FileHeader]
+	[ChunkHeader][Site]					Once per site, before the first frame referencing it
+	[ChunkHeader][Thread]				Once per thread, before the first frame containing it
+	[ChunkHeader][Queue]				Once per GPU queue, before the first GPU frame
+	[ChunkHeader][Frame]				For each finalized CPU frame (ChunkType::CPUFrame)
+		[Block][Event]...				For each thread with events in the frame
+	[ChunkHeader][Frame]				For each resolved GPU frame (ChunkType::GPUFrame)
+		[Block][Event]...				For each queue with events in the frame
+	...
+	[ChunkHeader][Histograms]			Written when the capture is closed
+		[Histogram]...					Duration histogram of each site with CPU events
+	[ChunkHeader][Index]				Written when the capture is closed
+		[uint64]...						File offset of each site, thread and queue chunk
+		[FrameEntry]...					File offset and time range of each CPU and GPU frame chunk
+	[Trailer]							Locates the index from the end of the file
+
+	Events are variable length encoded, see Event below.
+	The blocks of a frame can be compressed as a whole with LZCompressor. Frames can still be decoded independently.
+
+	The index allows opening a capture without reading the frames.
+	If the capture was never closed (eg. the process crashed), the index is rebuilt by scanning the chunks.
+
+	Site, thread and queue indices are implicit: the order in which their chunks appear.
+	Strings are stored including their null terminator.
+	All values are little endian and tightly packed.
+*/
+namespace CaptureFormat
+{
+	constexpr uint32 Magic = 0x50434C54;	// "TLCP"
+	constexpr uint32 Version = 4;
+
+	enum class ChunkType : uint32
+	{
+		Site,
+		Thread,
+		Queue,
+		CPUFrame,
+		GPUFrame,
+		Index,
+		Histograms,
+	};
+
+	enum class Compression : uint8
+	{
+		None,
+		LZ,
+	};
+
+#pragma pack(push, 1)
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 TicksPerSecond;		// Frequency of the CPU ticks
+	};
+
+	struct ChunkHeader
+	{
+		ChunkType	Type;
+		uint32		Size;			// Size of the chunk, excluding this header
+	};
+
+	struct Site
+	{
+		uint32 LineNumber;
+		uint16 NameLength;			// Followed by the name
+		uint16 FilePathLength;		// Followed by the file path. 0 if there is no file path
+	};
+
+	struct Thread
+	{
+		uint32 ThreadID;
+		uint16 NameLength;			// Followed by the name
+	};
+
+	struct Queue
+	{
+		uint64 GPUCalibrationTicks;	// The number of GPU ticks when the calibration was done
+		uint64 CPUCalibrationTicks;	// The number of CPU ticks when the calibration was done
+		uint64 GPUFrequency;		// The GPU tick frequency
+		uint64 CPUFrequency;		// The CPU tick frequency
+		uint16 NameLength;			// Followed by the name
+	};
+
+	struct Frame
+	{
+		uint32		FrameIndex;
+		uint64		TicksBegin;		// CPU ticks at the start of the earliest event, also for GPU frames
+		uint64		TicksEnd;		// CPU ticks at the end of the latest event, also for GPU frames
+		uint32		NumBlocks;
+		uint32		PayloadSize;	// Size of the blocks when decompressed
+		CaptureFormat::Compression Compression;	// Followed by the (compressed) blocks
+	};
+
+	// Events of a single thread or queue
+	struct Block
+	{
+		uint32 TrackIndex;			// Thread index or queue index
+		uint32 NumEvents;			// Followed by the events
+	};
+
+	/*
+		Events are stored as a sequence of LEB128 varints:
+			[TicksBegin - TicksBegin of the previous event in the block, zigzag encoded]
+			[TicksEnd - TicksBegin]
+			[SiteIndex]
+			[Depth]
+		The first event of a block is relative to 0.
+		Events are ordered by TicksBegin, so the deltas are small and most events take 6 to 8 bytes.
+	*/
+	constexpr uint32 MaxEventSize = 10 + 10 + 5 + 5;
+
+	// Histograms of the duration of the CPU events of each site in the written frames, see ProfilerHistogram
+	struct Histograms
+	{
+		uint32 NumHistograms;
+		uint32 LinearBits;			// Bucket layout. Followed by the histograms
+	};
+
+	/*
+		Histograms are stored as a sequence of LEB128 varints:
+			[SiteIndex]
+			[Min]
+			[Max]
+			[NumBuckets]				Buckets with a non-zero count
+			[BucketIndex - BucketIndex of the previous bucket][Count]...
+		The first bucket is relative to 0.
+	*/
+
+	struct Index
+	{
+		uint64 HistogramsOffset;	// File offset of the histograms chunk header. 0 if there is none
+		uint32 NumSites;
+		uint32 NumThreads;
+		uint32 NumQueues;
+		uint32 NumCPUFrames;
+		uint32 NumGPUFrames;		// Followed by the site, thread and queue offsets and the CPU and GPU frame entries
+	};
+
+	struct FrameEntry
+	{
+		uint64 Offset;				// File offset of the chunk header
+		uint64 TicksBegin;			// CPU ticks at the start of the frame
+		uint64 TicksEnd;			// CPU ticks at the end of the frame
+		uint32 FrameIndex;
+		uint32 Size;				// Size of the chunk, excluding the chunk header
+	};
+
+	struct Trailer
+	{
+		uint64 IndexOffset;			// File offset of the index chunk header
+		uint32 Magic;
+	};
+#pragma pack(pop)
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Encoder
+//-----------------------------------------------------------------------------
+
+// Encodes sites, threads, queues and frames as chunks into an in-memory buffer.
+// Shared by the capture writer and the live transport, so both produce the same chunks.
+// Frames are always encoded uncompressed.
+class CaptureEncoder
+{
+public:
+	// Clear the buffer and forget all added sites, threads and queues
+	void Reset();
+
+	// Add the next site, thread or queue. Their index is the number of previously added sites, threads or queues.
+	void AddSite(const char* pName, const char* pFilePath, uint32 lineNumber);
+	void AddThread(const char* pName, uint32 threadID);
+	void AddQueue(const char* pName, uint64 gpuCalibrationTicks, uint64 cpuCalibrationTicks, uint64 gpuFrequency, uint64 cpuFrequency);
+
+	uint32 GetNumSites() const { return m_NumSites; }
+	uint32 GetNumThreads() const { return m_NumThreads; }
+	uint32 GetNumQueues() const { return m_NumQueues; }
+
+	// Encode a frame. Each block must be followed by exactly numEvents calls to AddEvent()
+	void BeginFrame(CaptureFormat::ChunkType type, uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+	void BeginBlock(uint32 trackIndex, uint32 numEvents);
+	void AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, uint32 depth);
+	void EndFrame();
+
+	// Encode the histograms of all sites which have values, indexed by site
+	void AddHistograms(Span<const ProfilerHistogram> histograms);
+
+	void BeginChunk(CaptureFormat::ChunkType type);
+	void EndChunk();
+
+	// Offset of the header of the last chunk in the buffer
+	size_t GetChunkOffset() const { return m_ChunkOffset; }
+
+	// The encoded chunks. The owner removes the chunks once they are consumed.
+	std::vector<char>& GetBuffer() { return m_Buffer; }
+
+	void Append(const void* pData, uint32 size)
+	{
+		const char* pBytes = static_cast<const char*>(pData);
+		m_Buffer.insert(m_Buffer.end(), pBytes, pBytes + size);
+	}
+
+	template<typename T>
+	void Append(const T& value) { Append(&value, sizeof(T)); }
+
+	void AppendString(const char* pStr, uint32 length) { Append(pStr, length); m_Buffer.push_back(0); }
+	template<typename T>
+	void AppendArray(const std::vector<T>& values) { Append(values.data(), (uint32)(values.size() * sizeof(T))); }
+
+private:
+	std::vector<char>		m_Buffer;
+	size_t					m_ChunkOffset = 0;			// Offset of the header of the last chunk in the buffer
+	uint64					m_PreviousTicks = 0;		// TicksBegin of the previous event in the block
+
+	uint32					m_NumSites = 0;
+	uint32					m_NumThreads = 0;
+	uint32					m_NumQueues = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Writer
+//-----------------------------------------------------------------------------
+
+// Streams frames to a capture file.
+// The producer functions only append to an in-memory buffer. Once the buffer is large enough, it is
+// handed to a background thread which writes it to disk while the producer fills the second buffer.
+// If the disk can not keep up and the buffer reaches its maximum size, frames are dropped instead of stalling the producer.
+// The producer functions must all be called from the same thread (the thread calling Tick()).
+class CaptureWriter
+{
+public:
+	CaptureWriter() = default;
+	~CaptureWriter() { Close(); }
+
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	// Create the capture file and start the writer thread.
+	// Frames are compressed on the writer thread, so compression does not add to the cost of the producer.
+	// flushSize is the buffer size at which the buffer is handed to the writer thread.
+	// maxBufferSize is the buffer size at which frames start being dropped.
+	bool Open(const char* pPath, uint64 ticksPerSecond, CaptureFormat::Compression compression = CaptureFormat::Compression::LZ, uint32 flushSize = 1 << 18, uint32 maxBufferSize = 1 << 26);
+
+	// Write all remaining data, the histograms and the index, and close the file. Blocks until the writer thread is done.
+	void Close();
+
+	bool IsOpen() const { return m_pFile != nullptr; }
+
+	// Add the next site, thread or queue. Their index is the number of previously added sites, threads or queues.
+	void AddSite(const char* pName, const char* pFilePath, uint32 lineNumber) { m_Encoder.AddSite(pName, pFilePath, lineNumber); }
+	void AddThread(const char* pName, uint32 threadID) { m_Encoder.AddThread(pName, threadID); }
+	void AddQueue(const char* pName, uint64 gpuCalibrationTicks, uint64 cpuCalibrationTicks, uint64 gpuFrequency, uint64 cpuFrequency)
+	{
+		m_Encoder.AddQueue(pName, gpuCalibrationTicks, cpuCalibrationTicks, gpuFrequency, cpuFrequency);
+	}
+
+	uint32 GetNumSites() const { return m_Encoder.GetNumSites(); }
+	uint32 GetNumThreads() const { return m_Encoder.GetNumThreads(); }
+	uint32 GetNumQueues() const { return m_Encoder.GetNumQueues(); }
+
+	// Write a frame. Each block must be followed by exactly numEvents calls to AddEvent()
+	// Frame ticks are always CPU ticks, also for GPU frames.
+	void BeginCPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+	void BeginGPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+	void BeginBlock(uint32 trackIndex, uint32 numEvents);
+	void AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, uint32 depth);
+	void EndFrame();
+
+	uint32 GetNumFrames() const { return m_NumFrames; }
+	uint32 GetNumDroppedFrames() const { return m_NumDroppedFrames; }
+	uint64 GetNumBytesWritten() const { return m_NumBytesWritten; }
+	bool HasError() const { return m_HasError; }
+
+	// Histograms of the duration of the CPU events of each site in the written frames, indexed by site
+	Span<const ProfilerHistogram> GetHistograms() const { return m_Histograms; }
+
+private:
+	void BeginFrame(CaptureFormat::ChunkType type, uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+
+	void WriterThread();
+
+	// Compress the frames in the buffer. Called by the writer thread.
+	void CompressChunks(const std::vector<char>& buffer, std::vector<char>& outBuffer);
+
+	// Add the chunks in the buffer to the index. Called by the writer thread, before the buffer is written.
+	void IndexChunks(const std::vector<char>& buffer);
+
+	// Write the index and the trailer. Called after the writer thread has exited.
+	void WriteIndex();
+
+	// Hand the front buffer to the writer thread. Returns false if the writer thread is still busy.
+	bool Submit();
+
+	FILE*					m_pFile = nullptr;
+	std::thread				m_Thread;
+	std::mutex				m_Lock;						// Protects the back buffer state
+	std::condition_variable	m_Signal;					// Signaled when the back buffer state changes
+	CaptureEncoder			m_Encoder;					// Front buffer being filled by the producer
+	std::vector<char>		m_BackBuffer;				// Buffer being written to disk by the writer thread
+	bool					m_BackBufferPending = false;	// True while the writer thread owns the back buffer
+	bool					m_Exit = false;				// Request the writer thread to exit once the back buffer is written
+
+	uint32					m_FlushSize = 0;
+	uint32					m_MaxBufferSize = 0;
+	bool					m_DropFrame = false;		// True if the current frame is being dropped
+	bool					m_IsCPUFrame = false;		// True if the current frame is a CPU frame
+	std::vector<ProfilerHistogram>	m_Histograms;		// Duration histogram per site of the written CPU events
+	CaptureFormat::Compression m_Compression = CaptureFormat::Compression::None;
+
+	uint32					m_NumFrames = 0;
+	uint32					m_NumDroppedFrames = 0;
+	std::atomic<uint64>		m_NumBytesWritten = 0;
+	std::atomic<bool>		m_HasError = false;
+
+	// Owned by the writer thread
+	LZCompressor							m_Compressor;
+	std::vector<char>						m_CompressedBuffer;
+	uint64									m_FileOffset = 0;		// Offset in the file of the start of the back buffer
+	std::vector<uint64>						m_SiteOffsets;
+	std::vector<uint64>						m_ThreadOffsets;
+	std::vector<uint64>						m_QueueOffsets;
+	uint64									m_HistogramsOffset = 0;
+	std::vector<CaptureFormat::FrameEntry>	m_CPUFrameEntries;
+	std::vector<CaptureFormat::FrameEntry>	m_GPUFrameEntries;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Reader
+//-----------------------------------------------------------------------------
+
+struct CaptureSite
+{
+	const char* pName = "";
+	const char* pFilePath = nullptr;
+	uint32		LineNumber = 0;
+};
+
+struct CaptureThread
+{
+	const char* pName = "";
+	uint32		ThreadID = 0;
+};
+
+struct CaptureQueue
+{
+	const char* pName = "";
+	uint64		GPUCalibrationTicks = 0;
+	uint64		CPUCalibrationTicks = 0;
+	uint64		GPUFrequency = 1;
+	uint64		CPUFrequency = 1;
+
+	// Convert GPU ticks to CPU ticks. Split in whole seconds and remainder so it does not overflow on long captures.
+	uint64 GpuToCpuTicks(uint64 gpuTicks) const
+	{
+		if (gpuTicks < GPUCalibrationTicks)
+			return CPUCalibrationTicks - ConvertTicks(GPUCalibrationTicks - gpuTicks);
+		return CPUCalibrationTicks + ConvertTicks(gpuTicks - GPUCalibrationTicks);
+	}
+
+private:
+	uint64 ConvertTicks(uint64 gpuTicks) const
+	{
+		return gpuTicks / GPUFrequency * CPUFrequency + gpuTicks % GPUFrequency * CPUFrequency / GPUFrequency;
+	}
+};
+
+struct CaptureEvent
+{
+	uint64 TicksBegin = 0;			// CPU ticks for thread events, GPU ticks for queue events
+	uint64 TicksEnd = 0;
+	uint32 SiteIndex = 0;
+	uint32 Depth = 0;
+	uint64 SelfTicks = 0;			// Duration minus the duration of the direct children. Not stored, computed when the frame is decoded
+};
+
+// A single decoded CPU or GPU frame
+struct CaptureFrame
+{
+	// Range of events of a single thread or queue
+	struct Track
+	{
+		uint32 TrackIndex;
+		uint32 EventOffset;
+		uint32 NumEvents;
+	};
+
+	Span<const CaptureEvent> GetEvents(const Track& track) const
+	{
+		return Span<const CaptureEvent>(Events.data() + track.EventOffset, track.NumEvents);
+	}
+
+	// Searches the tracks. Prefer the overload above when iterating Tracks.
+	Span<const CaptureEvent> GetEvents(uint32 trackIndex) const
+	{
+		for (const Track& track : Tracks)
+		{
+			if (track.TrackIndex == trackIndex)
+				return GetEvents(track);
+		}
+		return {};
+	}
+
+	uint32						FrameIndex = 0;
+	uint64						TicksBegin = 0;		// CPU ticks at the start of the frame
+	uint64						TicksEnd = 0;		// CPU ticks at the end of the frame
+	std::vector<Track>			Tracks;				// Event range for each thread or queue with events
+	std::vector<CaptureEvent>	Events;				// Events of all tracks
+	std::vector<uint8>			Payload;			// Decompressed blocks. Kept to reuse the allocation between frames
+	std::vector<uint32>			SelfTimeStack;		// Scratch memory to compute the self time of the events. Kept like Payload
+};
+
+// Memory-maps a capture file and decodes frames on demand.
+// Opening only reads the index, so the cost does not depend on the length of the capture.
+// Decoding is const and does not modify the reader, so frames can be decoded from multiple threads.
+class CaptureReader
+{
+public:
+	CaptureReader() = default;
+	~CaptureReader() { Close(); }
+
+	CaptureReader(const CaptureReader&) = delete;
+	CaptureReader& operator=(const CaptureReader&) = delete;
+
+	bool Open(const char* pPath);
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; }
+
+	// True if the capture had no index and it was rebuilt by scanning the file
+	bool IsRecovered() const { return m_IsRecovered; }
+
+	uint64 GetTicksPerSecond() const { return m_TicksPerSecond; }
+	uint64 GetFileSize() const { return m_Size; }
+
+	Span<const CaptureSite> GetSites() const { return m_Sites; }
+	Span<const CaptureThread> GetThreads() const { return m_Threads; }
+	Span<const CaptureQueue> GetQueues() const { return m_Queues; }
+
+	// Duration histograms of the CPU events of each site, indexed by site.
+	// Empty if the capture was not closed properly, as the histograms are written when closing.
+	Span<const ProfilerHistogram> GetHistograms() const { return m_Histograms; }
+
+	// Index entries of all frames, ordered by time
+	Span<const CaptureFormat::FrameEntry> GetCPUFrames() const { return m_CPUFrames; }
+	Span<const CaptureFormat::FrameEntry> GetGPUFrames() const { return m_GPUFrames; }
+
+	// Index of the first frame which ends at or after the given CPU ticks
+	uint32 FindCPUFrame(uint64 ticks) const { return FindFrame(m_CPUFrames, ticks); }
+	uint32 FindGPUFrame(uint64 ticks) const { return FindFrame(m_GPUFrames, ticks); }
+
+	// Decode the frame at the given index in GetCPUFrames() or GetGPUFrames()
+	bool DecodeCPUFrame(uint32 index, CaptureFrame& outFrame) const { return DecodeFrame(m_CPUFrames[index], outFrame); }
+	bool DecodeGPUFrame(uint32 index, CaptureFrame& outFrame) const { return DecodeFrame(m_GPUFrames[index], outFrame); }
+
+	// Decode the body of a frame chunk, following its chunk header. Used for chunks which are not in a file.
+	static bool DecodeFrameChunk(const void* pData, uint32 size, CaptureFrame& outFrame);
+
+private:
+	bool MapFile(const char* pPath);
+	void UnmapFile();
+
+	bool ReadIndex();
+	bool RebuildIndex();
+	bool ReadTables(Span<const uint64> siteOffsets, Span<const uint64> threadOffsets, Span<const uint64> queueOffsets);
+	bool ReadHistograms(uint64 offset);
+
+	static uint32 FindFrame(Span<const CaptureFormat::FrameEntry> frames, uint64 ticks);
+	bool DecodeFrame(const CaptureFormat::FrameEntry& entry, CaptureFrame& outFrame) const;
+
+	const char*								m_pData = nullptr;		// Mapped file
+	uint64									m_Size = 0;				// Size of the mapped file
+	void*									m_pFileHandle = nullptr;
+	void*									m_pMappingHandle = nullptr;
+
+	uint64									m_TicksPerSecond = 0;
+	bool									m_IsRecovered = false;
+	std::vector<CaptureSite>				m_Sites;
+	std::vector<CaptureThread>				m_Threads;
+	std::vector<CaptureQueue>				m_Queues;
+	std::vector<CaptureFormat::FrameEntry>	m_CPUFrames;
+	std::vector<CaptureFormat::FrameEntry>	m_GPUFrames;
+	std::vector<ProfilerHistogram>			m_Histograms;
+};
@@ -0,0 +1,172 @@
+
+#include "ProfilerCompression.h"
+
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// [SECTION] LZ Compressor
+//-----------------------------------------------------------------------------
+
+static constexpr uint32 LZ_MIN_MATCH = 4;
+static constexpr uint32 LZ_MAX_OFFSET = 0xFFFF;
+static constexpr uint32 LZ_LAST_LITERALS = 5;		// Matches never extend into the last bytes, the block always ends with literals
+
+static uint32 Read32(const uint8* pData)
+{
+	uint32 value;
+	memcpy(&value, pData, sizeof(uint32));
+	return value;
+}
+
+static uint8* WriteLength(uint8* pDst, uint32 length)
+{
+	while (length >= 255)
+	{
+		*pDst++ = 255;
+		length -= 255;
+	}
+	*pDst++ = (uint8)length;
+	return pDst;
+}
+
+static bool ReadLength(const uint8*& pSrc, const uint8* pSrcEnd, uint32& length)
+{
+	uint8 value;
+	do
+	{
+		if (pSrc == pSrcEnd)
+			return false;
+		value = *pSrc++;
+		length += value;
+	} while (value == 255);
+	return true;
+}
+
+
+uint32 LZCompressor::Compress(const void* pSrc, uint32 srcSize, void* pDst, uint32 dstCapacity)
+{
+	if (dstCapacity < GetMaxCompressedSize(srcSize))
+		return 0;
+
+	// Restart the stream positions before they overflow
+	if (m_Table.empty() || m_Base > 0x7FFFFFFF - srcSize)
+	{
+		m_Table.assign(1u << HASH_BITS, 0);
+		m_Base = 1;
+	}
+
+	const uint8* pIn = (const uint8*)pSrc;
+	uint8* pOut = (uint8*)pDst;
+	uint32 anchor = 0;
+	uint32 position = 0;
+	uint32 matchLimit = srcSize > LZ_LAST_LITERALS + LZ_MIN_MATCH ? srcSize - LZ_LAST_LITERALS : 0;
+
+	while (position + LZ_MIN_MATCH <= matchLimit)
+	{
+		uint32 sequence = Read32(pIn + position);
+		uint32 hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		uint32 candidate = m_Table[hash];
+		m_Table[hash] = m_Base + position;
+
+		// Only accept candidates of the current block within the offset range
+		if (candidate < m_Base || m_Base + position - candidate > LZ_MAX_OFFSET || Read32(pIn + candidate - m_Base) != sequence)
+		{
+			// Skip faster through data that does not compress
+			position += 1 + ((position - anchor) >> 6);
+			continue;
+		}
+
+		uint32 matchPosition = candidate - m_Base;
+		uint32 matchLength = LZ_MIN_MATCH;
+		while (position + matchLength < matchLimit && pIn[matchPosition + matchLength] == pIn[position + matchLength])
+			++matchLength;
+
+		uint32 literalLength = position - anchor;
+		uint8* pToken = pOut++;
+		*pToken = (uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+		if (literalLength >= 15)
+			pOut = WriteLength(pOut, literalLength - 15);
+		memcpy(pOut, pIn + anchor, literalLength);
+		pOut += literalLength;
+
+		uint32 offset = position - matchPosition;
+		*pOut++ = (uint8)(offset & 0xFF);
+		*pOut++ = (uint8)(offset >> 8);
+
+		uint32 storedLength = matchLength - LZ_MIN_MATCH;
+		*pToken |= (uint8)(storedLength >= 15 ? 15 : storedLength);
+		if (storedLength >= 15)
+			pOut = WriteLength(pOut, storedLength - 15);
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	// The remainder is stored as literals
+	uint32 literalLength = srcSize - anchor;
+	uint8* pToken = pOut++;
+	*pToken = (uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15)
+		pOut = WriteLength(pOut, literalLength - 15);
+	memcpy(pOut, pIn + anchor, literalLength);
+	pOut += literalLength;
+
+	m_Base += srcSize;
+	return (uint32)(pOut - (uint8*)pDst);
+}
+
+
+bool LZCompressor::Decompress(const void* pSrc, uint32 srcSize, void* pDst, uint32 dstSize)
+{
+	const uint8* pIn = (const uint8*)pSrc;
+	const uint8* pInEnd = pIn + srcSize;
+	uint8* pOutBegin = (uint8*)pDst;
+	uint8* pOut = pOutBegin;
+	uint8* pOutEnd = pOut + dstSize;
+
+	while (pIn < pInEnd)
+	{
+		uint8 token = *pIn++;
+
+		uint32 literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(pIn, pInEnd, literalLength))
+			return false;
+		if (literalLength > (uint32)(pInEnd - pIn) || literalLength > (uint32)(pOutEnd - pOut))
+			return false;
+		memcpy(pOut, pIn, literalLength);
+		pIn += literalLength;
+		pOut += literalLength;
+
+		// The last sequence has no match
+		if (pIn == pInEnd)
+			break;
+
+		if (pInEnd - pIn < 2)
+			return false;
+		uint32 offset = pIn[0] | (pIn[1] << 8);
+		pIn += 2;
+		if (offset == 0 || offset > (uint32)(pOut - pOutBegin))
+			return false;
+
+		uint32 matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(pIn, pInEnd, matchLength))
+			return false;
+		matchLength += LZ_MIN_MATCH;
+		if (matchLength > (uint32)(pOutEnd - pOut))
+			return false;
+
+		// Overlapping matches repeat the last offset bytes, so they must be copied front to back
+		const uint8* pMatch = pOut - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(pOut, pMatch, matchLength);
+			pOut += matchLength;
+		}
+		else
+		{
+			for (uint32 i = 0; i < matchLength; ++i)
+				*pOut++ = *pMatch++;
+		}
+	}
+	return pOut == pOutEnd;
+}
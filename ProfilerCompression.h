@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ProfilerTypes.h"
+
+#include <vector>
+
+// Fast LZ77 block compressor used for capture frames.
+// The block format follows LZ4: a sequence of [token][literal length][literals][offset][match length].
+// The high nibble of the token is the literal length, the low nibble the match length minus 4.
+// A nibble of 15 means the length continues in the following bytes, each adding up to 255.
+// Offsets are 16-bit little endian. The last sequence only contains literals.
+class LZCompressor
+{
+public:
+	// Compress a block. Returns the compressed size, or 0 if the result does not fit in dstCapacity.
+	// Positions from earlier calls are never referenced, so each block can be decompressed on its own.
+	uint32 Compress(const void* pSrc, uint32 srcSize, void* pDst, uint32 dstCapacity);
+
+	// Decompress a block into a buffer of exactly dstSize bytes. Returns false if the data is corrupt.
+	static bool Decompress(const void* pSrc, uint32 srcSize, void* pDst, uint32 dstSize);
+
+	// The worst case size of a compressed block
+	static uint32 GetMaxCompressedSize(uint32 srcSize) { return srcSize + srcSize / 255 + 16; }
+
+private:
+	static constexpr uint32 HASH_BITS = 12;
+
+	std::vector<uint32>	m_Table;		// Stream position of the last occurrence of each hashed 4-byte sequence
+	uint32				m_Base = 0;		// Stream position of the current block. Positions below it belong to earlier blocks
+};
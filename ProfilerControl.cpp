@@ -0,0 +1,429 @@
+
+// Uses the portable CRT string functions, which are flagged by the MSVC SDL checks
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerControl.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#include <Windows.h>
+#pragma comment(lib, "Ws2_32.lib")
+using SocketHandle = SOCKET;
+static void CloseSocketHandle(SocketHandle socket) { closesocket(socket); }
+static void ShutdownSocketHandle(SocketHandle socket) { shutdown(socket, SD_BOTH); }
+static void RemoveSocketFile(const char* pPath) { DeleteFileA(pPath); }
+static constexpr int SendFlags = 0;
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using SocketHandle = int;
+static void CloseSocketHandle(SocketHandle socket) { close(socket); }
+static void ShutdownSocketHandle(SocketHandle socket) { shutdown(socket, SHUT_RDWR); }
+static void RemoveSocketFile(const char* pPath) { unlink(pPath); }
+static constexpr int SendFlags = MSG_NOSIGNAL;	// A client that disconnects must not kill the process with SIGPIPE
+#endif
+
+static constexpr intptr_t InvalidSocket = -1;
+
+// Longer command lines are rejected and their client is disconnected, so a client can not grow the line without bound
+static constexpr size_t MaxCommandLength = 4096;
+
+//-----------------------------------------------------------------------------
+// [SECTION] Control Commands
+//-----------------------------------------------------------------------------
+
+bool ProfilerCommand::Parse(const char* pLine, ProfilerCommand& outCommand)
+{
+	// Split the line in the command and its argument
+	while (*pLine == ' ' || *pLine == '\t')
+		++pLine;
+	const char* pCommandEnd = pLine;
+	while (*pCommandEnd && *pCommandEnd != ' ' && *pCommandEnd != '\t' && *pCommandEnd != '\r' && *pCommandEnd != '\n')
+		++pCommandEnd;
+	std::string command(pLine, pCommandEnd);
+
+	const char* pArgument = pCommandEnd;
+	while (*pArgument == ' ' || *pArgument == '\t')
+		++pArgument;
+	const char* pArgumentEnd = pArgument + strlen(pArgument);
+	while (pArgumentEnd > pArgument && (pArgumentEnd[-1] == ' ' || pArgumentEnd[-1] == '\t' || pArgumentEnd[-1] == '\r' || pArgumentEnd[-1] == '\n'))
+		--pArgumentEnd;
+	std::string argument(pArgument, pArgumentEnd);
+
+	outCommand = ProfilerCommand();
+	if (command == "snapshot")
+	{
+		outCommand.Type = ProfilerCommandType::Snapshot;
+		outCommand.Path = argument;
+		return true;
+	}
+	if (command == "start" && !argument.empty())
+	{
+		outCommand.Type = ProfilerCommandType::StartCapture;
+		outCommand.Path = argument;
+		return true;
+	}
+	if (command == "stop" && argument.empty())
+	{
+		outCommand.Type = ProfilerCommandType::StopCapture;
+		return true;
+	}
+	if (command == "enable" && !argument.empty())
+	{
+		char* pEnd = nullptr;
+		unsigned long mask = strtoul(argument.c_str(), &pEnd, 0);
+		if (*pEnd != 0 || (mask & ~(unsigned long)ProfilerEnable_All) != 0)
+			return false;
+		outCommand.Type = ProfilerCommandType::SetEnableMask;
+		outCommand.EnableMask = (uint32)mask;
+		return true;
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Profiler Control
+//-----------------------------------------------------------------------------
+
+// Set by the signal handler. Lock-free, so it is safe to use from a signal handler.
+static std::atomic<bool> sSnapshotRequested = false;
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+#ifndef _WIN32
+static struct sigaction sPreviousAction;
+
+static void OnSnapshotSignal(int)
+{
+	sSnapshotRequested.store(true, std::memory_order_relaxed);
+}
+#endif
+
+
+bool ProfilerControl::Start(const char* pSocketPath, const char* pSnapshotPrefix)
+{
+	Stop();
+
+#ifdef _WIN32
+	char eventName[64];
+	snprintf(eventName, sizeof(eventName), "TimelineProfilerSnapshot_%u", (uint32)GetCurrentProcessId());
+	m_pSnapshotEvent = CreateEventA(nullptr, FALSE, FALSE, eventName);
+	if (!m_pSnapshotEvent)
+		return false;
+#else
+	struct sigaction action = {};
+	action.sa_handler = OnSnapshotSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGUSR1, &action, &sPreviousAction) != 0)
+		return false;
+#endif
+
+	m_IsStarted = true;
+	m_SnapshotPrefix = pSnapshotPrefix;
+	m_NumSnapshots = 0;
+	m_StopWorker = false;
+	m_WorkerThread = std::thread(&ProfilerControl::WorkerThread, this);
+
+	if (pSocketPath && !OpenSocket(pSocketPath))
+	{
+		Stop();
+		return false;
+	}
+	return true;
+}
+
+
+void ProfilerControl::Stop()
+{
+	if (!m_IsStarted)
+		return;
+
+	CloseSocket();
+
+#ifdef _WIN32
+	CloseHandle(m_pSnapshotEvent);
+	m_pSnapshotEvent = nullptr;
+#else
+	sigaction(SIGUSR1, &sPreviousAction, nullptr);
+#endif
+
+	{
+		std::scoped_lock lock(m_JobLock);
+		m_StopWorker = true;
+	}
+	m_JobCondition.notify_one();
+	m_WorkerThread.join();
+
+	m_Commands.clear();
+	m_IsStarted = false;
+}
+
+
+bool ProfilerControl::PopCommand(ProfilerCommand& outCommand)
+{
+	bool snapshotRequested = false;
+#ifdef _WIN32
+	snapshotRequested = m_pSnapshotEvent && WaitForSingleObject(m_pSnapshotEvent, 0) == WAIT_OBJECT_0;
+#else
+	snapshotRequested = sSnapshotRequested.exchange(false, std::memory_order_relaxed);
+#endif
+
+	if (snapshotRequested)
+	{
+		outCommand = ProfilerCommand();
+		outCommand.Type = ProfilerCommandType::Snapshot;
+	}
+	else
+	{
+		std::scoped_lock lock(m_CommandLock);
+		if (m_Commands.empty())
+			return false;
+		outCommand = std::move(m_Commands.front());
+		m_Commands.pop_front();
+	}
+
+	if (outCommand.Type == ProfilerCommandType::Snapshot && outCommand.Path.empty())
+	{
+		char path[32];
+		snprintf(path, sizeof(path), "_%u.tlcap", m_NumSnapshots++);
+		outCommand.Path = m_SnapshotPrefix + path;
+	}
+	return true;
+}
+
+
+void ProfilerControl::RunAsync(std::function<void()>&& job)
+{
+	{
+		std::scoped_lock lock(m_JobLock);
+		m_Jobs.push_back(std::move(job));
+	}
+	m_JobCondition.notify_one();
+}
+
+
+void ProfilerControl::WorkerThread()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock lock(m_JobLock);
+			m_JobCondition.wait(lock, [this]() { return m_StopWorker || !m_Jobs.empty(); });
+			if (m_Jobs.empty())
+				return;
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+		job();
+	}
+}
+
+
+bool ProfilerControl::OpenSocket(const char* pSocketPath)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(pSocketPath) >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, pSocketPath);
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+#endif
+
+	// Remove the socket of a previous run
+	RemoveSocketFile(pSocketPath);
+
+	SocketHandle listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool success = (intptr_t)listenSocket != InvalidSocket;
+	if (success && (bind(listenSocket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 4) != 0))
+	{
+		CloseSocketHandle(listenSocket);
+		success = false;
+	}
+	if (!success)
+	{
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	m_SocketPath = pSocketPath;
+	m_ListenSocket = (intptr_t)listenSocket;
+	m_ClientSocket = InvalidSocket;
+	m_SocketThread = std::thread(&ProfilerControl::ServeSocket, this);
+	return true;
+}
+
+
+void ProfilerControl::CloseSocket()
+{
+	// Shutting down the sockets wakes up the socket thread if it is waiting for a client or a command.
+	// A client accepted after this is closed by the socket thread, as it sees the listen socket is gone.
+	{
+		std::scoped_lock lock(m_SocketLock);
+		if (m_ListenSocket == InvalidSocket)
+			return;
+		ShutdownSocketHandle((SocketHandle)m_ListenSocket);
+		CloseSocketHandle((SocketHandle)m_ListenSocket);
+		m_ListenSocket = InvalidSocket;
+		if (m_ClientSocket != InvalidSocket)
+			ShutdownSocketHandle((SocketHandle)m_ClientSocket);
+	}
+	m_SocketThread.join();
+
+	RemoveSocketFile(m_SocketPath.c_str());
+	m_SocketPath.clear();
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+
+void ProfilerControl::ServeSocket()
+{
+	SocketHandle listenSocket;
+	{
+		std::scoped_lock lock(m_SocketLock);
+		listenSocket = (SocketHandle)m_ListenSocket;
+	}
+
+	// Clients are served one at a time. Commands are short, so this does not need to scale.
+	for (;;)
+	{
+		SocketHandle clientSocket = accept(listenSocket, nullptr, nullptr);
+		if ((intptr_t)clientSocket == InvalidSocket)
+			return;
+
+		// Publish the client, unless the socket was closed while it was accepted
+		{
+			std::scoped_lock lock(m_SocketLock);
+			if (m_ListenSocket == InvalidSocket)
+			{
+				CloseSocketHandle(clientSocket);
+				return;
+			}
+			m_ClientSocket = (intptr_t)clientSocket;
+		}
+
+		std::string line;
+		bool isConnected = true;
+		char buffer[256];
+		while (isConnected)
+		{
+			int received = (int)recv(clientSocket, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+				break;
+
+			for (int i = 0; i < received && isConnected; ++i)
+			{
+				if (buffer[i] != '\n')
+				{
+					line += buffer[i];
+					if (line.size() > MaxCommandLength)
+					{
+						const char* pReply = "error: command too long\n";
+						send(clientSocket, pReply, (int)strlen(pReply), SendFlags);
+						isConnected = false;
+					}
+					continue;
+				}
+
+				ProfilerCommand command;
+				const char* pReply = "ok\n";
+				if (ProfilerCommand::Parse(line.c_str(), command))
+				{
+					std::scoped_lock lock(m_CommandLock);
+					m_Commands.push_back(std::move(command));
+				}
+				else
+				{
+					pReply = "error: unknown command\n";
+				}
+				send(clientSocket, pReply, (int)strlen(pReply), SendFlags);
+				line.clear();
+			}
+		}
+
+		{
+			std::scoped_lock lock(m_SocketLock);
+			m_ClientSocket = InvalidSocket;
+		}
+		CloseSocketHandle(clientSocket);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Control Client
+//-----------------------------------------------------------------------------
+
+bool SendProfilerCommand(const char* pSocketPath, const char* pCommand, std::string& outReply)
+{
+	outReply.clear();
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(pSocketPath) >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, pSocketPath);
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+#endif
+
+	bool success = false;
+	SocketHandle clientSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((intptr_t)clientSocket != InvalidSocket)
+	{
+		if (connect(clientSocket, (const sockaddr*)&address, sizeof(address)) == 0)
+		{
+			std::string line = std::string(pCommand) + "\n";
+			success = send(clientSocket, line.c_str(), (int)line.size(), SendFlags) == (int)line.size();
+
+			// The server answers each line with a single line
+			char character;
+			while (success && recv(clientSocket, &character, 1, 0) == 1 && character != '\n')
+				outReply += character;
+		}
+		CloseSocketHandle(clientSocket);
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return success && !outReply.empty();
+}
+
+
+bool SignalProfilerSnapshot(uint32 processID)
+{
+#ifdef _WIN32
+	char eventName[64];
+	snprintf(eventName, sizeof(eventName), "TimelineProfilerSnapshot_%u", processID);
+	HANDLE event = OpenEventA(EVENT_MODIFY_STATE, FALSE, eventName);
+	if (!event)
+		return false;
+	bool success = SetEvent(event) != 0;
+	CloseHandle(event);
+	return success;
+#else
+	return kill((pid_t)processID, SIGUSR1) == 0;
+#endif
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+// Control surface for processes without a HUD.
+
+#include "ProfilerTypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Control Commands
+//-----------------------------------------------------------------------------
+
+/*
+	Commands are sent as lines of text over the control socket. Each line is answered with "ok" or "error: <reason>".
+
+	snapshot [path]				Write the frames in the history to a capture
+	start <path>				Start streaming a capture
+	stop						Stop streaming the capture
+	enable <mask>				Set the enable mask (see ProfilerEnableFlags). Decimal or 0x prefixed hex
+
+	Commands are executed at the start of the next CPUProfiler::Tick().
+	A snapshot can also be requested without the socket, by sending SIGUSR1 to the process.
+	On Windows, which has no user signals, the named event "TimelineProfilerSnapshot_<pid>" is signaled instead.
+*/
+enum class ProfilerCommandType : uint8
+{
+	Snapshot,
+	StartCapture,
+	StopCapture,
+	SetEnableMask,
+};
+
+enum ProfilerEnableFlags : uint32
+{
+	ProfilerEnable_CPU	= 1 << 0,
+	ProfilerEnable_GPU	= 1 << 1,
+	ProfilerEnable_All	= ProfilerEnable_CPU | ProfilerEnable_GPU,
+};
+
+struct ProfilerCommand
+{
+	ProfilerCommandType Type = ProfilerCommandType::Snapshot;
+	std::string			Path;					// Path of the snapshot or the capture
+	uint32				EnableMask = ProfilerEnable_All;
+
+	// Parse a single line of the protocol
+	static bool Parse(const char* pLine, ProfilerCommand& outCommand);
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Profiler Control
+//-----------------------------------------------------------------------------
+
+// Receives commands from outside the process and queues them for the thread calling Tick().
+// The signal handler only sets a flag, so it is async-signal-safe. The socket is served by a background thread,
+// which also runs the jobs of the profiler (eg. writing snapshots), so the profiled threads never wait for the disk.
+class ProfilerControl
+{
+public:
+	ProfilerControl() = default;
+	~ProfilerControl() { Stop(); }
+
+	ProfilerControl(const ProfilerControl&) = delete;
+	ProfilerControl& operator=(const ProfilerControl&) = delete;
+
+	// Install the snapshot trigger and start the background thread.
+	// pSocketPath is the path of the local control socket. Pass nullptr to only use the snapshot trigger.
+	// Snapshots requested without a path are written to "<pSnapshotPrefix>_<n>.tlcap".
+	bool Start(const char* pSocketPath = nullptr, const char* pSnapshotPrefix = "ProfilerSnapshot");
+
+	// Remove the trigger, close the socket and finish all queued jobs
+	void Stop();
+
+	bool IsStarted() const { return m_IsStarted; }
+
+	// Retrieve the next command. Called from the thread calling Tick().
+	bool PopCommand(ProfilerCommand& outCommand);
+
+	// Run a job on the background thread. Jobs run in order.
+	void RunAsync(std::function<void()>&& job);
+
+private:
+	bool OpenSocket(const char* pSocketPath);
+	void CloseSocket();
+	void ServeSocket();
+	void WorkerThread();
+
+	bool									m_IsStarted = false;
+	std::string								m_SnapshotPrefix;
+	uint32									m_NumSnapshots = 0;
+	void*									m_pSnapshotEvent = nullptr;		// Windows only
+
+	std::string								m_SocketPath;
+	std::mutex								m_SocketLock;					// Guards the sockets, so a client accepted while closing is not missed
+	intptr_t								m_ListenSocket = -1;
+	intptr_t								m_ClientSocket = -1;
+	std::thread								m_SocketThread;
+
+	std::mutex								m_CommandLock;
+	std::deque<ProfilerCommand>				m_Commands;
+
+	std::mutex								m_JobLock;
+	std::condition_variable					m_JobCondition;
+	std::deque<std::function<void()>>		m_Jobs;
+	bool									m_StopWorker = false;
+	std::thread								m_WorkerThread;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Control Client
+//-----------------------------------------------------------------------------
+
+// Send a command line to the control socket of a process and receive the reply
+bool SendProfilerCommand(const char* pSocketPath, const char* pCommand, std::string& outReply);
+
+// Request a snapshot from a process through its snapshot trigger
+bool SignalProfilerSnapshot(uint32 processID);
@@ -0,0 +1,280 @@
+
+#include "ProfilerCriticalPath.h"
+#include "ProfilerCapture.h"
+
+#include <algorithm>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Critical Path
+//-----------------------------------------------------------------------------
+
+bool IsWaitScopeName(const char* pName)
+{
+	return pName && strncmp(pName, "Wait", 4) == 0;
+}
+
+
+void CriticalPath::Reset(uint64 ticksBegin, uint64 ticksEnd)
+{
+	m_TicksBegin = ticksBegin;
+	m_TicksEnd = ticksEnd;
+	m_Events.clear();
+	m_Intervals.clear();
+	m_Tracks.clear();
+	m_Segments.clear();
+	m_BusyTicks = 0;
+}
+
+
+void CriticalPath::BeginTrack(uint32 trackIndex)
+{
+	Track& track = m_Tracks.emplace_back();
+	track.TrackIndex = trackIndex;
+	track.FirstEvent = (uint32)m_Events.size();
+	track.NumEvents = 0;
+	track.FirstInterval = 0;
+	track.NumIntervals = 0;
+}
+
+
+void CriticalPath::AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 depth, bool isWait)
+{
+	check(!m_Tracks.empty());
+	m_Events.push_back({ ticksBegin, std::max(ticksBegin, ticksEnd), m_Tracks.back().TrackIndex, depth, isWait, false, 0 });
+	++m_Tracks.back().NumEvents;
+}
+
+
+void CriticalPath::BuildIntervals(Track& track)
+{
+	track.FirstInterval = (uint32)m_Intervals.size();
+	uint32 trackSlot = (uint32)(&track - m_Tracks.data());
+	auto AddInterval = [&](uint64 ticksBegin, uint64 ticksEnd) {
+		ticksBegin = std::max(ticksBegin, m_TicksBegin);
+		ticksEnd = std::min(ticksEnd, m_TicksEnd);
+		if (ticksBegin < ticksEnd)
+			m_Intervals.push_back({ ticksBegin, ticksEnd, 0, trackSlot, false });
+	};
+
+	// Events are in pre-order, so the waits inside a top-level event follow it
+	bool isInTopLevel = false;
+	uint64 cursor = 0;			// Start of the busy time not yet added
+	uint64 topLevelEnd = 0;
+	uint64 waitEnd = 0;			// End of the outermost wait
+	for (uint32 eventIndex = track.FirstEvent; eventIndex < track.FirstEvent + track.NumEvents; ++eventIndex)
+	{
+		Event& event = m_Events[eventIndex];
+		if (event.Depth == 0)
+		{
+			if (isInTopLevel)
+				AddInterval(cursor, topLevelEnd);
+			isInTopLevel = !event.IsWait;
+			cursor = event.TicksBegin;
+			topLevelEnd = event.TicksEnd;
+			waitEnd = event.IsWait ? event.TicksEnd : 0;
+		}
+		else if (event.TicksBegin < waitEnd)
+		{
+			// Everything inside a wait is part of it
+			event.IsWait = true;
+		}
+		else if (event.IsWait && isInTopLevel)
+		{
+			AddInterval(cursor, event.TicksBegin);
+			cursor = std::max(cursor, event.TicksEnd);
+			waitEnd = event.TicksEnd;
+		}
+	}
+	if (isInTopLevel)
+		AddInterval(cursor, topLevelEnd);
+
+	track.NumIntervals = (uint32)m_Intervals.size() - track.FirstInterval;
+}
+
+
+void CriticalPath::AddSegments(const Track& track, uint64 ticksBegin, uint64 ticksEnd)
+{
+	auto Emit = [&](uint32 eventIndex, uint64 from, uint64 to) {
+		const Event& event = m_Events[eventIndex];
+		from = std::max(from, ticksBegin);
+		to = std::min(to, ticksEnd);
+		if (from < to && !event.IsWait)
+			m_Segments.push_back({ track.TrackIndex, eventIndex, event.Depth, from, to });
+	};
+
+	// Start at the top-level event containing the beginning
+	uint32 firstEvent = track.FirstEvent;
+	uint32 lastEvent = track.FirstEvent + track.NumEvents;
+	uint32 eventIndex = (uint32)(std::lower_bound(m_Events.begin() + firstEvent, m_Events.begin() + lastEvent, ticksBegin,
+		[](const Event& event, uint64 ticks) { return event.TicksBegin < ticks; }) - m_Events.begin());
+	eventIndex = std::max(eventIndex, firstEvent + 1) - 1;
+	while (eventIndex > firstEvent && m_Events[eventIndex].Depth != 0)
+		--eventIndex;
+
+	// The time of each event which is not in one of its children belongs to the event
+	m_Stack.clear();
+	uint64 cursor = 0;
+	for (; eventIndex < lastEvent && m_Events[eventIndex].TicksBegin < ticksEnd; ++eventIndex)
+	{
+		const Event& event = m_Events[eventIndex];
+		while (!m_Stack.empty() && (m_Events[m_Stack.back()].TicksEnd <= event.TicksBegin || m_Events[m_Stack.back()].Depth >= event.Depth))
+		{
+			Emit(m_Stack.back(), cursor, m_Events[m_Stack.back()].TicksEnd);
+			cursor = std::max(cursor, m_Events[m_Stack.back()].TicksEnd);
+			m_Stack.pop_back();
+		}
+		if (!m_Stack.empty())
+			Emit(m_Stack.back(), cursor, event.TicksBegin);
+		m_Stack.push_back(eventIndex);
+		cursor = event.TicksBegin;
+	}
+	while (!m_Stack.empty())
+	{
+		Emit(m_Stack.back(), cursor, m_Events[m_Stack.back()].TicksEnd);
+		cursor = std::max(cursor, m_Events[m_Stack.back()].TicksEnd);
+		m_Stack.pop_back();
+	}
+}
+
+
+void CriticalPath::Compute()
+{
+	m_Intervals.clear();
+	m_Segments.clear();
+	m_Resumes.clear();
+	m_BusyTicks = 0;
+	for (Track& track : m_Tracks)
+		BuildIntervals(track);
+
+	// Intervals are stored by track, so intervals ending at the same time stay in track order
+	m_IntervalsByEnd.resize(m_Intervals.size());
+	for (uint32 index = 0; index < (uint32)m_Intervals.size(); ++index)
+		m_IntervalsByEnd[index] = index;
+	std::sort(m_IntervalsByEnd.begin(), m_IntervalsByEnd.end(), [&](uint32 a, uint32 b) {
+		return m_Intervals[a].TicksEnd != m_Intervals[b].TicksEnd ? m_Intervals[a].TicksEnd < m_Intervals[b].TicksEnd : a < b;
+	});
+
+	// The interval ending last at or before the given time on any track, or ~0u.
+	// Of the intervals ending at the same time (eg. clipped to the end of the frame), the current track is preferred, then the first track.
+	// Within a track, the last of them is taken.
+	// The path walks back in time, so the cursor only moves back and the whole walk is a single pass over the intervals.
+	uint32 cursor = (uint32)m_IntervalsByEnd.size();
+	auto FindIntervalBefore = [&](uint64 ticks, uint32 currentSlot) {
+		while (cursor > 0 && m_Intervals[m_IntervalsByEnd[cursor - 1]].TicksEnd > ticks)
+			--cursor;
+		if (cursor == 0)
+			return ~0u;
+		uint32 first = cursor - 1;
+		while (first > 0 && m_Intervals[m_IntervalsByEnd[first - 1]].TicksEnd == m_Intervals[m_IntervalsByEnd[cursor - 1]].TicksEnd)
+			--first;
+		uint32 slot = m_Intervals[m_IntervalsByEnd[first]].TrackSlot;
+		for (uint32 i = first; i < cursor; ++i)
+		{
+			if (m_Intervals[m_IntervalsByEnd[i]].TrackSlot == currentSlot)
+				slot = currentSlot;
+		}
+		uint32 result = ~0u;
+		for (uint32 i = first; i < cursor; ++i)
+		{
+			if (m_Intervals[m_IntervalsByEnd[i]].TrackSlot == slot)
+				result = m_IntervalsByEnd[i];
+		}
+		return result;
+	};
+
+	// Start at the work ending last, and walk back to the work each resumed thread waited for
+	uint32 intervalIndex = FindIntervalBefore(~0ull, ~0u);
+	uint32 trackSlot = intervalIndex != ~0u ? m_Intervals[intervalIndex].TrackSlot : ~0u;
+
+	m_Pieces.clear();
+	while (intervalIndex != ~0u)
+	{
+		Interval& interval = m_Intervals[intervalIndex];
+		interval.IsOnPath = true;
+		m_Pieces.push_back({ trackSlot, 0, 0, interval.TicksBegin, interval.TicksEnd });
+		m_BusyTicks += interval.TicksEnd - interval.TicksBegin;
+		if (interval.TicksBegin <= m_TicksBegin)
+			break;
+		m_Resumes.push_back(interval.TicksBegin);
+
+		// The thread stays on the path if no other thread finished later while it was idle
+		intervalIndex = FindIntervalBefore(interval.TicksBegin, trackSlot);
+		if (intervalIndex != ~0u)
+			trackSlot = m_Intervals[intervalIndex].TrackSlot;
+	}
+
+	// The pieces were found from the end. Split them into the segments of their events, in order of time.
+	for (auto it = m_Pieces.rbegin(); it != m_Pieces.rend(); ++it)
+		AddSegments(m_Tracks[it->TrackIndex], it->TicksBegin, it->TicksEnd);
+	std::reverse(m_Resumes.begin(), m_Resumes.end());
+
+	// An interval can grow until the path resumes after it, or until it delays the next interval of its track beyond that one's slack
+	for (const Track& track : m_Tracks)
+	{
+		for (uint32 index = track.FirstInterval + track.NumIntervals; index-- > track.FirstInterval;)
+		{
+			Interval& interval = m_Intervals[index];
+			uint64 slack = m_TicksEnd - interval.TicksEnd;
+			if (index + 1 < track.FirstInterval + track.NumIntervals)
+				slack = std::min(slack, m_Intervals[index + 1].TicksBegin - interval.TicksEnd + m_Intervals[index + 1].SlackTicks);
+			auto resume = std::lower_bound(m_Resumes.begin(), m_Resumes.end(), interval.TicksEnd);
+			if (resume != m_Resumes.end())
+				slack = std::min(slack, *resume - interval.TicksEnd);
+			interval.SlackTicks = interval.IsOnPath ? 0 : slack;
+		}
+	}
+
+	// An event is on the path if any of its busy time is. Its slack is the slack of the interval it ends in.
+	for (const Track& track : m_Tracks)
+	{
+		// Events begin in order of time, so the first interval overlapping them only moves forward
+		auto firstInterval = m_Intervals.begin() + track.FirstInterval;
+		auto intervalsEnd = firstInterval + track.NumIntervals;
+		for (uint32 eventIndex = track.FirstEvent; eventIndex < track.FirstEvent + track.NumEvents; ++eventIndex)
+		{
+			Event& event = m_Events[eventIndex];
+			event.IsOnPath = false;
+			event.SlackTicks = 0;
+			if (event.IsWait)
+				continue;
+
+			while (firstInterval != intervalsEnd && firstInterval->TicksEnd <= event.TicksBegin)
+				++firstInterval;
+			for (auto it = firstInterval; it != intervalsEnd && it->TicksBegin < event.TicksEnd; ++it)
+			{
+				event.IsOnPath |= it->IsOnPath;
+				event.SlackTicks = it->SlackTicks;
+			}
+			if (event.IsOnPath)
+				event.SlackTicks = 0;
+		}
+	}
+}
+
+
+std::vector<bool> GetWaitSites(const CaptureReader& capture)
+{
+	std::vector<bool> waitSites;
+	waitSites.reserve(capture.GetSites().size());
+	for (const CaptureSite& site : capture.GetSites())
+		waitSites.push_back(IsWaitScopeName(site.pName));
+	return waitSites;
+}
+
+
+void ComputeCriticalPath(const CaptureFrame& frame, const std::vector<bool>& waitSites, CriticalPath& outPath, std::vector<uint32>& outSites)
+{
+	outPath.Reset(frame.TicksBegin, frame.TicksEnd);
+	outSites.clear();
+	for (const CaptureFrame::Track& track : frame.Tracks)
+	{
+		outPath.BeginTrack(track.TrackIndex);
+		for (const CaptureEvent& event : frame.GetEvents(track))
+		{
+			outPath.AddEvent(event.TicksBegin, event.TicksEnd, event.Depth, event.SiteIndex < waitSites.size() && waitSites[event.SiteIndex]);
+			outSites.push_back(event.SiteIndex);
+		}
+	}
+	outPath.Compute();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+// Critical path of a frame across threads.
+
+#include "ProfilerTypes.h"
+
+#include <vector>
+
+struct CaptureFrame;
+class CaptureReader;
+
+//-----------------------------------------------------------------------------
+// [SECTION] Critical Path
+//-----------------------------------------------------------------------------
+
+// Returns true for the names of scopes in which a thread waits for other threads, eg. "WaitForJobs".
+// By convention, these are the scopes with a name starting with "Wait".
+bool IsWaitScopeName(const char* pName);
+
+// The chain of work across threads that bounds the length of a frame.
+// Events carry no dependencies between threads, so they are inferred from the timing:
+// a thread is busy during its top-level events, except inside wait scopes. When a thread resumes after being idle or waiting,
+// it is assumed to have waited for the work that ended last before it resumed, on any thread.
+// The path is found by walking back from the last work of the frame along these dependencies.
+// Shortening work on the path shortens the frame. Other work has slack: it can take longer without delaying the path.
+// Not thread safe. A path can be computed on a worker thread and read once it is done.
+class CriticalPath
+{
+public:
+	// Part of the path within a single event, which is the deepest event on its track at that time
+	struct Segment
+	{
+		uint32 TrackIndex;
+		uint32 EventIndex;		// Index of the event in the order the events were added
+		uint32 Depth;			// Depth of the event
+		uint64 TicksBegin;
+		uint64 TicksEnd;
+	};
+
+	// Forget all events and start a frame
+	void Reset(uint64 ticksBegin, uint64 ticksEnd);
+
+	// Add the events of each thread, in pre-order (parents before their children).
+	// isWait marks a scope in which the thread waits for other threads. Its children are also part of the wait.
+	void BeginTrack(uint32 trackIndex);
+	void AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 depth, bool isWait);
+
+	// Find the path once all events are added. O(events * log(events)).
+	void Compute();
+
+	// Segments of the path, in order of time
+	Span<const Segment> GetSegments() const { return m_Segments; }
+
+	// Time of the path spent in events. The rest of the path is spent between a thread finishing work and another thread resuming.
+	uint64 GetBusyTicks() const { return m_BusyTicks; }
+
+	uint32 GetNumEvents() const { return (uint32)m_Events.size(); }
+
+	// Whether part of the event is on the path. Wait scopes are never on the path.
+	bool IsOnPath(uint32 eventIndex) const { return m_Events[eventIndex].IsOnPath; }
+
+	// How much longer the event can take before it delays the path. 0 for events on the path and wait scopes.
+	// Conservative: assumes the event may be waited for by the next thread resuming after it.
+	uint64 GetSlackTicks(uint32 eventIndex) const { return m_Events[eventIndex].SlackTicks; }
+
+private:
+	struct Event
+	{
+		uint64 TicksBegin;
+		uint64 TicksEnd;
+		uint32 TrackIndex;
+		uint32 Depth;
+		bool IsWait;
+		bool IsOnPath;
+		uint64 SlackTicks;
+	};
+
+	// Time in which a track is busy: its top-level events minus its wait scopes
+	struct Interval
+	{
+		uint64 TicksBegin;
+		uint64 TicksEnd;
+		uint64 SlackTicks;
+		uint32 TrackSlot;		// Index of the track in m_Tracks
+		bool IsOnPath;
+	};
+
+	// Events and intervals of a track, in order of time
+	struct Track
+	{
+		uint32 TrackIndex;
+		uint32 FirstEvent;
+		uint32 NumEvents;
+		uint32 FirstInterval;
+		uint32 NumIntervals;
+	};
+
+	void BuildIntervals(Track& track);
+	void AddSegments(const Track& track, uint64 ticksBegin, uint64 ticksEnd);
+
+	uint64					m_TicksBegin = 0;
+	uint64					m_TicksEnd = 0;
+	std::vector<Event>		m_Events;
+	std::vector<Interval>	m_Intervals;
+	std::vector<Track>		m_Tracks;
+	std::vector<Segment>	m_Segments;
+	uint64					m_BusyTicks = 0;
+
+	// Scratch memory
+	std::vector<uint32>		m_Stack;			// Open events while splitting a piece into segments
+	std::vector<Segment>	m_Pieces;			// Busy intervals on the path, from the end. TrackIndex is the index in m_Tracks
+	std::vector<uint64>		m_Resumes;			// Times at which the path resumes on a track
+	std::vector<uint32>		m_IntervalsByEnd;	// Intervals of all tracks in order of their end
+};
+
+// Sites of a capture which are wait scopes, by site index
+std::vector<bool> GetWaitSites(const CaptureReader& capture);
+
+// Compute the critical path of a CPU frame of a capture. The events are added in the order of the tracks of the frame,
+// so the events of the path are numbered like the events of the frame when its tracks are iterated in order.
+// outSites receives the site of each event of the path.
+void ComputeCriticalPath(const CaptureFrame& frame, const std::vector<bool>& waitSites, CriticalPath& outPath, std::vector<uint32>& outSites);
@@ -0,0 +1,411 @@
+
+#include "ProfilerDiff.h"
+#include "ProfilerCapture.h"
+#include "ProfilerTasks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Significance Test
+//-----------------------------------------------------------------------------
+
+// Continued fraction of the regularized incomplete beta function, evaluated with the modified Lentz method
+static double BetaContinuedFraction(double a, double b, double x)
+{
+	constexpr int MaxIterations = 300;
+	constexpr double Epsilon = 1e-14;
+	constexpr double Tiny = 1e-300;
+
+	double c = 1.0;
+	double d = 1.0 - (a + b) * x / (a + 1.0);
+	d = 1.0 / (fabs(d) < Tiny ? Tiny : d);
+	double result = d;
+	for (int m = 1; m <= MaxIterations; ++m)
+	{
+		// Even step
+		double numerator = m * (b - m) * x / ((a + 2.0 * m - 1.0) * (a + 2.0 * m));
+		d = 1.0 + numerator * d;
+		d = 1.0 / (fabs(d) < Tiny ? Tiny : d);
+		c = 1.0 + numerator / c;
+		c = fabs(c) < Tiny ? Tiny : c;
+		result *= d * c;
+
+		// Odd step
+		numerator = -(a + m) * (a + b + m) * x / ((a + 2.0 * m) * (a + 2.0 * m + 1.0));
+		d = 1.0 + numerator * d;
+		d = 1.0 / (fabs(d) < Tiny ? Tiny : d);
+		c = 1.0 + numerator / c;
+		c = fabs(c) < Tiny ? Tiny : c;
+		double delta = d * c;
+		result *= delta;
+		if (fabs(delta - 1.0) < Epsilon)
+			break;
+	}
+	return result;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+static double IncompleteBeta(double a, double b, double x)
+{
+	if (x <= 0.0)
+		return 0.0;
+	if (x >= 1.0)
+		return 1.0;
+
+	double logFront = lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x);
+	// The continued fraction converges fast below the mean of the distribution. Use the symmetry above it.
+	if (x < (a + 1.0) / (a + b + 2.0))
+		return exp(logFront) * BetaContinuedFraction(a, b, x) / a;
+	return 1.0 - exp(logFront) * BetaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// Two-sided p-value of Welch's t-test, for two samples with possibly different variances
+static double WelchTTest(double meanA, double varianceA, uint32 numA, double meanB, double varianceB, uint32 numB)
+{
+	if (numA < 2 || numB < 2)
+		return 1.0;
+
+	double errorA = varianceA / numA;
+	double errorB = varianceB / numB;
+	double error = errorA + errorB;
+	if (error <= 0.0)
+		return meanA == meanB ? 1.0 : 0.0;
+
+	double t = (meanB - meanA) / sqrt(error);
+	double degreesOfFreedom = error * error / (errorA * errorA / (numA - 1) + errorB * errorB / (numB - 1));
+	return IncompleteBeta(degreesOfFreedom * 0.5, 0.5, degreesOfFreedom / (degreesOfFreedom + t * t));
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Capture Diff
+//-----------------------------------------------------------------------------
+
+// Identity of a site shared by both captures
+static std::string GetSiteKey(const CaptureSite& site, bool matchLineNumbers)
+{
+	// The directory of the file depends on the machine that built it
+	const char* pFileName = site.pFilePath ? site.pFilePath : "";
+	for (const char* pChar = pFileName; *pChar; ++pChar)
+	{
+		if (*pChar == '/' || *pChar == '\\')
+			pFileName = pChar + 1;
+	}
+
+	std::string key = site.pName;
+	key += '\0';
+	key += pFileName;
+	if (matchLineNumbers)
+	{
+		key += ':';
+		key += std::to_string(site.LineNumber);
+	}
+	return key;
+}
+
+// Accumulates the time per frame of each site of a capture
+struct CaptureSiteAccumulator
+{
+	ProfilerRunningVariance	FrameTicks;		// Time per frame, over the frames in which the site was called
+	double					SumSelfTicks = 0.0;
+	uint64					NumCalls = 0;
+	ProfilerHistogram		CallHistogram;
+};
+
+static void SummarizeSide(const CaptureSiteAccumulator& site, uint32 numFrames, double ticksToMs, CaptureDiffSide& outSide)
+{
+	outSide.NumFrames = numFrames;
+	outSide.NumCalls = site.NumCalls;
+	if (numFrames == 0)
+		return;
+
+	// Frames in which the site was not called are samples of 0
+	ProfilerRunningVariance frameTicks = site.FrameTicks;
+	ProfilerRunningVariance zeros;
+	zeros.Count = numFrames > frameTicks.Count ? numFrames - frameTicks.Count : 0;
+	frameTicks.Merge(zeros);
+	outSide.MeanMs = frameTicks.Mean * ticksToMs;
+	outSide.StdDevMs = sqrt(frameTicks.GetVariance()) * ticksToMs;
+	outSide.MeanSelfMs = site.SumSelfTicks / numFrames * ticksToMs;
+	outSide.P50Ms = site.CallHistogram.GetPercentile(50.0) * ticksToMs;
+	outSide.P99Ms = site.CallHistogram.GetPercentile(99.0) * ticksToMs;
+}
+
+// Number of frames a worker takes from its share at once
+static constexpr uint32 FramesPerBatch = 64;
+
+// Partial sums of a worker, with its scratch memory
+struct CaptureAccumulatorWorker
+{
+	std::vector<CaptureSiteAccumulator>	Sites;
+	CaptureSiteAccumulator				Frame;
+	std::vector<uint64>					FrameTicks;			// Time of each site in the current frame
+	std::vector<uint32>					KeyFrames;			// Last frame in which each site was called
+	std::vector<uint32>					FrameKeys;			// Sites called in the current frame
+	std::vector<uint32>					KeyStack;
+	CaptureFrame						DecodedFrame;
+};
+
+static void MergeAccumulator(CaptureSiteAccumulator& site, const CaptureSiteAccumulator& other)
+{
+	site.FrameTicks.Merge(other.FrameTicks);
+	site.SumSelfTicks += other.SumSelfTicks;
+	site.NumCalls += other.NumCalls;
+	site.CallHistogram.Merge(other.CallHistogram);
+}
+
+static void AccumulateFrame(const CaptureReader& capture, uint32 frameIndex, Span<const uint32> siteKeys, CaptureAccumulatorWorker& worker)
+{
+	CaptureFrame& frame = worker.DecodedFrame;
+	if (!capture.DecodeCPUFrame(frameIndex, frame))
+		return;
+
+	for (const CaptureFrame::Track& track : frame.Tracks)
+	{
+		worker.KeyStack.clear();
+		for (const CaptureEvent& event : frame.GetEvents(track))
+		{
+			if (event.SiteIndex >= siteKeys.size())
+				continue;
+
+			uint32 key = siteKeys[event.SiteIndex];
+			uint64 ticks = event.TicksEnd - event.TicksBegin;
+			CaptureSiteAccumulator& site = worker.Sites[key];
+			if (worker.KeyFrames[key] != frameIndex)
+			{
+				worker.KeyFrames[key] = frameIndex;
+				worker.FrameKeys.push_back(key);
+			}
+
+			if (PushSiteStack(worker.KeyStack, key, event.Depth))
+				worker.FrameTicks[key] += ticks;
+			site.SumSelfTicks += (double)event.SelfTicks;
+			site.CallHistogram.Add(ticks);
+			++site.NumCalls;
+		}
+	}
+
+	// Sites called at least once. Frames without calls are added as zeros when the sides are summarized.
+	for (uint32 key : worker.FrameKeys)
+	{
+		worker.Sites[key].FrameTicks.Add((double)worker.FrameTicks[key]);
+		worker.FrameTicks[key] = 0;
+	}
+	worker.FrameKeys.clear();
+
+	uint64 ticks = frame.TicksEnd - frame.TicksBegin;
+	worker.Frame.FrameTicks.Add((double)ticks);
+	worker.Frame.CallHistogram.Add(ticks);
+	++worker.Frame.NumCalls;
+}
+
+// Feed all CPU frames of a capture. siteKeys maps the site indices of the capture to the shared key indices.
+// The frames are split over the workers of the scheduler, and their partial sums are merged in worker order.
+static void AccumulateCapture(const CaptureReader& capture, Span<const uint32> siteKeys, uint32 numKeys, TaskScheduler& scheduler,
+	std::vector<CaptureSiteAccumulator>& outSites, CaptureSiteAccumulator& outFrame)
+{
+	CaptureAccumulatorWorker init;
+	init.Sites.resize(numKeys);
+	init.FrameTicks.resize(numKeys);
+	init.KeyFrames.assign(numKeys, ~0u);
+
+	CaptureAccumulatorWorker result = scheduler.ParallelReduce((uint32)capture.GetCPUFrames().size(), FramesPerBatch, init,
+		[&](uint32 frameBegin, uint32 frameEnd, CaptureAccumulatorWorker& worker) {
+			for (uint32 frameIndex = frameBegin; frameIndex < frameEnd; ++frameIndex)
+				AccumulateFrame(capture, frameIndex, siteKeys, worker);
+		},
+		[&](CaptureAccumulatorWorker& merged, const CaptureAccumulatorWorker& worker) {
+			for (uint32 key = 0; key < numKeys; ++key)
+				MergeAccumulator(merged.Sites[key], worker.Sites[key]);
+			MergeAccumulator(merged.Frame, worker.Frame);
+		});
+
+	outSites = std::move(result.Sites);
+	outFrame = result.Frame;
+}
+
+static void CompareSides(const CaptureDiffOptions& options, const CaptureSiteAccumulator& base, const CaptureSiteAccumulator& test, CaptureSiteDiff& diff)
+{
+	diff.DeltaMs = diff.Test.MeanMs - diff.Base.MeanMs;
+	diff.DeltaPercent = diff.Base.MeanMs > 0.0 ? diff.DeltaMs / diff.Base.MeanMs * 100.0 : 0.0;
+	diff.PValue = WelchTTest(diff.Base.MeanMs, diff.Base.StdDevMs * diff.Base.StdDevMs, diff.Base.NumFrames,
+		diff.Test.MeanMs, diff.Test.StdDevMs * diff.Test.StdDevMs, diff.Test.NumFrames);
+
+	if (base.NumCalls == 0 && test.NumCalls > 0)
+		diff.Result = CaptureSiteDiff::Status::Added;
+	else if (base.NumCalls > 0 && test.NumCalls == 0)
+		diff.Result = CaptureSiteDiff::Status::Removed;
+	else
+		diff.Result = CaptureSiteDiff::Status::Unchanged;
+
+	// New sites are judged by the absolute threshold only, they have no base to be relative to
+	bool isSignificant = diff.PValue < options.Alpha;
+	bool exceedsPercent = diff.Base.MeanMs > 0.0 ? fabs(diff.DeltaPercent) > options.ThresholdPercent : true;
+	if (isSignificant && exceedsPercent && fabs(diff.DeltaMs) > options.ThresholdMs)
+	{
+		if (diff.DeltaMs > 0.0 && diff.Result != CaptureSiteDiff::Status::Removed)
+			diff.Result = CaptureSiteDiff::Status::Regression;
+		else if (diff.DeltaMs < 0.0 && diff.Result == CaptureSiteDiff::Status::Unchanged)
+			diff.Result = CaptureSiteDiff::Status::Improvement;
+	}
+}
+
+bool DiffCaptures(const CaptureReader& base, const CaptureReader& test, const CaptureDiffOptions& options, CaptureDiffReport& outReport)
+{
+	outReport = CaptureDiffReport();
+	if (base.GetCPUFrames().empty() || test.GetCPUFrames().empty())
+		return false;
+
+	// Give the sites of both captures a shared index
+	std::unordered_map<std::string, uint32> keyMap;
+	std::vector<const CaptureSite*> keySites;
+	auto MapSites = [&](const CaptureReader& capture) {
+		std::vector<uint32> siteKeys;
+		for (const CaptureSite& site : capture.GetSites())
+		{
+			auto result = keyMap.emplace(GetSiteKey(site, options.MatchLineNumbers), (uint32)keySites.size());
+			if (result.second)
+				keySites.push_back(&site);
+			siteKeys.push_back(result.first->second);
+		}
+		return siteKeys;
+	};
+	std::vector<uint32> baseKeys = MapSites(base);
+	std::vector<uint32> testKeys = MapSites(test);
+	uint32 numKeys = (uint32)keySites.size();
+
+	TaskScheduler scheduler(options.NumThreads);
+	std::vector<CaptureSiteAccumulator> baseSites, testSites;
+	CaptureSiteAccumulator baseFrame, testFrame;
+	AccumulateCapture(base, baseKeys, numKeys, scheduler, baseSites, baseFrame);
+	AccumulateCapture(test, testKeys, numKeys, scheduler, testSites, testFrame);
+
+	double baseTicksToMs = 1000.0 / base.GetTicksPerSecond();
+	double testTicksToMs = 1000.0 / test.GetTicksPerSecond();
+	uint32 baseFrames = (uint32)baseFrame.NumCalls;
+	uint32 testFrames = (uint32)testFrame.NumCalls;
+
+	outReport.Frame.Name = "[Frame]";
+	SummarizeSide(baseFrame, baseFrames, baseTicksToMs, outReport.Frame.Base);
+	SummarizeSide(testFrame, testFrames, testTicksToMs, outReport.Frame.Test);
+	CompareSides(options, baseFrame, testFrame, outReport.Frame);
+	outReport.NumRegressions += outReport.Frame.Result == CaptureSiteDiff::Status::Regression;
+
+	for (uint32 key = 0; key < numKeys; ++key)
+	{
+		if (baseSites[key].NumCalls == 0 && testSites[key].NumCalls == 0)
+			continue;
+
+		CaptureSiteDiff& diff = outReport.Sites.emplace_back();
+		diff.Name = keySites[key]->pName;
+		diff.FilePath = keySites[key]->pFilePath ? keySites[key]->pFilePath : "";
+		diff.LineNumber = keySites[key]->LineNumber;
+		SummarizeSide(baseSites[key], baseFrames, baseTicksToMs, diff.Base);
+		SummarizeSide(testSites[key], testFrames, testTicksToMs, diff.Test);
+		CompareSides(options, baseSites[key], testSites[key], diff);
+		outReport.NumRegressions += diff.Result == CaptureSiteDiff::Status::Regression;
+	}
+
+	std::sort(outReport.Sites.begin(), outReport.Sites.end(), [](const CaptureSiteDiff& a, const CaptureSiteDiff& b) { return a.DeltaMs > b.DeltaMs; });
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Report Output
+//-----------------------------------------------------------------------------
+
+const char* GetDiffStatusName(CaptureSiteDiff::Status status)
+{
+	switch (status)
+	{
+	case CaptureSiteDiff::Status::Regression:	return "regression";
+	case CaptureSiteDiff::Status::Improvement:	return "improvement";
+	case CaptureSiteDiff::Status::Added:		return "added";
+	case CaptureSiteDiff::Status::Removed:		return "removed";
+	default:									return "unchanged";
+	}
+}
+
+/*
+	Site                                Base ms   Test ms  Delta ms  Delta %  Calls/frame    p99 call ms          p
+	[Frame]                              16.012    16.540    +0.528    +3.3%    1.0 -> 1.0    16.8 -> 17.4   0.0000  regression
+	Physics                               2.001     2.512    +0.511   +25.5%    4.0 -> 4.0     0.6 -> 0.7   0.0000  regression
+*/
+static void WriteDiffRowText(const CaptureSiteDiff& diff, FILE* pFile)
+{
+	char name[40];
+	snprintf(name, sizeof(name), "%s", diff.Name.c_str());
+	fprintf(pFile, "%-34s %9.3f %9.3f %+9.3f %+7.1f%% %6.1f -> %-6.1f %7.3f -> %-7.3f %8.4f  %s\n",
+		name, diff.Base.MeanMs, diff.Test.MeanMs, diff.DeltaMs, diff.DeltaPercent,
+		diff.Base.GetCallsPerFrame(), diff.Test.GetCallsPerFrame(), diff.Base.P99Ms, diff.Test.P99Ms, diff.PValue,
+		diff.Result == CaptureSiteDiff::Status::Unchanged ? "" : GetDiffStatusName(diff.Result));
+}
+
+void WriteDiffReportText(const CaptureDiffReport& report, FILE* pFile, uint32 maxSites)
+{
+	fprintf(pFile, "%u base frames, %u test frames. Times are means per frame.\n\n", report.Frame.Base.NumFrames, report.Frame.Test.NumFrames);
+	fprintf(pFile, "%-34s %9s %9s %9s %8s %16s %20s %8s\n", "Site", "Base ms", "Test ms", "Delta ms", "Delta %", "Calls/frame", "p99 call ms", "p");
+	WriteDiffRowText(report.Frame, pFile);
+
+	uint32 numSites = maxSites == 0 ? (uint32)report.Sites.size() : std::min(maxSites, (uint32)report.Sites.size());
+	for (uint32 i = 0; i < numSites; ++i)
+		WriteDiffRowText(report.Sites[i], pFile);
+	if (numSites < report.Sites.size())
+		fprintf(pFile, "... %zu more sites\n", report.Sites.size() - numSites);
+
+	fprintf(pFile, "\n%u regression%s\n", report.NumRegressions, report.NumRegressions == 1 ? "" : "s");
+}
+
+static void WriteJSONString(const std::string& str, FILE* pFile)
+{
+	fputc('"', pFile);
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			fprintf(pFile, "\\%c", c);
+		else if ((unsigned char)c < 0x20)
+			fprintf(pFile, "\\u%04x", c);
+		else
+			fputc(c, pFile);
+	}
+	fputc('"', pFile);
+}
+
+static void WriteDiffSideJSON(const CaptureDiffSide& side, FILE* pFile)
+{
+	fprintf(pFile, "{\"frames\":%u,\"calls\":%llu,\"calls_per_frame\":%.4f,\"mean_ms\":%.6f,\"stddev_ms\":%.6f,\"mean_self_ms\":%.6f,\"p50_ms\":%.6f,\"p99_ms\":%.6f}",
+		side.NumFrames, (unsigned long long)side.NumCalls, side.GetCallsPerFrame(), side.MeanMs, side.StdDevMs, side.MeanSelfMs, side.P50Ms, side.P99Ms);
+}
+
+static void WriteDiffRowJSON(const CaptureSiteDiff& diff, FILE* pFile)
+{
+	fprintf(pFile, "{\"name\":");
+	WriteJSONString(diff.Name, pFile);
+	fprintf(pFile, ",\"file\":");
+	WriteJSONString(diff.FilePath, pFile);
+	fprintf(pFile, ",\"line\":%u,\"status\":\"%s\",\"delta_ms\":%.6f,\"delta_percent\":%.4f,\"p_value\":%.6g,\"base\":",
+		diff.LineNumber, GetDiffStatusName(diff.Result), diff.DeltaMs, diff.DeltaPercent, diff.PValue);
+	WriteDiffSideJSON(diff.Base, pFile);
+	fprintf(pFile, ",\"test\":");
+	WriteDiffSideJSON(diff.Test, pFile);
+	fputc('}', pFile);
+}
+
+void WriteDiffReportJSON(const CaptureDiffReport& report, const CaptureDiffOptions& options, FILE* pFile)
+{
+	fprintf(pFile, "{\"options\":{\"threshold_percent\":%g,\"threshold_ms\":%g,\"alpha\":%g,\"match_line_numbers\":%s},\n",
+		options.ThresholdPercent, options.ThresholdMs, options.Alpha, options.MatchLineNumbers ? "true" : "false");
+	fprintf(pFile, "\"regressions\":%u,\n\"frame\":", report.NumRegressions);
+	WriteDiffRowJSON(report.Frame, pFile);
+	fprintf(pFile, ",\n\"sites\":[");
+	for (size_t i = 0; i < report.Sites.size(); ++i)
+	{
+		fprintf(pFile, i == 0 ? "\n" : ",\n");
+		WriteDiffRowJSON(report.Sites[i], pFile);
+	}
+	fprintf(pFile, "\n]}\n");
+}
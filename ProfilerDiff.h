@@ -0,0 +1,86 @@
+#pragma once
+
+// Compare two captures site by site, to find the regressions between two builds.
+
+#include "ProfilerTypes.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class CaptureReader;
+
+struct CaptureDiffOptions
+{
+	// A site regresses if its mean time per frame increases by more than both thresholds, and the increase is significant
+	double	ThresholdPercent = 5.0;
+	double	ThresholdMs = 0.01;
+
+	// Significance level of the two-sided Welch's t-test on the time per frame
+	double	Alpha = 0.01;
+
+	// Sites are matched by name and file name, so they still match when code moves within a file.
+	// Set to also match the line number. Sites with the same identity are merged.
+	bool	MatchLineNumbers = false;
+
+	// Number of threads decoding frames. 0 to use a thread per core
+	uint32	NumThreads = 0;
+};
+
+// Statistics of a site in one of the captures. Times are per frame, summed over all calls and threads.
+// Frames in which the site was not called count as zero.
+struct CaptureDiffSide
+{
+	uint32	NumFrames = 0;
+	uint64	NumCalls = 0;
+	double	MeanMs = 0.0;
+	double	StdDevMs = 0.0;
+	double	MeanSelfMs = 0.0;
+	double	P50Ms = 0.0;			// Percentiles of the duration of a single call
+	double	P99Ms = 0.0;
+
+	double GetCallsPerFrame() const { return NumFrames > 0 ? (double)NumCalls / NumFrames : 0.0; }
+};
+
+struct CaptureSiteDiff
+{
+	enum class Status
+	{
+		Unchanged,
+		Regression,
+		Improvement,
+		Added,			// Only called in the test capture
+		Removed,		// Only called in the base capture
+	};
+
+	std::string		Name;
+	std::string		FilePath;
+	uint32			LineNumber = 0;
+
+	CaptureDiffSide	Base;
+	CaptureDiffSide	Test;
+	double			DeltaMs = 0.0;			// Test - base mean
+	double			DeltaPercent = 0.0;		// Relative to the base mean. 0 if the base mean is 0
+	double			PValue = 1.0;			// Probability of a difference at least this large if the means are equal
+	Status			Result = Status::Unchanged;
+};
+
+struct CaptureDiffReport
+{
+	CaptureSiteDiff					Frame;				// The frame time, compared like a site
+	std::vector<CaptureSiteDiff>	Sites;				// Sorted by DeltaMs, largest regression first
+	uint32							NumRegressions = 0;	// Including the frame time
+};
+
+// Compare the CPU events of two captures.
+// The captures can have a different tick frequency. Recursive calls of a site are only timed once per frame.
+// Returns false if a capture has no CPU frames.
+bool DiffCaptures(const CaptureReader& base, const CaptureReader& test, const CaptureDiffOptions& options, CaptureDiffReport& outReport);
+
+// Write the report as an aligned text table with at most maxSites sites, or all sites if maxSites is 0
+void WriteDiffReportText(const CaptureDiffReport& report, FILE* pFile, uint32 maxSites = 0);
+
+// Write the report as JSON, with all sites
+void WriteDiffReportJSON(const CaptureDiffReport& report, const CaptureDiffOptions& options, FILE* pFile);
+
+const char* GetDiffStatusName(CaptureSiteDiff::Status status);
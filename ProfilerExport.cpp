@@ -0,0 +1,1063 @@
+
+// Uses the portable CRT file functions, which are flagged by the MSVC SDL checks
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerExport.h"
+#include "ProfilerCapture.h"
+#include "ProfilerCriticalPath.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Output Stream
+//-----------------------------------------------------------------------------
+
+// Buffered file output with fast formatting of the values used by the exporters
+class OutputStream
+{
+public:
+	~OutputStream() { Close(); }
+
+	bool Open(const char* pPath)
+	{
+		m_pFile = fopen(pPath, "wb");
+		m_Buffer.resize(BUFFER_SIZE);
+		m_Size = 0;
+		m_HasError = m_pFile == nullptr;
+		return m_pFile != nullptr;
+	}
+
+	// Flush and close the file. Returns false if any write failed.
+	bool Close()
+	{
+		if (!m_pFile)
+			return false;
+		Flush();
+		m_HasError |= fclose(m_pFile) != 0;
+		m_pFile = nullptr;
+		return !m_HasError;
+	}
+
+	void Write(const void* pData, size_t size)
+	{
+		if (m_Size + size > m_Buffer.size())
+		{
+			Flush();
+			if (size > m_Buffer.size())
+			{
+				m_HasError |= fwrite(pData, 1, size, m_pFile) != size;
+				return;
+			}
+		}
+		memcpy(&m_Buffer[m_Size], pData, size);
+		m_Size += size;
+	}
+
+	void Write(const char* pStr) { Write(pStr, strlen(pStr)); }
+	void Write(const std::string& str) { Write(str.data(), str.size()); }
+
+	void WriteChar(char c)
+	{
+		if (m_Size == m_Buffer.size())
+			Flush();
+		m_Buffer[m_Size++] = c;
+	}
+
+	// Write an unsigned integer in decimal
+	void WriteUInt(uint64 value)
+	{
+		char digits[20];
+		char* pEnd = digits + sizeof(digits);
+		char* pDigit = FormatDigits(value, pEnd);
+		Write(pDigit, pEnd - pDigit);
+	}
+
+	// Write value / 10^decimals with exactly the given number of decimals. Eg. WriteFixed(12345, 3) writes "12.345"
+	void WriteFixed(uint64 value, uint32 decimals)
+	{
+		uint64 scale = 1;
+		for (uint32 i = 0; i < decimals; ++i)
+			scale *= 10;
+		WriteUInt(value / scale);
+		if (decimals == 0)
+			return;
+
+		char fraction[20];
+		uint64 remainder = value % scale;
+		for (uint32 i = decimals; i > 0; --i)
+		{
+			fraction[i - 1] = (char)('0' + remainder % 10);
+			remainder /= 10;
+		}
+		WriteChar('.');
+		Write(fraction, decimals);
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+	// Write the digits right to left, two at a time. Returns the first digit.
+	static char* FormatDigits(uint64 value, char* pEnd)
+	{
+		static constexpr char digitPairs[] =
+			"00010203040506070809"
+			"10111213141516171819"
+			"20212223242526272829"
+			"30313233343536373839"
+			"40414243444546474849"
+			"50515253545556575859"
+			"60616263646566676869"
+			"70717273747576777879"
+			"80818283848586878889"
+			"90919293949596979899";
+
+		char* pDigit = pEnd;
+		while (value >= 100)
+		{
+			uint32 pair = (uint32)(value % 100) * 2;
+			value /= 100;
+			*--pDigit = digitPairs[pair + 1];
+			*--pDigit = digitPairs[pair];
+		}
+		if (value >= 10)
+		{
+			uint32 pair = (uint32)value * 2;
+			*--pDigit = digitPairs[pair + 1];
+			*--pDigit = digitPairs[pair];
+		}
+		else
+		{
+			*--pDigit = (char)('0' + value);
+		}
+		return pDigit;
+	}
+
+	void Flush()
+	{
+		if (m_Size > 0 && m_pFile)
+			m_HasError |= fwrite(m_Buffer.data(), 1, m_Size, m_pFile) != m_Size;
+		m_Size = 0;
+	}
+
+	FILE*				m_pFile = nullptr;
+	std::vector<char>	m_Buffer;
+	size_t				m_Size = 0;
+	bool				m_HasError = false;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Helpers
+//-----------------------------------------------------------------------------
+
+// Category of the slices of the critical path. They are derived from the capture threads, so the importers skip them.
+static constexpr const char* CRITICAL_PATH_CATEGORY = "critical_path";
+
+// Convert ticks to nanoseconds. Split in whole seconds and remainder so it does not overflow.
+static uint64 TicksToNanoseconds(uint64 ticks, uint64 ticksPerSecond)
+{
+	return ticks / ticksPerSecond * 1000000000ull + ticks % ticksPerSecond * 1000000000ull / ticksPerSecond;
+}
+
+// The CPU ticks of the earliest frame. All exported timestamps are relative to it.
+static uint64 GetCaptureTicksBegin(const CaptureReader& capture)
+{
+	uint64 ticksBegin = ~0ull;
+	if (!capture.GetCPUFrames().empty())
+		ticksBegin = capture.GetCPUFrames()[0].TicksBegin;
+	if (!capture.GetGPUFrames().empty() && capture.GetGPUFrames()[0].TicksBegin < ticksBegin)
+		ticksBegin = capture.GetGPUFrames()[0].TicksBegin;
+	return ticksBegin == ~0ull ? 0 : ticksBegin;
+}
+
+// Quote and escape a string for JSON
+static std::string EscapeJSON(const char* pStr)
+{
+	static constexpr char hexDigits[] = "0123456789abcdef";
+
+	std::string result = "\"";
+	for (; *pStr; ++pStr)
+	{
+		char c = *pStr;
+		switch (c)
+		{
+		case '"':	result += "\\\"";	break;
+		case '\\':	result += "\\\\";	break;
+		case '\n':	result += "\\n";	break;
+		case '\r':	result += "\\r";	break;
+		case '\t':	result += "\\t";	break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				result += "\\u00";
+				result += hexDigits[(c >> 4) & 0xF];
+				result += hexDigits[c & 0xF];
+			}
+			else
+			{
+				result += c;
+			}
+			break;
+		}
+	}
+	result += '"';
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Chrome Trace Export
+//-----------------------------------------------------------------------------
+
+/*
+	{"displayTimeUnit":"ns","traceEvents":[
+	{"ph":"M","pid":0,"name":"process_name","args":{"name":"CPU"}},
+	{"ph":"M","pid":0,"tid":0,"name":"thread_name","args":{"name":"Main [1234]"}},
+	{"ph":"X","pid":0,"tid":0,"ts":16.667,"dur":1.000,"name":"Update"},
+	{"ph":"C","pid":0,"ts":16.667,"name":"CPU Frame Time","args":{"ms":16.666667}},
+	...
+	]}
+
+	Timestamps are in microseconds with nanosecond precision.
+
+	With TraceExportOptions::WriteDerivedTimes, slices have "self_us" and "slack_us" arguments:
+	{"ph":"X","pid":0,"tid":0,"ts":16.667,"dur":1.000,"name":"Update","args":{"self_us":0.250,"slack_us":0.000}},
+	The self time of a slice is its duration minus the duration of its direct children.
+	The slack of a CPU slice is how much longer it can take without delaying the critical path of its frame. It is 0 on the path.
+
+	With TraceExportOptions::WriteCriticalPath, the critical path is an extra thread of the CPU process after the capture threads,
+	with a slice for each segment of the path:
+	{"ph":"X","cat":"critical_path","pid":0,"tid":2,"ts":16.667,"dur":0.250,"name":"Update"},
+	Its events are in the "critical_path" category, which the importer skips, as they are derived from the other threads.
+*/
+
+class ChromeTraceWriter
+{
+public:
+	ChromeTraceWriter(OutputStream& stream, uint64 ticksBegin, uint64 ticksPerSecond)
+		: m_Stream(stream), m_TicksBegin(ticksBegin), m_TicksPerSecond(ticksPerSecond)
+	{}
+
+	void BeginEvent(const char* pPhase, uint32 pid, const char* pCategory = nullptr)
+	{
+		m_Stream.Write(m_IsFirstEvent ? "{\"ph\":\"" : ",\n{\"ph\":\"");
+		m_Stream.Write(pPhase);
+		if (pCategory)
+		{
+			m_Stream.Write("\",\"cat\":\"");
+			m_Stream.Write(pCategory);
+		}
+		m_Stream.Write("\",\"pid\":");
+		m_Stream.WriteUInt(pid);
+		m_IsFirstEvent = false;
+	}
+
+	void WriteProcessName(uint32 pid, const char* pName)
+	{
+		BeginEvent("M", pid);
+		m_Stream.Write(",\"name\":\"process_name\",\"args\":{\"name\":");
+		m_Stream.Write(EscapeJSON(pName));
+		m_Stream.Write("}}");
+	}
+
+	void WriteThreadName(uint32 pid, uint32 tid, const char* pName, const char* pCategory = nullptr)
+	{
+		BeginEvent("M", pid, pCategory);
+		m_Stream.Write(",\"tid\":");
+		m_Stream.WriteUInt(tid);
+		m_Stream.Write(",\"name\":\"thread_name\",\"args\":{\"name\":");
+		m_Stream.Write(EscapeJSON(pName));
+		m_Stream.Write("}}");
+
+		// Keep the order of the tracks instead of sorting them by name
+		BeginEvent("M", pid, pCategory);
+		m_Stream.Write(",\"tid\":");
+		m_Stream.WriteUInt(tid);
+		m_Stream.Write(",\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":");
+		m_Stream.WriteUInt(tid);
+		m_Stream.Write("}}");
+	}
+
+	// The name must already be quoted and escaped.
+	// Pass the self time to add it as an argument, and the slack of the critical path for CPU events which are not wait scopes.
+	void WriteSlice(uint32 pid, uint32 tid, uint64 ticksBegin, uint64 ticksEnd, const std::string& escapedName,
+		const uint64* pSelfTicks = nullptr, const uint64* pSlackTicks = nullptr, const char* pCategory = nullptr)
+	{
+		BeginEvent("X", pid, pCategory);
+		m_Stream.Write(",\"tid\":");
+		m_Stream.WriteUInt(tid);
+		m_Stream.Write(",\"ts\":");
+		WriteTimestamp(ticksBegin);
+		m_Stream.Write(",\"dur\":");
+		m_Stream.WriteFixed(ticksEnd > ticksBegin ? TicksToNanoseconds(ticksEnd - ticksBegin, m_TicksPerSecond) : 0, 3);
+		m_Stream.Write(",\"name\":");
+		m_Stream.Write(escapedName);
+		if (pSelfTicks)
+		{
+			m_Stream.Write(",\"args\":{\"self_us\":");
+			m_Stream.WriteFixed(TicksToNanoseconds(*pSelfTicks, m_TicksPerSecond), 3);
+			if (pSlackTicks)
+			{
+				m_Stream.Write(",\"slack_us\":");
+				m_Stream.WriteFixed(TicksToNanoseconds(*pSlackTicks, m_TicksPerSecond), 3);
+			}
+			m_Stream.Write("}");
+		}
+		m_Stream.Write("}");
+	}
+
+	// Write a counter sample. The value is written as value / 10^decimals
+	void WriteCounter(uint32 pid, uint64 ticks, const char* pName, const char* pSeries, uint64 value, uint32 decimals)
+	{
+		BeginEvent("C", pid);
+		m_Stream.Write(",\"ts\":");
+		WriteTimestamp(ticks);
+		m_Stream.Write(",\"name\":\"");
+		m_Stream.Write(pName);
+		m_Stream.Write("\",\"args\":{\"");
+		m_Stream.Write(pSeries);
+		m_Stream.Write("\":");
+		m_Stream.WriteFixed(value, decimals);
+		m_Stream.Write("}}");
+	}
+
+private:
+	void WriteTimestamp(uint64 ticks)
+	{
+		m_Stream.WriteFixed(ticks > m_TicksBegin ? TicksToNanoseconds(ticks - m_TicksBegin, m_TicksPerSecond) : 0, 3);
+	}
+
+	OutputStream&	m_Stream;
+	uint64			m_TicksBegin;
+	uint64			m_TicksPerSecond;
+	bool			m_IsFirstEvent = true;
+};
+
+
+bool ExportChromeTrace(const CaptureReader& capture, const char* pPath, const TraceExportOptions& options)
+{
+	constexpr uint32 CPU_PID = 0;
+	constexpr uint32 GPU_PID = 1;
+
+	OutputStream stream;
+	if (!capture.IsOpen() || !stream.Open(pPath))
+		return false;
+
+	uint64 ticksPerSecond = capture.GetTicksPerSecond();
+	ChromeTraceWriter writer(stream, GetCaptureTicksBegin(capture), ticksPerSecond);
+
+	// Sites are shared by all events, so escape their names only once
+	std::vector<std::string> siteNames;
+	siteNames.reserve(capture.GetSites().size());
+	for (const CaptureSite& site : capture.GetSites())
+		siteNames.push_back(EscapeJSON(site.pName));
+	const std::string unknownSite = "\"???\"";
+
+	stream.Write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	writer.WriteProcessName(CPU_PID, "CPU");
+	Span<const CaptureThread> threads = capture.GetThreads();
+	for (uint32 threadIndex = 0; threadIndex < (uint32)threads.size(); ++threadIndex)
+	{
+		char name[160];
+		snprintf(name, sizeof(name), "%s [%u]", threads[threadIndex].pName, threads[threadIndex].ThreadID);
+		writer.WriteThreadName(CPU_PID, threadIndex, name);
+	}
+	const uint32 criticalPathTid = (uint32)threads.size();
+	if (options.WriteCriticalPath)
+		writer.WriteThreadName(CPU_PID, criticalPathTid, "Critical Path", CRITICAL_PATH_CATEGORY);
+
+	writer.WriteProcessName(GPU_PID, "GPU");
+	Span<const CaptureQueue> queues = capture.GetQueues();
+	for (uint32 queueIndex = 0; queueIndex < (uint32)queues.size(); ++queueIndex)
+		writer.WriteThreadName(GPU_PID, queueIndex, queues[queueIndex].pName);
+
+	// The critical path is only needed for the slack and the critical path thread
+	bool hasCriticalPath = options.WriteDerivedTimes || options.WriteCriticalPath;
+	std::vector<bool> waitSites = hasCriticalPath ? GetWaitSites(capture) : std::vector<bool>();
+	CriticalPath path;
+	std::vector<uint32> pathSites;
+
+	CaptureFrame frame;
+	for (uint32 frameIndex = 0; frameIndex < (uint32)capture.GetCPUFrames().size(); ++frameIndex)
+	{
+		if (!capture.DecodeCPUFrame(frameIndex, frame))
+			continue;
+
+		if (hasCriticalPath)
+			ComputeCriticalPath(frame, waitSites, path, pathSites);
+		uint32 pathEventIndex = 0;
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			for (const CaptureEvent& event : frame.GetEvents(track))
+			{
+				const std::string& name = event.SiteIndex < siteNames.size() ? siteNames[event.SiteIndex] : unknownSite;
+				if (!options.WriteDerivedTimes)
+				{
+					writer.WriteSlice(CPU_PID, track.TrackIndex, event.TicksBegin, event.TicksEnd, name);
+					continue;
+				}
+				bool isWait = event.SiteIndex < waitSites.size() && waitSites[event.SiteIndex];
+				uint64 slackTicks = path.GetSlackTicks(pathEventIndex++);
+				writer.WriteSlice(CPU_PID, track.TrackIndex, event.TicksBegin, event.TicksEnd, name, &event.SelfTicks, isWait ? nullptr : &slackTicks);
+			}
+		}
+
+		if (options.WriteCriticalPath)
+		{
+			for (const CriticalPath::Segment& segment : path.GetSegments())
+			{
+				uint32 siteIndex = pathSites[segment.EventIndex];
+				const std::string& name = siteIndex < siteNames.size() ? siteNames[siteIndex] : unknownSite;
+				writer.WriteSlice(CPU_PID, criticalPathTid, segment.TicksBegin, segment.TicksEnd, name, nullptr, nullptr, CRITICAL_PATH_CATEGORY);
+			}
+		}
+
+		writer.WriteCounter(CPU_PID, frame.TicksBegin, "CPU Frame Time", "ms", TicksToNanoseconds(frame.TicksEnd - frame.TicksBegin, ticksPerSecond), 6);
+		writer.WriteCounter(CPU_PID, frame.TicksBegin, "CPU Events", "count", frame.Events.size(), 0);
+	}
+
+	for (uint32 frameIndex = 0; frameIndex < (uint32)capture.GetGPUFrames().size(); ++frameIndex)
+	{
+		if (!capture.DecodeGPUFrame(frameIndex, frame))
+			continue;
+
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			if (track.TrackIndex >= queues.size())
+				continue;
+
+			const CaptureQueue& queue = queues[track.TrackIndex];
+			for (const CaptureEvent& event : frame.GetEvents(track))
+			{
+				const std::string& name = event.SiteIndex < siteNames.size() ? siteNames[event.SiteIndex] : unknownSite;
+				uint64 ticksBegin = queue.GpuToCpuTicks(event.TicksBegin);
+				uint64 selfTicks = queue.GpuToCpuTicks(event.TicksBegin + event.SelfTicks) - ticksBegin;
+				writer.WriteSlice(GPU_PID, track.TrackIndex, ticksBegin, queue.GpuToCpuTicks(event.TicksEnd), name, options.WriteDerivedTimes ? &selfTicks : nullptr);
+			}
+		}
+
+		writer.WriteCounter(GPU_PID, frame.TicksBegin, "GPU Frame Time", "ms", TicksToNanoseconds(frame.TicksEnd - frame.TicksBegin, ticksPerSecond), 6);
+		writer.WriteCounter(GPU_PID, frame.TicksBegin, "GPU Events", "count", frame.Events.size(), 0);
+	}
+
+	stream.Write("\n]}\n");
+	return stream.Close();
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Perfetto Export
+//-----------------------------------------------------------------------------
+
+/*
+	A Perfetto trace is a sequence of TracePackets. Field numbers are from perfetto/protos/perfetto/trace/.
+
+	[TrackDescriptor]...					The CPU and GPU process, each thread, each queue and each counter
+	For each thread, queue and counter group, on its own packet sequence:
+		[TracePacketDefaults]				Clears the incremental state. Sets the default track and the clock
+		[ClockSnapshot]						Defines a sequence scoped incremental clock, relative to BOOTTIME
+		[TrackEvent]...						Slice begin/end or counter values
+
+	Every sequence has its own incremental clock, so each packet only stores the time since the previous packet on its sequence.
+	Event names are interned per sequence the first time they are used. Events only reference them by iid.
+	Timestamps are in nanoseconds since the start of the capture.
+
+	With TraceExportOptions::WriteDerivedTimes, slice begin events have a "self_ns" debug annotation with the duration of the slice
+	minus the duration of its direct children. CPU slices which are not wait scopes also have a "slack_ns" annotation with the slack
+	of the critical path of their frame. The annotations more than double the size of the trace.
+	With TraceExportOptions::WriteCriticalPath, the critical path is a track of the CPU process with a slice for each segment of the path.
+*/
+namespace PerfettoProto
+{
+	namespace Trace
+	{
+		constexpr uint32 Packet = 1;
+	}
+
+	namespace TracePacket
+	{
+		constexpr uint32 ClockSnapshot = 6;
+		constexpr uint32 Timestamp = 8;
+		constexpr uint32 TrustedPacketSequenceID = 10;
+		constexpr uint32 TrackEvent = 11;
+		constexpr uint32 InternedData = 12;
+		constexpr uint32 SequenceFlags = 13;
+		constexpr uint32 TracePacketDefaults = 59;
+		constexpr uint32 TrackDescriptor = 60;
+
+		constexpr uint32 SeqIncrementalStateCleared = 1;
+		constexpr uint32 SeqNeedsIncrementalState = 2;
+	}
+
+	namespace ClockSnapshot
+	{
+		constexpr uint32 Clocks = 1;
+		constexpr uint32 ClockID = 1;
+		constexpr uint32 ClockTimestamp = 2;
+		constexpr uint32 ClockIsIncremental = 3;
+
+		constexpr uint32 BuiltinClockBoottime = 6;
+		constexpr uint32 SequenceClock = 64;		// First sequence scoped clock ID
+	}
+
+	namespace TracePacketDefaults
+	{
+		constexpr uint32 TimestampClockID = 58;
+		constexpr uint32 TrackEventDefaults = 11;
+		constexpr uint32 TrackUuid = 11;			// TrackEventDefaults
+	}
+
+	namespace TrackDescriptor
+	{
+		constexpr uint32 Uuid = 1;
+		constexpr uint32 Name = 2;
+		constexpr uint32 Process = 3;
+		constexpr uint32 Thread = 4;
+		constexpr uint32 ParentUuid = 5;
+		constexpr uint32 Counter = 8;
+
+		constexpr uint32 ProcessPid = 1;			// ProcessDescriptor
+		constexpr uint32 ProcessName = 6;
+		constexpr uint32 ThreadPid = 1;				// ThreadDescriptor
+		constexpr uint32 ThreadTid = 2;
+		constexpr uint32 ThreadName = 5;
+		constexpr uint32 CounterUnit = 3;			// CounterDescriptor
+
+		constexpr uint32 UnitTimeNs = 1;
+		constexpr uint32 UnitCount = 2;
+	}
+
+	namespace TrackEvent
+	{
+		constexpr uint32 DebugAnnotations = 4;
+		constexpr uint32 Type = 9;
+		constexpr uint32 NameIid = 10;
+		constexpr uint32 TrackUuid = 11;
+		constexpr uint32 Categories = 22;
+		constexpr uint32 CounterValue = 30;
+
+		constexpr uint32 TypeSliceBegin = 1;
+		constexpr uint32 TypeSliceEnd = 2;
+		constexpr uint32 TypeCounter = 4;
+	}
+
+	namespace DebugAnnotation
+	{
+		constexpr uint32 NameIid = 1;
+		constexpr uint32 UintValue = 3;
+	}
+
+	namespace InternedData
+	{
+		constexpr uint32 EventNames = 2;
+		constexpr uint32 DebugAnnotationNames = 3;
+		constexpr uint32 Iid = 1;					// EventName and DebugAnnotationName
+		constexpr uint32 Name = 2;
+
+		constexpr uint64 SelfTimeIid = 1;			// Iid of the name of the self time annotation
+		constexpr uint64 SlackIid = 2;				// Iid of the name of the slack annotation
+	}
+}
+
+// Minimal protobuf encoder for a single message.
+// Nested messages are written in place and their length is inserted in front of them when they are closed.
+// Packets are small, so moving the contents is cheaper than reserving space for the length.
+class ProtoWriter
+{
+public:
+	void Clear() { m_Size = 0; }
+	const uint8* GetData() const { return m_Data.data(); }
+	size_t GetSize() const { return m_Size; }
+
+	void WriteVarint(uint32 field, uint64 value)
+	{
+		Reserve(20);
+		uint8* pEnd = EncodeVarint(&m_Data[m_Size], (uint64)field << 3 | WIRE_TYPE_VARINT);
+		pEnd = EncodeVarint(pEnd, value);
+		m_Size = pEnd - m_Data.data();
+	}
+
+	void WriteString(uint32 field, const char* pStr)
+	{
+		size_t length = strlen(pStr);
+		Reserve(20 + length);
+		uint8* pEnd = EncodeVarint(&m_Data[m_Size], (uint64)field << 3 | WIRE_TYPE_LENGTH_DELIMITED);
+		pEnd = EncodeVarint(pEnd, length);
+		memcpy(pEnd, pStr, length);
+		m_Size = pEnd + length - m_Data.data();
+	}
+
+	// Returns the offset to pass to EndMessage()
+	size_t BeginMessage(uint32 field)
+	{
+		Reserve(10);
+		m_Size = EncodeVarint(&m_Data[m_Size], (uint64)field << 3 | WIRE_TYPE_LENGTH_DELIMITED) - m_Data.data();
+		return m_Size;
+	}
+
+	void EndMessage(size_t offset)
+	{
+		uint8 length[10];
+		size_t lengthSize = EncodeVarint(length, m_Size - offset) - length;
+		Reserve(lengthSize);
+		memmove(&m_Data[offset + lengthSize], &m_Data[offset], m_Size - offset);
+		memcpy(&m_Data[offset], length, lengthSize);
+		m_Size += lengthSize;
+	}
+
+	static uint8* EncodeVarint(uint8* pDst, uint64 value)
+	{
+		while (value >= 0x80)
+		{
+			*pDst++ = (uint8)(value | 0x80);
+			value >>= 7;
+		}
+		*pDst++ = (uint8)value;
+		return pDst;
+	}
+
+	static constexpr uint32 WIRE_TYPE_VARINT = 0;
+	static constexpr uint32 WIRE_TYPE_LENGTH_DELIMITED = 2;
+
+private:
+	void Reserve(size_t size)
+	{
+		if (m_Size + size > m_Data.size())
+			m_Data.resize(std::max(m_Size + size, m_Data.size() * 2));
+	}
+
+	std::vector<uint8>	m_Data;
+	size_t				m_Size = 0;
+};
+
+// A packet sequence with its own incremental state
+struct PerfettoSequence
+{
+	uint32				SequenceID = 0;
+	uint64				TrackUuid = 0;			// Default track of the events. 0 if the events specify their track
+	uint64				Timestamp = 0;			// Timestamp of the previous packet, in nanoseconds
+	bool				IsStarted = false;
+	bool				IsSelfTimeInterned = false;	// True if the name of the self time annotation has been interned on this sequence
+	bool				IsSlackInterned = false;	// True if the name of the slack annotation has been interned on this sequence
+	std::vector<bool>	InternedSites;			// True if the name of the site has been interned on this sequence
+};
+
+class PerfettoTraceWriter
+{
+public:
+	// With writeSelfTime, the slices written by WriteSlices() have a self time annotation
+	PerfettoTraceWriter(OutputStream& stream, uint64 ticksBegin, uint64 ticksPerSecond, Span<const char* const> siteNames, bool writeSelfTime)
+		: m_Stream(stream), m_TicksBegin(ticksBegin), m_TicksPerSecond(ticksPerSecond), m_SiteNames(siteNames), m_WriteSelfTime(writeSelfTime)
+	{}
+
+	PerfettoSequence CreateSequence(uint64 trackUuid)
+	{
+		PerfettoSequence sequence;
+		sequence.SequenceID = ++m_NumSequences;
+		sequence.TrackUuid = trackUuid;
+		sequence.InternedSites.resize(m_SiteNames.size());
+		return sequence;
+	}
+
+	void WriteProcessTrack(uint64 uuid, uint32 pid, const char* pName)
+	{
+		using namespace PerfettoProto;
+		m_Packet.Clear();
+		size_t track = m_Packet.BeginMessage(TracePacket::TrackDescriptor);
+		m_Packet.WriteVarint(TrackDescriptor::Uuid, uuid);
+		size_t process = m_Packet.BeginMessage(TrackDescriptor::Process);
+		m_Packet.WriteVarint(TrackDescriptor::ProcessPid, pid);
+		m_Packet.WriteString(TrackDescriptor::ProcessName, pName);
+		m_Packet.EndMessage(process);
+		m_Packet.EndMessage(track);
+		WritePacket();
+	}
+
+	void WriteThreadTrack(uint64 uuid, uint32 pid, uint32 tid, const char* pName)
+	{
+		using namespace PerfettoProto;
+		m_Packet.Clear();
+		size_t track = m_Packet.BeginMessage(TracePacket::TrackDescriptor);
+		m_Packet.WriteVarint(TrackDescriptor::Uuid, uuid);
+		size_t thread = m_Packet.BeginMessage(TrackDescriptor::Thread);
+		m_Packet.WriteVarint(TrackDescriptor::ThreadPid, pid);
+		m_Packet.WriteVarint(TrackDescriptor::ThreadTid, tid);
+		m_Packet.WriteString(TrackDescriptor::ThreadName, pName);
+		m_Packet.EndMessage(thread);
+		m_Packet.EndMessage(track);
+		WritePacket();
+	}
+
+	// A track which is not a thread, eg. a GPU queue. Pass a counter unit to create a counter track.
+	void WriteTrack(uint64 uuid, uint64 parentUuid, const char* pName, uint32 counterUnit = 0)
+	{
+		using namespace PerfettoProto;
+		m_Packet.Clear();
+		size_t track = m_Packet.BeginMessage(TracePacket::TrackDescriptor);
+		m_Packet.WriteVarint(TrackDescriptor::Uuid, uuid);
+		m_Packet.WriteVarint(TrackDescriptor::ParentUuid, parentUuid);
+		m_Packet.WriteString(TrackDescriptor::Name, pName);
+		if (counterUnit != 0)
+		{
+			size_t counter = m_Packet.BeginMessage(TrackDescriptor::Counter);
+			m_Packet.WriteVarint(TrackDescriptor::CounterUnit, counterUnit);
+			m_Packet.EndMessage(counter);
+		}
+		m_Packet.EndMessage(track);
+		WritePacket();
+	}
+
+	// Write the events of one track of a frame as nested slices on the default track of the sequence.
+	// Events are ordered by TicksBegin with parents before their children.
+	// ToCPUTicks converts the ticks of the events to CPU ticks.
+	// If a critical path is given, the slack of the events is added, starting at the event firstPathEvent of the path.
+	template<typename ToCPUTicks>
+	void WriteSlices(PerfettoSequence& sequence, Span<const CaptureEvent> events, ToCPUTicks&& toCPUTicks,
+		const CriticalPath* pPath = nullptr, const std::vector<bool>* pWaitSites = nullptr, uint32 firstPathEvent = 0)
+	{
+		uint32 pathEventIndex = firstPathEvent;
+		for (const CaptureEvent& event : events)
+		{
+			uint64 begin = ToTimestamp(toCPUTicks(event.TicksBegin));
+			uint64 end = std::max(begin, ToTimestamp(toCPUTicks(event.TicksEnd)));
+			uint64 selfNs = NoAnnotation;
+			if (m_WriteSelfTime)
+				selfNs = TicksToNanoseconds(toCPUTicks(event.TicksBegin + event.SelfTicks) - toCPUTicks(event.TicksBegin), m_TicksPerSecond);
+
+			while (!m_OpenSlices.empty() && m_OpenSlices.back() <= begin)
+			{
+				WriteSliceEnd(sequence, m_OpenSlices.back());
+				m_OpenSlices.pop_back();
+			}
+
+			// Perfetto requires slices to be strictly nested. Clip the event to its parent in case of clock inaccuracies.
+			if (!m_OpenSlices.empty())
+				end = std::min(end, m_OpenSlices.back());
+
+			uint64 slackNs = NoAnnotation;
+			if (pPath)
+			{
+				bool isWait = event.SiteIndex < pWaitSites->size() && (*pWaitSites)[event.SiteIndex];
+				if (!isWait)
+					slackNs = TicksToNanoseconds(pPath->GetSlackTicks(pathEventIndex), m_TicksPerSecond);
+				++pathEventIndex;
+			}
+
+			WriteSliceBegin(sequence, begin, event.SiteIndex, selfNs, slackNs);
+			m_OpenSlices.push_back(end);
+		}
+
+		while (!m_OpenSlices.empty())
+		{
+			WriteSliceEnd(sequence, m_OpenSlices.back());
+			m_OpenSlices.pop_back();
+		}
+	}
+
+	// Write a single slice which is not nested, eg. a segment of the critical path
+	void WriteSlice(PerfettoSequence& sequence, uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, const char* pCategory = nullptr)
+	{
+		uint64 begin = ToTimestamp(ticksBegin);
+		uint64 end = std::max(begin, ToTimestamp(ticksEnd));
+		WriteSliceBegin(sequence, begin, siteIndex, NoAnnotation, NoAnnotation, pCategory);
+		WriteSliceEnd(sequence, end, pCategory);
+	}
+
+	void WriteCounter(PerfettoSequence& sequence, uint64 ticks, uint64 trackUuid, uint64 value)
+	{
+		using namespace PerfettoProto;
+		BeginPacket(sequence, ToTimestamp(ticks));
+		size_t trackEvent = m_Packet.BeginMessage(TracePacket::TrackEvent);
+		m_Packet.WriteVarint(TrackEvent::Type, TrackEvent::TypeCounter);
+		m_Packet.WriteVarint(TrackEvent::TrackUuid, trackUuid);
+		m_Packet.WriteVarint(TrackEvent::CounterValue, value);
+		m_Packet.EndMessage(trackEvent);
+		WritePacket();
+	}
+
+private:
+	uint64 ToTimestamp(uint64 ticks) const
+	{
+		return ticks > m_TicksBegin ? TicksToNanoseconds(ticks - m_TicksBegin, m_TicksPerSecond) : 0;
+	}
+
+	// Value of an annotation which is not written
+	static constexpr uint64 NoAnnotation = ~0ull;
+
+	void WriteSliceBegin(PerfettoSequence& sequence, uint64 timestamp, uint32 siteIndex, uint64 selfNs, uint64 slackNs, const char* pCategory = nullptr)
+	{
+		using namespace PerfettoProto;
+
+		// The last site name is used for events with an invalid site
+		siteIndex = std::min(siteIndex, (uint32)m_SiteNames.size() - 1);
+		uint64 nameIid = siteIndex + 1;
+
+		BeginPacket(sequence, timestamp);
+		bool internSelfTime = selfNs != NoAnnotation && !sequence.IsSelfTimeInterned;
+		bool internSlack = slackNs != NoAnnotation && !sequence.IsSlackInterned;
+		if (!sequence.InternedSites[siteIndex] || internSelfTime || internSlack)
+		{
+			size_t internedData = m_Packet.BeginMessage(TracePacket::InternedData);
+			if (!sequence.InternedSites[siteIndex])
+			{
+				sequence.InternedSites[siteIndex] = true;
+				size_t eventName = m_Packet.BeginMessage(InternedData::EventNames);
+				m_Packet.WriteVarint(InternedData::Iid, nameIid);
+				m_Packet.WriteString(InternedData::Name, m_SiteNames[siteIndex]);
+				m_Packet.EndMessage(eventName);
+			}
+			if (internSelfTime)
+			{
+				sequence.IsSelfTimeInterned = true;
+				size_t annotationName = m_Packet.BeginMessage(InternedData::DebugAnnotationNames);
+				m_Packet.WriteVarint(InternedData::Iid, InternedData::SelfTimeIid);
+				m_Packet.WriteString(InternedData::Name, "self_ns");
+				m_Packet.EndMessage(annotationName);
+			}
+			if (internSlack)
+			{
+				sequence.IsSlackInterned = true;
+				size_t annotationName = m_Packet.BeginMessage(InternedData::DebugAnnotationNames);
+				m_Packet.WriteVarint(InternedData::Iid, InternedData::SlackIid);
+				m_Packet.WriteString(InternedData::Name, "slack_ns");
+				m_Packet.EndMessage(annotationName);
+			}
+			m_Packet.EndMessage(internedData);
+		}
+		size_t trackEvent = m_Packet.BeginMessage(TracePacket::TrackEvent);
+		if (selfNs != NoAnnotation)
+		{
+			size_t selfTime = m_Packet.BeginMessage(TrackEvent::DebugAnnotations);
+			m_Packet.WriteVarint(DebugAnnotation::NameIid, InternedData::SelfTimeIid);
+			m_Packet.WriteVarint(DebugAnnotation::UintValue, selfNs);
+			m_Packet.EndMessage(selfTime);
+		}
+		if (slackNs != NoAnnotation)
+		{
+			size_t slack = m_Packet.BeginMessage(TrackEvent::DebugAnnotations);
+			m_Packet.WriteVarint(DebugAnnotation::NameIid, InternedData::SlackIid);
+			m_Packet.WriteVarint(DebugAnnotation::UintValue, slackNs);
+			m_Packet.EndMessage(slack);
+		}
+		m_Packet.WriteVarint(TrackEvent::Type, TrackEvent::TypeSliceBegin);
+		m_Packet.WriteVarint(TrackEvent::NameIid, nameIid);
+		if (pCategory)
+			m_Packet.WriteString(TrackEvent::Categories, pCategory);
+		m_Packet.EndMessage(trackEvent);
+		WritePacket();
+	}
+
+	void WriteSliceEnd(PerfettoSequence& sequence, uint64 timestamp, const char* pCategory = nullptr)
+	{
+		using namespace PerfettoProto;
+		BeginPacket(sequence, timestamp);
+		size_t trackEvent = m_Packet.BeginMessage(TracePacket::TrackEvent);
+		m_Packet.WriteVarint(TrackEvent::Type, TrackEvent::TypeSliceEnd);
+		if (pCategory)
+			m_Packet.WriteString(TrackEvent::Categories, pCategory);
+		m_Packet.EndMessage(trackEvent);
+		WritePacket();
+	}
+
+	// Start a packet with a timestamp on the sequence.
+	// Timestamps on a sequence can not decrease. Earlier timestamps (eg. overlapping frames) are moved to the previous timestamp.
+	void BeginPacket(PerfettoSequence& sequence, uint64 timestamp)
+	{
+		using namespace PerfettoProto;
+		if (!sequence.IsStarted)
+			StartSequence(sequence, timestamp);
+
+		timestamp = std::max(timestamp, sequence.Timestamp);
+		m_Packet.Clear();
+		m_Packet.WriteVarint(TracePacket::Timestamp, timestamp - sequence.Timestamp);
+		m_Packet.WriteVarint(TracePacket::TrustedPacketSequenceID, sequence.SequenceID);
+		m_Packet.WriteVarint(TracePacket::SequenceFlags, TracePacket::SeqNeedsIncrementalState);
+		sequence.Timestamp = timestamp;
+	}
+
+	void StartSequence(PerfettoSequence& sequence, uint64 timestamp)
+	{
+		using namespace PerfettoProto;
+
+		// Packet defaults are only applied to packets with SeqNeedsIncrementalState
+		m_Packet.Clear();
+		m_Packet.WriteVarint(TracePacket::TrustedPacketSequenceID, sequence.SequenceID);
+		m_Packet.WriteVarint(TracePacket::SequenceFlags, TracePacket::SeqIncrementalStateCleared);
+		size_t defaults = m_Packet.BeginMessage(TracePacket::TracePacketDefaults);
+		m_Packet.WriteVarint(TracePacketDefaults::TimestampClockID, ClockSnapshot::SequenceClock);
+		if (sequence.TrackUuid != 0)
+		{
+			size_t trackEventDefaults = m_Packet.BeginMessage(TracePacketDefaults::TrackEventDefaults);
+			m_Packet.WriteVarint(TracePacketDefaults::TrackUuid, sequence.TrackUuid);
+			m_Packet.EndMessage(trackEventDefaults);
+		}
+		m_Packet.EndMessage(defaults);
+		WritePacket();
+
+		// The incremental clock starts at the first timestamp of the sequence
+		m_Packet.Clear();
+		m_Packet.WriteVarint(TracePacket::TrustedPacketSequenceID, sequence.SequenceID);
+		size_t clockSnapshot = m_Packet.BeginMessage(TracePacket::ClockSnapshot);
+		size_t sequenceClock = m_Packet.BeginMessage(ClockSnapshot::Clocks);
+		m_Packet.WriteVarint(ClockSnapshot::ClockID, ClockSnapshot::SequenceClock);
+		m_Packet.WriteVarint(ClockSnapshot::ClockTimestamp, timestamp);
+		m_Packet.WriteVarint(ClockSnapshot::ClockIsIncremental, 1);
+		m_Packet.EndMessage(sequenceClock);
+		size_t boottimeClock = m_Packet.BeginMessage(ClockSnapshot::Clocks);
+		m_Packet.WriteVarint(ClockSnapshot::ClockID, ClockSnapshot::BuiltinClockBoottime);
+		m_Packet.WriteVarint(ClockSnapshot::ClockTimestamp, timestamp);
+		m_Packet.EndMessage(boottimeClock);
+		m_Packet.EndMessage(clockSnapshot);
+		WritePacket();
+
+		sequence.Timestamp = timestamp;
+		sequence.IsStarted = true;
+	}
+
+	// Write the packet as a field of the Trace message
+	void WritePacket()
+	{
+		uint8 header[11];
+		uint8* pEnd = ProtoWriter::EncodeVarint(header, PerfettoProto::Trace::Packet << 3 | ProtoWriter::WIRE_TYPE_LENGTH_DELIMITED);
+		pEnd = ProtoWriter::EncodeVarint(pEnd, m_Packet.GetSize());
+		m_Stream.Write(header, pEnd - header);
+		m_Stream.Write(m_Packet.GetData(), m_Packet.GetSize());
+	}
+
+	OutputStream&			m_Stream;
+	uint64					m_TicksBegin;
+	uint64					m_TicksPerSecond;
+	Span<const char* const>	m_SiteNames;
+	bool					m_WriteSelfTime;
+	uint32					m_NumSequences = 0;
+	ProtoWriter				m_Packet;			// The packet being written
+	std::vector<uint64>		m_OpenSlices;		// End timestamp of the open slices of the track being written
+};
+
+
+bool ExportPerfettoTrace(const CaptureReader& capture, const char* pPath, const TraceExportOptions& options)
+{
+	using namespace PerfettoProto;
+
+	// Synthetic process IDs, the capture does not contain the process ID
+	constexpr uint32 CPU_PID = 1;
+	constexpr uint32 GPU_PID = 2;
+
+	constexpr uint64 CPU_PROCESS_UUID = 1;
+	constexpr uint64 GPU_PROCESS_UUID = 2;
+	constexpr uint64 CPU_FRAME_TIME_UUID = 3;
+	constexpr uint64 CPU_EVENTS_UUID = 4;
+	constexpr uint64 GPU_FRAME_TIME_UUID = 5;
+	constexpr uint64 GPU_EVENTS_UUID = 6;
+	constexpr uint64 CRITICAL_PATH_UUID = 7;
+	constexpr uint64 THREAD_UUID_BASE = 1ull << 32;
+	constexpr uint64 QUEUE_UUID_BASE = 2ull << 32;
+
+	OutputStream stream;
+	if (!capture.IsOpen() || !stream.Open(pPath))
+		return false;
+
+	// The extra name is used for events with an invalid site
+	std::vector<const char*> siteNames;
+	siteNames.reserve(capture.GetSites().size() + 1);
+	for (const CaptureSite& site : capture.GetSites())
+		siteNames.push_back(site.pName);
+	siteNames.push_back("???");
+
+	uint64 ticksPerSecond = capture.GetTicksPerSecond();
+	PerfettoTraceWriter writer(stream, GetCaptureTicksBegin(capture), ticksPerSecond, siteNames, options.WriteDerivedTimes);
+
+	writer.WriteProcessTrack(CPU_PROCESS_UUID, CPU_PID, "CPU");
+	writer.WriteTrack(CPU_FRAME_TIME_UUID, CPU_PROCESS_UUID, "CPU Frame Time", TrackDescriptor::UnitTimeNs);
+	writer.WriteTrack(CPU_EVENTS_UUID, CPU_PROCESS_UUID, "CPU Events", TrackDescriptor::UnitCount);
+
+	Span<const CaptureThread> threads = capture.GetThreads();
+	std::vector<PerfettoSequence> threadSequences;
+	for (uint32 threadIndex = 0; threadIndex < (uint32)threads.size(); ++threadIndex)
+	{
+		writer.WriteThreadTrack(THREAD_UUID_BASE + threadIndex, CPU_PID, threads[threadIndex].ThreadID, threads[threadIndex].pName);
+		threadSequences.push_back(writer.CreateSequence(THREAD_UUID_BASE + threadIndex));
+	}
+	PerfettoSequence criticalPathSequence;
+	if (options.WriteCriticalPath)
+	{
+		writer.WriteTrack(CRITICAL_PATH_UUID, CPU_PROCESS_UUID, "Critical Path");
+		criticalPathSequence = writer.CreateSequence(CRITICAL_PATH_UUID);
+	}
+
+	writer.WriteProcessTrack(GPU_PROCESS_UUID, GPU_PID, "GPU");
+	writer.WriteTrack(GPU_FRAME_TIME_UUID, GPU_PROCESS_UUID, "GPU Frame Time", TrackDescriptor::UnitTimeNs);
+	writer.WriteTrack(GPU_EVENTS_UUID, GPU_PROCESS_UUID, "GPU Events", TrackDescriptor::UnitCount);
+
+	Span<const CaptureQueue> queues = capture.GetQueues();
+	std::vector<PerfettoSequence> queueSequences;
+	for (uint32 queueIndex = 0; queueIndex < (uint32)queues.size(); ++queueIndex)
+	{
+		writer.WriteTrack(QUEUE_UUID_BASE + queueIndex, GPU_PROCESS_UUID, queues[queueIndex].pName);
+		queueSequences.push_back(writer.CreateSequence(QUEUE_UUID_BASE + queueIndex));
+	}
+
+	PerfettoSequence cpuCounterSequence = writer.CreateSequence(0);
+	PerfettoSequence gpuCounterSequence = writer.CreateSequence(0);
+
+	// The critical path is only needed for the slack and the critical path track
+	bool hasCriticalPath = options.WriteDerivedTimes || options.WriteCriticalPath;
+	std::vector<bool> waitSites = hasCriticalPath ? GetWaitSites(capture) : std::vector<bool>();
+	CriticalPath path;
+	std::vector<uint32> pathSites;
+	const CriticalPath* pSlackPath = options.WriteDerivedTimes ? &path : nullptr;
+
+	CaptureFrame frame;
+	for (uint32 frameIndex = 0; frameIndex < (uint32)capture.GetCPUFrames().size(); ++frameIndex)
+	{
+		if (!capture.DecodeCPUFrame(frameIndex, frame))
+			continue;
+
+		if (hasCriticalPath)
+			ComputeCriticalPath(frame, waitSites, path, pathSites);
+		uint32 firstPathEvent = 0;
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			Span<const CaptureEvent> events = frame.GetEvents(track);
+			if (track.TrackIndex < threadSequences.size())
+				writer.WriteSlices(threadSequences[track.TrackIndex], events, [](uint64 ticks) { return ticks; }, pSlackPath, &waitSites, firstPathEvent);
+			firstPathEvent += (uint32)events.size();
+		}
+
+		if (options.WriteCriticalPath)
+		{
+			for (const CriticalPath::Segment& segment : path.GetSegments())
+				writer.WriteSlice(criticalPathSequence, segment.TicksBegin, segment.TicksEnd, pathSites[segment.EventIndex], CRITICAL_PATH_CATEGORY);
+		}
+
+		writer.WriteCounter(cpuCounterSequence, frame.TicksBegin, CPU_FRAME_TIME_UUID, TicksToNanoseconds(frame.TicksEnd - frame.TicksBegin, ticksPerSecond));
+		writer.WriteCounter(cpuCounterSequence, frame.TicksBegin, CPU_EVENTS_UUID, frame.Events.size());
+	}
+
+	for (uint32 frameIndex = 0; frameIndex < (uint32)capture.GetGPUFrames().size(); ++frameIndex)
+	{
+		if (!capture.DecodeGPUFrame(frameIndex, frame))
+			continue;
+
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			if (track.TrackIndex >= queueSequences.size())
+				continue;
+
+			const CaptureQueue& queue = queues[track.TrackIndex];
+			writer.WriteSlices(queueSequences[track.TrackIndex], frame.GetEvents(track), [&queue](uint64 ticks) { return queue.GpuToCpuTicks(ticks); });
+		}
+
+		writer.WriteCounter(gpuCounterSequence, frame.TicksBegin, GPU_FRAME_TIME_UUID, TicksToNanoseconds(frame.TicksEnd - frame.TicksBegin, ticksPerSecond));
+		writer.WriteCounter(gpuCounterSequence, frame.TicksBegin, GPU_EVENTS_UUID, frame.Events.size());
+	}
+
+	return stream.Close();
+}
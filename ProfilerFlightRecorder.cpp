@@ -0,0 +1,373 @@
+
+// Uses the portable CRT file functions, which are flagged by the MSVC SDL checks
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerFlightRecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace FlightRecordFormat;
+
+// Copy a string into a fixed size field, truncating it if needed
+template<uint32 N>
+static void CopyTruncated(char (&dst)[N], const char* pSrc)
+{
+	size_t length = pSrc ? strlen(pSrc) : 0;
+	if (length > N - 1)
+		length = N - 1;
+	if (length > 0)
+		memcpy(dst, pSrc, length);
+	memset(dst + length, 0, N - length);
+}
+
+//-----------------------------------------------------------------------------
+// [SECTION] Flight Recorder
+//-----------------------------------------------------------------------------
+
+bool FlightRecorder::Open(const char* pPath, uint64 ticksPerSecond, uint32 maxThreads, uint32 recordsPerThread, uint32 maxSites)
+{
+	Close();
+
+	uint32 ringSize = 2;
+	while (ringSize < recordsPerThread)
+		ringSize <<= 1;
+
+	uint64 size = sizeof(FileHeader) + (uint64)maxSites * sizeof(Site) + (uint64)maxThreads * sizeof(Thread) + (uint64)maxThreads * ringSize * sizeof(Record);
+	if (!MapFile(pPath, size))
+		return false;
+
+	// A new file is zero-filled, so only the header has to be written
+	m_pHeader = (FileHeader*)m_pData;
+	m_pSites = (Site*)(m_pHeader + 1);
+	m_pThreads = (Thread*)(m_pSites + maxSites);
+	m_pRecords = (Record*)(m_pThreads + maxThreads);
+
+	m_pHeader->Version = Version;
+	m_pHeader->TicksPerSecond = ticksPerSecond;
+	m_pHeader->MaxSites = maxSites;
+	m_pHeader->MaxThreads = maxThreads;
+	m_pHeader->RecordsPerThread = ringSize;
+	std::atomic_ref<uint32>(m_pHeader->Magic).store(Magic, std::memory_order_release);
+
+	m_SiteCaches.assign(maxThreads, SiteCache());
+	m_SiteMap.clear();
+	return true;
+}
+
+
+void FlightRecorder::Close()
+{
+	UnmapFile();
+	m_pHeader = nullptr;
+	m_pSites = nullptr;
+	m_pThreads = nullptr;
+	m_pRecords = nullptr;
+	m_SiteCaches.clear();
+	m_SiteMap.clear();
+}
+
+
+void FlightRecorder::SetThread(uint32 threadIndex, const char* pName, uint32 threadID)
+{
+	if (threadIndex >= m_pHeader->MaxThreads)
+		return;
+
+	std::scoped_lock lock(m_Lock);
+	Thread& thread = m_pThreads[threadIndex];
+	CopyTruncated(thread.Name, pName);
+	thread.ThreadID = threadID;
+
+	std::atomic_ref<uint32> numThreads(m_pHeader->NumThreads);
+	if (numThreads.load(std::memory_order_relaxed) <= threadIndex)
+		numThreads.store(threadIndex + 1, std::memory_order_release);
+}
+
+
+void FlightRecorder::BeginEvent(uint32 threadIndex, const char* pName, const char* pFilePath, uint32 lineNumber, uint64 ticks)
+{
+	if (threadIndex >= m_pHeader->MaxThreads)
+		return;
+
+	Thread& thread = m_pThreads[threadIndex];
+	uint32 siteIndex = InternSite(threadIndex, pName, pFilePath, lineNumber);
+	if (thread.Depth < MaxDepth)
+		thread.SiteStack[thread.Depth] = siteIndex;
+
+	WriteRecord(threadIndex, Record{ ticks, siteIndex, (uint16)thread.Depth, RecordType::Begin, 0 });
+	++thread.Depth;
+}
+
+
+void FlightRecorder::EndEvent(uint32 threadIndex, uint64 ticks)
+{
+	if (threadIndex >= m_pHeader->MaxThreads)
+		return;
+
+	// Events which were already open when the recorder was attached have no begin record and no known site
+	Thread& thread = m_pThreads[threadIndex];
+	uint32 siteIndex = InvalidSite;
+	if (thread.Depth > 0)
+	{
+		--thread.Depth;
+		if (thread.Depth < MaxDepth)
+			siteIndex = thread.SiteStack[thread.Depth];
+	}
+
+	WriteRecord(threadIndex, Record{ ticks, siteIndex, (uint16)thread.Depth, RecordType::End, 0 });
+}
+
+
+uint32 FlightRecorder::InternSite(uint32 threadIndex, const char* pName, const char* pFilePath, uint32 lineNumber)
+{
+	// Most names are string literals, so the pointer is a cheap key
+	uint64 key = (uint64)(uintptr_t)pName ^ ((uint64)lineNumber << 32);
+	SiteCache::Entry& entry = m_SiteCaches[threadIndex].Entries[(key * 0x9E3779B97F4A7C15ull) >> (64 - SiteCache::NUM_BITS)];
+	if (entry.pName == pName && entry.pFilePath == pFilePath && entry.LineNumber == lineNumber)
+	{
+		// Names may also come from temporary buffers, so the pointer alone does not identify the site
+		if (entry.SiteIndex == InvalidSite || strncmp(pName, m_pSites[entry.SiteIndex].Name, sizeof(Site::Name) - 1) == 0)
+			return entry.SiteIndex;
+	}
+
+	Site site;
+	site.LineNumber = lineNumber;
+	CopyTruncated(site.Name, pName);
+	CopyTruncated(site.FilePath, pFilePath);
+	std::string siteKey((const char*)&site, sizeof(Site));
+
+	uint32 siteIndex = InvalidSite;
+	{
+		std::scoped_lock lock(m_Lock);
+		auto it = m_SiteMap.find(siteKey);
+		if (it != m_SiteMap.end())
+		{
+			siteIndex = it->second;
+		}
+		else if (m_pHeader->NumSites < m_pHeader->MaxSites)
+		{
+			siteIndex = m_pHeader->NumSites;
+			m_pSites[siteIndex] = site;
+			std::atomic_ref<uint32>(m_pHeader->NumSites).store(siteIndex + 1, std::memory_order_release);
+			m_SiteMap.emplace(std::move(siteKey), siteIndex);
+		}
+	}
+
+	entry.pName = pName;
+	entry.pFilePath = pFilePath;
+	entry.LineNumber = lineNumber;
+	entry.SiteIndex = siteIndex;
+	return siteIndex;
+}
+
+
+void FlightRecorder::WriteRecord(uint32 threadIndex, const Record& record)
+{
+	// The record is written before the write index is published, so a reader never sees a partial record at the end of the ring
+	Thread& thread = m_pThreads[threadIndex];
+	uint32 ringSize = m_pHeader->RecordsPerThread;
+	uint64 writeIndex = thread.WriteIndex;
+	m_pRecords[(uint64)threadIndex * ringSize + (writeIndex & (ringSize - 1))] = record;
+	std::atomic_ref<uint64>(thread.WriteIndex).store(writeIndex + 1, std::memory_order_release);
+}
+
+
+#ifdef _WIN32
+
+bool FlightRecorder::MapFile(const char* pPath, uint64 size)
+{
+	HANDLE file = CreateFileA(pPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Creating the mapping extends the file to its full size
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_pFileHandle = file;
+	m_pMappingHandle = mapping;
+	m_pData = (char*)pView;
+	m_Size = size;
+	return true;
+}
+
+
+void FlightRecorder::UnmapFile()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_pMappingHandle)
+		CloseHandle(m_pMappingHandle);
+	if (m_pFileHandle)
+		CloseHandle(m_pFileHandle);
+	m_pData = nullptr;
+	m_pMappingHandle = nullptr;
+	m_pFileHandle = nullptr;
+	m_Size = 0;
+}
+
+#else
+
+bool FlightRecorder::MapFile(const char* pPath, uint64 size)
+{
+	int file = open(pPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return false;
+
+	if (ftruncate(file, (off_t)size) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// MAP_SHARED writes through to the page cache, which the kernel writes back even if the process is killed
+	void* pView = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (pView == MAP_FAILED)
+		return false;
+
+	m_pData = (char*)pView;
+	m_Size = size;
+	return true;
+}
+
+
+void FlightRecorder::UnmapFile()
+{
+	if (m_pData)
+		munmap(m_pData, (size_t)m_Size);
+	m_pData = nullptr;
+	m_Size = 0;
+}
+
+#endif
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Flight Record Reader
+//-----------------------------------------------------------------------------
+
+bool FlightRecordReader::Open(const char* pPath)
+{
+	m_Sites.clear();
+	m_Threads.clear();
+	m_Records.clear();
+	m_TicksEnd = 0;
+
+	FILE* pFile = fopen(pPath, "rb");
+	if (!pFile)
+		return false;
+
+	// All parts are read in file order, so the file is read sequentially
+	bool success = fread(&m_Header, sizeof(FileHeader), 1, pFile) == 1
+		&& m_Header.Magic == Magic
+		&& m_Header.Version == Version
+		&& m_Header.RecordsPerThread > 0
+		&& (m_Header.RecordsPerThread & (m_Header.RecordsPerThread - 1)) == 0;
+
+	if (success)
+	{
+		m_Sites.resize(m_Header.MaxSites);
+		m_Threads.resize(m_Header.MaxThreads);
+		success = fread(m_Sites.data(), sizeof(Site), m_Sites.size(), pFile) == m_Sites.size()
+			&& fread(m_Threads.data(), sizeof(Thread), m_Threads.size(), pFile) == m_Threads.size();
+		m_Sites.resize(std::min(m_Header.NumSites, m_Header.MaxSites));
+		m_Threads.resize(std::min(m_Header.NumThreads, m_Header.MaxThreads));
+	}
+
+	std::vector<Record> ring(m_Header.RecordsPerThread);
+	for (uint32 threadIndex = 0; success && threadIndex < (uint32)m_Threads.size(); ++threadIndex)
+	{
+		success = fread(ring.data(), sizeof(Record), ring.size(), pFile) == ring.size();
+
+		// The oldest record in the ring may have been partially overwritten by the record being written
+		uint64 ringSize = m_Header.RecordsPerThread;
+		uint64 writeIndex = m_Threads[threadIndex].WriteIndex;
+		uint64 firstIndex = writeIndex >= ringSize ? writeIndex - ringSize + 1 : 0;
+
+		std::vector<Record>& records = m_Records.emplace_back();
+		records.reserve(writeIndex - firstIndex);
+		for (uint64 index = firstIndex; index < writeIndex; ++index)
+			records.push_back(ring[index & (ringSize - 1)]);
+
+		if (!records.empty())
+			m_TicksEnd = std::max(m_TicksEnd, records.back().Ticks);
+	}
+
+	fclose(pFile);
+	return success;
+}
+
+
+void FlightRecordReader::GetEvents(uint32 threadIndex, uint64 ticksMin, std::vector<FlightRecordEvent>& outEvents) const
+{
+	outEvents.clear();
+	const std::vector<Record>& records = m_Records[threadIndex];
+	const Thread& thread = m_Threads[threadIndex];
+	uint64 ticksStart = records.empty() ? m_TicksEnd : records.front().Ticks;
+
+	// Replay the records. Events are added when they begin, the stack holds the open ones.
+	std::vector<uint32> stack;
+	for (const Record& record : records)
+	{
+		if (record.Type == RecordType::Begin)
+		{
+			stack.push_back((uint32)outEvents.size());
+			outEvents.push_back(FlightRecordEvent{ record.Ticks, 0, record.SiteIndex, record.Depth, false, false });
+		}
+		else if (!stack.empty())
+		{
+			outEvents[stack.back()].TicksEnd = record.Ticks;
+			stack.pop_back();
+		}
+		else
+		{
+			// The begin record was overwritten
+			outEvents.push_back(FlightRecordEvent{ ticksStart, record.Ticks, record.SiteIndex, record.Depth, false, true });
+		}
+	}
+
+	for (uint32 eventIndex : stack)
+	{
+		outEvents[eventIndex].TicksEnd = m_TicksEnd;
+		outEvents[eventIndex].IsOpen = true;
+	}
+
+	// Events which were open during the whole ring only exist in the site stack of the thread
+	uint32 numOpen = std::min(thread.Depth, MaxDepth);
+	uint32 firstReplayedDepth = stack.empty() ? numOpen : std::min(outEvents[stack.front()].Depth, numOpen);
+	for (uint32 depth = 0; depth < firstReplayedDepth; ++depth)
+		outEvents.push_back(FlightRecordEvent{ ticksStart, m_TicksEnd, thread.SiteStack[depth], depth, true, true });
+
+	outEvents.erase(std::remove_if(outEvents.begin(), outEvents.end(), [ticksMin](const FlightRecordEvent& event) { return event.TicksEnd < ticksMin; }), outEvents.end());
+	std::sort(outEvents.begin(), outEvents.end(), [](const FlightRecordEvent& a, const FlightRecordEvent& b)
+		{
+			if (a.TicksBegin != b.TicksBegin)
+				return a.TicksBegin < b.TicksBegin;
+			return a.Depth < b.Depth;
+		});
+}
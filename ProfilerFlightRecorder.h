@@ -0,0 +1,202 @@
+#pragma once
+
+// Crash-surviving flight recorder.
+
+#include "ProfilerTypes.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Flight Record Format
+//-----------------------------------------------------------------------------
+
+/*
+	A flight record is a fixed size file which is mapped shared into the process:
+
+	[FileHeader]
+	[Site]...							MaxSites entries. The first NumSites are valid
+	[Thread]...							MaxThreads entries. The first NumThreads are valid
+	[Record]...							RecordsPerThread entries for each of the MaxThreads threads
+
+	Each thread writes the begin and end of its events to its own ring of records.
+	Record i of a thread is stored at i % RecordsPerThread. WriteIndex is incremented after the record is written,
+	so the records [WriteIndex - RecordsPerThread + 1, WriteIndex) are complete, even if the process died while writing.
+
+	The file is written through a shared mapping, which means the data is in the page cache of the OS and not in the
+	memory of the process. If the process crashes, the OS still writes it back to the file.
+
+	Names longer than the site fields are truncated.
+	All values are little endian and naturally aligned.
+*/
+namespace FlightRecordFormat
+{
+	constexpr uint32 Magic = 0x52464C54;	// "TLFR"
+	constexpr uint32 Version = 1;
+
+	enum class RecordType : uint8
+	{
+		Begin,
+		End,
+	};
+
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 TicksPerSecond;		// Frequency of the CPU ticks
+		uint32 MaxSites;
+		uint32 MaxThreads;
+		uint32 RecordsPerThread;	// Power of two
+		uint32 NumSites;			// Incremented after the site is written
+		uint32 NumThreads;			// Incremented after the thread is written
+		uint32 Padding;
+	};
+
+	struct Site
+	{
+		uint32 LineNumber;
+		char   Name[60];
+		char   FilePath[64];
+	};
+
+	constexpr uint32 MaxDepth = 32;
+
+	struct Thread
+	{
+		uint64 WriteIndex;			// The number of records written by the thread
+		uint32 ThreadID;
+		uint32 Depth;				// The number of open events of the thread
+		uint32 SiteStack[MaxDepth];	// Sites of the open events. Recovers open events of which the begin record was overwritten
+		char   Name[112];
+	};
+
+	struct Record
+	{
+		uint64 Ticks;
+		uint32 SiteIndex;			// Site of the event
+		uint16 Depth;				// Depth of the event
+		RecordType Type;
+		uint8  Padding;
+	};
+
+	static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(Site) % 8 == 0 && sizeof(Thread) % 8 == 0 && sizeof(Record) == 16);
+
+	// Site index of events which did not fit in the site table
+	constexpr uint32 InvalidSite = ~0u;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Flight Recorder
+//-----------------------------------------------------------------------------
+
+// Records the begin and end of all CPU events in a ring per thread, in a file mapped shared in memory.
+// Unlike a capture, nothing is buffered in the process, so the last events survive a crash of the process.
+// Each thread only writes to its own ring, so recording does not take any locks, except the first time a site is seen.
+class FlightRecorder
+{
+public:
+	FlightRecorder() = default;
+	~FlightRecorder() { Close(); }
+
+	FlightRecorder(const FlightRecorder&) = delete;
+	FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+	// Create the file and map it. The size of the file is fixed: recordsPerThread is rounded up to a power of two,
+	// each event takes two records of 16 bytes.
+	bool Open(const char* pPath, uint64 ticksPerSecond, uint32 maxThreads = 64, uint32 recordsPerThread = 1 << 16, uint32 maxSites = 4096);
+
+	// Unmap the file. No thread may record events while closing.
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; }
+
+	// Describe the thread with the given index. Threads of which the index exceeds maxThreads are not recorded.
+	void SetThread(uint32 threadIndex, const char* pName, uint32 threadID);
+
+	// Record the begin or end of an event. Must be called from the thread with the given index.
+	void BeginEvent(uint32 threadIndex, const char* pName, const char* pFilePath, uint32 lineNumber, uint64 ticks);
+	void EndEvent(uint32 threadIndex, uint64 ticks);
+
+private:
+	bool MapFile(const char* pPath, uint64 size);
+	void UnmapFile();
+
+	uint32 InternSite(uint32 threadIndex, const char* pName, const char* pFilePath, uint32 lineNumber);
+	void WriteRecord(uint32 threadIndex, const FlightRecordFormat::Record& record);
+
+	// Last sites seen by a thread. Only accessed by the thread itself.
+	struct SiteCache
+	{
+		static constexpr uint32 NUM_BITS = 6;
+		static constexpr uint32 NUM_ENTRIES = 1 << NUM_BITS;
+
+		struct Entry
+		{
+			const char* pName = nullptr;
+			const char* pFilePath = nullptr;
+			uint32		LineNumber = 0;
+			uint32		SiteIndex = 0;
+		};
+		Entry Entries[NUM_ENTRIES];
+	};
+
+	char*									m_pData = nullptr;		// Mapped file
+	uint64									m_Size = 0;				// Size of the mapped file
+	void*									m_pFileHandle = nullptr;
+	void*									m_pMappingHandle = nullptr;
+
+	FlightRecordFormat::FileHeader*			m_pHeader = nullptr;
+	FlightRecordFormat::Site*				m_pSites = nullptr;
+	FlightRecordFormat::Thread*				m_pThreads = nullptr;
+	FlightRecordFormat::Record*				m_pRecords = nullptr;
+
+	std::vector<SiteCache>					m_SiteCaches;			// Per thread
+	std::mutex								m_Lock;					// Mutex for adding sites and threads
+	std::unordered_map<std::string, uint32>	m_SiteMap;				// Site key to site index
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Flight Record Reader
+//-----------------------------------------------------------------------------
+
+// An event reconstructed from a flight record
+struct FlightRecordEvent
+{
+	uint64 TicksBegin;
+	uint64 TicksEnd;
+	uint32 SiteIndex;
+	uint32 Depth;
+	bool   IsOpen;				// The event never ended. TicksEnd is the end of the record
+	bool   IsTruncated;			// The begin of the event was overwritten. TicksBegin is the start of the thread's ring
+};
+
+// Reads a flight record written by FlightRecorder, also when the process that wrote it crashed.
+class FlightRecordReader
+{
+public:
+	bool Open(const char* pPath);
+
+	uint64 GetTicksPerSecond() const { return m_Header.TicksPerSecond; }
+
+	// The ticks of the last record of all threads. For a crashed process, this is approximately the time of the crash.
+	uint64 GetTicksEnd() const { return m_TicksEnd; }
+
+	Span<const FlightRecordFormat::Site> GetSites() const { return m_Sites; }
+	Span<const FlightRecordFormat::Thread> GetThreads() const { return m_Threads; }
+
+	// Reconstruct the events of a thread which end at or after ticksMin, ordered by TicksBegin and depth.
+	// Events that were still open end at GetTicksEnd().
+	void GetEvents(uint32 threadIndex, uint64 ticksMin, std::vector<FlightRecordEvent>& outEvents) const;
+
+private:
+	FlightRecordFormat::FileHeader				m_Header{};
+	uint64										m_TicksEnd = 0;
+	std::vector<FlightRecordFormat::Site>		m_Sites;
+	std::vector<FlightRecordFormat::Thread>		m_Threads;
+	std::vector<std::vector<FlightRecordFormat::Record>> m_Records;	// Complete records of each thread, in order
+};
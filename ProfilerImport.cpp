@@ -0,0 +1,1435 @@
+
+// Uses the portable CRT file functions, which are flagged by the MSVC SDL checks
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerImport.h"
+#include "ProfilerCapture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Input Stream
+//-----------------------------------------------------------------------------
+
+// Buffered file input.
+// The parsers read directly from the buffer. When they reach the end, they refill it and keep the unread part.
+class InputStream
+{
+public:
+	~InputStream() { Close(); }
+
+	bool Open(const char* pPath)
+	{
+		Close();
+		m_pFile = fopen(pPath, "rb");
+		m_Buffer.resize(BUFFER_SIZE);
+		m_Size = 0;
+		m_IsEnd = m_pFile == nullptr;
+		return m_pFile != nullptr;
+	}
+
+	void Close()
+	{
+		if (m_pFile)
+			fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+
+	const char* GetBegin() const { return m_Buffer.data(); }
+	const char* GetEnd() const { return m_Buffer.data() + m_Size; }
+	bool IsEnd() const { return m_IsEnd; }
+
+	// Discard the data before pUnread, move the rest to the front of the buffer and read more data after it.
+	// pUnread is updated to its new location. Returns false if there is no more data.
+	bool Refill(const char*& pUnread)
+	{
+		if (m_IsEnd)
+			return false;
+
+		size_t unreadSize = GetEnd() - pUnread;
+		memmove(m_Buffer.data(), pUnread, unreadSize);
+
+		// Grow the buffer if a single token or packet fills most of it
+		if (unreadSize > m_Buffer.size() / 2)
+			m_Buffer.resize(m_Buffer.size() * 2);
+
+		size_t numRead = fread(m_Buffer.data() + unreadSize, 1, m_Buffer.size() - unreadSize, m_pFile);
+		m_Size = unreadSize + numRead;
+		m_IsEnd = numRead == 0;
+		pUnread = m_Buffer.data();
+		return numRead > 0;
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+	FILE*				m_pFile = nullptr;
+	std::vector<char>	m_Buffer;
+	size_t				m_Size = 0;
+	bool				m_IsEnd = true;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Trace Builder
+//-----------------------------------------------------------------------------
+
+// Category of the critical path written by the exporters. It is derived from the other threads, so its events are skipped.
+static constexpr std::string_view CRITICAL_PATH_CATEGORY = "critical_path";
+
+// Counter written by the exporters at the start of each CPU frame, with its duration.
+// Used to cut the events in the frames of the original capture.
+static constexpr std::string_view FRAME_TIME_COUNTER = "CPU Frame Time";
+
+// Collects the events of an imported trace and writes them as a capture.
+// External traces are not ordered by thread or time, so all events are kept until the trace is complete.
+class TraceBuilder
+{
+public:
+	uint32 GetThread(uint64 key, uint32 processID, uint32 threadID)
+	{
+		// Consecutive events are usually on the same thread
+		if (key == m_LastThreadKey && !m_Threads.empty())
+			return m_LastThreadIndex;
+		m_LastThreadKey = key;
+
+		auto it = m_ThreadMap.find(key);
+		if (it != m_ThreadMap.end())
+			return m_LastThreadIndex = it->second;
+
+		uint32 index = (uint32)m_Threads.size();
+		Thread& thread = m_Threads.emplace_back();
+		thread.ProcessID = processID;
+		thread.ThreadID = threadID;
+		m_ThreadMap[key] = index;
+		return m_LastThreadIndex = index;
+	}
+
+	void SetThreadName(uint32 threadIndex, std::string_view name) { m_Threads[threadIndex].Name = name; }
+	void SetProcessName(uint32 processID, std::string_view name) { m_ProcessNames[processID] = name; }
+
+	uint32 InternSite(std::string_view name)
+	{
+		auto it = m_SiteMap.find(name);
+		if (it != m_SiteMap.end())
+			return it->second;
+
+		// The deque does not move its elements, so the map can reference the strings
+		uint32 index = (uint32)m_SiteNames.size();
+		const std::string& siteName = m_SiteNames.emplace_back(name);
+		m_SiteMap[siteName] = index;
+		return index;
+	}
+
+	// Timestamps are in nanoseconds
+	void AddEvent(uint32 threadIndex, int64_t begin, int64_t end, uint32 siteIndex)
+	{
+		m_Threads[threadIndex].Events.push_back({ begin, std::max(begin, end), siteIndex, 0 });
+		m_LastTimestamp = std::max(m_LastTimestamp, end);
+	}
+
+	void BeginEvent(uint32 threadIndex, int64_t begin, uint32 siteIndex)
+	{
+		m_Threads[threadIndex].OpenEvents.push_back({ begin, begin, siteIndex, 0 });
+		m_LastTimestamp = std::max(m_LastTimestamp, begin);
+	}
+
+	// Ends without a matching begin are ignored
+	void EndEvent(uint32 threadIndex, int64_t end)
+	{
+		Thread& thread = m_Threads[threadIndex];
+		if (thread.OpenEvents.empty())
+			return;
+		Event event = thread.OpenEvents.back();
+		thread.OpenEvents.pop_back();
+		AddEvent(threadIndex, event.Begin, end, event.SiteIndex);
+	}
+
+	// Frame of the capture the trace was exported from
+	void AddFrameMarker(int64_t begin, int64_t duration) { m_FrameMarkers.push_back({ begin, begin + std::max(duration, (int64_t)0) }); }
+
+	bool WriteCapture(const char* pPath, const TraceImportOptions& options);
+
+private:
+	struct Event
+	{
+		int64_t Begin;				// Nanoseconds in the trace. Converted to ticks in place when the capture is written
+		int64_t End;
+		uint32	SiteIndex;
+		uint32	Depth;
+	};
+
+	struct Thread
+	{
+		std::string			Name;
+		uint32				ProcessID = 0;
+		uint32				ThreadID = 0;
+		std::vector<Event>	Events;
+		std::vector<Event>	OpenEvents;		// Begin events waiting for their end
+	};
+
+	struct FrameMarker
+	{
+		int64_t Begin;				// Nanoseconds in the trace, converted to ticks like the events
+		int64_t End;
+	};
+
+	static uint64 NanosecondsToTicks(uint64 nanoseconds, uint64 ticksPerSecond)
+	{
+		return nanoseconds / 1000000000ull * ticksPerSecond + nanoseconds % 1000000000ull * ticksPerSecond / 1000000000ull;
+	}
+
+	std::vector<Thread>							m_Threads;
+	std::unordered_map<uint64, uint32>			m_ThreadMap;		// Thread key of the importer to thread index
+	uint64										m_LastThreadKey = 0;
+	uint32										m_LastThreadIndex = 0;
+	std::unordered_map<uint32, std::string>		m_ProcessNames;
+	std::deque<std::string>						m_SiteNames;
+	std::unordered_map<std::string_view, uint32> m_SiteMap;
+	std::vector<FrameMarker>					m_FrameMarkers;
+	int64_t										m_LastTimestamp = INT64_MIN;
+};
+
+
+bool TraceBuilder::WriteCapture(const char* pPath, const TraceImportOptions& options)
+{
+	// Events which never ended are closed at the end of the trace
+	for (uint32 threadIndex = 0; threadIndex < (uint32)m_Threads.size(); ++threadIndex)
+	{
+		while (!m_Threads[threadIndex].OpenEvents.empty())
+			EndEvent(threadIndex, m_LastTimestamp);
+	}
+
+	int64_t firstTimestamp = INT64_MAX;
+	for (const Thread& thread : m_Threads)
+	{
+		for (const Event& event : thread.Events)
+			firstTimestamp = std::min(firstTimestamp, event.Begin);
+	}
+	if (firstTimestamp == INT64_MAX)
+		firstTimestamp = 0;
+
+	int64_t origin = options.AlignToStart ? firstTimestamp : 0;
+	uint64 startTicks = options.AlignToStart ? options.StartTicks : 0;
+	auto ToTicks = [&](int64_t timestamp) -> uint64
+	{
+		int64_t nanoseconds = timestamp - origin + options.OffsetNanoseconds;
+		return startTicks + (nanoseconds > 0 ? NanosecondsToTicks((uint64)nanoseconds, options.TicksPerSecond) : 0);
+	};
+
+	// Order the events of each thread by begin time, parents before their children, and compute their depth
+	std::vector<int64_t> openEnds;
+	for (Thread& thread : m_Threads)
+	{
+		// Most tools write the events of a thread in order already
+		auto IsBefore = [](const Event& a, const Event& b)
+		{
+			if (a.Begin != b.Begin)
+				return a.Begin < b.Begin;
+			return a.End > b.End;
+		};
+		if (!std::is_sorted(thread.Events.begin(), thread.Events.end(), IsBefore))
+			std::sort(thread.Events.begin(), thread.Events.end(), IsBefore);
+
+		openEnds.clear();
+		for (Event& event : thread.Events)
+		{
+			while (!openEnds.empty() && openEnds.back() <= event.Begin)
+				openEnds.pop_back();
+			event.Depth = (uint32)openEnds.size();
+			openEnds.push_back(event.End);
+
+			event.Begin = (int64_t)ToTicks(event.Begin);
+			event.End = (int64_t)ToTicks(event.End);
+		}
+	}
+
+	for (FrameMarker& marker : m_FrameMarkers)
+	{
+		marker.Begin = (int64_t)ToTicks(marker.Begin);
+		marker.End = (int64_t)ToTicks(marker.End);
+	}
+	std::sort(m_FrameMarkers.begin(), m_FrameMarkers.end(), [](const FrameMarker& a, const FrameMarker& b) { return a.Begin < b.Begin; });
+
+	// The importer is not realtime. Never drop frames.
+	CaptureWriter writer;
+	if (!writer.Open(pPath, options.TicksPerSecond, CaptureFormat::Compression::LZ, 1 << 20, ~0u))
+		return false;
+
+	for (const std::string& siteName : m_SiteNames)
+		writer.AddSite(siteName.c_str(), nullptr, 0);
+
+	for (const Thread& thread : m_Threads)
+	{
+		std::string name = thread.Name.empty() ? "Thread " + std::to_string(thread.ThreadID) : thread.Name;
+		auto processIt = m_ProcessNames.find(thread.ProcessID);
+		if (processIt != m_ProcessNames.end() && !processIt->second.empty())
+			name = processIt->second + " | " + name;
+		writer.AddThread(name.c_str(), thread.ThreadID);
+	}
+
+	// Split the events in frames between top-level events, so an event is always in the same frame as its descendants.
+	// A frame ends before the first top-level event which starts after all top-level events of the frame ended, and either
+	// after the next frame marker of the exported capture or, without markers, once the frame is at least FrameDuration long.
+	// Frames span from the first begin to the last end of their events, extended to their marker if they have one.
+	uint64 frameTicks = NanosecondsToTicks(options.FrameDuration, options.TicksPerSecond);
+	std::vector<size_t> cursors(m_Threads.size(), 0);
+	std::vector<size_t> frameCursors(m_Threads.size(), 0);
+	size_t markerIndex = 0;
+	for (uint32 frameIndex = 0;; ++frameIndex)
+	{
+		uint64 frameBegin = ~0ull;
+		uint64 frameEnd = 0;
+		const FrameMarker* pMarker = nullptr;
+		frameCursors = cursors;
+		for (;;)
+		{
+			// The top-level event which starts first. The cursors are always at a top-level event.
+			uint32 nextThread = ~0u;
+			uint64 nextTicks = ~0ull;
+			for (uint32 threadIndex = 0; threadIndex < (uint32)m_Threads.size(); ++threadIndex)
+			{
+				const std::vector<Event>& events = m_Threads[threadIndex].Events;
+				if (frameCursors[threadIndex] < events.size() && (uint64)events[frameCursors[threadIndex]].Begin < nextTicks)
+				{
+					nextThread = threadIndex;
+					nextTicks = (uint64)events[frameCursors[threadIndex]].Begin;
+				}
+			}
+			if (nextThread == ~0u)
+				break;
+
+			if (frameBegin == ~0ull)
+			{
+				// The last marker at or before the first event is the marker of this frame. Earlier ones had no events.
+				while (markerIndex < m_FrameMarkers.size() && (uint64)m_FrameMarkers[markerIndex].Begin <= nextTicks)
+					pMarker = &m_FrameMarkers[markerIndex++];
+			}
+			else if (nextTicks >= frameEnd)
+			{
+				bool isCut = m_FrameMarkers.empty() ? frameEnd - frameBegin >= frameTicks :
+					markerIndex < m_FrameMarkers.size() && (uint64)m_FrameMarkers[markerIndex].Begin <= nextTicks;
+				if (isCut)
+					break;
+			}
+
+			// Take the top-level event with all its descendants
+			const std::vector<Event>& events = m_Threads[nextThread].Events;
+			size_t index = frameCursors[nextThread];
+			frameBegin = std::min(frameBegin, nextTicks);
+			do
+			{
+				frameEnd = std::max(frameEnd, (uint64)events[index].End);
+				++index;
+			} while (index < events.size() && events[index].Depth > 0);
+			frameCursors[nextThread] = index;
+		}
+		if (frameBegin == ~0ull)
+			break;
+
+		if (pMarker)
+		{
+			frameBegin = std::min(frameBegin, (uint64)pMarker->Begin);
+			frameEnd = std::max(frameEnd, (uint64)pMarker->End);
+		}
+		writer.BeginCPUFrame(frameIndex, frameBegin, frameEnd);
+		for (uint32 threadIndex = 0; threadIndex < (uint32)m_Threads.size(); ++threadIndex)
+		{
+			const std::vector<Event>& events = m_Threads[threadIndex].Events;
+			size_t begin = cursors[threadIndex];
+			size_t end = frameCursors[threadIndex];
+			if (end == begin)
+				continue;
+
+			writer.BeginBlock(threadIndex, (uint32)(end - begin));
+			for (size_t i = begin; i < end; ++i)
+				writer.AddEvent((uint64)events[i].Begin, (uint64)events[i].End, events[i].SiteIndex, events[i].Depth);
+		}
+		writer.EndFrame();
+		cursors.swap(frameCursors);
+	}
+
+	writer.Close();
+	return !writer.HasError() && writer.GetNumDroppedFrames() == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] JSON Tokenizer
+//-----------------------------------------------------------------------------
+
+// SAX style JSON tokenizer.
+// Strings without escapes are returned as views into the read buffer, so most tokens are not copied.
+// Commas and colons are skipped. Object keys are returned as Key tokens.
+class JsonTokenizer
+{
+public:
+	enum class Token : uint8
+	{
+		ObjectBegin,
+		ObjectEnd,
+		ArrayBegin,
+		ArrayEnd,
+		Key,
+		String,
+		Number,
+		Literal,		// true, false or null
+		End,
+		Error,
+	};
+
+	JsonTokenizer(InputStream& stream)
+		: m_Stream(stream), m_pCursor(stream.GetBegin()), m_pEnd(stream.GetEnd())
+	{}
+
+	Token Next();
+
+	// Skip the rest of the value starting with the given token. Returns false on an error.
+	bool SkipValue(Token token);
+
+	// The text of the last String, Key, Number or Literal token. Valid until the next call to Next().
+	std::string_view GetText() const { return m_Text; }
+
+	// Parse a number token as a fixed point value: value * 10^decimals. Eg. ParseFixed("1.5", 3) returns 1500.
+	static int64_t ParseFixed(std::string_view text, uint32 decimals);
+
+private:
+	// Returns false if the string is not complete in the buffer
+	bool ScanString();
+	bool UnescapeString(const char* pBegin);
+
+	bool Refill(const char*& pUnread)
+	{
+		bool result = m_Stream.Refill(pUnread);
+		m_pEnd = m_Stream.GetEnd();
+		return result;
+	}
+
+	static bool IsValueChar(char c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+	}
+
+	InputStream&		m_Stream;
+	const char*			m_pCursor;
+	const char*			m_pEnd;
+	std::string_view	m_Text;
+	std::string			m_UnescapedText;		// Storage of the last string with escapes
+	std::vector<uint8>	m_IsObject;				// For each open container, 1 if it is an object
+	bool				m_InObject = false;		// True if the innermost container is an object
+	bool				m_ExpectKey = false;	// True if the next string is an object key
+};
+
+
+JsonTokenizer::Token JsonTokenizer::Next()
+{
+	for (;;)
+	{
+		// Skip whitespace and separators. Control characters are not valid outside of strings and are treated as whitespace.
+		while (m_pCursor < m_pEnd)
+		{
+			char c = *m_pCursor;
+			if (c == ',')
+				m_ExpectKey = m_InObject;
+			else if (c != ':' && (uint8)c > ' ')
+				break;
+			++m_pCursor;
+		}
+
+		if (m_pCursor == m_pEnd)
+		{
+			if (!Refill(m_pCursor))
+				return Token::End;
+			continue;
+		}
+
+		const char* pStart = m_pCursor;
+		switch (*m_pCursor)
+		{
+		case '{':
+			++m_pCursor;
+			m_IsObject.push_back(1);
+			m_InObject = true;
+			m_ExpectKey = true;
+			return Token::ObjectBegin;
+		case '[':
+			++m_pCursor;
+			m_IsObject.push_back(0);
+			m_InObject = false;
+			m_ExpectKey = false;
+			return Token::ArrayBegin;
+		case '}':
+		case ']':
+		{
+			bool isObject = *m_pCursor == '}';
+			++m_pCursor;
+			if (m_IsObject.empty() || m_InObject != isObject)
+				return Token::Error;
+			m_IsObject.pop_back();
+			m_InObject = !m_IsObject.empty() && m_IsObject.back();
+			m_ExpectKey = false;
+			return isObject ? Token::ObjectEnd : Token::ArrayEnd;
+		}
+		case '"':
+		{
+			if (!ScanString())
+			{
+				// The string continues in the next block. Scan it again once it is complete.
+				if (!Refill(pStart))
+					return Token::Error;
+				m_pCursor = pStart;
+				continue;
+			}
+			Token token = m_ExpectKey ? Token::Key : Token::String;
+			m_ExpectKey = false;
+			return token;
+		}
+		default:
+		{
+			const char* pValueEnd = m_pCursor;
+			while (pValueEnd < m_pEnd && IsValueChar(*pValueEnd))
+				++pValueEnd;
+			if (pValueEnd == m_pEnd && !m_Stream.IsEnd())
+			{
+				// The value may continue in the next block. At the end of the file it is scanned again as it is.
+				Refill(pStart);
+				m_pCursor = pStart;
+				continue;
+			}
+			if (pValueEnd == m_pCursor)
+				return Token::Error;
+
+			m_Text = std::string_view(m_pCursor, pValueEnd - m_pCursor);
+			m_pCursor = pValueEnd;
+			char c = m_Text[0];
+			return (c >= '0' && c <= '9') || c == '-' ? Token::Number : Token::Literal;
+		}
+		}
+	}
+}
+
+
+bool JsonTokenizer::ScanString()
+{
+	const char* pBegin = m_pCursor + 1;
+	const char* pQuote = (const char*)memchr(pBegin, '"', m_pEnd - pBegin);
+	if (!pQuote)
+		return false;
+
+	// Fast path: the string has no escapes
+	if (!memchr(pBegin, '\\', pQuote - pBegin))
+	{
+		m_Text = std::string_view(pBegin, pQuote - pBegin);
+		m_pCursor = pQuote + 1;
+		return true;
+	}
+	return UnescapeString(pBegin);
+}
+
+
+bool JsonTokenizer::UnescapeString(const char* pBegin)
+{
+	static constexpr auto HexValue = [](char c) -> int
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return 0;
+	};
+
+	m_UnescapedText.clear();
+	const char* pChar = pBegin;
+	while (pChar < m_pEnd)
+	{
+		char c = *pChar++;
+		if (c == '"')
+		{
+			m_Text = m_UnescapedText;
+			m_pCursor = pChar;
+			return true;
+		}
+		if (c != '\\')
+		{
+			m_UnescapedText += c;
+			continue;
+		}
+		if (pChar == m_pEnd)
+			return false;
+
+		c = *pChar++;
+		switch (c)
+		{
+		case 'b': m_UnescapedText += '\b'; break;
+		case 'f': m_UnescapedText += '\f'; break;
+		case 'n': m_UnescapedText += '\n'; break;
+		case 'r': m_UnescapedText += '\r'; break;
+		case 't': m_UnescapedText += '\t'; break;
+		case 'u':
+		{
+			if (m_pEnd - pChar < 4)
+				return false;
+			uint32 codePoint = 0;
+			for (int i = 0; i < 4; ++i)
+				codePoint = codePoint << 4 | HexValue(*pChar++);
+
+			// Surrogate pairs are not combined. Both halves are replaced.
+			if (codePoint >= 0xD800 && codePoint < 0xE000)
+				codePoint = '?';
+
+			// Encode as UTF-8
+			if (codePoint < 0x80)
+			{
+				m_UnescapedText += (char)codePoint;
+			}
+			else if (codePoint < 0x800)
+			{
+				m_UnescapedText += (char)(0xC0 | codePoint >> 6);
+				m_UnescapedText += (char)(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				m_UnescapedText += (char)(0xE0 | codePoint >> 12);
+				m_UnescapedText += (char)(0x80 | (codePoint >> 6 & 0x3F));
+				m_UnescapedText += (char)(0x80 | (codePoint & 0x3F));
+			}
+			break;
+		}
+		default:
+			// \" \\ \/
+			m_UnescapedText += c;
+			break;
+		}
+	}
+	return false;
+}
+
+
+bool JsonTokenizer::SkipValue(Token token)
+{
+	if (token != Token::ObjectBegin && token != Token::ArrayBegin)
+		return token != Token::End && token != Token::Error;
+
+	uint32 depth = 1;
+	while (depth > 0)
+	{
+		token = Next();
+		if (token == Token::ObjectBegin || token == Token::ArrayBegin)
+			++depth;
+		else if (token == Token::ObjectEnd || token == Token::ArrayEnd)
+			--depth;
+		else if (token == Token::End || token == Token::Error)
+			return false;
+	}
+	return true;
+}
+
+
+int64_t JsonTokenizer::ParseFixed(std::string_view text, uint32 decimals)
+{
+	size_t i = 0;
+	bool negative = i < text.size() && text[i] == '-';
+	if (negative)
+		++i;
+
+	int64_t value = 0;
+	for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i)
+		value = value * 10 + (text[i] - '0');
+
+	// Digits after the requested precision are truncated
+	if (i < text.size() && text[i] == '.')
+		++i;
+	for (uint32 d = 0; d < decimals; ++d)
+	{
+		value *= 10;
+		if (i < text.size() && text[i] >= '0' && text[i] <= '9')
+			value += text[i++] - '0';
+	}
+	while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+		++i;
+
+	// Exponents are rare, let the CRT handle them
+	if (i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+	{
+		std::string copy(text);
+		double result = strtod(copy.c_str(), nullptr);
+		for (uint32 d = 0; d < decimals; ++d)
+			result *= 10;
+		return (int64_t)result;
+	}
+	return negative ? -value : value;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Chrome Trace Import
+//-----------------------------------------------------------------------------
+
+class ChromeTraceImporter
+{
+public:
+	ChromeTraceImporter(InputStream& stream, TraceBuilder& builder)
+		: m_Tokenizer(stream), m_Builder(builder)
+	{}
+
+	bool Import()
+	{
+		using Token = JsonTokenizer::Token;
+
+		// The trace is either an array of events or an object with a "traceEvents" array
+		Token token = m_Tokenizer.Next();
+		if (token == Token::ArrayBegin)
+			return ImportEvents();
+		if (token != Token::ObjectBegin)
+			return false;
+
+		while ((token = m_Tokenizer.Next()) == Token::Key)
+		{
+			if (m_Tokenizer.GetText() == "traceEvents")
+			{
+				if (m_Tokenizer.Next() != Token::ArrayBegin || !ImportEvents())
+					return false;
+			}
+			else if (!m_Tokenizer.SkipValue(m_Tokenizer.Next()))
+			{
+				return false;
+			}
+		}
+		return token == Token::ObjectEnd;
+	}
+
+private:
+	bool ImportEvents()
+	{
+		using Token = JsonTokenizer::Token;
+
+		Token token;
+		while ((token = m_Tokenizer.Next()) == Token::ObjectBegin)
+		{
+			if (!ImportEvent())
+				return false;
+		}
+
+		// The array format allows a missing closing bracket, for traces of crashed processes
+		return token == Token::ArrayEnd || token == Token::End;
+	}
+
+	bool ImportEvent()
+	{
+		using Token = JsonTokenizer::Token;
+
+		char phase = 0;
+		int64_t timestamp = 0;
+		int64_t duration = 0;
+		uint32 processID = 0;
+		uint32 threadID = 0;
+		bool isDerived = false;
+		m_Name.clear();
+		m_ArgName.clear();
+		m_ArgMilliseconds = 0;
+
+		Token token;
+		while ((token = m_Tokenizer.Next()) == Token::Key)
+		{
+			std::string_view key = m_Tokenizer.GetText();
+			if (key == "ph")
+			{
+				if (m_Tokenizer.Next() != Token::String)
+					return false;
+				phase = m_Tokenizer.GetText().empty() ? 0 : m_Tokenizer.GetText()[0];
+			}
+			else if (key == "name")
+			{
+				if (m_Tokenizer.Next() != Token::String)
+					return false;
+				m_Name = m_Tokenizer.GetText();
+			}
+			else if (key == "cat")
+			{
+				if (m_Tokenizer.Next() != Token::String)
+					return false;
+				isDerived = m_Tokenizer.GetText() == CRITICAL_PATH_CATEGORY;
+			}
+			else if (key == "ts" || key == "dur")
+			{
+				// The key is invalidated by Next(), as it can refill the buffer
+				int64_t& value = key == "ts" ? timestamp : duration;
+				if (m_Tokenizer.Next() != Token::Number)
+					return false;
+				// Microseconds to nanoseconds
+				value = JsonTokenizer::ParseFixed(m_Tokenizer.GetText(), 3);
+			}
+			else if (key == "pid" || key == "tid")
+			{
+				uint32& id = key == "pid" ? processID : threadID;
+				token = m_Tokenizer.Next();
+				if (token == Token::Number)
+					id = (uint32)JsonTokenizer::ParseFixed(m_Tokenizer.GetText(), 0);
+				else if (token == Token::String)
+					id = (uint32)std::hash<std::string_view>()(m_Tokenizer.GetText());
+				else
+					return false;
+			}
+			else if (key == "args")
+			{
+				if (!ImportArgs())
+					return false;
+			}
+			else if (!m_Tokenizer.SkipValue(m_Tokenizer.Next()))
+			{
+				return false;
+			}
+		}
+		if (token != Token::ObjectEnd)
+			return false;
+		if (isDerived)
+			return true;
+
+		uint64 threadKey = (uint64)processID << 32 | threadID;
+		switch (phase)
+		{
+		case 'X':
+			m_Builder.AddEvent(m_Builder.GetThread(threadKey, processID, threadID), timestamp, timestamp + duration, m_Builder.InternSite(m_Name));
+			break;
+		case 'B':
+			m_Builder.BeginEvent(m_Builder.GetThread(threadKey, processID, threadID), timestamp, m_Builder.InternSite(m_Name));
+			break;
+		case 'E':
+			m_Builder.EndEvent(m_Builder.GetThread(threadKey, processID, threadID), timestamp);
+			break;
+		case 'C':
+			if (m_Name == FRAME_TIME_COUNTER)
+				m_Builder.AddFrameMarker(timestamp, m_ArgMilliseconds);
+			break;
+		case 'M':
+			if (m_Name == "thread_name")
+				m_Builder.SetThreadName(m_Builder.GetThread(threadKey, processID, threadID), m_ArgName);
+			else if (m_Name == "process_name")
+				m_Builder.SetProcessName(processID, m_ArgName);
+			break;
+		default:
+			// Instant, async and flow events and other counters have no equivalent in a capture
+			break;
+		}
+		return true;
+	}
+
+	// Only the "name" argument of metadata events and the "ms" argument of the frame time counter are used
+	bool ImportArgs()
+	{
+		using Token = JsonTokenizer::Token;
+
+		Token token = m_Tokenizer.Next();
+		if (token != Token::ObjectBegin)
+			return m_Tokenizer.SkipValue(token);
+
+		while ((token = m_Tokenizer.Next()) == Token::Key)
+		{
+			bool isName = m_Tokenizer.GetText() == "name";
+			bool isMilliseconds = m_Tokenizer.GetText() == "ms";
+			token = m_Tokenizer.Next();
+			if (isName && token == Token::String)
+				m_ArgName = m_Tokenizer.GetText();
+			else if (isMilliseconds && token == Token::Number)
+				m_ArgMilliseconds = JsonTokenizer::ParseFixed(m_Tokenizer.GetText(), 6);
+			else if (!m_Tokenizer.SkipValue(token))
+				return false;
+		}
+		return token == Token::ObjectEnd;
+	}
+
+	JsonTokenizer	m_Tokenizer;
+	TraceBuilder&	m_Builder;
+	std::string		m_Name;				// Copied, the tokenizer text is only valid until the next token
+	std::string		m_ArgName;
+	int64_t			m_ArgMilliseconds = 0;	// In nanoseconds
+};
+
+
+bool ImportChromeTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options)
+{
+	InputStream stream;
+	if (!stream.Open(pPath))
+		return false;
+
+	TraceBuilder builder;
+	ChromeTraceImporter importer(stream, builder);
+	if (!importer.Import())
+		return false;
+	stream.Close();
+	return builder.WriteCapture(pCapturePath, options);
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Perfetto Import
+//-----------------------------------------------------------------------------
+
+static const uint8* ReadVarint(const uint8* pSrc, const uint8* pEnd, uint64& outValue)
+{
+	uint64 value = 0;
+	for (uint32 shift = 0; shift < 64 && pSrc < pEnd; shift += 7)
+	{
+		uint8 byte = *pSrc++;
+		value |= (uint64)(byte & 0x7F) << shift;
+		if (byte < 0x80)
+		{
+			outValue = value;
+			return pSrc;
+		}
+	}
+	return nullptr;
+}
+
+// Iterates the fields of a protobuf message
+class ProtoReader
+{
+public:
+	ProtoReader() = default;
+	ProtoReader(const uint8* pData, size_t size)
+		: m_pCursor(pData), m_pEnd(pData + size)
+	{}
+
+	// Read the next field. Returns false at the end of the message or if the message is malformed.
+	bool Next()
+	{
+		if (m_pCursor >= m_pEnd)
+			return false;
+
+		uint64 tag;
+		if (!(m_pCursor = ReadVarint(m_pCursor, m_pEnd, tag)))
+			return Fail();
+		m_Field = (uint32)(tag >> 3);
+		m_WireType = (uint32)(tag & 7);
+
+		switch (m_WireType)
+		{
+		case 0:
+			if (!(m_pCursor = ReadVarint(m_pCursor, m_pEnd, m_Value)))
+				return Fail();
+			return true;
+		case 1:
+		case 5:
+		{
+			size_t size = m_WireType == 1 ? 8 : 4;
+			if ((size_t)(m_pEnd - m_pCursor) < size)
+				return Fail();
+			m_Value = 0;
+			memcpy(&m_Value, m_pCursor, size);
+			m_pCursor += size;
+			return true;
+		}
+		case 2:
+		{
+			uint64 size;
+			if (!(m_pCursor = ReadVarint(m_pCursor, m_pEnd, size)) || size > (uint64)(m_pEnd - m_pCursor))
+				return Fail();
+			m_pBytes = m_pCursor;
+			m_Value = size;
+			m_pCursor += size;
+			return true;
+		}
+		default:
+			// Groups are deprecated and not used by Perfetto
+			return Fail();
+		}
+	}
+
+	uint32 GetField() const { return m_Field; }
+	uint64 GetValue() const { return m_Value; }
+	bool IsBytes() const { return m_WireType == 2; }
+	std::string_view GetString() const { return IsBytes() ? std::string_view((const char*)m_pBytes, m_Value) : std::string_view(); }
+	ProtoReader GetMessage() const { return IsBytes() ? ProtoReader(m_pBytes, m_Value) : ProtoReader(); }
+	bool HasError() const { return m_HasError; }
+
+private:
+	bool Fail()
+	{
+		m_HasError = true;
+		m_pCursor = m_pEnd;
+		return false;
+	}
+
+	const uint8*	m_pCursor = nullptr;
+	const uint8*	m_pEnd = nullptr;
+	const uint8*	m_pBytes = nullptr;
+	uint64			m_Value = 0;
+	uint32			m_Field = 0;
+	uint32			m_WireType = 0;
+	bool			m_HasError = false;
+};
+
+/*
+	The importer handles the subset of the Perfetto format used for track events:
+
+	TracePacket:		timestamp (8), timestamp_clock_id (58), trusted_packet_sequence_id (10), track_event (11),
+						interned_data (12), sequence_flags (13), incremental_state_cleared (41),
+						trace_packet_defaults (59), track_descriptor (60), clock_snapshot (6)
+	TrackEvent:			type (9), name_iid (10), track_uuid (11), categories (22), name (23), counter_value (30)
+	TrackDescriptor:	uuid (1), name (2), process (3), thread (4), counter (8)
+
+	Builtin clocks are assumed to share one time base. Sequence scoped clocks (64 to 127) are converted
+	through the clock snapshot of their sequence, and may be incremental.
+*/
+class PerfettoImporter
+{
+public:
+	PerfettoImporter(InputStream& stream, TraceBuilder& builder)
+		: m_Stream(stream), m_Builder(builder)
+	{}
+
+	bool Import();
+
+private:
+	struct SequenceClock
+	{
+		uint32	ClockID = 0;
+		uint64	Timestamp = 0;			// Timestamp of the clock in the snapshot, in nanoseconds
+		uint64	ReferenceTimestamp = 0;	// Timestamp of the builtin clock in the snapshot
+		uint64	Multiplier = 1;			// Nanoseconds per unit
+		bool	IsIncremental = false;
+		uint64	LastTimestamp = 0;		// Last value of an incremental clock, in nanoseconds
+	};
+
+	struct Sequence
+	{
+		std::unordered_map<uint64, uint32>	EventNames;				// Interned name iid to site index
+		std::vector<SequenceClock>			Clocks;
+		uint64								DefaultTrackUuid = 0;
+		uint32								DefaultClockID = 0;
+	};
+
+	struct Track
+	{
+		std::string Name;
+		uint32		ProcessID = 0;
+		uint32		ThreadID = 0;
+		bool		IsThread = false;
+		bool		IsCounter = false;
+		uint32		ThreadIndex = ~0u;		// Index in the builder. Created when the first event is added
+	};
+
+	bool ImportPacket(ProtoReader packet);
+	void ImportTrackDescriptor(ProtoReader descriptor);
+	void ImportClockSnapshot(Sequence& sequence, ProtoReader snapshot);
+	void ImportTrackEvent(Sequence& sequence, ProtoReader trackEvent, int64_t timestamp, uint32 sequenceID);
+	int64_t ToNanoseconds(Sequence& sequence, uint32 clockID, uint64 timestamp);
+	uint32 GetThread(uint64 trackUuid);
+
+	InputStream&							m_Stream;
+	TraceBuilder&							m_Builder;
+	std::unordered_map<uint32, Sequence>	m_Sequences;		// Elements do not move, so the last sequence can be cached
+	Sequence*								m_pLastSequence = nullptr;
+	uint32									m_LastSequenceID = 0;
+	std::unordered_map<uint64, Track>		m_Tracks;
+	Track*									m_pLastTrack = nullptr;
+	uint64									m_LastTrackUuid = 0;
+};
+
+
+bool PerfettoImporter::Import()
+{
+	// Read the Trace message one packet at a time. The stream keeps each packet contiguous.
+	const char* pCursor = m_Stream.GetBegin();
+	for (;;)
+	{
+		// Tag and length take at most 20 bytes
+		if (m_Stream.GetEnd() - pCursor < 20 && !m_Stream.IsEnd())
+			m_Stream.Refill(pCursor);
+		if (pCursor == m_Stream.GetEnd())
+			break;
+
+		const uint8* pEnd = (const uint8*)m_Stream.GetEnd();
+		uint64 tag;
+		uint64 size;
+		const uint8* pData = ReadVarint((const uint8*)pCursor, pEnd, tag);
+		if (!pData || (tag & 7) != 2 || !(pData = ReadVarint(pData, pEnd, size)))
+			return false;
+
+		size_t headerSize = pData - (const uint8*)pCursor;
+		while ((size_t)(m_Stream.GetEnd() - pCursor) < headerSize + size)
+		{
+			if (!m_Stream.Refill(pCursor))
+				return false;
+		}
+
+		pData = (const uint8*)pCursor + headerSize;
+		if ((tag >> 3) == 1 && !ImportPacket(ProtoReader(pData, size)))
+			return false;
+		pCursor += headerSize + size;
+	}
+	return true;
+}
+
+
+bool PerfettoImporter::ImportPacket(ProtoReader packet)
+{
+	uint64 timestamp = 0;
+	bool hasTimestamp = false;
+	uint32 clockID = 0;
+	uint32 sequenceID = 0;
+	uint32 sequenceFlags = 0;
+	ProtoReader trackEvent, internedData, defaults, trackDescriptor, clockSnapshot;
+	bool hasTrackEvent = false;
+
+	while (packet.Next())
+	{
+		switch (packet.GetField())
+		{
+		case 8:		timestamp = packet.GetValue(); hasTimestamp = true;		break;
+		case 58:	clockID = (uint32)packet.GetValue();						break;
+		case 10:	sequenceID = (uint32)packet.GetValue();						break;
+		case 13:	sequenceFlags = (uint32)packet.GetValue();					break;
+		case 41:	sequenceFlags |= packet.GetValue() ? 1 : 0;				break;
+		case 11:	trackEvent = packet.GetMessage(); hasTrackEvent = true;	break;
+		case 12:	internedData = packet.GetMessage();							break;
+		case 59:	defaults = packet.GetMessage();								break;
+		case 60:	trackDescriptor = packet.GetMessage();						break;
+		case 6:		clockSnapshot = packet.GetMessage();						break;
+		}
+	}
+	if (packet.HasError())
+		return false;
+
+	// Packets of a sequence are usually written in batches
+	if (!m_pLastSequence || sequenceID != m_LastSequenceID)
+	{
+		m_pLastSequence = &m_Sequences[sequenceID];
+		m_LastSequenceID = sequenceID;
+	}
+	Sequence& sequence = *m_pLastSequence;
+
+	// SEQ_INCREMENTAL_STATE_CLEARED
+	if (sequenceFlags & 1)
+	{
+		sequence.EventNames.clear();
+		sequence.DefaultTrackUuid = 0;
+		sequence.DefaultClockID = 0;
+	}
+
+	while (defaults.Next())
+	{
+		if (defaults.GetField() == 58)
+		{
+			sequence.DefaultClockID = (uint32)defaults.GetValue();
+		}
+		else if (defaults.GetField() == 11)
+		{
+			ProtoReader trackEventDefaults = defaults.GetMessage();
+			while (trackEventDefaults.Next())
+			{
+				if (trackEventDefaults.GetField() == 11)
+					sequence.DefaultTrackUuid = trackEventDefaults.GetValue();
+			}
+		}
+	}
+
+	ImportClockSnapshot(sequence, clockSnapshot);
+
+	// InternedData.event_names
+	while (internedData.Next())
+	{
+		if (internedData.GetField() != 2)
+			continue;
+		ProtoReader eventName = internedData.GetMessage();
+		uint64 iid = 0;
+		std::string_view name;
+		while (eventName.Next())
+		{
+			if (eventName.GetField() == 1)
+				iid = eventName.GetValue();
+			else if (eventName.GetField() == 2)
+				name = eventName.GetString();
+		}
+		sequence.EventNames[iid] = m_Builder.InternSite(name);
+	}
+
+	ImportTrackDescriptor(trackDescriptor);
+
+	// Incremental clocks advance with every timestamp on the sequence, also of packets which are not imported
+	if (hasTimestamp)
+	{
+		int64_t nanoseconds = ToNanoseconds(sequence, clockID != 0 ? clockID : sequence.DefaultClockID, timestamp);
+		if (hasTrackEvent)
+			ImportTrackEvent(sequence, trackEvent, nanoseconds, sequenceID);
+	}
+	return true;
+}
+
+
+void PerfettoImporter::ImportTrackDescriptor(ProtoReader descriptor)
+{
+	uint64 uuid = 0;
+	Track track;
+	while (descriptor.Next())
+	{
+		switch (descriptor.GetField())
+		{
+		case 1:
+			uuid = descriptor.GetValue();
+			break;
+		case 2:
+			if (track.Name.empty())
+				track.Name = descriptor.GetString();
+			break;
+		case 3:
+		{
+			// A process track. Its name is also the name of the process.
+			ProtoReader process = descriptor.GetMessage();
+			std::string_view processName;
+			while (process.Next())
+			{
+				if (process.GetField() == 1)
+					track.ProcessID = (uint32)process.GetValue();
+				else if (process.GetField() == 6)
+					processName = process.GetString();
+			}
+			if (!processName.empty())
+			{
+				m_Builder.SetProcessName(track.ProcessID, processName);
+				track.Name = processName;
+			}
+			break;
+		}
+		case 4:
+		{
+			ProtoReader thread = descriptor.GetMessage();
+			track.IsThread = true;
+			while (thread.Next())
+			{
+				if (thread.GetField() == 1)
+					track.ProcessID = (uint32)thread.GetValue();
+				else if (thread.GetField() == 2)
+					track.ThreadID = (uint32)thread.GetValue();
+				else if (thread.GetField() == 5)
+					track.Name = thread.GetString();
+			}
+			break;
+		}
+		case 8:
+			track.IsCounter = true;
+			break;
+		}
+	}
+	if (uuid == 0)
+		return;
+
+	// Descriptors can be repeated. Keep the thread of the first one.
+	Track& existing = m_Tracks[uuid];
+	track.ThreadIndex = existing.ThreadIndex;
+	existing = std::move(track);
+	if (existing.ThreadIndex != ~0u && !existing.Name.empty())
+		m_Builder.SetThreadName(existing.ThreadIndex, existing.Name);
+}
+
+
+void PerfettoImporter::ImportClockSnapshot(Sequence& sequence, ProtoReader snapshot)
+{
+	struct Clock
+	{
+		uint32	ClockID = 0;
+		uint64	Timestamp = 0;
+		uint64	Multiplier = 1;
+		bool	IsIncremental = false;
+	};
+
+	std::vector<Clock> clocks;
+	while (snapshot.Next())
+	{
+		if (snapshot.GetField() != 1)
+			continue;
+		ProtoReader clockReader = snapshot.GetMessage();
+		Clock& clock = clocks.emplace_back();
+		while (clockReader.Next())
+		{
+			switch (clockReader.GetField())
+			{
+			case 1: clock.ClockID = (uint32)clockReader.GetValue();		break;
+			case 2: clock.Timestamp = clockReader.GetValue();				break;
+			case 3: clock.IsIncremental = clockReader.GetValue() != 0;		break;
+			case 4: clock.Multiplier = std::max(clockReader.GetValue(), (uint64)1);	break;
+			}
+		}
+	}
+
+	// The reference is BOOTTIME (6) if present, otherwise the first builtin clock
+	const Clock* pReference = nullptr;
+	for (const Clock& clock : clocks)
+	{
+		if (clock.ClockID < 64 && (!pReference || clock.ClockID == 6))
+			pReference = &clock;
+	}
+	if (!pReference)
+		return;
+
+	for (const Clock& clock : clocks)
+	{
+		if (clock.ClockID < 64 || clock.ClockID > 127)
+			continue;
+
+		auto it = std::find_if(sequence.Clocks.begin(), sequence.Clocks.end(), [&](const SequenceClock& c) { return c.ClockID == clock.ClockID; });
+		SequenceClock& sequenceClock = it != sequence.Clocks.end() ? *it : sequence.Clocks.emplace_back();
+		sequenceClock.ClockID = clock.ClockID;
+		sequenceClock.Timestamp = clock.Timestamp * clock.Multiplier;
+		sequenceClock.ReferenceTimestamp = pReference->Timestamp * pReference->Multiplier;
+		sequenceClock.Multiplier = clock.Multiplier;
+		sequenceClock.IsIncremental = clock.IsIncremental;
+		sequenceClock.LastTimestamp = sequenceClock.Timestamp;
+	}
+}
+
+
+int64_t PerfettoImporter::ToNanoseconds(Sequence& sequence, uint32 clockID, uint64 timestamp)
+{
+	if (clockID < 64)
+		return (int64_t)timestamp;
+
+	for (SequenceClock& clock : sequence.Clocks)
+	{
+		if (clock.ClockID != clockID)
+			continue;
+
+		uint64 value = timestamp * clock.Multiplier;
+		if (clock.IsIncremental)
+		{
+			clock.LastTimestamp += value;
+			value = clock.LastTimestamp;
+		}
+		return (int64_t)(clock.ReferenceTimestamp + (value - clock.Timestamp));
+	}
+
+	// Unknown clock. Assume it is in the same time base.
+	return (int64_t)timestamp;
+}
+
+
+void PerfettoImporter::ImportTrackEvent(Sequence& sequence, ProtoReader trackEvent, int64_t timestamp, uint32 sequenceID)
+{
+	uint32 type = 0;
+	uint64 trackUuid = sequence.DefaultTrackUuid;
+	uint32 siteIndex = ~0u;
+	int64_t counterValue = 0;
+	bool isDerived = false;
+	while (trackEvent.Next())
+	{
+		switch (trackEvent.GetField())
+		{
+		case 9:
+			type = (uint32)trackEvent.GetValue();
+			break;
+		case 10:
+		{
+			auto it = sequence.EventNames.find(trackEvent.GetValue());
+			if (it != sequence.EventNames.end())
+				siteIndex = it->second;
+			break;
+		}
+		case 11:
+			trackUuid = trackEvent.GetValue();
+			break;
+		case 22:
+			isDerived |= trackEvent.GetString() == CRITICAL_PATH_CATEGORY;
+			break;
+		case 23:
+			siteIndex = m_Builder.InternSite(trackEvent.GetString());
+			break;
+		case 30:
+			counterValue = (int64_t)trackEvent.GetValue();
+			break;
+		}
+	}
+
+	if (isDerived)
+		return;
+
+	// TYPE_COUNTER. Only the frame time of the exporters is used, to cut the frames. Its value is in nanoseconds.
+	if (type == 4)
+	{
+		auto it = m_Tracks.find(trackUuid);
+		if (it != m_Tracks.end() && it->second.Name == FRAME_TIME_COUNTER)
+			m_Builder.AddFrameMarker(timestamp, counterValue);
+		return;
+	}
+
+	// TYPE_SLICE_BEGIN and TYPE_SLICE_END. Instants have no equivalent in a capture.
+	if (type != 1 && type != 2)
+		return;
+
+	// Events without a track belong to the thread of their sequence
+	if (trackUuid == 0)
+		trackUuid = 1ull << 63 | sequenceID;
+
+	uint32 threadIndex = GetThread(trackUuid);
+	if (threadIndex == ~0u)
+		return;
+
+	if (type == 1)
+		m_Builder.BeginEvent(threadIndex, timestamp, siteIndex != ~0u ? siteIndex : m_Builder.InternSite("???"));
+	else
+		m_Builder.EndEvent(threadIndex, timestamp);
+}
+
+
+uint32 PerfettoImporter::GetThread(uint64 trackUuid)
+{
+	if (m_pLastTrack && trackUuid == m_LastTrackUuid && m_pLastTrack->ThreadIndex != ~0u)
+		return m_pLastTrack->ThreadIndex;
+
+	Track& track = m_Tracks[trackUuid];
+	m_pLastTrack = &track;
+	m_LastTrackUuid = trackUuid;
+	if (track.IsCounter)
+		return ~0u;
+	if (track.ThreadIndex != ~0u)
+		return track.ThreadIndex;
+
+	// Thread tracks of the same thread share a thread. Other tracks get their own.
+	uint64 key = track.IsThread ? (uint64)track.ProcessID << 32 | track.ThreadID : trackUuid ^ 1ull << 62;
+	track.ThreadIndex = m_Builder.GetThread(key, track.ProcessID, track.IsThread ? track.ThreadID : (uint32)trackUuid);
+	if (!track.Name.empty())
+		m_Builder.SetThreadName(track.ThreadIndex, track.Name);
+	return track.ThreadIndex;
+}
+
+
+bool ImportPerfettoTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options)
+{
+	InputStream stream;
+	if (!stream.Open(pPath))
+		return false;
+
+	TraceBuilder builder;
+	PerfettoImporter importer(stream, builder);
+	if (!importer.Import())
+		return false;
+	stream.Close();
+	return builder.WriteCapture(pCapturePath, options);
+}
+
+
+bool ImportTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options)
+{
+	FILE* pFile = fopen(pPath, "rb");
+	if (!pFile)
+		return false;
+
+	// JSON starts with an object or an array. A Perfetto trace starts with the tag of a packet.
+	int c;
+	while ((c = fgetc(pFile)) == ' ' || c == '\n' || c == '\r' || c == '\t')
+	{
+	}
+	fclose(pFile);
+
+	if (c == '{' || c == '[')
+		return ImportChromeTrace(pPath, pCapturePath, options);
+	return ImportPerfettoTrace(pPath, pCapturePath, options);
+}
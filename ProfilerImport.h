@@ -0,0 +1,40 @@
+#pragma once
+
+// Import traces of other tools into captures, so they can be viewed in the HUD.
+
+#include "ProfilerTypes.h"
+
+struct TraceImportOptions
+{
+	// Tick frequency of the created capture.
+	// Use the frequency of the profiler to line up imported traces with its own captures.
+	uint64	TicksPerSecond = 1000000000;
+
+	// Traces of other tools have no frames. The events are split in frames of at least this length, in nanoseconds.
+	// Frames are only split between top-level events, so a long event makes a long frame. 0 splits at every top-level event which does not overlap another.
+	// Traces exported from captures are split in the frames of the capture instead.
+	uint64	FrameDuration = 16666667;
+
+	// Time base alignment.
+	// If true, the trace is moved so its first event starts at StartTicks.
+	// If false, the timestamps of the trace are converted to ticks as they are. Use this when the tool used the same clock as the profiler.
+	bool	AlignToStart = true;
+	uint64	StartTicks = 0;
+
+	// Added to all timestamps after alignment, to correct a known offset between the clocks
+	int64_t	OffsetNanoseconds = 0;
+};
+
+// Convert Chrome trace-event JSON (both the object and the array format) to a capture.
+// Complete (X) and duration (B/E) events are imported. Each pid/tid becomes a thread.
+// Events in the "critical_path" category are skipped, as the exporters derive them from the other threads.
+// The file is tokenized while it is read, so the size of the trace is only limited by the number of events.
+bool ImportChromeTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options = {});
+
+// Convert a Perfetto protobuf trace to a capture.
+// Track event slices are imported, including interned names and incremental timestamps. Each thread or track becomes a thread.
+// Like for Chrome traces, slices in the "critical_path" category are skipped.
+bool ImportPerfettoTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options = {});
+
+// Detect the format from the contents of the file and import it
+bool ImportTrace(const char* pPath, const char* pCapturePath, const TraceImportOptions& options = {});
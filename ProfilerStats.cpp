@@ -0,0 +1,708 @@
+
+#include "ProfilerStats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Histogram
+//-----------------------------------------------------------------------------
+
+uint32 ProfilerHistogram::GetBucketIndex(uint64 value)
+{
+	if (value < 2 * LinearBuckets)
+		return (uint32)value;
+
+	// Values in [2^n, 2^(n+1)) are shifted down to [LinearBuckets, 2 * LinearBuckets)
+	uint32 shift = (uint32)std::bit_width(value) - 1 - LinearBits;
+	return (shift << LinearBits) + (uint32)(value >> shift);
+}
+
+
+uint64 ProfilerHistogram::GetBucketBegin(uint32 bucketIndex)
+{
+	if (bucketIndex < 2 * LinearBuckets)
+		return bucketIndex;
+
+	uint32 shift = (bucketIndex >> LinearBits) - 1;
+	return (uint64)(bucketIndex - (shift << LinearBits)) << shift;
+}
+
+
+uint64 ProfilerHistogram::GetBucketEnd(uint32 bucketIndex)
+{
+	return bucketIndex + 1 < NumBuckets ? GetBucketBegin(bucketIndex + 1) : ~0ull;
+}
+
+
+void ProfilerHistogram::Add(uint64 value, uint64 count)
+{
+	if (count == 0)
+		return;
+	IncrementBucket(GetBucketIndex(value), count);
+	m_Min = std::min(m_Min, value);
+	m_Max = std::max(m_Max, value);
+}
+
+
+void ProfilerHistogram::AddBucket(uint32 bucketIndex, uint64 count)
+{
+	if (count == 0)
+		return;
+	IncrementBucket(bucketIndex, count);
+
+	// Without the exact values, the bucket bounds are the best estimate of the min and max
+	m_Min = std::min(m_Min, GetBucketBegin(bucketIndex));
+	m_Max = std::max(m_Max, GetBucketEnd(bucketIndex) - 1);
+}
+
+
+void ProfilerHistogram::Merge(const ProfilerHistogram& other)
+{
+	if (other.m_Count == 0)
+		return;
+
+	for (uint32 i = 0; i < (uint32)other.m_Counts.size(); ++i)
+	{
+		if (other.m_Counts[i] > 0)
+			IncrementBucket(other.m_FirstBucket + i, other.m_Counts[i]);
+	}
+	m_Min = std::min(m_Min, other.m_Min);
+	m_Max = std::max(m_Max, other.m_Max);
+}
+
+
+void ProfilerHistogram::IncrementBucket(uint32 bucketIndex, uint64 count)
+{
+	check(bucketIndex < NumBuckets);
+
+	// Grow the stored range to include the bucket
+	if (m_Counts.empty())
+	{
+		m_FirstBucket = bucketIndex;
+		m_Counts.resize(1);
+	}
+	else if (bucketIndex < m_FirstBucket)
+	{
+		m_Counts.insert(m_Counts.begin(), m_FirstBucket - bucketIndex, 0);
+		m_FirstBucket = bucketIndex;
+	}
+	else if (bucketIndex >= GetEndBucket())
+	{
+		m_Counts.resize(bucketIndex - m_FirstBucket + 1);
+	}
+
+	m_Counts[bucketIndex - m_FirstBucket] += count;
+	m_Count += count;
+}
+
+
+void ProfilerHistogram::SetRange(uint64 min, uint64 max)
+{
+	if (m_Count == 0 || min > max)
+		return;
+	m_Min = min;
+	m_Max = max;
+}
+
+
+void ProfilerHistogram::Reset()
+{
+	m_Counts.clear();
+	m_FirstBucket = 0;
+	m_Count = 0;
+	m_Min = ~0ull;
+	m_Max = 0;
+}
+
+
+uint64 ProfilerHistogram::GetPercentile(double percentile) const
+{
+	if (m_Count == 0)
+		return 0;
+
+	// Rank of the value, counting from 1
+	double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 * (double)m_Count;
+	uint64 target = std::max((uint64)ceil(rank), (uint64)1);
+	if (target >= m_Count)
+		return m_Max;
+	uint64 count = 0;
+	for (uint32 i = 0; i < (uint32)m_Counts.size(); ++i)
+	{
+		count += m_Counts[i];
+		if (count >= target)
+		{
+			uint32 bucketIndex = m_FirstBucket + i;
+			uint64 begin = GetBucketBegin(bucketIndex);
+			uint64 value = begin + (GetBucketEnd(bucketIndex) - 1 - begin) / 2;
+			return std::clamp(value, GetMin(), m_Max);
+		}
+	}
+	return m_Max;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Statistics
+//-----------------------------------------------------------------------------
+
+double ProfilerSiteStats::GetStdDevTicks() const
+{
+	return sqrt(VarianceTicks);
+}
+
+
+ProfilerStatistics::ProfilerStatistics()
+{
+	const uint32 defaultWindows[] = { 100, 1000 };
+	SetWindows(defaultWindows);
+}
+
+
+void ProfilerStatistics::SetWindows(Span<const uint32> windowSizes)
+{
+	m_WindowSizes.clear();
+	m_RingSize = 1;
+	for (uint32 windowSize : windowSizes)
+	{
+		m_WindowSizes.push_back(std::max(windowSize, 1u));
+		m_RingSize = std::max(m_RingSize, m_WindowSizes.back());
+	}
+	Reset();
+}
+
+
+void ProfilerStatistics::Reset()
+{
+	m_NumFrames = 0;
+	m_Sites.clear();
+	m_FrameTicks.clear();
+	m_FrameSelfTicks.clear();
+	m_FrameCalls.clear();
+	m_SiteStack.clear();
+}
+
+
+void ProfilerStatistics::BeginFrame(uint32 numSites)
+{
+	if (numSites > m_Sites.size())
+	{
+		m_Sites.resize(numSites);
+		m_FrameTicks.resize(numSites);
+		m_FrameSelfTicks.resize(numSites);
+		m_FrameCalls.resize(numSites);
+	}
+	m_SiteStack.clear();
+}
+
+
+void ProfilerStatistics::BeginTrack()
+{
+	m_SiteStack.clear();
+}
+
+
+void ProfilerStatistics::AddEvent(uint32 siteIndex, uint32 depth, uint64 ticks, uint64 selfTicks)
+{
+	check(siteIndex < m_Sites.size());
+
+	if (PushSiteStack(m_SiteStack, siteIndex, depth))
+		m_FrameTicks[siteIndex] += ticks;
+	// Self times do not overlap, so recursive calls all count
+	m_FrameSelfTicks[siteIndex] += selfTicks;
+	++m_FrameCalls[siteIndex];
+
+	if (m_HistogramsEnabled)
+	{
+		SiteData& site = m_Sites[siteIndex];
+		if (site.BlockHistograms.empty())
+			site.BlockHistograms.resize(m_WindowSizes.size() * (HistogramBlocks + 1));
+		site.HistoryHistogram.Add(ticks);
+		for (uint32 windowIndex = 0; windowIndex < (uint32)m_WindowSizes.size(); ++windowIndex)
+			site.BlockHistograms[GetHistogramBlock(windowIndex, m_NumFrames)].Add(ticks);
+	}
+}
+
+
+void ProfilerStatistics::EndFrame()
+{
+	for (uint32 siteIndex = 0; siteIndex < (uint32)m_Sites.size(); ++siteIndex)
+	{
+		SiteData& site = m_Sites[siteIndex];
+		uint32 calls = m_FrameCalls[siteIndex];
+		if (!site.IsSeen)
+		{
+			if (calls == 0)
+				continue;
+
+			site.IsSeen = true;
+			site.FirstFrame = m_NumFrames;
+			site.RingTicks.assign(m_RingSize, 0);
+			site.RingSelfTicks.assign(m_RingSize, 0);
+			site.RingCalls.assign(m_RingSize, 0);
+			site.Windows.assign(m_WindowSizes.size(), WindowData());
+		}
+
+		UpdateSite(site, m_FrameTicks[siteIndex], m_FrameSelfTicks[siteIndex], calls);
+		m_FrameTicks[siteIndex] = 0;
+		m_FrameSelfTicks[siteIndex] = 0;
+		m_FrameCalls[siteIndex] = 0;
+	}
+	++m_NumFrames;
+
+	// Clear the oldest histogram block of a window when the next frame starts a new block
+	for (uint32 windowIndex = 0; windowIndex < (uint32)m_WindowSizes.size(); ++windowIndex)
+	{
+		if (m_NumFrames % GetHistogramBlockSize(windowIndex) != 0)
+			continue;
+		uint32 block = GetHistogramBlock(windowIndex, m_NumFrames);
+		for (SiteData& site : m_Sites)
+		{
+			if (!site.BlockHistograms.empty())
+				site.BlockHistograms[block].Reset();
+		}
+	}
+}
+
+
+void ProfilerStatistics::UpdateSite(SiteData& site, uint64 ticks, uint64 selfTicks, uint32 calls)
+{
+	uint32 frame = m_NumFrames;
+
+	// History
+	site.FrameTicks.Add((double)ticks);
+	site.NumCalls += calls;
+	site.TotalTicks += ticks;
+	site.TotalSelfTicks += selfTicks;
+	site.MinTicks = std::min(site.MinTicks, ticks);
+	site.MaxTicks = std::max(site.MaxTicks, ticks);
+
+	// Remove the samples leaving the windows before the ring slot is overwritten
+	for (uint32 windowIndex = 0; windowIndex < (uint32)m_WindowSizes.size(); ++windowIndex)
+	{
+		uint32 windowSize = m_WindowSizes[windowIndex];
+		WindowData& window = site.Windows[windowIndex];
+		if (frame - site.FirstFrame >= windowSize)
+		{
+			uint32 leavingFrame = frame - windowSize;
+			uint64 leavingTicks = site.RingTicks[leavingFrame % m_RingSize];
+			window.SumTicks -= leavingTicks;
+			window.SumSelfTicks -= site.RingSelfTicks[leavingFrame % m_RingSize];
+			window.SumSquares -= (double)leavingTicks * (double)leavingTicks;
+			window.NumCalls -= site.RingCalls[leavingFrame % m_RingSize];
+			if (!window.MinQueue.empty() && window.MinQueue.front() == leavingFrame)
+				window.MinQueue.pop_front();
+			if (!window.MaxQueue.empty() && window.MaxQueue.front() == leavingFrame)
+				window.MaxQueue.pop_front();
+		}
+	}
+
+	site.RingTicks[frame % m_RingSize] = ticks;
+	site.RingSelfTicks[frame % m_RingSize] = selfTicks;
+	site.RingCalls[frame % m_RingSize] = calls;
+
+	for (uint32 windowIndex = 0; windowIndex < (uint32)m_WindowSizes.size(); ++windowIndex)
+	{
+		uint32 windowSize = m_WindowSizes[windowIndex];
+		WindowData& window = site.Windows[windowIndex];
+		window.SumTicks += ticks;
+		window.SumSelfTicks += selfTicks;
+		window.SumSquares += (double)ticks * (double)ticks;
+		window.NumCalls += calls;
+
+		while (!window.MinQueue.empty() && site.RingTicks[window.MinQueue.back() % m_RingSize] >= ticks)
+			window.MinQueue.pop_back();
+		window.MinQueue.push_back(frame);
+		while (!window.MaxQueue.empty() && site.RingTicks[window.MaxQueue.back() % m_RingSize] <= ticks)
+			window.MaxQueue.pop_back();
+		window.MaxQueue.push_back(frame);
+
+		// Once per window length, so the cost per frame stays constant
+		if ((frame - site.FirstFrame + 1) % windowSize == 0)
+			RecomputeWindow(site, windowSize, window);
+	}
+}
+
+
+void ProfilerStatistics::RecomputeWindow(const SiteData& site, uint32 windowSize, WindowData& window) const
+{
+	window.SumTicks = 0;
+	window.SumSelfTicks = 0;
+	window.SumSquares = 0.0;
+	window.NumCalls = 0;
+	uint32 numFrames = GetWindowFrames(site, windowSize);
+	for (uint32 i = 0; i < numFrames; ++i)
+	{
+		uint32 slot = (m_NumFrames - i) % m_RingSize;
+		window.SumTicks += site.RingTicks[slot];
+		window.SumSelfTicks += site.RingSelfTicks[slot];
+		window.SumSquares += (double)site.RingTicks[slot] * (double)site.RingTicks[slot];
+		window.NumCalls += site.RingCalls[slot];
+	}
+}
+
+
+// The number of frames in a window of a site, including the frame being fed
+uint32 ProfilerStatistics::GetWindowFrames(const SiteData& site, uint32 windowSize) const
+{
+	uint32 end = m_NumFrames + 1;
+	if (end <= site.FirstFrame)
+		return 0;
+	return std::min(end - site.FirstFrame, windowSize);
+}
+
+
+bool ProfilerStatistics::GetHistoryStats(uint32 siteIndex, ProfilerSiteStats& outStats) const
+{
+	outStats = ProfilerSiteStats();
+	if (siteIndex >= m_Sites.size() || !m_Sites[siteIndex].IsSeen)
+		return false;
+
+	const SiteData& site = m_Sites[siteIndex];
+	outStats.NumFrames = m_NumFrames - site.FirstFrame;
+	outStats.NumCalls = site.NumCalls;
+	outStats.TotalTicks = site.TotalTicks;
+	outStats.TotalSelfTicks = site.TotalSelfTicks;
+	outStats.MinTicks = site.MinTicks;
+	outStats.MaxTicks = site.MaxTicks;
+	outStats.MeanTicks = site.FrameTicks.Mean;
+	outStats.VarianceTicks = site.FrameTicks.GetVariance();
+	return true;
+}
+
+
+bool ProfilerStatistics::GetWindowStats(uint32 windowIndex, uint32 siteIndex, ProfilerSiteStats& outStats) const
+{
+	outStats = ProfilerSiteStats();
+	if (windowIndex >= m_WindowSizes.size() || siteIndex >= m_Sites.size() || !m_Sites[siteIndex].IsSeen)
+		return false;
+
+	const SiteData& site = m_Sites[siteIndex];
+	const WindowData& window = site.Windows[windowIndex];
+	uint32 numFrames = std::min(m_NumFrames - site.FirstFrame, m_WindowSizes[windowIndex]);
+	outStats.NumFrames = numFrames;
+	outStats.NumCalls = window.NumCalls;
+	outStats.TotalTicks = window.SumTicks;
+	outStats.TotalSelfTicks = window.SumSelfTicks;
+	outStats.MinTicks = window.MinQueue.empty() ? 0 : site.RingTicks[window.MinQueue.front() % m_RingSize];
+	outStats.MaxTicks = window.MaxQueue.empty() ? 0 : site.RingTicks[window.MaxQueue.front() % m_RingSize];
+	outStats.MeanTicks = numFrames > 0 ? (double)window.SumTicks / numFrames : 0.0;
+	if (numFrames > 1)
+	{
+		double variance = (window.SumSquares - (double)window.SumTicks * outStats.MeanTicks) / (numFrames - 1);
+		outStats.VarianceTicks = std::max(variance, 0.0);
+	}
+	return true;
+}
+
+
+void ProfilerStatistics::SetHistogramsEnabled(bool enabled)
+{
+	m_HistogramsEnabled = enabled;
+	if (!enabled)
+	{
+		for (SiteData& site : m_Sites)
+		{
+			site.HistoryHistogram = ProfilerHistogram();
+			site.BlockHistograms = std::vector<ProfilerHistogram>();
+		}
+	}
+}
+
+
+const ProfilerHistogram* ProfilerStatistics::GetHistoryHistogram(uint32 siteIndex) const
+{
+	if (!m_HistogramsEnabled || siteIndex >= m_Sites.size() || !m_Sites[siteIndex].IsSeen)
+		return nullptr;
+	return &m_Sites[siteIndex].HistoryHistogram;
+}
+
+
+bool ProfilerStatistics::GetWindowHistogram(uint32 windowIndex, uint32 siteIndex, ProfilerHistogram& outHistogram) const
+{
+	outHistogram.Reset();
+	if (!m_HistogramsEnabled || windowIndex >= m_WindowSizes.size() || siteIndex >= m_Sites.size() || !m_Sites[siteIndex].IsSeen)
+		return false;
+
+	const SiteData& site = m_Sites[siteIndex];
+	if (site.BlockHistograms.empty())
+		return true;
+	for (uint32 block = 0; block <= HistogramBlocks; ++block)
+		outHistogram.Merge(site.BlockHistograms[windowIndex * (HistogramBlocks + 1) + block]);
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Frame Summaries
+//-----------------------------------------------------------------------------
+
+ProfilerFrameSummaries::ProfilerFrameSummaries()
+{
+	// About 73 minutes at 60 fps in 9 MB
+	SetCapacity(1u << 18, 8);
+}
+
+
+void ProfilerFrameSummaries::SetCapacity(uint32 numFrames, uint32 numSitesPerFrame)
+{
+	m_Capacity = numFrames;
+	m_NumSitesPerFrame = numSitesPerFrame;
+	m_FrameTicks = std::vector<uint32>();
+	m_Entries = std::vector<uint32>();
+	Reset();
+}
+
+
+void ProfilerFrameSummaries::Reset()
+{
+	m_FrameEnd = 0;
+	m_NumFrames = 0;
+	m_SiteTicks.clear();
+	m_FrameSites.clear();
+}
+
+
+void ProfilerFrameSummaries::BeginFrame(uint32 numSites)
+{
+	numSites = std::min(numSites, MaxSites);
+	if (numSites > m_SiteTicks.size())
+		m_SiteTicks.resize(numSites);
+}
+
+
+void ProfilerFrameSummaries::AddEvent(uint32 siteIndex, uint64 selfTicks)
+{
+	if (selfTicks == 0 || siteIndex >= m_SiteTicks.size())
+		return;
+
+	// Events without self time are skipped, so a site with time is always in the list
+	if (m_SiteTicks[siteIndex] == 0)
+		m_FrameSites.push_back(siteIndex);
+	m_SiteTicks[siteIndex] += selfTicks;
+}
+
+
+void ProfilerFrameSummaries::EndFrame(uint32 frameIndex, uint64 frameTicks)
+{
+	if (m_Capacity > 0)
+	{
+		if (m_FrameTicks.empty())
+		{
+			m_FrameTicks.resize(m_Capacity);
+			m_Entries.resize((size_t)m_Capacity * m_NumSitesPerFrame);
+		}
+		if (m_NumFrames > 0 && frameIndex != m_FrameEnd)
+			m_NumFrames = 0;
+
+		uint32 slot = frameIndex % m_Capacity;
+		m_FrameTicks[slot] = (uint32)std::min(frameTicks, (uint64)UINT32_MAX);
+
+		// Only the sites with the most time are kept, so only they have to be sorted
+		uint32 numSites = std::min((uint32)m_FrameSites.size(), m_NumSitesPerFrame);
+		std::partial_sort(m_FrameSites.begin(), m_FrameSites.begin() + numSites, m_FrameSites.end(),
+			[this](uint32 a, uint32 b) { return m_SiteTicks[a] > m_SiteTicks[b]; });
+
+		uint32* pEntries = &m_Entries[(size_t)slot * m_NumSitesPerFrame];
+		for (uint32 i = 0; i < m_NumSitesPerFrame; ++i)
+		{
+			uint32 siteIndex = i < numSites ? m_FrameSites[i] : 0;
+			pEntries[i] = i < numSites ? siteIndex << BucketBits | ProfilerHistogram::GetBucketIndex(m_SiteTicks[siteIndex]) : EmptyEntry;
+		}
+
+		m_FrameEnd = frameIndex + 1;
+		m_NumFrames = std::min(m_NumFrames + 1, m_Capacity);
+	}
+
+	for (uint32 siteIndex : m_FrameSites)
+		m_SiteTicks[siteIndex] = 0;
+	m_FrameSites.clear();
+}
+
+
+uint64 ProfilerFrameSummaries::GetFrameTicks(uint32 frameIndex) const
+{
+	URange range = GetFrameRange();
+	if (frameIndex < range.Begin || frameIndex >= range.End)
+		return 0;
+	return m_FrameTicks[frameIndex % m_Capacity];
+}
+
+
+uint32 ProfilerFrameSummaries::GetTopSites(uint32 frameIndex, Span<SiteTime> outSites) const
+{
+	URange range = GetFrameRange();
+	if (frameIndex < range.Begin || frameIndex >= range.End)
+		return 0;
+
+	const uint32* pEntries = &m_Entries[(size_t)(frameIndex % m_Capacity) * m_NumSitesPerFrame];
+	uint32 numSites = 0;
+	for (uint32 i = 0; i < m_NumSitesPerFrame && numSites < outSites.size() && pEntries[i] != EmptyEntry; ++i)
+	{
+		// The middle of the bucket is the best estimate of the time
+		uint32 bucketIndex = pEntries[i] & ((1u << BucketBits) - 1);
+		uint64 begin = ProfilerHistogram::GetBucketBegin(bucketIndex);
+		outSites[numSites++] = { pEntries[i] >> BucketBits, begin + (ProfilerHistogram::GetBucketEnd(bucketIndex) - 1 - begin) / 2 };
+	}
+	return numSites;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Outlier Detection
+//-----------------------------------------------------------------------------
+
+void ProfilerOutlierDetector::SetOptions(const ProfilerOutlierOptions& options, uint64 ticksPerSecond)
+{
+	m_Options = options;
+	m_IsEnabled = options.WindowSize > 0;
+	m_MinDeltaTicks = (uint64)(options.MinDeltaMs * 0.001 * ticksPerSecond);
+	m_RecomputeInterval = std::max(options.WindowSize / 8, 1u);
+	Reset();
+}
+
+
+void ProfilerOutlierDetector::Reset()
+{
+	m_NumFrames = 0;
+	m_Sites.clear();
+	m_Frame = Baseline();
+	m_Outliers.clear();
+	m_NumOutliers = 0;
+	m_FrameTicks.clear();
+	m_SiteStack.clear();
+}
+
+
+void ProfilerOutlierDetector::BeginFrame(uint32 numSites)
+{
+	if (numSites > m_Sites.size())
+	{
+		m_Sites.resize(numSites);
+		m_FrameTicks.resize(numSites);
+	}
+	m_SiteStack.clear();
+}
+
+
+void ProfilerOutlierDetector::BeginTrack()
+{
+	m_SiteStack.clear();
+}
+
+
+void ProfilerOutlierDetector::AddEvent(uint32 siteIndex, uint32 depth, uint64 ticks)
+{
+	if (siteIndex >= m_FrameTicks.size())
+		return;
+
+	if (PushSiteStack(m_SiteStack, siteIndex, depth))
+		m_FrameTicks[siteIndex] += ticks;
+}
+
+
+void ProfilerOutlierDetector::EndFrame(uint32 frameIndex, uint64 frameTicks)
+{
+	if (!m_IsEnabled)
+	{
+		std::fill(m_FrameTicks.begin(), m_FrameTicks.end(), 0);
+		return;
+	}
+
+	ProfilerOutlier outlier;
+	outlier.FrameIndex = frameIndex;
+	if (Evaluate(m_Frame, 0, frameTicks, outlier) > 0.0f)
+	{
+		m_Outliers.push_back(outlier);
+		++m_NumOutliers;
+	}
+
+	m_Candidates.clear();
+	for (uint32 siteIndex = 0; siteIndex < (uint32)m_Sites.size(); ++siteIndex)
+	{
+		Baseline& baseline = m_Sites[siteIndex];
+		uint64 ticks = m_FrameTicks[siteIndex];
+		m_FrameTicks[siteIndex] = 0;
+
+		// Sites are only judged from the first frame they are called in
+		if (baseline.Ring.empty() && ticks == 0)
+			continue;
+
+		outlier.SiteIndex = siteIndex;
+		float deviation = Evaluate(baseline, siteIndex, ticks, outlier);
+		if (deviation > 0.0f)
+			m_Candidates.emplace_back(deviation, outlier);
+	}
+
+	// A frame with a long stall can push many sites over their baseline. Keep the ones deviating the most.
+	uint32 numSites = std::min((uint32)m_Candidates.size(), m_Options.MaxSitesPerFrame);
+	std::partial_sort(m_Candidates.begin(), m_Candidates.begin() + numSites, m_Candidates.end(),
+		[](const auto& a, const auto& b) { return a.first > b.first; });
+	for (uint32 i = 0; i < numSites; ++i)
+		m_Outliers.push_back(m_Candidates[i].second);
+	m_NumOutliers += numSites;
+
+	while (m_Outliers.size() > m_Options.MaxOutliers)
+		m_Outliers.pop_front();
+	++m_NumFrames;
+}
+
+
+URange ProfilerOutlierDetector::FindOutliers(URange frames) const
+{
+	auto IsBefore = [](const ProfilerOutlier& outlier, uint32 frameIndex) { return outlier.FrameIndex < frameIndex; };
+	auto begin = std::lower_bound(m_Outliers.begin(), m_Outliers.end(), frames.Begin, IsBefore);
+	auto end = std::lower_bound(begin, m_Outliers.end(), frames.End, IsBefore);
+	return URange((uint32)(begin - m_Outliers.begin()), (uint32)(end - m_Outliers.begin()));
+}
+
+
+float ProfilerOutlierDetector::Evaluate(Baseline& baseline, uint32 staggerIndex, uint64 ticks, ProfilerOutlier& outOutlier)
+{
+	uint32 windowSize = m_Options.WindowSize;
+	if (baseline.Ring.empty())
+		baseline.Ring.resize(windowSize);
+
+	// Judge the time against the baseline of the previous frames, before it is part of the window
+	float deviation = 0.0f;
+	if (baseline.IsValid && ticks > baseline.MedianTicks + m_MinDeltaTicks)
+	{
+		uint64 delta = ticks - baseline.MedianTicks;
+		if ((double)delta > m_Options.Threshold * (double)baseline.DeviationTicks)
+		{
+			// A site with a constant time has no deviation, so any increase beyond the minimum is an outlier
+			deviation = (float)delta / (float)std::max(baseline.DeviationTicks, (uint64)1);
+			outOutlier.Ticks = ticks;
+			outOutlier.BaselineTicks = baseline.MedianTicks;
+			outOutlier.DeviationTicks = baseline.DeviationTicks;
+		}
+	}
+
+	baseline.Ring[baseline.NumSamples % windowSize] = (uint32)std::min(ticks, (uint64)UINT32_MAX);
+	++baseline.NumSamples;
+
+	// Stagger the recomputation of the baselines, so each frame recomputes about the same number of them
+	if (baseline.NumSamples >= m_Options.MinFrames && (!baseline.IsValid || (m_NumFrames + staggerIndex) % m_RecomputeInterval == 0))
+		Recompute(baseline);
+	return deviation;
+}
+
+
+void ProfilerOutlierDetector::Recompute(Baseline& baseline)
+{
+	uint32 numSamples = std::min(baseline.NumSamples, m_Options.WindowSize);
+	m_Scratch.assign(baseline.Ring.begin(), baseline.Ring.begin() + numSamples);
+	auto middle = m_Scratch.begin() + numSamples / 2;
+	std::nth_element(m_Scratch.begin(), middle, m_Scratch.end());
+	uint32 median = *middle;
+
+	for (uint32& sample : m_Scratch)
+		sample = sample > median ? sample - median : median - sample;
+	std::nth_element(m_Scratch.begin(), middle, m_Scratch.end());
+
+	// 1.4826 * MAD estimates the standard deviation of normally distributed times
+	baseline.MedianTicks = median;
+	baseline.DeviationTicks = (uint64)(*middle * 1.4826 + 0.5);
+	baseline.IsValid = true;
+}
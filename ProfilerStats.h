@@ -0,0 +1,432 @@
+#pragma once
+
+// Per-site statistics and latency histograms over the frame history, and compact summaries of a long frame history.
+
+#include "ProfilerTypes.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Self Time
+//-----------------------------------------------------------------------------
+
+// Assign the self (exclusive) time of the events of a single thread or queue: the duration of an event minus the duration of its direct children.
+// The events must be in pre-order (parents before their children) and have a TicksBegin, TicksEnd, Depth and SelfTicks member.
+// A single linear pass. stack is scratch memory for the open events, so it can be reused between tracks.
+template<typename EventType>
+void ComputeSelfTicks(Span<EventType> events, std::vector<uint32>& stack)
+{
+	stack.clear();
+	for (uint32 i = 0; i < (uint32)events.size(); ++i)
+	{
+		// The stack only holds the ancestors of the event after truncating it to its depth
+		EventType& event = events[i];
+		if (event.Depth < stack.size())
+			stack.resize(event.Depth);
+
+		uint64 ticks = event.TicksEnd - event.TicksBegin;
+		event.SelfTicks = ticks;
+		if (!stack.empty())
+		{
+			uint64& parentSelfTicks = events[stack.back()].SelfTicks;
+			parentSelfTicks -= std::min(parentSelfTicks, ticks);
+		}
+		stack.push_back(i);
+	}
+}
+
+// Push the site of an event on the stack of its ancestors. Returns false if the event is a recursive call of an ancestor of the same site,
+// as its time is already part of the outer call. Used to add the inclusive time of each site in a frame without counting recursion twice.
+// The events of a track must be in pre-order. Clear siteStack at the start of each track.
+inline bool PushSiteStack(std::vector<uint32>& siteStack, uint32 siteIndex, uint32 depth)
+{
+	// The stack only holds the ancestors of the event after truncating it to its depth
+	if (depth < siteStack.size())
+		siteStack.resize(depth);
+	bool isOutermost = std::find(siteStack.begin(), siteStack.end(), siteIndex) == siteStack.end();
+	siteStack.push_back(siteIndex);
+	return isOutermost;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Histogram
+//-----------------------------------------------------------------------------
+
+// Log-linear (HDR style) histogram of durations in ticks.
+// Values below 2 * LinearBuckets have a bucket each. Above, each power of two is split in LinearBuckets buckets of equal width,
+// so a bucket is at most 1/LinearBuckets (3%) of its values wide, over the whole range of 64-bit values.
+// The bucket layout is fixed, so histograms of different threads, sites, windows or captures can be merged by adding the counts.
+// Only the buckets between the lowest and highest recorded value are stored.
+class ProfilerHistogram
+{
+public:
+	static constexpr uint32 LinearBits = 5;
+	static constexpr uint32 LinearBuckets = 1u << LinearBits;
+	static constexpr uint32 NumBuckets = (65 - LinearBits) << LinearBits;
+
+	static uint32 GetBucketIndex(uint64 value);
+	static uint64 GetBucketBegin(uint32 bucketIndex);
+	static uint64 GetBucketEnd(uint32 bucketIndex);		// Exclusive. ~0ull for the last bucket
+
+	void Add(uint64 value, uint64 count = 1);
+	void AddBucket(uint32 bucketIndex, uint64 count);
+	void Merge(const ProfilerHistogram& other);
+	void Reset();
+
+	// Restore the exact min and max of the values, after adding their buckets with AddBucket()
+	void SetRange(uint64 min, uint64 max);
+
+	uint64 GetCount() const { return m_Count; }
+	uint64 GetMin() const { return m_Count > 0 ? m_Min : 0; }
+	uint64 GetMax() const { return m_Max; }
+
+	// The value below which the given percentage [0, 100] of the values lie.
+	// Returns the middle of the bucket containing it, clamped to the recorded min and max. O(buckets).
+	uint64 GetPercentile(double percentile) const;
+
+	// Range of the stored buckets. Buckets outside it are empty.
+	uint32 GetFirstBucket() const { return m_FirstBucket; }
+	uint32 GetEndBucket() const { return m_FirstBucket + (uint32)m_Counts.size(); }
+	uint64 GetBucketCount(uint32 bucketIndex) const
+	{
+		return bucketIndex >= m_FirstBucket && bucketIndex < GetEndBucket() ? m_Counts[bucketIndex - m_FirstBucket] : 0;
+	}
+
+private:
+	void IncrementBucket(uint32 bucketIndex, uint64 count);
+
+	std::vector<uint64>	m_Counts;				// Count of each bucket, starting at m_FirstBucket
+	uint32				m_FirstBucket = 0;
+	uint64				m_Count = 0;
+	uint64				m_Min = ~0ull;
+	uint64				m_Max = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Statistics
+//-----------------------------------------------------------------------------
+
+// Welford's online mean and variance. Unlike sums of squares, it does not lose precision when the samples are large compared to their spread.
+// Accumulators of disjoint samples are merged with Chan's parallel formula, so partial results of a parallel pass combine exactly.
+struct ProfilerRunningVariance
+{
+	uint64 Count = 0;
+	double Mean = 0.0;
+	double M2 = 0.0;				// Sum of squared differences from the mean
+
+	void Add(double value)
+	{
+		++Count;
+		double delta = value - Mean;
+		Mean += delta / (double)Count;
+		M2 += delta * (value - Mean);
+	}
+
+	void Merge(const ProfilerRunningVariance& other)
+	{
+		if (other.Count == 0)
+			return;
+		double count = (double)(Count + other.Count);
+		double delta = other.Mean - Mean;
+		Mean += delta * ((double)other.Count / count);
+		M2 += other.M2 + delta * delta * ((double)Count * (double)other.Count / count);
+		Count += other.Count;
+	}
+
+	// Sample variance
+	double GetVariance() const { return Count > 1 ? M2 / (double)(Count - 1) : 0.0; }
+};
+
+// Statistics of a site over a range of frames.
+// A frame sample is the time spent in the site during the frame, summed over all its calls and threads.
+// Frames in which the site was not called count as zero, frames before the site was first seen are not included.
+struct ProfilerSiteStats
+{
+	uint32 NumFrames = 0;			// Frames in the range
+	uint64 NumCalls = 0;			// Calls in all frames
+	uint64 TotalTicks = 0;			// Time in all frames
+	uint64 MinTicks = 0;			// Least time in a single frame
+	uint64 MaxTicks = 0;			// Most time in a single frame
+	double MeanTicks = 0.0;			// Mean time per frame
+	double VarianceTicks = 0.0;		// Sample variance of the time per frame, in ticks squared
+	uint64 TotalSelfTicks = 0;		// Self time in all frames, excluding the time of child events
+
+	double GetCallsPerFrame() const { return NumFrames > 0 ? (double)NumCalls / NumFrames : 0.0; }
+	double GetMeanSelfTicks() const { return NumFrames > 0 ? (double)TotalSelfTicks / NumFrames : 0.0; }
+	double GetStdDevTicks() const;
+};
+
+// Maintains statistics per site, fed once per finalized frame.
+// The statistics are kept over the whole history and over rolling windows of the last frames.
+// Each frame costs a pass over its events and O(sites * windows), independent of the length of the history or the windows:
+//	- The history uses Welford's online mean and variance.
+//	- The windows keep running sums of the frame samples in a ring, and min/max with monotonic queues.
+//	  The sums are recomputed from the ring each time a window wraps, so rounding errors do not accumulate.
+// Each site also has a histogram of the duration of its calls over the history and over each window, for percentiles.
+// A window histogram is the merge of HistogramBlocks blocks of window / HistogramBlocks frames and the block being filled,
+// so it covers the last window frames plus up to one block more.
+// Not thread safe. Feed and query from the same thread, or synchronize externally.
+class ProfilerStatistics
+{
+public:
+	ProfilerStatistics();
+
+	// Set the sizes of the rolling windows in frames and reset all statistics.
+	// Each site keeps a ring of the largest window size with 20 bytes per frame.
+	void SetWindows(Span<const uint32> windowSizes);
+	Span<const uint32> GetWindows() const { return m_WindowSizes; }
+
+	// Forget all frames and sites
+	void Reset();
+
+	// Feed a frame. The events of each thread or queue follow a call to BeginTrack(), in pre-order (parents before their children).
+	// numSites is the number of sites in the site table. Site indices of the events must be smaller.
+	// selfTicks is the duration of the event minus the duration of its direct children. See ComputeSelfTicks().
+	void BeginFrame(uint32 numSites);
+	void BeginTrack();
+	void AddEvent(uint32 siteIndex, uint32 depth, uint64 ticks, uint64 selfTicks);
+	void EndFrame();
+
+	uint32 GetNumFrames() const { return m_NumFrames; }
+	uint32 GetNumSites() const { return (uint32)m_Sites.size(); }
+
+	// Statistics over all frames since the site was first seen. Returns false if the site was never seen.
+	bool GetHistoryStats(uint32 siteIndex, ProfilerSiteStats& outStats) const;
+
+	// Statistics over the last GetWindows()[windowIndex] frames, or fewer if not as many frames were fed since the site was first seen.
+	bool GetWindowStats(uint32 windowIndex, uint32 siteIndex, ProfilerSiteStats& outStats) const;
+
+	// Enable the histograms. Disabling them frees their memory. Enabled by default.
+	void SetHistogramsEnabled(bool enabled);
+	bool IsHistogramsEnabled() const { return m_HistogramsEnabled; }
+
+	// Histogram of the duration of each call of the site over all frames, merged over all threads. Recursive calls are included.
+	// Returns nullptr if the site was never seen or histograms are disabled.
+	const ProfilerHistogram* GetHistoryHistogram(uint32 siteIndex) const;
+
+	// Histogram of the duration of each call of the site over the last GetWindows()[windowIndex] frames. O(buckets).
+	bool GetWindowHistogram(uint32 windowIndex, uint32 siteIndex, ProfilerHistogram& outHistogram) const;
+
+	static constexpr uint32 HistogramBlocks = 4;
+
+private:
+	struct WindowData
+	{
+		uint64				SumTicks = 0;
+		uint64				SumSelfTicks = 0;
+		uint64				NumCalls = 0;
+		double				SumSquares = 0.0;
+		std::deque<uint32>	MinQueue;			// Frames of increasing samples. The front is the minimum in the window
+		std::deque<uint32>	MaxQueue;			// Frames of decreasing samples. The front is the maximum in the window
+	};
+
+	struct SiteData
+	{
+		bool					IsSeen = false;
+		uint32					FirstFrame = 0;		// Frame in which the site was first seen
+
+		// History
+		uint64					NumCalls = 0;
+		uint64					TotalTicks = 0;
+		uint64					TotalSelfTicks = 0;
+		uint64					MinTicks = ~0ull;
+		uint64					MaxTicks = 0;
+		ProfilerRunningVariance	FrameTicks;			// Mean and variance of the time per frame
+
+		std::vector<uint64>		RingTicks;			// Sample of the last frames, indexed by frame % ring size
+		std::vector<uint64>		RingSelfTicks;
+		std::vector<uint32>		RingCalls;
+		std::vector<WindowData>	Windows;
+
+		ProfilerHistogram				HistoryHistogram;
+		std::vector<ProfilerHistogram>	BlockHistograms;	// HistogramBlocks + 1 blocks per window. The block of frame f is (f / block size) % (HistogramBlocks + 1)
+	};
+
+	void UpdateSite(SiteData& site, uint64 ticks, uint64 selfTicks, uint32 calls);
+	void RecomputeWindow(const SiteData& site, uint32 windowSize, WindowData& window) const;
+	uint32 GetWindowFrames(const SiteData& site, uint32 windowSize) const;
+	uint32 GetHistogramBlockSize(uint32 windowIndex) const { return (m_WindowSizes[windowIndex] + HistogramBlocks - 1) / HistogramBlocks; }
+	uint32 GetHistogramBlock(uint32 windowIndex, uint32 frame) const { return windowIndex * (HistogramBlocks + 1) + frame / GetHistogramBlockSize(windowIndex) % (HistogramBlocks + 1); }
+
+	std::vector<uint32>		m_WindowSizes;
+	uint32					m_RingSize = 0;
+	uint32					m_NumFrames = 0;		// Frames fed
+	std::vector<SiteData>	m_Sites;
+	bool					m_HistogramsEnabled = true;
+
+	// Current frame
+	std::vector<uint64>		m_FrameTicks;			// Time per site
+	std::vector<uint64>		m_FrameSelfTicks;		// Self time per site
+	std::vector<uint32>		m_FrameCalls;			// Calls per site
+	std::vector<uint32>		m_SiteStack;			// Sites of the open events of the current track. Recursive calls are only timed once
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Frame Summaries
+//-----------------------------------------------------------------------------
+
+// Compact summary of each frame over a long history, to follow trends over hours the full event history can not hold.
+// A summary is the frame time and the self time of the sites with the most self time in the frame.
+// Each frame takes 4 bytes for the frame time and 4 bytes per site: the site index and the bucket of the time in a ProfilerHistogram,
+// so the site times are accurate to about 1.5%.
+// The summaries are kept in a ring, which overwrites the oldest frames.
+// Not thread safe. Feed and query from the same thread, or synchronize externally.
+class ProfilerFrameSummaries
+{
+public:
+	struct SiteTime
+	{
+		uint32 SiteIndex;
+		uint64 Ticks;
+	};
+
+	static constexpr uint32 MaxSites = (1u << 21) - 1;		// Sites with a higher index are not summarized
+
+	ProfilerFrameSummaries();
+
+	// Set the number of frames and the number of sites per frame, and forget all frames.
+	// The ring is allocated with the first frame. 0 frames disables the summaries.
+	void SetCapacity(uint32 numFrames, uint32 numSitesPerFrame);
+	uint32 GetCapacity() const { return m_Capacity; }
+	uint32 GetNumSitesPerFrame() const { return m_NumSitesPerFrame; }
+	size_t GetMemorySize() const { return m_FrameTicks.size() * sizeof(uint32) + m_Entries.size() * sizeof(uint32); }
+
+	// Forget all frames
+	void Reset();
+
+	// Feed a frame. The self time of its events can be added in any order.
+	// Frame indices must be consecutive. A frame that does not follow the previous one forgets the previous frames.
+	void BeginFrame(uint32 numSites);
+	void AddEvent(uint32 siteIndex, uint64 selfTicks);
+	void EndFrame(uint32 frameIndex, uint64 frameTicks);
+
+	// Frames of which a summary is kept
+	URange GetFrameRange() const { return URange(m_FrameEnd - m_NumFrames, m_FrameEnd); }
+
+	// Frame time in ticks, saturated to 32 bits
+	uint64 GetFrameTicks(uint32 frameIndex) const;
+
+	// The sites with the most self time in the frame, highest first. Returns the number of sites written.
+	uint32 GetTopSites(uint32 frameIndex, Span<SiteTime> outSites) const;
+
+private:
+	static constexpr uint32 BucketBits = 11;
+	static constexpr uint32 EmptyEntry = ~0u;
+	static_assert(ProfilerHistogram::NumBuckets <= 1u << BucketBits);
+
+	uint32					m_Capacity = 0;
+	uint32					m_NumSitesPerFrame = 0;
+	uint32					m_FrameEnd = 0;			// Frame after the last summarized frame
+	uint32					m_NumFrames = 0;
+	std::vector<uint32>		m_FrameTicks;			// Frame time per ring slot
+	std::vector<uint32>		m_Entries;				// m_NumSitesPerFrame entries per ring slot. Site index << BucketBits | bucket
+
+	// Current frame
+	std::vector<uint64>		m_SiteTicks;			// Self time per site
+	std::vector<uint32>		m_FrameSites;			// Sites with self time in the frame
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Outlier Detection
+//-----------------------------------------------------------------------------
+
+struct ProfilerOutlierOptions
+{
+	// Number of frames of the rolling window of the baselines
+	uint32	WindowSize = 240;
+
+	// A time is an outlier if it exceeds the median of the window by more than Threshold times the median absolute deviation (MAD),
+	// scaled by 1.4826 to be comparable to a standard deviation, and by more than MinDeltaMs.
+	float	Threshold = 6.0f;
+	float	MinDeltaMs = 0.5f;
+
+	// Frames a site must have in the window before its times are judged
+	uint32	MinFrames = 30;
+
+	// Maximum number of sites flagged per frame, largest deviation first. The frame time is flagged in addition.
+	uint32	MaxSitesPerFrame = 4;
+
+	// Number of outliers kept. The oldest are forgotten first.
+	uint32	MaxOutliers = 4096;
+};
+
+// A site or frame time that deviates from its baseline
+struct ProfilerOutlier
+{
+	static constexpr uint32 FrameSite = ~0u;
+
+	uint32	FrameIndex = 0;
+	uint32	SiteIndex = FrameSite;		// FrameSite if the frame time is the outlier
+	uint64	Ticks = 0;					// Time in the frame. Recursive calls are only counted once
+	uint64	BaselineTicks = 0;			// Median time per frame over the window
+	uint64	DeviationTicks = 0;			// Scaled MAD over the window
+};
+
+// Flags the frames and sites of which the time deviates from a robust baseline: the median and MAD over a rolling window of frames.
+// Frames in which a site is not called count as zero once the site was seen.
+// The baseline of a site is recomputed every WindowSize / 8 frames, staggered over the sites,
+// so a frame costs O(sites) and no frame recomputes all baselines at once.
+// Not thread safe. Feed and query from the same thread, or synchronize externally.
+class ProfilerOutlierDetector
+{
+public:
+	// Set the options and forget all frames and outliers. MinDeltaMs is converted with ticksPerSecond.
+	// Disabled until the options are set, or if WindowSize is 0.
+	void SetOptions(const ProfilerOutlierOptions& options, uint64 ticksPerSecond);
+	const ProfilerOutlierOptions& GetOptions() const { return m_Options; }
+
+	// Forget all frames and outliers
+	void Reset();
+
+	// Feed a frame. The events of each thread or queue follow a call to BeginTrack(), in pre-order (parents before their children).
+	void BeginFrame(uint32 numSites);
+	void BeginTrack();
+	void AddEvent(uint32 siteIndex, uint32 depth, uint64 ticks);
+	void EndFrame(uint32 frameIndex, uint64 frameTicks);
+
+	// The kept outliers, oldest first. Outliers of the same frame are adjacent.
+	const std::deque<ProfilerOutlier>& GetOutliers() const { return m_Outliers; }
+
+	// Range of indices in GetOutliers() of the outliers in the range of frames. O(log outliers).
+	URange FindOutliers(URange frames) const;
+
+	// The total number of outliers flagged, including the forgotten ones
+	uint64 GetNumOutliers() const { return m_NumOutliers; }
+
+private:
+	struct Baseline
+	{
+		std::vector<uint32>	Ring;				// Time per frame, saturated to 32 bits, indexed by sample % window size
+		uint32				NumSamples = 0;
+		uint64				MedianTicks = 0;
+		uint64				DeviationTicks = 0;
+		bool				IsValid = false;	// Whether the median and deviation were computed
+	};
+
+	// Judge the time against the baseline, then add it to the window.
+	// Returns how many baseline deviations it exceeds the median by if it is an outlier, or 0 if not.
+	float Evaluate(Baseline& baseline, uint32 staggerIndex, uint64 ticks, ProfilerOutlier& outOutlier);
+	void Recompute(Baseline& baseline);
+
+	ProfilerOutlierOptions		m_Options;
+	bool						m_IsEnabled = false;
+	uint64						m_MinDeltaTicks = 0;
+	uint32						m_RecomputeInterval = 1;
+	uint32						m_NumFrames = 0;		// Frames fed
+	std::vector<Baseline>		m_Sites;
+	Baseline					m_Frame;
+	std::deque<ProfilerOutlier>	m_Outliers;
+	uint64						m_NumOutliers = 0;
+	std::vector<uint32>			m_Scratch;				// Samples of the window being recomputed
+
+	// Current frame
+	std::vector<uint64>			m_FrameTicks;			// Time per site
+	std::vector<uint32>			m_SiteStack;			// Sites of the open events of the current track. Recursive calls are only timed once
+	std::vector<std::pair<float, ProfilerOutlier>>	m_Candidates;	// Outlier sites of the frame and their deviation
+};
@@ -0,0 +1,162 @@
+
+#include "ProfilerTasks.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Task Scheduler
+//-----------------------------------------------------------------------------
+
+TaskScheduler::TaskScheduler(uint32 numWorkers)
+{
+	if (numWorkers == 0)
+		numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (uint32 workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+		m_Workers.push_back(std::make_unique<Worker>());
+	for (uint32 workerIndex = 1; workerIndex < numWorkers; ++workerIndex)
+		m_Threads.emplace_back(&TaskScheduler::ThreadLoop, this, workerIndex);
+}
+
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+	for (std::thread& thread : m_Threads)
+		thread.join();
+}
+
+
+void TaskScheduler::ParallelFor(uint32 count, uint32 grainSize, const RangeFn& rangeFn)
+{
+	std::lock_guard<std::mutex> loopLock(m_LoopMutex);
+	grainSize = std::max(grainSize, 1u);
+	m_NumSteals = 0;
+
+	// Not worth waking the threads for a single range
+	if (m_Threads.empty() || count <= grainSize)
+	{
+		for (uint32 begin = 0; begin < count; begin += grainSize)
+			rangeFn(begin, std::min(begin + grainSize, count), 0);
+		return;
+	}
+
+	uint32 numWorkers = GetNumWorkers();
+	for (uint32 workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+	{
+		Worker& worker = *m_Workers[workerIndex];
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		worker.Begin = (uint32)((uint64)count * workerIndex / numWorkers);
+		worker.End = (uint32)((uint64)count * (workerIndex + 1) / numWorkers);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_pRangeFn = &rangeFn;
+		m_GrainSize = grainSize;
+		m_NumBusyThreads = (uint32)m_Threads.size();
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	RunWorker(0);
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [this]() { return m_NumBusyThreads == 0; });
+	m_pRangeFn = nullptr;
+}
+
+
+void TaskScheduler::ThreadLoop(uint32 workerIndex)
+{
+	uint64 generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [&]() { return m_IsStopping || m_Generation != generation; });
+			if (m_IsStopping)
+				return;
+			generation = m_Generation;
+		}
+
+		RunWorker(workerIndex);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (--m_NumBusyThreads == 0)
+			m_DoneCondition.notify_one();
+	}
+}
+
+
+void TaskScheduler::RunWorker(uint32 workerIndex)
+{
+	uint32 begin, end;
+	while (PopRange(workerIndex, begin, end) || (StealRange(workerIndex) && PopRange(workerIndex, begin, end)))
+		(*m_pRangeFn)(begin, end, workerIndex);
+}
+
+
+// Take the next grain of the own items, from the front
+bool TaskScheduler::PopRange(uint32 workerIndex, uint32& outBegin, uint32& outEnd)
+{
+	Worker& worker = *m_Workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker.Mutex);
+	if (worker.Begin >= worker.End)
+		return false;
+
+	outBegin = worker.Begin;
+	outEnd = std::min(worker.Begin + m_GrainSize, worker.End);
+	worker.Begin = outEnd;
+	return true;
+}
+
+
+// Move the back half of the items of the worker with the most items left to this worker.
+// Returns false once no worker has items left, the loop is done for this worker.
+bool TaskScheduler::StealRange(uint32 workerIndex)
+{
+	uint32 numWorkers = GetNumWorkers();
+	for (;;)
+	{
+		uint32 victimIndex = workerIndex;
+		uint32 victimItems = 0;
+		for (uint32 offset = 1; offset < numWorkers; ++offset)
+		{
+			uint32 index = (workerIndex + offset) % numWorkers;
+			Worker& worker = *m_Workers[index];
+			std::lock_guard<std::mutex> lock(worker.Mutex);
+			if (worker.End - worker.Begin > victimItems)
+			{
+				victimIndex = index;
+				victimItems = worker.End - worker.Begin;
+			}
+		}
+		if (victimItems == 0)
+			return false;
+
+		// The victim may have taken items since it was inspected. Try again if it has none left.
+		uint32 stolenBegin, stolenEnd;
+		{
+			Worker& victim = *m_Workers[victimIndex];
+			std::lock_guard<std::mutex> lock(victim.Mutex);
+			uint32 numItems = victim.End - victim.Begin;
+			if (numItems == 0)
+				continue;
+			stolenEnd = victim.End;
+			stolenBegin = numItems <= m_GrainSize ? victim.Begin : victim.End - numItems / 2;
+			victim.End = stolenBegin;
+		}
+
+		Worker& worker = *m_Workers[workerIndex];
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		worker.Begin = stolenBegin;
+		worker.End = stolenEnd;
+		++m_NumSteals;
+		return true;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// Work-stealing scheduler for the passes over the frames of captures.
+
+#include "ProfilerTypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Task Scheduler
+//-----------------------------------------------------------------------------
+
+// Runs parallel loops on a fixed set of threads. The thread calling ParallelFor is worker 0 and takes part in the loop.
+// Each worker starts with a contiguous share of the items, so consecutive items (eg. frames, which are stored in order in a capture)
+// are mostly processed by the same worker. A worker which runs out of items steals the second half of the items left to the worker with the most,
+// so uneven items (eg. hitches) are balanced without a shared counter that all workers contend on.
+// ParallelFor can be called from any thread. Calls are serialized, and loops can not be nested.
+class TaskScheduler
+{
+public:
+	// Range of items [begin, end) processed by a worker
+	using RangeFn = std::function<void(uint32 begin, uint32 end, uint32 workerIndex)>;
+
+	// 0 to use a worker per core
+	explicit TaskScheduler(uint32 numWorkers = 0);
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	uint32 GetNumWorkers() const { return (uint32)m_Workers.size(); }
+
+	// Call rangeFn for ranges of at most grainSize items until all items of [0, count) are done. Returns once they are.
+	void ParallelFor(uint32 count, uint32 grainSize, const RangeFn& rangeFn);
+
+	// ParallelFor with a partial result per worker. Each partial starts as a copy of init and is passed to accumulateFn(begin, end, partial).
+	// The partials are merged in worker order with mergeFn(result, partial).
+	template<typename T, typename AccumulateFn, typename MergeFn>
+	T ParallelReduce(uint32 count, uint32 grainSize, const T& init, AccumulateFn&& accumulateFn, MergeFn&& mergeFn)
+	{
+		std::vector<T> partials(GetNumWorkers(), init);
+		ParallelFor(count, grainSize, [&](uint32 begin, uint32 end, uint32 workerIndex) { accumulateFn(begin, end, partials[workerIndex]); });
+		T result = std::move(partials[0]);
+		for (uint32 workerIndex = 1; workerIndex < (uint32)partials.size(); ++workerIndex)
+			mergeFn(result, partials[workerIndex]);
+		return result;
+	}
+
+	// Number of ranges stolen in the last loop
+	uint32 GetNumSteals() const { return m_NumSteals; }
+
+private:
+	// Items left to a worker. Padded so workers do not share cache lines.
+	struct alignas(64) Worker
+	{
+		std::mutex	Mutex;
+		uint32		Begin = 0;
+		uint32		End = 0;
+	};
+
+	void ThreadLoop(uint32 workerIndex);
+	void RunWorker(uint32 workerIndex);
+	bool PopRange(uint32 workerIndex, uint32& outBegin, uint32& outEnd);
+	bool StealRange(uint32 workerIndex);
+
+	std::vector<std::unique_ptr<Worker>>	m_Workers;
+	std::vector<std::thread>				m_Threads;				// Workers 1 and up
+
+	std::mutex								m_LoopMutex;			// Serializes the loops
+	std::mutex								m_Mutex;				// Guards the state below
+	std::condition_variable					m_WakeCondition;
+	std::condition_variable					m_DoneCondition;
+	uint64									m_Generation = 0;		// Incremented for each loop
+	uint32									m_NumBusyThreads = 0;
+	bool									m_IsStopping = false;
+
+	const RangeFn*							m_pRangeFn = nullptr;	// Loop being run
+	uint32									m_GrainSize = 1;
+	std::atomic<uint32>						m_NumSteals = 0;
+};
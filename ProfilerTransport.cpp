@@ -0,0 +1,502 @@
+
+#include "ProfilerTransport.h"
+
+#include <atomic>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace LiveTransportFormat;
+
+//-----------------------------------------------------------------------------
+// [SECTION] Shared Memory
+//-----------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+bool SharedMemoryRegion::Create(const char* pName, uint64 size)
+{
+	Close();
+
+	std::string name = std::string("Local\\") + pName;
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, name.c_str());
+	if (!mapping)
+		return false;
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	pHandle = mapping;
+	pData = (char*)pView;
+	Size = size;
+	Name = name;
+	return true;
+}
+
+
+bool SharedMemoryRegion::Open(const char* pName)
+{
+	Close();
+
+	std::string name = std::string("Local\\") + pName;
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_WRITE, FALSE, name.c_str());
+	if (!mapping)
+		return false;
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	if (!pView || VirtualQuery(pView, &info, sizeof(info)) == 0)
+	{
+		if (pView)
+			UnmapViewOfFile(pView);
+		CloseHandle(mapping);
+		return false;
+	}
+
+	pHandle = mapping;
+	pData = (char*)pView;
+	Size = (uint64)info.RegionSize;
+	return true;
+}
+
+
+void SharedMemoryRegion::Close()
+{
+	// The mapping is released by the OS once no process has it open anymore
+	if (pData)
+		UnmapViewOfFile(pData);
+	if (pHandle)
+		CloseHandle(pHandle);
+	pData = nullptr;
+	pHandle = nullptr;
+	Size = 0;
+	Name.clear();
+}
+
+#else
+
+bool SharedMemoryRegion::Create(const char* pName, uint64 size)
+{
+	Close();
+
+	// Remove a region left behind by a process that did not close it
+	std::string name = std::string("/") + pName;
+	shm_unlink(name.c_str());
+
+	int file = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (file < 0)
+		return false;
+
+	if (ftruncate(file, (off_t)size) != 0)
+	{
+		close(file);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	void* pView = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (pView == MAP_FAILED)
+	{
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	pData = (char*)pView;
+	Size = size;
+	Name = name;
+	return true;
+}
+
+
+bool SharedMemoryRegion::Open(const char* pName)
+{
+	Close();
+
+	std::string name = std::string("/") + pName;
+	int file = shm_open(name.c_str(), O_RDWR, 0);
+	if (file < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* pView = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (pView == MAP_FAILED)
+		return false;
+
+	pData = (char*)pView;
+	Size = (uint64)fileStat.st_size;
+	return true;
+}
+
+
+void SharedMemoryRegion::Close()
+{
+	// Other processes keep their mapping after the name is removed
+	if (pData)
+		munmap(pData, (size_t)Size);
+	if (!Name.empty())
+		shm_unlink(Name.c_str());
+	pData = nullptr;
+	Size = 0;
+	Name.clear();
+}
+
+#endif
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Live Transport Writer
+//-----------------------------------------------------------------------------
+
+bool LiveTransportWriter::Open(const char* pName, uint64 ticksPerSecond, uint32 capacity)
+{
+	Close();
+
+	uint64 ringSize = 1 << 12;
+	while (ringSize < capacity)
+		ringSize <<= 1;
+
+	if (!m_Memory.Create(pName, sizeof(Header) + ringSize))
+		return false;
+
+	m_pHeader = (Header*)m_Memory.pData;
+	m_pRing = m_Memory.pData + sizeof(Header);
+	m_Capacity = ringSize;
+	m_WriteOffset = 0;
+	m_ReaderGeneration = 0;
+	m_Encoder.Reset();
+	m_NumFrames = 0;
+	m_NumDroppedFrames = 0;
+
+	// The region is zero-filled. The magic is written last, so a reader never sees a partial header.
+	m_pHeader->Version = Version;
+	m_pHeader->TicksPerSecond = ticksPerSecond;
+	m_pHeader->Capacity = ringSize;
+	m_pHeader->ReadOffset = NoReader;
+	std::atomic_ref<uint32>(m_pHeader->Magic).store(Magic, std::memory_order_release);
+	return true;
+}
+
+
+void LiveTransportWriter::Close()
+{
+	if (!m_pHeader)
+		return;
+
+	std::atomic_ref<uint32>(m_pHeader->IsClosed).store(1, std::memory_order_release);
+	m_Memory.Close();
+	m_pHeader = nullptr;
+	m_pRing = nullptr;
+	m_Encoder.Reset();
+}
+
+
+bool LiveTransportWriter::PollReader()
+{
+	if (!m_pHeader)
+		return false;
+
+	uint32 generation = std::atomic_ref<uint32>(m_pHeader->ReaderGeneration).load(std::memory_order_acquire);
+	if (generation != m_ReaderGeneration)
+	{
+		// A new reader attached. Everything it needs is sent again, starting at the current write offset.
+		m_ReaderGeneration = generation;
+		m_Encoder.Reset();
+		std::atomic_ref<uint64>(m_pHeader->SyncOffset).store(m_WriteOffset, std::memory_order_relaxed);
+		std::atomic_ref<uint32>(m_pHeader->SyncGeneration).store(generation, std::memory_order_release);
+	}
+	return std::atomic_ref<uint64>(m_pHeader->ReadOffset).load(std::memory_order_acquire) != NoReader;
+}
+
+
+void LiveTransportWriter::BeginCPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	m_FrameOffset = m_Encoder.GetBuffer().size();
+	m_Encoder.BeginFrame(CaptureFormat::ChunkType::CPUFrame, frameIndex, ticksBegin, ticksEnd);
+}
+
+
+void LiveTransportWriter::BeginGPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd)
+{
+	m_FrameOffset = m_Encoder.GetBuffer().size();
+	m_Encoder.BeginFrame(CaptureFormat::ChunkType::GPUFrame, frameIndex, ticksBegin, ticksEnd);
+}
+
+
+void LiveTransportWriter::EndFrame()
+{
+	m_Encoder.EndFrame();
+	if (Publish())
+	{
+		++m_NumFrames;
+		std::atomic_ref<uint32>(m_pHeader->NumFrames).store(m_NumFrames, std::memory_order_relaxed);
+	}
+	else
+	{
+		// Keep the sites, threads and queues added before the frame. The reader needs them for the next frame.
+		m_Encoder.GetBuffer().resize(m_FrameOffset);
+		++m_NumDroppedFrames;
+		if (m_pHeader)
+			std::atomic_ref<uint32>(m_pHeader->NumDroppedFrames).store(m_NumDroppedFrames, std::memory_order_relaxed);
+	}
+}
+
+
+bool LiveTransportWriter::Publish()
+{
+	if (!m_pHeader)
+		return false;
+
+	std::vector<char>& buffer = m_Encoder.GetBuffer();
+	uint64 size = buffer.size();
+	uint64 readOffset = std::atomic_ref<uint64>(m_pHeader->ReadOffset).load(std::memory_order_acquire);
+	if (readOffset == NoReader || readOffset > m_WriteOffset || m_WriteOffset - readOffset + size > m_Capacity)
+		return false;
+
+	uint64 position = m_WriteOffset & (m_Capacity - 1);
+	uint64 firstSize = size < m_Capacity - position ? size : m_Capacity - position;
+	memcpy(m_pRing + position, buffer.data(), firstSize);
+	memcpy(m_pRing, buffer.data() + firstSize, size - firstSize);
+
+	m_WriteOffset += size;
+	std::atomic_ref<uint64>(m_pHeader->WriteOffset).store(m_WriteOffset, std::memory_order_release);
+	buffer.clear();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Live Transport Reader
+//-----------------------------------------------------------------------------
+
+bool LiveTransportReader::Open(const char* pName, uint32 maxFrames)
+{
+	Close();
+
+	if (!m_Memory.Open(pName))
+		return false;
+
+	Header* pHeader = (Header*)m_Memory.pData;
+	if (m_Memory.Size < sizeof(Header) ||
+		std::atomic_ref<uint32>(pHeader->Magic).load(std::memory_order_acquire) != Magic ||
+		pHeader->Version != Version ||
+		pHeader->Capacity == 0 || (pHeader->Capacity & (pHeader->Capacity - 1)) != 0 ||
+		pHeader->Capacity > m_Memory.Size - sizeof(Header))
+	{
+		m_Memory.Close();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	m_pRing = m_Memory.pData + sizeof(Header);
+	m_Capacity = pHeader->Capacity;
+	m_TicksPerSecond = pHeader->TicksPerSecond;
+	m_MaxFrames = maxFrames > 0 ? maxFrames : 1;
+	m_HasError = false;
+
+	// Skip what is in the ring and ask the writer to send the tables again
+	m_ReadOffset = std::atomic_ref<uint64>(m_pHeader->WriteOffset).load(std::memory_order_acquire);
+	std::atomic_ref<uint64>(m_pHeader->ReadOffset).store(m_ReadOffset, std::memory_order_release);
+	m_Generation = std::atomic_ref<uint32>(m_pHeader->ReaderGeneration).fetch_add(1, std::memory_order_acq_rel) + 1;
+	return true;
+}
+
+
+void LiveTransportReader::Close()
+{
+	if (m_pHeader)
+		std::atomic_ref<uint64>(m_pHeader->ReadOffset).store(NoReader, std::memory_order_release);
+	m_Memory.Close();
+	m_pHeader = nullptr;
+	m_pRing = nullptr;
+	m_Capacity = 0;
+	m_ReadOffset = 0;
+	m_TicksPerSecond = 0;
+	m_ChunkBuffer.clear();
+	m_Strings.clear();
+	m_Sites.clear();
+	m_Threads.clear();
+	m_Queues.clear();
+	m_CPUFrames.clear();
+	m_GPUFrames.clear();
+}
+
+
+bool LiveTransportReader::IsWriterClosed() const
+{
+	return m_pHeader && std::atomic_ref<uint32>(m_pHeader->IsClosed).load(std::memory_order_acquire) != 0;
+}
+
+
+uint32 LiveTransportReader::GetNumDroppedFrames() const
+{
+	return m_pHeader ? std::atomic_ref<uint32>(m_pHeader->NumDroppedFrames).load(std::memory_order_relaxed) : 0;
+}
+
+
+uint32 LiveTransportReader::Poll()
+{
+	if (!m_pHeader)
+		return 0;
+
+	// Until the writer has seen this reader, its chunks refer to tables this reader did not receive
+	uint32 syncGeneration = std::atomic_ref<uint32>(m_pHeader->SyncGeneration).load(std::memory_order_acquire);
+	uint64 syncOffset = std::atomic_ref<uint64>(m_pHeader->SyncOffset).load(std::memory_order_relaxed);
+	uint64 writeOffset = std::atomic_ref<uint64>(m_pHeader->WriteOffset).load(std::memory_order_acquire);
+	if (syncGeneration != m_Generation)
+		m_ReadOffset = writeOffset;
+	else if (m_ReadOffset < syncOffset)
+		m_ReadOffset = syncOffset;
+
+	uint32 numFrames = 0;
+	while (m_ReadOffset < writeOffset)
+	{
+		CaptureFormat::ChunkHeader chunk;
+		if (writeOffset - m_ReadOffset < sizeof(chunk))
+		{
+			m_HasError = true;
+			m_ReadOffset = writeOffset;
+			break;
+		}
+		ReadRing(m_ReadOffset, &chunk, sizeof(chunk));
+		if (chunk.Size > writeOffset - m_ReadOffset - sizeof(chunk))
+		{
+			m_HasError = true;
+			m_ReadOffset = writeOffset;
+			break;
+		}
+
+		m_ChunkBuffer.resize(chunk.Size);
+		ReadRing(m_ReadOffset + sizeof(chunk), m_ChunkBuffer.data(), chunk.Size);
+		m_ReadOffset += sizeof(chunk) + chunk.Size;
+
+		if (!ReadChunk(chunk.Type, m_ChunkBuffer.data(), chunk.Size))
+			m_HasError = true;
+		else if (chunk.Type == CaptureFormat::ChunkType::CPUFrame || chunk.Type == CaptureFormat::ChunkType::GPUFrame)
+			++numFrames;
+	}
+
+	// Hand the space back to the writer
+	std::atomic_ref<uint64>(m_pHeader->ReadOffset).store(m_ReadOffset, std::memory_order_release);
+	return numFrames;
+}
+
+
+void LiveTransportReader::ReadRing(uint64 offset, void* pDst, uint64 size) const
+{
+	uint64 position = offset & (m_Capacity - 1);
+	uint64 firstSize = size < m_Capacity - position ? size : m_Capacity - position;
+	memcpy(pDst, m_pRing + position, firstSize);
+	memcpy((char*)pDst + firstSize, m_pRing, size - firstSize);
+}
+
+
+const char* LiveTransportReader::CopyString(const char* pStr, uint32 length)
+{
+	// Strings are stored including their null terminator
+	if (length == 0 || pStr[length - 1] != 0)
+		return nullptr;
+	return m_Strings.emplace_back(pStr, length - 1).c_str();
+}
+
+
+bool LiveTransportReader::ReadChunk(CaptureFormat::ChunkType type, const char* pData, uint32 size)
+{
+	switch (type)
+	{
+	case CaptureFormat::ChunkType::Site:
+	{
+		CaptureFormat::Site site;
+		if (size < sizeof(site))
+			return false;
+		memcpy(&site, pData, sizeof(site));
+		if ((uint64)sizeof(site) + site.NameLength + site.FilePathLength > size)
+			return false;
+
+		CaptureSite& outSite = m_Sites.emplace_back();
+		outSite.LineNumber = site.LineNumber;
+		outSite.pName = CopyString(pData + sizeof(site), site.NameLength);
+		if (site.FilePathLength > 0)
+			outSite.pFilePath = CopyString(pData + sizeof(site) + site.NameLength, site.FilePathLength);
+		if (!outSite.pName)
+			outSite.pName = "???";
+		return true;
+	}
+	case CaptureFormat::ChunkType::Thread:
+	{
+		CaptureFormat::Thread thread;
+		if (size < sizeof(thread))
+			return false;
+		memcpy(&thread, pData, sizeof(thread));
+		if ((uint64)sizeof(thread) + thread.NameLength > size)
+			return false;
+
+		CaptureThread& outThread = m_Threads.emplace_back();
+		outThread.ThreadID = thread.ThreadID;
+		outThread.pName = CopyString(pData + sizeof(thread), thread.NameLength);
+		if (!outThread.pName)
+			outThread.pName = "";
+		return true;
+	}
+	case CaptureFormat::ChunkType::Queue:
+	{
+		CaptureFormat::Queue queue;
+		if (size < sizeof(queue))
+			return false;
+		memcpy(&queue, pData, sizeof(queue));
+		if ((uint64)sizeof(queue) + queue.NameLength > size)
+			return false;
+
+		CaptureQueue& outQueue = m_Queues.emplace_back();
+		outQueue.GPUCalibrationTicks = queue.GPUCalibrationTicks;
+		outQueue.CPUCalibrationTicks = queue.CPUCalibrationTicks;
+		outQueue.GPUFrequency = queue.GPUFrequency ? queue.GPUFrequency : 1;
+		outQueue.CPUFrequency = queue.CPUFrequency ? queue.CPUFrequency : 1;
+		outQueue.pName = CopyString(pData + sizeof(queue), queue.NameLength);
+		if (!outQueue.pName)
+			outQueue.pName = "";
+		return true;
+	}
+	case CaptureFormat::ChunkType::CPUFrame:
+	case CaptureFormat::ChunkType::GPUFrame:
+	{
+		// Reuse the allocations of the oldest frame
+		std::deque<CaptureFrame>& frames = type == CaptureFormat::ChunkType::CPUFrame ? m_CPUFrames : m_GPUFrames;
+		CaptureFrame frame;
+		if (frames.size() >= m_MaxFrames)
+		{
+			frame = std::move(frames.front());
+			frames.pop_front();
+		}
+		if (!CaptureReader::DecodeFrameChunk(pData, size, frame))
+			return false;
+		frames.push_back(std::move(frame));
+		return true;
+	}
+	default:
+		return true;
+	}
+}
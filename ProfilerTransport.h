@@ -0,0 +1,231 @@
+#pragma once
+
+// Live transport of frames to a viewer in another process.
+
+#include "ProfilerCapture.h"
+
+#include <deque>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// [SECTION] Live Transport Format
+//-----------------------------------------------------------------------------
+
+/*
+	The transport is a named shared memory region:
+
+	[Header]
+	[Ring]								Capacity bytes
+
+	The ring carries the same chunks as a capture file (see CaptureFormat), without the file header and the index.
+	Frames are never compressed. A chunk may wrap around the end of the ring.
+
+	There is a single writer (the profiled process) and a single reader (the viewer).
+	WriteOffset and ReadOffset count the bytes written and read since the region was created. The ring position is the offset modulo Capacity.
+	The writer stores WriteOffset with release semantics after the chunks are written, the reader stores ReadOffset after the chunks are read.
+	The writer only writes chunks that fit in the free space between the offsets. If they don't, the frame is dropped and counted.
+
+	A reader attaches by setting ReadOffset to WriteOffset and incrementing ReaderGeneration.
+	When the writer sees a new generation, it sets SyncOffset to its write offset, stores the generation in SyncGeneration,
+	and sends all sites, threads and queues again before the next frame. The reader skips everything before SyncOffset,
+	as those chunks refer to tables it never received.
+	ReadOffset is NoReader while no reader is attached. The writer does not encode frames in that case.
+
+	On POSIX, the region is a shm_open() object named "/<name>". On Windows, it is the pagefile backed mapping "Local\<name>".
+	The header is naturally aligned. Both processes must be built for the same architecture.
+*/
+namespace LiveTransportFormat
+{
+	constexpr uint32 Magic = 0x56494C54;	// "TLIV"
+	constexpr uint32 Version = 1;
+
+	constexpr uint64 NoReader = ~0ull;
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 TicksPerSecond;				// Frequency of the CPU ticks
+		uint64 Capacity;					// Size of the ring. Power of two
+		uint32 IsClosed;					// Set when the writer closed the transport
+		uint32 Padding;
+
+		alignas(64) uint64 WriteOffset;		// Written by the writer
+		uint64 SyncOffset;					// Write offset at which the tables were sent again for the reader
+		uint32 SyncGeneration;				// Reader generation the tables were sent for
+		uint32 NumFrames;					// Frames written to the ring
+		uint32 NumDroppedFrames;			// Frames dropped because the ring was full
+
+		alignas(64) uint64 ReadOffset;		// Written by the reader
+		uint32 ReaderGeneration;			// Incremented by each reader attaching
+	};
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Shared Memory
+//-----------------------------------------------------------------------------
+
+// A named region of memory which is mapped in multiple processes
+struct SharedMemoryRegion
+{
+	// Create the region, filled with zeros. On POSIX, an existing region with the same name is replaced.
+	// On Windows, the name stays in use until all processes closed it, and creating fails until then.
+	bool Create(const char* pName, uint64 size);
+
+	// Map an existing region
+	bool Open(const char* pName);
+
+	// Unmap the region. The creator also removes the name.
+	void Close();
+
+	char*		pData = nullptr;
+	uint64		Size = 0;
+	void*		pHandle = nullptr;			// Windows only
+	std::string	Name;						// Platform name of the region, if it was created
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Live Transport Writer
+//-----------------------------------------------------------------------------
+
+// Publishes finalized frames into the shared memory ring.
+// Has the same producer functions as CaptureWriter. Frames are encoded in a local buffer and copied into
+// the ring in EndFrame(). The writer never waits for the reader: if the reader is too slow and the ring
+// has no room for the frame, the frame is dropped and counted.
+// The producer functions must all be called from the same thread (the thread calling Tick()).
+class LiveTransportWriter
+{
+public:
+	LiveTransportWriter() = default;
+	~LiveTransportWriter() { Close(); }
+
+	LiveTransportWriter(const LiveTransportWriter&) = delete;
+	LiveTransportWriter& operator=(const LiveTransportWriter&) = delete;
+
+	// Create the shared memory region. capacity is the size of the ring and is rounded up to a power of two.
+	bool Open(const char* pName, uint64 ticksPerSecond, uint32 capacity = 1 << 24);
+
+	// Mark the transport closed and remove the region. An attached reader keeps its mapping.
+	void Close();
+
+	bool IsOpen() const { return m_pHeader != nullptr; }
+
+	// Returns true if a reader is attached. Call before each frame: when a new reader attached,
+	// all sites, threads and queues are forgotten so they are sent again.
+	bool PollReader();
+
+	void AddSite(const char* pName, const char* pFilePath, uint32 lineNumber) { m_Encoder.AddSite(pName, pFilePath, lineNumber); }
+	void AddThread(const char* pName, uint32 threadID) { m_Encoder.AddThread(pName, threadID); }
+	void AddQueue(const char* pName, uint64 gpuCalibrationTicks, uint64 cpuCalibrationTicks, uint64 gpuFrequency, uint64 cpuFrequency)
+	{
+		m_Encoder.AddQueue(pName, gpuCalibrationTicks, cpuCalibrationTicks, gpuFrequency, cpuFrequency);
+	}
+
+	uint32 GetNumSites() const { return m_Encoder.GetNumSites(); }
+	uint32 GetNumThreads() const { return m_Encoder.GetNumThreads(); }
+	uint32 GetNumQueues() const { return m_Encoder.GetNumQueues(); }
+
+	// Write a frame. Each block must be followed by exactly numEvents calls to AddEvent()
+	// Frame ticks are always CPU ticks, also for GPU frames.
+	void BeginCPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+	void BeginGPUFrame(uint32 frameIndex, uint64 ticksBegin, uint64 ticksEnd);
+	void BeginBlock(uint32 trackIndex, uint32 numEvents) { m_Encoder.BeginBlock(trackIndex, numEvents); }
+	void AddEvent(uint64 ticksBegin, uint64 ticksEnd, uint32 siteIndex, uint32 depth) { m_Encoder.AddEvent(ticksBegin, ticksEnd, siteIndex, depth); }
+	void EndFrame();
+
+	uint32 GetNumFrames() const { return m_NumFrames; }
+	uint32 GetNumDroppedFrames() const { return m_NumDroppedFrames; }
+
+private:
+	// Copy the encoded chunks into the ring. Returns false if the ring has no room for them.
+	bool Publish();
+
+	SharedMemoryRegion				m_Memory;
+	LiveTransportFormat::Header*	m_pHeader = nullptr;
+	char*							m_pRing = nullptr;
+	uint64							m_Capacity = 0;
+	uint64							m_WriteOffset = 0;
+	uint32							m_ReaderGeneration = 0;		// Generation of the reader the tables were sent to
+
+	CaptureEncoder					m_Encoder;					// Chunks not published yet
+	size_t							m_FrameOffset = 0;			// Offset of the open frame in the encoder buffer
+
+	uint32							m_NumFrames = 0;
+	uint32							m_NumDroppedFrames = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Live Transport Reader
+//-----------------------------------------------------------------------------
+
+// Attaches to the ring of a writer in another process and decodes the frames it publishes.
+// The last frames are kept in memory. Sites, threads and queues are copied out of the ring as they arrive.
+// Only one reader can be attached to a writer at a time. Attaching takes over the ring from a previous reader.
+class LiveTransportReader
+{
+public:
+	LiveTransportReader() = default;
+	~LiveTransportReader() { Close(); }
+
+	LiveTransportReader(const LiveTransportReader&) = delete;
+	LiveTransportReader& operator=(const LiveTransportReader&) = delete;
+
+	// Attach to the transport with the given name. maxFrames is the number of CPU and GPU frames kept.
+	bool Open(const char* pName, uint32 maxFrames = 64);
+
+	// Detach from the transport
+	void Close();
+
+	bool IsOpen() const { return m_pHeader != nullptr; }
+
+	// True if the writer closed the transport. The frames received so far remain available.
+	bool IsWriterClosed() const;
+
+	// Read all chunks published since the last call. Returns the number of new CPU and GPU frames.
+	// While not polled, the ring fills up and the writer drops frames.
+	uint32 Poll();
+
+	uint64 GetTicksPerSecond() const { return m_TicksPerSecond; }
+
+	Span<const CaptureSite> GetSites() const { return m_Sites; }
+	Span<const CaptureThread> GetThreads() const { return m_Threads; }
+	Span<const CaptureQueue> GetQueues() const { return m_Queues; }
+
+	// The last received frames, oldest first
+	const std::deque<CaptureFrame>& GetCPUFrames() const { return m_CPUFrames; }
+	const std::deque<CaptureFrame>& GetGPUFrames() const { return m_GPUFrames; }
+
+	// The number of frames the writer dropped, also before this reader attached
+	uint32 GetNumDroppedFrames() const;
+
+	// True if a chunk in the ring was corrupt. The reader skipped all data up to the write offset.
+	bool HasError() const { return m_HasError; }
+
+private:
+	// Copy bytes out of the ring, handling the wrap around
+	void ReadRing(uint64 offset, void* pDst, uint64 size) const;
+
+	bool ReadChunk(CaptureFormat::ChunkType type, const char* pData, uint32 size);
+	const char* CopyString(const char* pStr, uint32 length);
+
+	SharedMemoryRegion				m_Memory;
+	LiveTransportFormat::Header*	m_pHeader = nullptr;
+	const char*						m_pRing = nullptr;
+	uint64							m_Capacity = 0;
+	uint64							m_ReadOffset = 0;
+	uint64							m_TicksPerSecond = 0;
+	uint32							m_MaxFrames = 0;
+	uint32							m_Generation = 0;			// Generation of this reader
+	bool							m_HasError = false;
+
+	std::vector<char>				m_ChunkBuffer;				// Scratch buffer for a chunk copied out of the ring
+	std::deque<std::string>			m_Strings;					// Storage for the names. A deque does not move its elements
+	std::vector<CaptureSite>		m_Sites;
+	std::vector<CaptureThread>		m_Threads;
+	std::vector<CaptureQueue>		m_Queues;
+	std::deque<CaptureFrame>		m_CPUFrames;
+	std::deque<CaptureFrame>		m_GPUFrames;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// Platform independent types shared by the profiler, the capture format and the command-line tools.
+// Must not include any platform headers.
+
+#include <cinttypes>
+#include <span>
+#include <assert.h>
+
+#define check(op, ...) assert(op)
+#define checkf(op, ...) assert(op)
+
+#define _STRINGIFY(a) #a
+#define STRINGIFY(a) _STRINGIFY(a)
+#define CONCAT_IMPL( x, y ) x##y
+#define MACRO_CONCAT( x, y ) CONCAT_IMPL( x, y )
+
+using uint64 = uint64_t;
+using uint32 = uint32_t;
+using uint16 = uint16_t;
+using uint8 = uint8_t;
+template<typename T>
+using Span = std::span<T>;
+
+struct URange
+{
+	uint32 Begin;
+	uint32 End;
+};
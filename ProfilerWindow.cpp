@@ -1,5 +1,11 @@
 
 #include "Profiler.h"
+#include "ProfilerCapture.h"
+#include "ProfilerCallTree.h"
+#include "ProfilerCriticalPath.h"
+#include "ProfilerImport.h"
+#include "ProfilerTasks.h"
+#include "ProfilerTransport.h"
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_internal.h"
 #include "IconsFontAwesome4.h"
@@ -18,22 +24,1074 @@ struct StyleOptions
 	ImVec4 FGTextColor = ImVec4(0.9f, 0.9f, 0.9f, 1.0f);
 	ImVec4 BarHighlightColor = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
 
+	bool ColorBySelfTime = false;	// Shade the bars from green to red by their self time instead of coloring them by name
+	float SelfTimeMaxMs = 1.0f;		// Self time at which a bar is fully red
+
+	bool ShowCriticalPath = false;	// Highlight the critical path of each frame across the CPU threads
+
+	float MergeWidth = 3.0f;		// Events narrower than this many pixels are merged into blocks shaded by how busy the track is. 0 to draw all bars
+
 	bool DebugMode = false;
 };
 
+//-----------------------------------------------------------------------------
+// [SECTION] Timeline Sources
+//-----------------------------------------------------------------------------
+
+// Adds the CPU events of a range of frames to a call tree. Runs on a worker thread.
+// Checks cancel between frames and stores the number of frames done in progress.
+using CallTreeTask = std::function<void(CallTree& outTree, const std::atomic<bool>& cancel, std::atomic<uint32>& progress)>;
+
+// Provides the frames drawn by the timeline. Mirrors the query functions of the profilers.
+class TimelineSource
+{
+public:
+	virtual ~TimelineSource() = default;
+
+	// Create the task building the call tree of the CPU frames. Called on the thread drawing the HUD.
+	// By default, the events are copied out of the source, as the source changes while the task runs.
+	virtual CallTreeTask CreateCallTreeTask(URange frames) const;
+
+	virtual uint64 GetTicksPerSecond() const = 0;
+	virtual void GetHistoryRange(uint64& ticksMin, uint64& ticksMax) const = 0;
+
+	virtual URange GetCPUFrameRange() const = 0;
+	virtual Span<const CPUProfiler::ThreadData> GetThreads() const = 0;
+	virtual Span<const CPUProfiler::EventData::Event> GetEventsForThread(const CPUProfiler::ThreadData& thread, uint32 frame) const = 0;
+
+	virtual URange GetGPUFrameRange() const = 0;
+	virtual Span<const GPUProfiler::QueueInfo> GetQueues() const = 0;
+	virtual Span<const GPUProfiler::EventData::Event> GetEventsForQueue(const GPUProfiler::QueueInfo& queue, uint32 frame) const = 0;
+};
+
+CallTreeTask TimelineSource::CreateCallTreeTask(URange frames) const
+{
+	struct CopiedEvent
+	{
+		uint32 SiteIndex;
+		uint32 Depth;
+		uint64 TicksBegin;
+		uint64 TicksEnd;
+	};
+
+	struct CopiedFrames
+	{
+		std::vector<CopiedEvent>	Events;
+		std::vector<uint32>			TrackEnds;		// End of the events of each track
+		std::vector<uint32>			FrameEnds;		// End of the tracks of each frame
+		std::vector<std::string>	SiteNames;
+	};
+
+	auto pFrames = std::make_shared<CopiedFrames>();
+	for (uint32 frame = frames.Begin; frame < frames.End; ++frame)
+	{
+		for (const CPUProfiler::ThreadData& thread : GetThreads())
+		{
+			Span<const CPUProfiler::EventData::Event> events = GetEventsForThread(thread, frame);
+			if (events.empty())
+				continue;
+			for (const CPUProfiler::EventData::Event& event : events)
+			{
+				pFrames->Events.push_back({ event.SiteIndex, event.Depth, event.TicksBegin, event.TicksEnd });
+				if (event.SiteIndex >= pFrames->SiteNames.size())
+					pFrames->SiteNames.resize(event.SiteIndex + 1);
+				if (pFrames->SiteNames[event.SiteIndex].empty())
+					pFrames->SiteNames[event.SiteIndex] = event.pName;
+			}
+			pFrames->TrackEnds.push_back((uint32)pFrames->Events.size());
+		}
+		pFrames->FrameEnds.push_back((uint32)pFrames->TrackEnds.size());
+	}
+
+	return [pFrames](CallTree& outTree, const std::atomic<bool>& cancel, std::atomic<uint32>& progress)
+		{
+			for (uint32 siteIndex = 0; siteIndex < (uint32)pFrames->SiteNames.size(); ++siteIndex)
+				outTree.SetSiteName(siteIndex, pFrames->SiteNames[siteIndex].c_str());
+
+			uint32 track = 0;
+			uint32 event = 0;
+			for (uint32 frame = 0; frame < (uint32)pFrames->FrameEnds.size() && !cancel; ++frame)
+			{
+				for (; track < pFrames->FrameEnds[frame]; ++track)
+				{
+					outTree.BeginTrack();
+					for (; event < pFrames->TrackEnds[track]; ++event)
+					{
+						const CopiedEvent& copiedEvent = pFrames->Events[event];
+						outTree.AddEvent(copiedEvent.SiteIndex, copiedEvent.Depth, copiedEvent.TicksBegin, copiedEvent.TicksEnd);
+					}
+				}
+				outTree.AddFrame();
+				progress = frame + 1;
+			}
+		};
+}
+
+// The history of the running profilers
+class LiveTimelineSource : public TimelineSource
+{
+public:
+	uint64 GetTicksPerSecond() const override
+	{
+		uint64 frequency = 0;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+		return frequency;
+	}
+
+	void GetHistoryRange(uint64& ticksMin, uint64& ticksMax) const override { gCPUProfiler.GetHistoryRange(ticksMin, ticksMax); }
+
+	URange GetCPUFrameRange() const override { return gCPUProfiler.GetFrameRange(); }
+	Span<const CPUProfiler::ThreadData> GetThreads() const override { return gCPUProfiler.GetThreads(); }
+	Span<const CPUProfiler::EventData::Event> GetEventsForThread(const CPUProfiler::ThreadData& thread, uint32 frame) const override { return gCPUProfiler.GetEventsForThread(thread, frame); }
+
+	URange GetGPUFrameRange() const override { return gGPUProfiler.GetFrameRange(); }
+	Span<const GPUProfiler::QueueInfo> GetQueues() const override { return gGPUProfiler.GetQueues(); }
+	Span<const GPUProfiler::EventData::Event> GetEventsForQueue(const GPUProfiler::QueueInfo& queue, uint32 frame) const override { return gGPUProfiler.GetEventsForQueue(queue, frame); }
+};
+
+// Decoded capture frame converted to the events of the profilers, so it can be drawn like the live history
+template<typename EventType>
+struct CachedFrame
+{
+	std::vector<EventType>				Events;
+	std::vector<Span<const EventType>>	EventsPerTrack;
+};
+using CachedCPUFrame = CachedFrame<CPUProfiler::EventData::Event>;
+using CachedGPUFrame = CachedFrame<GPUProfiler::EventData::Event>;
+
+static CaptureSite GetCaptureSite(Span<const CaptureSite> sites, uint32 siteIndex)
+{
+	return siteIndex < sites.size() ? sites[siteIndex] : CaptureSite{ "???" };
+}
+
+static void ConvertCPUFrame(const CaptureFrame& frame, Span<const CaptureSite> sites, uint32 numThreads, CachedCPUFrame& outFrame)
+{
+	outFrame.Events.reserve(frame.Events.size());
+	outFrame.EventsPerTrack.resize(numThreads);
+	for (const CaptureFrame::Track& track : frame.Tracks)
+	{
+		if (track.TrackIndex >= numThreads)
+			continue;
+
+		size_t first = outFrame.Events.size();
+		for (const CaptureEvent& captureEvent : Span<const CaptureEvent>(frame.Events.data() + track.EventOffset, track.NumEvents))
+		{
+			CaptureSite site = GetCaptureSite(sites, captureEvent.SiteIndex);
+
+			CPUProfiler::EventData::Event& event = outFrame.Events.emplace_back();
+			event.pName = site.pName;
+			event.pFilePath = site.pFilePath;
+			event.LineNumber = site.LineNumber;
+			event.TicksBegin = captureEvent.TicksBegin;
+			event.TicksEnd = captureEvent.TicksEnd;
+			event.ThreadIndex = track.TrackIndex;
+			event.Depth = captureEvent.Depth;
+			event.SiteIndex = captureEvent.SiteIndex;
+			event.SelfTicks = captureEvent.SelfTicks;
+		}
+		outFrame.EventsPerTrack[track.TrackIndex] = Span<const CPUProfiler::EventData::Event>(outFrame.Events.data() + first, track.NumEvents);
+	}
+}
+
+static void ConvertGPUFrame(const CaptureFrame& frame, Span<const CaptureSite> sites, uint32 numQueues, CachedGPUFrame& outFrame)
+{
+	outFrame.Events.reserve(frame.Events.size());
+	outFrame.EventsPerTrack.resize(numQueues);
+	for (const CaptureFrame::Track& track : frame.Tracks)
+	{
+		if (track.TrackIndex >= numQueues)
+			continue;
+
+		size_t first = outFrame.Events.size();
+		for (const CaptureEvent& captureEvent : Span<const CaptureEvent>(frame.Events.data() + track.EventOffset, track.NumEvents))
+		{
+			CaptureSite site = GetCaptureSite(sites, captureEvent.SiteIndex);
+
+			GPUProfiler::EventData::Event& event = outFrame.Events.emplace_back();
+			event.pName = site.pName;
+			event.pFilePath = site.pFilePath;
+			event.LineNumber = site.LineNumber;
+			event.TicksBegin = captureEvent.TicksBegin;
+			event.TicksEnd = captureEvent.TicksEnd;
+			event.Depth = captureEvent.Depth;
+			event.QueueIndex = track.TrackIndex;
+			event.SiteIndex = captureEvent.SiteIndex;
+			event.SelfTicks = captureEvent.SelfTicks;
+		}
+		outFrame.EventsPerTrack[track.TrackIndex] = Span<const GPUProfiler::EventData::Event>(outFrame.Events.data() + first, track.NumEvents);
+	}
+}
+
+// A window of frames of a capture file.
+// Only the frames in the view are decoded and kept in memory, so captures of any length can be browsed.
+// Frame indices in the ranges are indices in the capture index, not the frame numbers of the recording.
+class CaptureTimelineSource : public TimelineSource
+{
+public:
+	bool Open(const char* pPath)
+	{
+		Close();
+		if (!m_Reader.Open(pPath))
+			return false;
+
+		for (const CaptureThread& captureThread : m_Reader.GetThreads())
+		{
+			CPUProfiler::ThreadData& thread = m_Threads.emplace_back();
+			ImStrncpy(thread.Name, captureThread.pName, ARRAYSIZE(thread.Name));
+			thread.ThreadID = captureThread.ThreadID;
+			thread.Index = (uint32)m_Threads.size() - 1;
+		}
+
+		for (const CaptureQueue& captureQueue : m_Reader.GetQueues())
+		{
+			GPUProfiler::QueueInfo& queue = m_Queues.emplace_back();
+			ImStrncpy(queue.Name, captureQueue.pName, ARRAYSIZE(queue.Name));
+			queue.InitCalibration(captureQueue.GPUCalibrationTicks, captureQueue.CPUCalibrationTicks, captureQueue.GPUFrequency, captureQueue.CPUFrequency);
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		m_Reader.Close();
+		m_Threads.clear();
+		m_Queues.clear();
+		m_CPUFrames.clear();
+		m_GPUFrames.clear();
+		m_CPURange = URange(0, 0);
+		m_GPURange = URange(0, 0);
+	}
+
+	bool IsOpen() const { return m_Reader.IsOpen(); }
+	const CaptureReader& GetReader() const { return m_Reader; }
+	uint32 GetNumFrames() const { return (uint32)m_Reader.GetCPUFrames().size(); }
+
+	// The frames are decoded on the worker, so the range is not limited to the view. The capture must stay open until the task is done.
+	// The frames are split over the workers of a scheduler, each building its own tree. The trees are merged once all frames are done.
+	CallTreeTask CreateCallTreeTask(URange frames) const override
+	{
+		const CaptureReader* pReader = &m_Reader;
+		frames.End = ImMin(frames.End, GetNumFrames());
+		return [pReader, frames](CallTree& outTree, const std::atomic<bool>& cancel, std::atomic<uint32>& progress)
+			{
+				static constexpr uint32 FramesPerBatch = 16;
+
+				TaskScheduler scheduler;
+				std::vector<CallTree> workerTrees(scheduler.GetNumWorkers());
+				std::vector<CaptureFrame> decodedFrames(scheduler.GetNumWorkers());
+				scheduler.ParallelFor(frames.End - frames.Begin, FramesPerBatch, [&](uint32 begin, uint32 end, uint32 workerIndex)
+					{
+						CallTree& tree = workerTrees[workerIndex];
+						CaptureFrame& decodedFrame = decodedFrames[workerIndex];
+						for (uint32 frame = frames.Begin + begin; frame < frames.Begin + end && !cancel; ++frame)
+						{
+							if (pReader->DecodeCPUFrame(frame, decodedFrame))
+							{
+								for (const CaptureFrame::Track& track : decodedFrame.Tracks)
+								{
+									tree.BeginTrack();
+									for (const CaptureEvent& event : decodedFrame.GetEvents(track))
+										tree.AddEvent(event.SiteIndex, event.Depth, event.TicksBegin, event.TicksEnd);
+								}
+							}
+							tree.AddFrame();
+							++progress;
+						}
+					});
+
+				Span<const CaptureSite> sites = pReader->GetSites();
+				for (uint32 siteIndex = 0; siteIndex < (uint32)sites.size(); ++siteIndex)
+					outTree.SetSiteName(siteIndex, sites[siteIndex].pName);
+				for (const CallTree& tree : workerTrees)
+				{
+					if (cancel)
+						break;
+					outTree.Merge(tree);
+				}
+			};
+	}
+
+	// Select the CPU frames to display. Decodes the frames entering the view and frees the frames leaving it.
+	void SetView(uint32 firstFrame, uint32 numFrames)
+	{
+		uint32 numCaptureFrames = GetNumFrames();
+		m_CPURange.Begin = ImMin(firstFrame, numCaptureFrames);
+		m_CPURange.End = ImMin(m_CPURange.Begin + numFrames, numCaptureFrames);
+
+		// GPU frames are selected by time, so work that lags behind the CPU is shown at the right place
+		m_GPURange = URange(0, 0);
+		if (m_CPURange.Begin < m_CPURange.End)
+		{
+			Span<const CaptureFormat::FrameEntry> cpuFrames = m_Reader.GetCPUFrames();
+			Span<const CaptureFormat::FrameEntry> gpuFrames = m_Reader.GetGPUFrames();
+			uint64 ticksBegin = cpuFrames[m_CPURange.Begin].TicksBegin;
+			uint64 ticksEnd = cpuFrames[m_CPURange.End - 1].TicksEnd;
+			m_GPURange.Begin = m_Reader.FindGPUFrame(ticksBegin);
+			m_GPURange.End = m_GPURange.Begin;
+			while (m_GPURange.End < (uint32)gpuFrames.size() && gpuFrames[m_GPURange.End].TicksBegin <= ticksEnd)
+				++m_GPURange.End;
+		}
+
+		UpdateCache(m_CPUFrames, m_CPURange, &CaptureTimelineSource::DecodeCPUFrame);
+		UpdateCache(m_GPUFrames, m_GPURange, &CaptureTimelineSource::DecodeGPUFrame);
+	}
+
+	uint64 GetTicksPerSecond() const override { return m_Reader.GetTicksPerSecond(); }
+
+	void GetHistoryRange(uint64& ticksMin, uint64& ticksMax) const override
+	{
+		ticksMin = 0;
+		ticksMax = 0;
+		if (m_CPURange.Begin < m_CPURange.End)
+		{
+			ticksMin = m_Reader.GetCPUFrames()[m_CPURange.Begin].TicksBegin;
+			ticksMax = m_Reader.GetCPUFrames()[m_CPURange.End - 1].TicksEnd;
+		}
+	}
+
+	URange GetCPUFrameRange() const override { return m_CPURange; }
+	Span<const CPUProfiler::ThreadData> GetThreads() const override { return m_Threads; }
+
+	Span<const CPUProfiler::EventData::Event> GetEventsForThread(const CPUProfiler::ThreadData& thread, uint32 frame) const override
+	{
+		auto it = m_CPUFrames.find(frame);
+		if (it == m_CPUFrames.end() || thread.Index >= it->second.EventsPerTrack.size())
+			return {};
+		return it->second.EventsPerTrack[thread.Index];
+	}
+
+	URange GetGPUFrameRange() const override { return m_GPURange; }
+	Span<const GPUProfiler::QueueInfo> GetQueues() const override { return m_Queues; }
+
+	Span<const GPUProfiler::EventData::Event> GetEventsForQueue(const GPUProfiler::QueueInfo& queue, uint32 frame) const override
+	{
+		auto it = m_GPUFrames.find(frame);
+		uint32 queueIndex = (uint32)(&queue - m_Queues.data());
+		if (it == m_GPUFrames.end() || queueIndex >= it->second.EventsPerTrack.size())
+			return {};
+		return it->second.EventsPerTrack[queueIndex];
+	}
+
+private:
+	using CPUFrame = CachedCPUFrame;
+	using GPUFrame = CachedGPUFrame;
+
+	template<typename FrameType>
+	void UpdateCache(std::unordered_map<uint32, FrameType>& cache, URange range, void (CaptureTimelineSource::*pDecodeFn)(uint32, FrameType&))
+	{
+		for (auto it = cache.begin(); it != cache.end();)
+		{
+			if (it->first < range.Begin || it->first >= range.End)
+				it = cache.erase(it);
+			else
+				++it;
+		}
+
+		for (uint32 frame = range.Begin; frame < range.End; ++frame)
+		{
+			if (!cache.contains(frame))
+				(this->*pDecodeFn)(frame, cache[frame]);
+		}
+	}
+
+	void DecodeCPUFrame(uint32 frame, CPUFrame& outFrame)
+	{
+		if (m_Reader.DecodeCPUFrame(frame, m_DecodedFrame))
+			ConvertCPUFrame(m_DecodedFrame, m_Reader.GetSites(), (uint32)m_Threads.size(), outFrame);
+	}
+
+	void DecodeGPUFrame(uint32 frame, GPUFrame& outFrame)
+	{
+		if (m_Reader.DecodeGPUFrame(frame, m_DecodedFrame))
+			ConvertGPUFrame(m_DecodedFrame, m_Reader.GetSites(), (uint32)m_Queues.size(), outFrame);
+	}
+
+	CaptureReader								m_Reader;
+	CaptureFrame								m_DecodedFrame;		// Scratch frame to decode into
+	std::vector<CPUProfiler::ThreadData>		m_Threads;
+	std::vector<GPUProfiler::QueueInfo>			m_Queues;
+	URange										m_CPURange = URange(0, 0);
+	URange										m_GPURange = URange(0, 0);
+	std::unordered_map<uint32, CPUFrame>		m_CPUFrames;		// Decoded frames in the view
+	std::unordered_map<uint32, GPUFrame>		m_GPUFrames;
+};
+
+
+// The frames published by another process through the live transport.
+// The last frames received are kept. Frame indices in the ranges are the frame numbers of the publishing process,
+// frames that were dropped by the transport are missing from the range.
+class RemoteTimelineSource : public TimelineSource
+{
+public:
+	bool Open(const char* pName)
+	{
+		Close();
+		return m_Reader.Open(pName, MaxFrames);
+	}
+
+	void Close()
+	{
+		m_Reader.Close();
+		m_Threads.clear();
+		m_Queues.clear();
+		m_CPUFrames.clear();
+		m_GPUFrames.clear();
+	}
+
+	bool IsOpen() const { return m_Reader.IsOpen(); }
+	const LiveTransportReader& GetReader() const { return m_Reader; }
+
+	// Receive the frames published since the last update
+	void Update()
+	{
+		if (m_Reader.Poll() == 0)
+			return;
+
+		for (uint32 i = (uint32)m_Threads.size(); i < (uint32)m_Reader.GetThreads().size(); ++i)
+		{
+			const CaptureThread& captureThread = m_Reader.GetThreads()[i];
+			CPUProfiler::ThreadData& thread = m_Threads.emplace_back();
+			ImStrncpy(thread.Name, captureThread.pName, ARRAYSIZE(thread.Name));
+			thread.ThreadID = captureThread.ThreadID;
+			thread.Index = i;
+		}
+
+		for (uint32 i = (uint32)m_Queues.size(); i < (uint32)m_Reader.GetQueues().size(); ++i)
+		{
+			const CaptureQueue& captureQueue = m_Reader.GetQueues()[i];
+			GPUProfiler::QueueInfo& queue = m_Queues.emplace_back();
+			ImStrncpy(queue.Name, captureQueue.pName, ARRAYSIZE(queue.Name));
+			queue.InitCalibration(captureQueue.GPUCalibrationTicks, captureQueue.CPUCalibrationTicks, captureQueue.GPUFrequency, captureQueue.CPUFrequency);
+		}
+
+		m_CPURange = UpdateCache(m_CPUFrames, m_Reader.GetCPUFrames(), [this](const CaptureFrame& frame, CachedCPUFrame& outFrame)
+			{
+				ConvertCPUFrame(frame, m_Reader.GetSites(), (uint32)m_Threads.size(), outFrame);
+			});
+		m_GPURange = UpdateCache(m_GPUFrames, m_Reader.GetGPUFrames(), [this](const CaptureFrame& frame, CachedGPUFrame& outFrame)
+			{
+				ConvertGPUFrame(frame, m_Reader.GetSites(), (uint32)m_Queues.size(), outFrame);
+			});
+	}
+
+	uint64 GetTicksPerSecond() const override { return m_Reader.GetTicksPerSecond(); }
+
+	void GetHistoryRange(uint64& ticksMin, uint64& ticksMax) const override
+	{
+		ticksMin = 0;
+		ticksMax = 0;
+		const std::deque<CaptureFrame>& frames = m_Reader.GetCPUFrames();
+		if (!frames.empty())
+		{
+			ticksMin = frames.front().TicksBegin;
+			ticksMax = frames.back().TicksEnd;
+		}
+	}
+
+	URange GetCPUFrameRange() const override { return m_CPURange; }
+	Span<const CPUProfiler::ThreadData> GetThreads() const override { return m_Threads; }
+
+	Span<const CPUProfiler::EventData::Event> GetEventsForThread(const CPUProfiler::ThreadData& thread, uint32 frame) const override
+	{
+		auto it = m_CPUFrames.find(frame);
+		if (it == m_CPUFrames.end() || thread.Index >= it->second.EventsPerTrack.size())
+			return {};
+		return it->second.EventsPerTrack[thread.Index];
+	}
+
+	URange GetGPUFrameRange() const override { return m_GPURange; }
+	Span<const GPUProfiler::QueueInfo> GetQueues() const override { return m_Queues; }
+
+	Span<const GPUProfiler::EventData::Event> GetEventsForQueue(const GPUProfiler::QueueInfo& queue, uint32 frame) const override
+	{
+		auto it = m_GPUFrames.find(frame);
+		uint32 queueIndex = (uint32)(&queue - m_Queues.data());
+		if (it == m_GPUFrames.end() || queueIndex >= it->second.EventsPerTrack.size())
+			return {};
+		return it->second.EventsPerTrack[queueIndex];
+	}
+
+private:
+	static constexpr uint32 MaxFrames = 32;
+
+	// Convert the frames the reader received and free the frames it discarded. Returns the range of frame numbers.
+	template<typename FrameType, typename ConvertFn>
+	static URange UpdateCache(std::unordered_map<uint32, FrameType>& cache, const std::deque<CaptureFrame>& frames, ConvertFn&& convertFn)
+	{
+		if (frames.empty())
+		{
+			cache.clear();
+			return URange(0, 0);
+		}
+
+		URange range(frames.front().FrameIndex, frames.back().FrameIndex + 1);
+		for (auto it = cache.begin(); it != cache.end();)
+		{
+			if (it->first < range.Begin || it->first >= range.End)
+				it = cache.erase(it);
+			else
+				++it;
+		}
+
+		for (const CaptureFrame& frame : frames)
+		{
+			if (!cache.contains(frame.FrameIndex))
+				convertFn(frame, cache[frame.FrameIndex]);
+		}
+		return range;
+	}
+
+	LiveTransportReader							m_Reader;
+	std::vector<CPUProfiler::ThreadData>		m_Threads;
+	std::vector<GPUProfiler::QueueInfo>			m_Queues;
+	URange										m_CPURange = URange(0, 0);
+	URange										m_GPURange = URange(0, 0);
+	std::unordered_map<uint32, CachedCPUFrame>	m_CPUFrames;		// Converted frames of the reader
+	std::unordered_map<uint32, CachedGPUFrame>	m_GPUFrames;
+};
+
+//-----------------------------------------------------------------------------
+// [SECTION] Call Tree Worker
+//-----------------------------------------------------------------------------
+
+// Builds the top-down and bottom-up call trees on a worker thread, so large frame ranges do not stall the HUD.
+// The trees of the previous build remain available until the next build is done.
+class CallTreeWorker
+{
+public:
+	CallTreeWorker() = default;
+	~CallTreeWorker() { Cancel(); }
+
+	CallTreeWorker(const CallTreeWorker&) = delete;
+	CallTreeWorker& operator=(const CallTreeWorker&) = delete;
+
+	// Start building. Cancels a build in progress.
+	void Start(CallTreeTask&& task, uint32 numFrames)
+	{
+		Cancel();
+		m_NumFrames = numFrames;
+		m_Progress = 0;
+		m_IsCancelled = false;
+		m_IsDone = false;
+		m_Thread = std::thread([this, task = std::move(task)]()
+			{
+				m_PendingTopDown.Reset();
+				task(m_PendingTopDown, m_IsCancelled, m_Progress);
+				if (!m_IsCancelled)
+				{
+					m_PendingTopDown.Finalize();
+					m_PendingBottomUp.BuildBottomUp(m_PendingTopDown);
+					m_PendingBottomUp.Finalize();
+				}
+				m_IsDone = true;
+			});
+	}
+
+	// Stop a build in progress and wait for the worker. The data the task reads can be released afterwards.
+	void Cancel()
+	{
+		if (!m_Thread.joinable())
+			return;
+		m_IsCancelled = true;
+		m_Thread.join();
+	}
+
+	// Take the trees of a finished build. Call once per frame.
+	void Update()
+	{
+		if (!m_Thread.joinable() || !m_IsDone)
+			return;
+		m_Thread.join();
+		std::swap(m_TopDown, m_PendingTopDown);
+		std::swap(m_BottomUp, m_PendingBottomUp);
+		m_HasTrees = true;
+	}
+
+	bool IsBusy() const { return m_Thread.joinable(); }
+	float GetProgress() const { return m_NumFrames > 0 ? (float)m_Progress / m_NumFrames : 1.0f; }
+
+	bool HasTrees() const { return m_HasTrees; }
+	const CallTree& GetTopDown() const { return m_TopDown; }
+	const CallTree& GetBottomUp() const { return m_BottomUp; }
+
+private:
+	std::thread				m_Thread;
+	std::atomic<bool>		m_IsCancelled = false;
+	std::atomic<bool>		m_IsDone = false;
+	std::atomic<uint32>		m_Progress = 0;
+	uint32					m_NumFrames = 0;
+
+	CallTree				m_PendingTopDown;		// Owned by the worker while it runs
+	CallTree				m_PendingBottomUp;
+	CallTree				m_TopDown;
+	CallTree				m_BottomUp;
+	bool					m_HasTrees = false;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Timeline Index
+//-----------------------------------------------------------------------------
+
+// The events of a track of a frame, grouped by depth.
+// Events of the same depth are nested in different parents or follow each other, so they do not overlap
+// and are in order of both their begin and end time.
+// Each depth also has a pyramid of merged spans: level 0 are the events, and each node of a level merges two nodes of the level below.
+// The timeline walks the pyramid from the top, skipping the nodes out of view and drawing the nodes narrower than a few pixels
+// as a single block, so the cost of drawing a depth depends on its width on screen and not on its number of events.
+struct TimelineTrackIndex
+{
+	struct MergedSpan
+	{
+		uint64 TicksBegin;		// Begin of the first event
+		uint64 TicksEnd;		// End of the last event
+		uint64 BusyTicks;		// Time in the events. The events do not overlap, so this is at most the length of the span.
+	};
+
+	std::vector<uint32>		DepthEnds;		// End of the events of each depth in Events
+	std::vector<uint32>		Events;			// Index of each event in the track, by depth
+	std::vector<uint32>		LevelEnds;		// End of the spans of each level (from 1) of each depth in Spans. DepthLevelEnds delimits the depths.
+	std::vector<uint32>		DepthLevelEnds;
+	std::vector<MergedSpan>	Spans;
+
+	// Group the events by depth, keeping the order of the events within a depth, and merge them into pyramids. O(events).
+	template<typename EventType>
+	void Build(Span<const EventType> events)
+	{
+		DepthEnds.clear();
+		for (const EventType& event : events)
+		{
+			if (event.Depth >= DepthEnds.size())
+				DepthEnds.resize(event.Depth + 1, 0);
+			++DepthEnds[event.Depth];
+		}
+
+		// Turn the counts into the first index of each depth. Each depth ends at the first index of the next once its events are placed.
+		uint32 first = 0;
+		for (uint32& depthEnd : DepthEnds)
+		{
+			uint32 count = depthEnd;
+			depthEnd = first;
+			first += count;
+		}
+
+		Events.resize(events.size());
+		for (uint32 eventIndex = 0; eventIndex < (uint32)events.size(); ++eventIndex)
+			Events[DepthEnds[events[eventIndex].Depth]++] = eventIndex;
+
+		LevelEnds.clear();
+		DepthLevelEnds.clear();
+		Spans.clear();
+		for (uint32 depth = 0; depth < GetNumDepths(); ++depth)
+		{
+			Span<const uint32> depthEvents = GetEvents(depth);
+			uint32 count = (uint32)depthEvents.size();
+			for (uint32 level = 1; count > 1; ++level)
+			{
+				uint32 levelBegin = (uint32)Spans.size();
+				for (uint32 index = 0; index < count; index += 2)
+				{
+					MergedSpan span = GetSpan(events, depth, level - 1, index);
+					if (index + 1 < count)
+					{
+						MergedSpan next = GetSpan(events, depth, level - 1, index + 1);
+						span.TicksEnd = next.TicksEnd;
+						span.BusyTicks += next.BusyTicks;
+					}
+					Spans.push_back(span);
+				}
+				LevelEnds.push_back((uint32)Spans.size());
+				count = (uint32)Spans.size() - levelBegin;
+			}
+			DepthLevelEnds.push_back((uint32)LevelEnds.size());
+		}
+	}
+
+	uint32 GetNumDepths() const { return (uint32)DepthEnds.size(); }
+
+	Span<const uint32> GetEvents(uint32 depth) const
+	{
+		uint32 begin = depth > 0 ? DepthEnds[depth - 1] : 0;
+		return Span<const uint32>(Events.data() + begin, DepthEnds[depth] - begin);
+	}
+
+	// Visit the events of a depth overlapping [ticksBegin, ticksEnd), in order of time. toTicks converts the ticks of an event to the ticks of the range.
+	// Events at least minTicks long are passed to eventFn(eventIndex). Runs of shorter events are merged into spans shorter than minTicks
+	// and passed to blockFn(ticksBegin, ticksEnd, busyTicks, numEvents), in the ticks of the range.
+	template<typename EventType, typename ToTicksFn, typename EventFn, typename BlockFn>
+	void VisitEvents(Span<const EventType> events, uint32 depth, uint64 ticksBegin, uint64 ticksEnd, uint64 minTicks, ToTicksFn&& toTicks, EventFn&& eventFn, BlockFn&& blockFn) const
+	{
+		if (depth >= GetNumDepths() || GetEvents(depth).empty())
+			return;
+
+		auto Visit = [&](auto&& visit, uint32 level, uint32 index) -> void {
+			MergedSpan span = GetSpan(events, depth, level, index);
+			uint64 spanBegin = toTicks(span.TicksBegin);
+			uint64 spanEnd = toTicks(span.TicksEnd);
+			if (spanEnd <= ticksBegin || spanBegin >= ticksEnd)
+				return;
+
+			if (spanEnd - spanBegin < minTicks)
+			{
+				uint32 numEvents = ImMin(GetNumEvents(depth) - (index << level), 1u << level);
+				blockFn(spanBegin, spanEnd, toTicks(span.TicksBegin + span.BusyTicks) - spanBegin, numEvents);
+			}
+			else if (level == 0)
+			{
+				eventFn(GetEvents(depth)[index]);
+			}
+			else
+			{
+				visit(visit, level - 1, index * 2);
+				if (index * 2 + 1 < GetNumSpans(depth, level - 1))
+					visit(visit, level - 1, index * 2 + 1);
+			}
+		};
+		Visit(Visit, GetNumLevels(depth) - 1, 0);
+	}
+
+private:
+	uint32 GetNumEvents(uint32 depth) const { return (uint32)GetEvents(depth).size(); }
+
+	// Levels of a depth, including the events at level 0
+	uint32 GetNumLevels(uint32 depth) const
+	{
+		uint32 firstLevel = depth > 0 ? DepthLevelEnds[depth - 1] : 0;
+		return DepthLevelEnds[depth] - firstLevel + 1;
+	}
+
+	uint32 GetLevelBegin(uint32 depth, uint32 level) const
+	{
+		uint32 levelIndex = (depth > 0 ? DepthLevelEnds[depth - 1] : 0) + level - 1;
+		return levelIndex > 0 ? LevelEnds[levelIndex - 1] : 0;
+	}
+
+	uint32 GetNumSpans(uint32 depth, uint32 level) const
+	{
+		if (level == 0)
+			return GetNumEvents(depth);
+		uint32 levelIndex = (depth > 0 ? DepthLevelEnds[depth - 1] : 0) + level - 1;
+		return LevelEnds[levelIndex] - GetLevelBegin(depth, level);
+	}
+
+	template<typename EventType>
+	MergedSpan GetSpan(Span<const EventType> events, uint32 depth, uint32 level, uint32 index) const
+	{
+		if (level > 0)
+			return Spans[GetLevelBegin(depth, level) + index];
+		const EventType& event = events[GetEvents(depth)[index]];
+		return { event.TicksBegin, event.TicksEnd, event.TicksEnd - event.TicksBegin };
+	}
+};
+
+// The indices of the tracks of the frames in the timeline.
+// A frame is indexed when it enters the view and kept until it leaves it, so drawing only touches the events in view.
+class TimelineIndexCache
+{
+public:
+	// Index the frames in the ranges and free the others
+	void Update(const TimelineSource& source, URange cpuFrames, URange gpuFrames)
+	{
+		Span<const CPUProfiler::ThreadData> threads = source.GetThreads();
+		UpdateFrames(m_CPUFrames, cpuFrames, (uint32)threads.size(), [&](uint32 frameIndex, uint32 trackIndex) { return source.GetEventsForThread(threads[trackIndex], frameIndex); });
+
+		Span<const GPUProfiler::QueueInfo> queues = source.GetQueues();
+		UpdateFrames(m_GPUFrames, gpuFrames, (uint32)queues.size(), [&](uint32 frameIndex, uint32 trackIndex) { return source.GetEventsForQueue(queues[trackIndex], frameIndex); });
+	}
+
+	const TimelineTrackIndex* FindCPUTrack(uint32 frameIndex, uint32 threadIndex) const { return FindTrack(m_CPUFrames, frameIndex, threadIndex); }
+	const TimelineTrackIndex* FindGPUTrack(uint32 frameIndex, uint32 queueIndex) const { return FindTrack(m_GPUFrames, frameIndex, queueIndex); }
+
+private:
+	struct Frame
+	{
+		std::vector<TimelineTrackIndex>	Tracks;
+		const void*						pFirstEvent = nullptr;	// Identifies the frame, as the sources reuse frame indices when they are reopened
+		uint64							TicksBegin = 0;
+		uint32							NumEvents = 0;
+	};
+
+	template<typename GetEventsFn>
+	static void UpdateFrames(std::unordered_map<uint32, Frame>& frames, URange range, uint32 numTracks, GetEventsFn&& getEvents)
+	{
+		for (auto it = frames.begin(); it != frames.end();)
+		{
+			if (it->first < range.Begin || it->first >= range.End)
+				it = frames.erase(it);
+			else
+				++it;
+		}
+
+		for (uint32 frameIndex = range.Begin; frameIndex < range.End; ++frameIndex)
+		{
+			const void* pFirstEvent = nullptr;
+			uint64 ticksBegin = 0;
+			uint32 numEvents = 0;
+			for (uint32 trackIndex = 0; trackIndex < numTracks; ++trackIndex)
+			{
+				auto events = getEvents(frameIndex, trackIndex);
+				if (!pFirstEvent && !events.empty())
+				{
+					pFirstEvent = events.data();
+					ticksBegin = events[0].TicksBegin;
+				}
+				numEvents += (uint32)events.size();
+			}
+
+			Frame& frame = frames[frameIndex];
+			if (frame.pFirstEvent == pFirstEvent && frame.TicksBegin == ticksBegin && frame.NumEvents == numEvents && frame.Tracks.size() == numTracks)
+				continue;
+
+			frame.pFirstEvent = pFirstEvent;
+			frame.TicksBegin = ticksBegin;
+			frame.NumEvents = numEvents;
+			frame.Tracks.resize(numTracks);
+			for (uint32 trackIndex = 0; trackIndex < numTracks; ++trackIndex)
+				frame.Tracks[trackIndex].Build(getEvents(frameIndex, trackIndex));
+		}
+	}
+
+	static const TimelineTrackIndex* FindTrack(const std::unordered_map<uint32, Frame>& frames, uint32 frameIndex, uint32 trackIndex)
+	{
+		auto it = frames.find(frameIndex);
+		return it != frames.end() && trackIndex < it->second.Tracks.size() ? &it->second.Tracks[trackIndex] : nullptr;
+	}
+
+	std::unordered_map<uint32, Frame> m_CPUFrames;
+	std::unordered_map<uint32, Frame> m_GPUFrames;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Timeline Sites
+//-----------------------------------------------------------------------------
+
+static ImColor ColorFromString(const char* pName);
+
+// The color and ID of the bars of each site, computed once from the name instead of for every bar.
+// Indexed by the site index of the events, which is only valid for one source. Clear the cache when a source is opened or closed.
+class TimelineSiteCache
+{
+public:
+	struct Site
+	{
+		ImColor Color;				// Color of the bars when not colored by self time
+		ImGuiID ID = 0;				// Hash of the name, so the same name gets the same ID in every source. 0 until computed
+	};
+
+	const Site& Get(uint32 siteIndex, const char* pName)
+	{
+		if (siteIndex >= m_Sites.size())
+			m_Sites.resize(siteIndex + 1);
+
+		Site& site = m_Sites[siteIndex];
+		if (site.ID == 0)
+		{
+			site.Color = ColorFromString(pName);
+			site.ID = ImMax(ImHashStr(pName), 1u);
+		}
+		return site;
+	}
+
+	void Clear() { m_Sites.clear(); }
+
+private:
+	std::vector<Site> m_Sites;
+};
+
+// ID of a bar from the ID of its site and track, and the position of its event.
+// Unlike the address of the event, it stays the same across draws while the frame is in the history.
+static ImGuiID GetBarID(ImGuiID siteID, ImGuiID trackID, uint32 frameIndex, uint32 eventIndex)
+{
+	ImGuiID id = siteID ^ trackID ^ ((frameIndex * 0x9E3779B1u + eventIndex) * 0x85EBCA6Bu);
+	return id != 0 ? id : 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Timeline Labels
+//-----------------------------------------------------------------------------
+
+// The measured width of the site names drawn on the timeline bars, so the labels are laid out without measuring their text every frame.
+// Keyed by the name: site names are interned and stay valid while their source is open. Clear the cache when a source is opened or closed.
+class TimelineLabelCache
+{
+public:
+	struct Label
+	{
+		std::vector<float> PrefixWidths;		// Width of the first i bytes of the name, for i in [0, length]. Rounded up to whole characters.
+
+		float GetWidth() const { return PrefixWidths.back(); }
+
+		// Number of bytes of the name which fit in the given width, ending at a character. O(log(length)).
+		uint32 GetFittingLength(float width) const
+		{
+			return (uint32)(std::upper_bound(PrefixWidths.begin(), PrefixWidths.end(), width) - PrefixWidths.begin()) - 1;
+		}
+	};
+
+	// The label of a name, measured with the current font the first time it is drawn
+	const Label& Get(const char* pName)
+	{
+		ImFont* pFont = ImGui::GetFont();
+		float fontSize = ImGui::GetFontSize();
+		if (pFont != m_pFont || fontSize != m_FontSize)
+		{
+			m_Labels.clear();
+			m_pFont = pFont;
+			m_FontSize = fontSize;
+		}
+
+		auto [it, isNew] = m_Labels.try_emplace(pName);
+		Label& label = it->second;
+		if (isNew)
+		{
+			// The bytes inside a multi-byte character get the width of the whole character, so names are never cut inside one
+			size_t length = strlen(pName);
+			label.PrefixWidths.assign(length + 1, 0.0f);
+			float width = 0.0f;
+			for (size_t begin = 0; begin < length;)
+			{
+				unsigned int c;
+				size_t end = ImMin(begin + (size_t)ImMax(ImTextCharFromUtf8(&c, pName + begin, pName + length), 1), length);
+				width += ImGui::CalcTextSize(pName + begin, pName + end).x;
+				for (size_t i = begin + 1; i <= end; ++i)
+					label.PrefixWidths[i] = width;
+				begin = end;
+			}
+		}
+		return label;
+	}
+
+	void Clear() { m_Labels.clear(); }
+
+private:
+	std::unordered_map<const char*, Label>	m_Labels;
+	ImFont*									m_pFont = nullptr;
+	float									m_FontSize = 0.0f;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Critical Path Cache
+//-----------------------------------------------------------------------------
+
+// The critical paths of the CPU frames in the timeline.
+// A path is computed when its frame enters the view and kept until the frame leaves it.
+class CriticalPathCache
+{
+public:
+	struct Frame
+	{
+		CriticalPath			Path;
+		std::vector<uint32>		FirstEvents;		// Index in the path of the first event of each thread
+		uint64					TicksBegin = 0;		// Identifies the frame, as the sources reuse frame indices when they are reopened
+		uint32					NumEvents = 0;
+	};
+
+	// Compute the paths of the frames in the range and free the others
+	void Update(const TimelineSource& source, URange frames)
+	{
+		for (auto it = m_Frames.begin(); it != m_Frames.end();)
+		{
+			if (it->first < frames.Begin || it->first >= frames.End)
+				it = m_Frames.erase(it);
+			else
+				++it;
+		}
+
+		Span<const CPUProfiler::ThreadData> threads = source.GetThreads();
+		if (threads.empty())
+			return;
+
+		for (uint32 frameIndex = frames.Begin; frameIndex < frames.End; ++frameIndex)
+		{
+			// The first event of the first thread spans the frame
+			Span<const CPUProfiler::EventData::Event> frameEvents = source.GetEventsForThread(threads[0], frameIndex);
+			if (frameEvents.empty())
+				continue;
+
+			uint32 numEvents = 0;
+			for (const CPUProfiler::ThreadData& thread : threads)
+				numEvents += (uint32)source.GetEventsForThread(thread, frameIndex).size();
+
+			Frame& frame = m_Frames[frameIndex];
+			if (frame.TicksBegin == frameEvents[0].TicksBegin && frame.NumEvents == numEvents && frame.FirstEvents.size() == threads.size())
+				continue;
+
+			frame.TicksBegin = frameEvents[0].TicksBegin;
+			frame.NumEvents = numEvents;
+			frame.FirstEvents.clear();
+			frame.Path.Reset(frameEvents[0].TicksBegin, frameEvents[0].TicksEnd);
+			for (uint32 threadIndex = 0; threadIndex < (uint32)threads.size(); ++threadIndex)
+			{
+				frame.FirstEvents.push_back(frame.Path.GetNumEvents());
+				frame.Path.BeginTrack(threadIndex);
+				for (const CPUProfiler::EventData::Event& event : source.GetEventsForThread(threads[threadIndex], frameIndex))
+					frame.Path.AddEvent(event.TicksBegin, event.TicksEnd, event.Depth, IsWaitScopeName(event.pName));
+			}
+			frame.Path.Compute();
+		}
+	}
+
+	const Frame* Find(uint32 frameIndex) const
+	{
+		auto it = m_Frames.find(frameIndex);
+		return it != m_Frames.end() ? &it->second : nullptr;
+	}
+
+private:
+	std::unordered_map<uint32, Frame> m_Frames;
+};
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] HUD
+//-----------------------------------------------------------------------------
+
 struct HUDContext
 {
 	StyleOptions Style;
 
-	float TimelineScale = 5.0f;
-	ImVec2 TimelineOffset = ImVec2(0.0f, 0.0f);
+	// The horizontal scale and offset are doubles, so bars stay in place when zoomed in to a few ticks on a long history
+	double TimelineScale = 5.0;
+	double TimelineOffsetX = 0.0;				// Position of the start of the history relative to the left of the timeline, in pixels
+	float TimelineOffsetY = 0.0f;
 
 	bool IsSelectingRange = false;
 	float RangeSelectionStart = 0.0f;
 	char SearchString[128]{};
 	bool PauseThreshold = false;
 	float PauseThresholdTime = 100.0f;
+	uint32 NumHitches = 0;						// Hitches of the profiler's trigger that were seen by the HUD
 	bool IsPaused = false;
+
+	LiveTimelineSource LiveSource;
+	CaptureTimelineSource CaptureSource;		// Open capture. Drawn instead of the live history when open
+	CaptureWriter CaptureRecorder;				// Records the live profilers when open
+	RemoteTimelineSource RemoteSource;			// Frames of another process. Drawn instead of the live history when attached
+	char RemoteName[64] = "TimelineProfiler";
+	char CapturePath[256] = "capture.tlcap";
+	int CaptureFirstFrame = 0;
+	int CaptureNumFrames = 5;
+	bool ImportAlignToStart = true;				// Move imported traces to the start of the timeline instead of keeping their timestamps
+
+	bool ShowStatistics = false;
+	int StatisticsRange = 0;					// 0 for the whole history, otherwise the rolling window index + 1
+	uint32 StatisticsSite = ~0u;				// Site of which the distribution is shown
+
+	bool ShowCallTree = false;
+	int CallTreeNumFrames = 100;
+	CallTreeWorker CallTrees;
+
+	bool ShowFrameHistory = false;
+	int FrameHistoryRange = 3;					// Index of the number of frames in the graph
+	uint32 ZoomToFrame = ~0u;					// Frame of the live history to zoom the timeline to when it is drawn next
+
+	CriticalPathCache CriticalPaths;			// Paths of the CPU frames in the timeline, when shown
+	TimelineIndexCache TimelineIndex;			// Events of the frames in the timeline by depth, to draw only the events in view
+	TimelineSiteCache TimelineSites;			// Colors and IDs of the bars of each site. Cleared when a source is opened or closed
+	TimelineLabelCache TimelineLabels;			// Widths of the names on the bars. Cleared when a source is opened or closed
 };
 
 static HUDContext gHUDContext;
@@ -55,6 +1113,11 @@ static void EditStyle(StyleOptions& style)
 	ImGui::ColorEdit4("Foreground Text Color", &style.FGTextColor.x);
 	ImGui::ColorEdit4("Bar Highlight Color", &style.BarHighlightColor.x);
 	ImGui::Separator();
+	ImGui::Checkbox("Color By Self Time", &style.ColorBySelfTime);
+	ImGui::SliderFloat("Self Time Max (ms)", &style.SelfTimeMaxMs, 0.05f, 20.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+	ImGui::Checkbox("Show Critical Path", &style.ShowCriticalPath);
+	ImGui::SliderFloat("Merge Width", &style.MergeWidth, 0.0f, 10.0f, "%.1f px");
+	ImGui::Separator();
 	ImGui::Checkbox("Debug Mode", &style.DebugMode);
 	ImGui::PopItemWidth();
 }
@@ -96,7 +1159,42 @@ static ImColor ColorFromString(const char* pName)
 	return ImColor(HSVtoRGB(hashF, 0.5f, 0.6f));
 }
 
-static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
+// Generate a color from green to red from the self time of an event, on a log scale from 10us to maxMs
+static ImColor ColorFromSelfTime(float selfMs, float maxMs)
+{
+	constexpr float minMs = 0.01f;
+	float t = ImSaturate(logf(ImMax(selfMs, minMs) / minMs) / logf(ImMax(maxMs, minMs * 2) / minMs));
+	return ImColor(HSVtoRGB((1.0f - t) * 0.33f, 0.6f, 0.7f));
+}
+
+// Duration with a unit that keeps a few significant digits, from ms down to ns
+struct DurationText
+{
+	char Text[32];
+};
+
+static DurationText FormatDuration(double ms)
+{
+	DurationText text;
+	if (ms >= 1.0 || ms == 0.0)
+		ImFormatString(text.Text, sizeof(text.Text), "%.3f ms", ms);
+	else if (ms >= 0.001)
+		ImFormatString(text.Text, sizeof(text.Text), "%.3f us", ms * 1000.0);
+	else
+		ImFormatString(text.Text, sizeof(text.Text), "%.1f ns", ms * 1000000.0);
+	return text;
+}
+
+// Run of events too short to be drawn individually
+struct TimelineBlock
+{
+	uint64 TicksBegin = 0;
+	uint64 TicksEnd = 0;
+	uint64 BusyTicks = 0;		// Time in the events
+	uint32 NumEvents = 0;
+};
+
+static void DrawProfilerTimeline(const TimelineSource& source, const ImVec2& size = ImVec2(0, 0))
 {
 	HUDContext& context = gHUDContext;
 	StyleOptions& style = context.Style;
@@ -107,9 +1205,10 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 	ImGui::ItemSize(timelineRect.GetSize());
 
 	// The current (scaled) size of the timeline
-	float timelineWidth = timelineRect.GetWidth() * context.TimelineScale;
+	double timelineWidth = timelineRect.GetWidth() * context.TimelineScale;
 
-	ImVec2 cursor = timelineRect.Min + context.TimelineOffset;
+	// Vertical position of the tracks. Horizontal positions are computed from the ticks with TicksToX.
+	ImVec2 cursor = ImVec2(timelineRect.Min.x, timelineRect.Min.y + context.TimelineOffsetY);
 	ImVec2 cursorStart = cursor;
 	ImDrawList* pDraw = ImGui::GetWindowDrawList();
 
@@ -120,22 +1219,53 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		ImGui::PushClipRect(timelineRect.Min, timelineRect.Max, true);
 
 		// How many ticks per ms
-		uint64 frequency = 0;
-		QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
-		const float MsToTicks = (float)frequency / 1000.0f;
+		uint64 frequency = source.GetTicksPerSecond();
+		const double MsToTicks = (double)frequency / 1000.0;
 		const float TicksToMs = 1000.0f / frequency;
 
 		// How many ticks are in the timeline
-		float ticksInTimeline = MsToTicks * style.MaxTime;
+		double ticksInTimeline = MsToTicks * style.MaxTime;
+
+		// Zoom in until a few ticks fill the timeline, so the shortest scopes can be inspected
+		const double MinTicksInView = 10.0;
+		const double maxScale = ImMax(ticksInTimeline / MinTicksInView, 1.0);
 
 		uint64 timelineTicksBegin, timelineTicksEnd;
-		gCPUProfiler.GetHistoryRange(timelineTicksBegin, timelineTicksEnd);
+		source.GetHistoryRange(timelineTicksBegin, timelineTicksEnd);
 		uint64 beginAnchor = timelineTicksBegin;
 
+		// Zoom to the frame selected in the frame history, to fill the entire window
+		URange cpuRange = source.GetCPUFrameRange();
+		if (context.ZoomToFrame != ~0u)
+		{
+			if (context.ZoomToFrame >= cpuRange.Begin && context.ZoomToFrame < cpuRange.End && !source.GetThreads().empty())
+			{
+				Span<const CPUProfiler::EventData::Event> events = source.GetEventsForThread(source.GetThreads()[0], context.ZoomToFrame);
+				if (events.size() > 0 && events[0].TicksEnd > events[0].TicksBegin && events[0].TicksBegin >= beginAnchor)
+				{
+					context.TimelineScale = ImClamp(ticksInTimeline / (double)(events[0].TicksEnd - events[0].TicksBegin), 1.0, maxScale);
+					timelineWidth = timelineRect.GetWidth() * context.TimelineScale;
+					context.TimelineOffsetX = -timelineWidth / ticksInTimeline * (double)(events[0].TicksBegin - beginAnchor);
+				}
+			}
+			context.ZoomToFrame = ~0u;
+		}
+
 		// How many pixels is one tick
-		const float TicksToPixels = timelineWidth / ticksInTimeline;
+		const double TicksToPixels = timelineWidth / ticksInTimeline;
+
+		// Screen position of the start of the history
+		const double originX = timelineRect.Min.x + context.TimelineOffsetX;
 
-		// Add vertical bars for each ms interval
+		// Screen position of a time. The offset from the anchor is computed in 64 bits and scaled in double precision,
+		// and the result is clamped to just outside the timeline, so it is exact enough for a float.
+		auto TicksToX = [&](uint64 ticks) -> float
+		{
+			double x = originX + (double)(int64_t)(ticks - beginAnchor) * TicksToPixels;
+			return (float)ImClamp(x, (double)timelineRect.Min.x - 10.0, (double)timelineRect.Max.x + 10.0);
+		};
+
+		// Add vertical bars for each interval, from ms down to ns when zoomed in
 		/*
 			0	1	2	3
 			|	|	|	|
@@ -144,19 +1274,36 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		*/
 		pDraw->AddRectFilled(timelineRect.Min, ImVec2(timelineRect.Max.x, timelineRect.Min.y + style.BarHeight), ImColor(0.0f, 0.0f, 0.0f, 0.1f));
 		pDraw->AddRect(timelineRect.Min - ImVec2(10, 0), ImVec2(timelineRect.Max.x + 10, timelineRect.Min.y + style.BarHeight), ImColor(1.0f, 1.0f, 1.0f, 0.4f));
-		for (int i = 0; i < style.MaxTime; ++i)
 		{
-			float x0 = (float)i * MsToTicks * TicksToPixels;
-			float msWidth = 1.0f * MsToTicks * TicksToPixels;
-			ImVec2 tickPos = ImVec2(cursor.x + x0, timelineRect.Min.y);
-			pDraw->AddLine(tickPos + ImVec2(0, style.BarHeight * 0.5f), tickPos + ImVec2(0, style.BarHeight), ImColor(style.BGTextColor));
-
-			if (i % 2 == 0)
+			// Interval of 1, 2 or 5 times a power of 10 ms, at least 50 pixels wide
+			const double MinIntervalWidth = 50.0;
+			double msToPixels = MsToTicks * TicksToPixels;
+			double intervalMs = pow(10.0, floor(log10(MinIntervalWidth / msToPixels)));
+			if (intervalMs * msToPixels < MinIntervalWidth)
+				intervalMs *= 2.0;
+			if (intervalMs * msToPixels < MinIntervalWidth)
+				intervalMs *= 2.5;
+			double intervalWidth = intervalMs * msToPixels;
+
+			const char* pUnit = intervalMs >= 1.0 ? "ms" : intervalMs >= 0.001 ? "us" : "ns";
+			double unitScale = intervalMs >= 1.0 ? 1.0 : intervalMs >= 0.001 ? 1000.0 : 1000000.0;
+
+			// Only the intervals in view
+			int64_t firstInterval = (int64_t)ImMax(floor((timelineRect.Min.x - originX) / intervalWidth) - 1.0, 0.0);
+			int64_t endInterval = (int64_t)ImMin(ceil((timelineRect.Max.x - originX) / intervalWidth) + 1.0, style.MaxTime / intervalMs);
+			for (int64_t i = firstInterval; i < endInterval; ++i)
 			{
-				pDraw->AddRectFilled(tickPos + ImVec2(0, style.BarHeight), tickPos + ImVec2(msWidth, timelineRect.Max.y), ImColor(1.0f, 1.0f, 1.0f, 0.02f));
-				const char* pBarText;
-				ImFormatStringToTempBuffer(&pBarText, nullptr, "%d ms", i);
-				pDraw->AddText(tickPos + ImVec2(5, 0), ImColor(style.BGTextColor), pBarText);
+				float x0 = (float)(originX + i * intervalWidth);
+				ImVec2 tickPos = ImVec2(x0, timelineRect.Min.y);
+				pDraw->AddLine(tickPos + ImVec2(0, style.BarHeight * 0.5f), tickPos + ImVec2(0, style.BarHeight), ImColor(style.BGTextColor));
+
+				if (i % 2 == 0)
+				{
+					pDraw->AddRectFilled(tickPos + ImVec2(0, style.BarHeight), ImVec2((float)(originX + (i + 1) * intervalWidth), timelineRect.Max.y), ImColor(1.0f, 1.0f, 1.0f, 0.02f));
+					const char* pBarText;
+					ImFormatStringToTempBuffer(&pBarText, nullptr, "%g %s", i * intervalMs * unitScale, pUnit);
+					pDraw->AddText(tickPos + ImVec2(5, 0), ImColor(style.BGTextColor), pBarText);
+				}
 			}
 		}
 
@@ -164,42 +1311,53 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 
 		// Add dark shade background for every even frame
 		int frameNr = 0;
-		URange cpuRange = gCPUProfiler.GetFrameRange();
-		for(uint32 i = cpuRange.Begin; i < cpuRange.End; ++i)
+		for(uint32 i = cpuRange.Begin; i < cpuRange.End && !source.GetThreads().empty(); ++i)
 		{
-			Span<const CPUProfiler::EventData::Event> events = gCPUProfiler.GetEventsForThread(gCPUProfiler.GetThreads()[0], i);
+			Span<const CPUProfiler::EventData::Event> events = source.GetEventsForThread(source.GetThreads()[0], i);
 			if (events.size() > 0 && frameNr++ % 2 == 0)
 			{
-				float beginOffset = (events[0].TicksBegin - beginAnchor) * TicksToPixels;
-				float endOffset = (events[0].TicksEnd - beginAnchor) * TicksToPixels;
-				pDraw->AddRectFilled(ImVec2(cursor.x + beginOffset, timelineRect.Min.y), ImVec2(cursor.x + endOffset, timelineRect.Max.y), ImColor(1.0f, 1.0f, 1.0f, 0.05f));
+				pDraw->AddRectFilled(ImVec2(TicksToX(events[0].TicksBegin), timelineRect.Min.y), ImVec2(TicksToX(events[0].TicksEnd), timelineRect.Max.y), ImColor(1.0f, 1.0f, 1.0f, 0.05f));
 			}
 		}
 
 		ImGui::PushClipRect(timelineRect.Min + ImVec2(0, style.BarHeight), timelineRect.Max, true);
 
+		// Time in view, with a margin of a few pixels as a bar is at least a pixel wide. Only the events overlapping it are drawn.
+		const float CullMargin = 2.0f;
+		uint64 visibleTicksBegin = beginAnchor + (uint64)ImMax(0.0, (timelineRect.Min.x - CullMargin - originX) / TicksToPixels);
+		uint64 visibleTicksEnd = beginAnchor + (uint64)ImMax(0.0, (timelineRect.Max.x + CullMargin - originX) / TicksToPixels) + 1;
+
+		// The depths of a track with rows in view, given the top of its first row
+		auto GetVisibleDepths = [&](float trackY, uint32 maxDepth) {
+			float clipMinY = timelineRect.Min.y + style.BarHeight;
+			uint32 first = (uint32)ImClamp((clipMinY - trackY) / style.BarHeight, 0.0f, (float)maxDepth);
+			uint32 last = (uint32)ImClamp((timelineRect.Max.y - trackY) / style.BarHeight + 1.0f, 0.0f, (float)maxDepth);
+			return URange(first, ImMax(first, last));
+		};
+
+		context.TimelineIndex.Update(source, cpuRange, source.GetGPUFrameRange());
+
 		// Common function to draw a single bar
 		/*
 			[=== SomeFunction (1.2 ms) ===]
 		*/
 		bool anyHovered = false;
-		auto DrawBar = [&](uint32 id, uint64 beginTicks, uint64 endTicks, uint32 depth, const char* pName, bool* pOutHovered = nullptr)
+		auto DrawBar = [&](ImGuiID id, uint64 beginTicks, uint64 endTicks, uint64 selfTicks, uint32 depth, const char* pName, ImColor nameColor, bool* pOutHovered = nullptr)
 		{
 			bool hovered = false;
 			if (endTicks > beginAnchor)
 			{
-				float startPos = (beginTicks < beginAnchor ? 0 : beginTicks - beginAnchor) * TicksToPixels;
-				float endPos = (endTicks - beginAnchor) * TicksToPixels;
-				float y = depth * style.BarHeight;
-				ImRect itemRect = ImRect(cursor + ImVec2(startPos, y), cursor + ImVec2(endPos, y + style.BarHeight));
+				float y = cursor.y + depth * style.BarHeight;
+				ImRect itemRect = ImRect(TicksToX(ImMax(beginTicks, beginAnchor)), y, TicksToX(endTicks), y + style.BarHeight);
 
 				// Ensure a bar always has a width
 				itemRect.Max.x = ImMax(itemRect.Max.x, itemRect.Min.x + 1);
 				if (ImGui::ItemAdd(itemRect, id, 0))
 				{
-					float ms = TicksToMs * (float)(endTicks - beginTicks);
+					double ms = (double)TicksToMs * (double)(endTicks - beginTicks);
 
-					ImColor color = ColorFromString(pName) * style.BarColorMultiplier;
+					ImColor color = style.ColorBySelfTime ? ColorFromSelfTime(TicksToMs * (float)selfTicks, style.SelfTimeMaxMs) : nameColor;
+					color = color * style.BarColorMultiplier;
 					ImColor textColor = style.FGTextColor;
 					// Fade out the bars that don't match the filter
 					if (context.SearchString[0] != 0 && !strstr(pName, context.SearchString))
@@ -207,11 +1365,6 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 						color.Value.w *= 0.3f;
 						textColor.Value.w *= 0.5f;
 					}
-					else if (context.PauseThreshold && ms >= context.PauseThresholdTime)
-					{
-						gCPUProfiler.SetPaused(true);
-						gGPUProfiler.SetPaused(true);
-					}
 
 					// Darken the bottom
 					ImColor colorBottom = color.Value * ImVec4(0.8f, 0.8f, 0.8f, 1.0f);
@@ -222,16 +1375,15 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					// If the bar is double-clicked, zoom in to make the bar fill the entire window
 					if (ImGui::ButtonBehavior(itemRect, ImGui::GetItemID(), nullptr, nullptr, ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_PressedOnDoubleClick))
 					{
-						// Zoom ration to make the bar fit the entire window
-						float zoom = timelineWidth / itemRect.GetWidth();
-						context.TimelineScale = zoom;
+						// Zoom ratio to make the bar fit the entire window. Computed from the ticks, as the rect of the bar is clamped to the view.
+						context.TimelineScale = ImClamp(ticksInTimeline / (double)ImMax(endTicks - beginTicks, (uint64)1), 1.0, maxScale);
 
 						// Recompute the timeline size with new zoom
-						float newTimelineWidth = timelineRect.GetWidth() * context.TimelineScale;
-						float newTickScale = newTimelineWidth / ticksInTimeline;
-						float newStartPos = newTickScale * (beginTicks - beginAnchor);
+						double newTimelineWidth = timelineRect.GetWidth() * context.TimelineScale;
+						double newTickScale = newTimelineWidth / ticksInTimeline;
+						double newStartPos = newTickScale * (double)(ImMax(beginTicks, beginAnchor) - beginAnchor);
 
-						context.TimelineOffset.x = -newStartPos;
+						context.TimelineOffsetX = -newStartPos;
 					}
 
 					// Draw the bar rect and outline if hovered
@@ -255,33 +1407,33 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					// If the bar size is large enough, draw the name of the bar on top
 					if (itemRect.GetWidth() > 10.0f)
 					{
-						const char* pBarText;
-						ImFormatStringToTempBuffer(&pBarText, nullptr, "%s (%.2f ms)", pName, ms);
-
-						ImVec2 textSize = ImGui::CalcTextSize(pBarText);
+						const TimelineLabelCache::Label& label = context.TimelineLabels.Get(pName);
+						float textHeight = ImGui::GetFontSize();
 						const char* pEtc = "...";
 						float etcWidth = 20.0f;
-						if (textSize.x < itemRect.GetWidth() * 0.9f)
-						{
-							pDraw->AddText(itemRect.Min + (ImVec2(itemRect.GetWidth(), style.BarHeight) - textSize) * 0.5f, textColor, pBarText);
-						}
-						else if (itemRect.GetWidth() > etcWidth + 10)
+
+						// The duration is only formatted if the name leaves room for it
+						bool isFullText = false;
+						if (label.GetWidth() < itemRect.GetWidth() * 0.9f)
 						{
-							const char* pChar = pBarText;
-							float currentOffset = 10;
-							while (*pChar++)
+							char durationText[48];
+							ImFormatString(durationText, ARRAYSIZE(durationText), " (%s)", FormatDuration(ms).Text);
+							float textWidth = label.GetWidth() + ImGui::CalcTextSize(durationText).x;
+							if (textWidth < itemRect.GetWidth() * 0.9f)
 							{
-								float width = ImGui::CalcTextSize(pChar, pChar + 1).x;
-								if (currentOffset + width + etcWidth > itemRect.GetWidth())
-									break;
-								currentOffset += width;
+								ImVec2 textPos = itemRect.Min + ImVec2(itemRect.GetWidth() - textWidth, style.BarHeight - textHeight) * 0.5f;
+								pDraw->AddText(textPos, textColor, pName);
+								pDraw->AddText(textPos + ImVec2(label.GetWidth(), 0), textColor, durationText);
+								isFullText = true;
 							}
+						}
 
-							float textWidth = ImGui::CalcTextSize(pBarText, pChar).x;
-
-							ImVec2 textPos = itemRect.Min + ImVec2(4, (style.BarHeight - textSize.y) * 0.5f);
-							pDraw->AddText(textPos, textColor, pBarText, pChar);
-							pDraw->AddText(textPos + ImVec2(textWidth, 0), textColor, pEtc);
+						if (!isFullText && itemRect.GetWidth() > etcWidth + 10)
+						{
+							uint32 length = label.GetFittingLength(itemRect.GetWidth() - 10.0f - etcWidth);
+							ImVec2 textPos = itemRect.Min + ImVec2(4, (style.BarHeight - textHeight) * 0.5f);
+							pDraw->AddText(textPos, textColor, pName, pName + length);
+							pDraw->AddText(textPos + ImVec2(label.PrefixWidths[length], 0), textColor, pEtc);
 						}
 					}
 				}
@@ -290,6 +1442,55 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 				*pOutHovered = hovered;
 		};
 
+		// Draw a run of short events as a single block, more opaque the more time is spent in the events
+		/*
+			[|||  |||||| |]
+		*/
+		auto DrawBlock = [&](const TimelineBlock& block, uint32 depth)
+		{
+			if (block.NumEvents == 0 || block.TicksEnd <= beginAnchor)
+				return;
+
+			float y = cursor.y + depth * style.BarHeight;
+			ImRect itemRect = ImRect(TicksToX(ImMax(block.TicksBegin, beginAnchor)), y, TicksToX(block.TicksEnd), y + style.BarHeight);
+			itemRect.Max.x = ImMax(itemRect.Max.x, itemRect.Min.x + 1);
+
+			float occupancy = ImSaturate((float)block.BusyTicks / (float)ImMax(block.TicksEnd - block.TicksBegin, (uint64)1));
+			ImColor color = style.BGTextColor * style.BarColorMultiplier;
+			color.Value.w *= 0.3f + 0.7f * occupancy;
+			pDraw->AddRectFilled(itemRect.Min + ImVec2(0, style.BarPadding), itemRect.Max - ImVec2(0, style.BarPadding), color);
+
+			if (!anyHovered && ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(itemRect.Min, itemRect.Max))
+			{
+				anyHovered = true;
+				pDraw->AddRect(itemRect.Min, itemRect.Max, ImColor(style.BarHighlightColor), 0.0f, ImDrawFlags_None, 2.0f);
+				if (ImGui::BeginTooltip())
+				{
+					ImGui::Text("%u events | %s", block.NumEvents, FormatDuration(TicksToMs * (double)(block.TicksEnd - block.TicksBegin)).Text);
+					ImGui::Text("Busy: %s (%.0f%%)", FormatDuration(TicksToMs * (double)block.BusyTicks).Text, occupancy * 100.0f);
+					ImGui::TextColored(style.BGTextColor, "Zoom in to see the events");
+					ImGui::EndTooltip();
+				}
+			}
+		};
+
+		// Add a merged span to the pending block of a depth. Spans which touch on screen are drawn as one block.
+		auto AddToBlock = [&](TimelineBlock& block, uint32 depth, uint64 ticksBegin, uint64 ticksEnd, uint64 busyTicks, uint32 numEvents)
+		{
+			if (block.NumEvents > 0 && (double)(ticksBegin - block.TicksEnd) * TicksToPixels < 1.0)
+			{
+				block.TicksEnd = ticksEnd;
+				block.BusyTicks += busyTicks;
+				block.NumEvents += numEvents;
+				return;
+			}
+			DrawBlock(block, depth);
+			block = { ticksBegin, ticksEnd, busyTicks, numEvents };
+		};
+
+		// Events shorter than this are merged
+		uint64 mergeTicks = (uint64)(style.MergeWidth / TicksToPixels);
+
 		// Add track name and expander
 		/*
 			(>) Main Thread [1234]
@@ -320,47 +1521,64 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		};
 
 		{
-			URange gpuRange = gGPUProfiler.GetFrameRange();
-			for (const GPUProfiler::QueueInfo& queue : gGPUProfiler.GetQueues())
+			URange gpuRange = source.GetGPUFrameRange();
+			Span<const GPUProfiler::QueueInfo> queues = source.GetQueues();
+			for (uint32 queueIndex = 0; queueIndex < (uint32)queues.size(); ++queueIndex)
 			{
 				// Add thread name for track
-				bool isOpen = TrackHeader(queue.Name, ImGui::GetID(&queue));
+				const GPUProfiler::QueueInfo& queue = queues[queueIndex];
+				ImGuiID trackID = ImGui::GetID(&queue);
+				bool isOpen = TrackHeader(queue.Name, trackID);
 				uint32 maxDepth = isOpen ? style.MaxDepth : 1;
 				uint32 trackDepth = 1;
 				cursor.y += style.BarHeight;
 
+				URange visibleDepths = GetVisibleDepths(cursor.y, maxDepth);
+				auto GpuToCpuTicks = [&](uint64 ticks) { return queue.GpuToCpuTicks(ticks); };
 				for (uint32 i = gpuRange.Begin; i < gpuRange.End; ++i)
 				{
-					// Add a bar in the right place for each event
+					const TimelineTrackIndex* pIndex = context.TimelineIndex.FindGPUTrack(i, queueIndex);
+					if (!pIndex)
+						continue;
+					trackDepth = ImMax(trackDepth, ImMin(pIndex->GetNumDepths(), maxDepth));
+
+					// Add a bar in the right place for each event in view
 					/*
 						|[=============]			|
 						|	[======]				|
 					*/
-					Span<const GPUProfiler::EventData::Event> events = gGPUProfiler.GetEventsForQueue(queue, i);
-					for (const GPUProfiler::EventData::Event& event : events)
+					Span<const GPUProfiler::EventData::Event> events = source.GetEventsForQueue(queue, i);
+					auto DrawEvent = [&](uint32 eventIndex)
 					{
-						// Skip events above the max depth
-						if ((int)event.Depth >= maxDepth)
-							continue;
-
-						trackDepth = ImMax(trackDepth, (uint32)event.Depth + 1);
-
+						const GPUProfiler::EventData::Event& event = events[eventIndex];
 						uint64 cpuBeginTicks = queue.GpuToCpuTicks(event.TicksBegin);
 						uint64 cpuEndTicks = queue.GpuToCpuTicks(event.TicksEnd);
+						uint64 cpuSelfTicks = queue.GpuToCpuTicks(event.TicksBegin + event.SelfTicks) - cpuBeginTicks;
 
+						const TimelineSiteCache::Site& site = context.TimelineSites.Get(event.SiteIndex, event.pName);
 						bool hovered;
-						DrawBar(ImGui::GetID(&event), cpuBeginTicks, cpuEndTicks, event.Depth, event.pName, &hovered);
+						DrawBar(GetBarID(site.ID, trackID, i, eventIndex), cpuBeginTicks, cpuEndTicks, cpuSelfTicks, event.Depth, event.pName, site.Color, &hovered);
 						if (hovered)
 						{
 							if (ImGui::BeginTooltip())
 							{
-								ImGui::Text("%s | %.3f ms", event.pName, TicksToMs * (float)(cpuEndTicks - cpuBeginTicks));
+								ImGui::Text("%s | %s", event.pName, FormatDuration(TicksToMs * (double)(cpuEndTicks - cpuBeginTicks)).Text);
+								ImGui::Text("Self: %s", FormatDuration(TicksToMs * (double)cpuSelfTicks).Text);
 								ImGui::Text("Frame %d", i);
 								if (event.pFilePath)
 									ImGui::Text("%s:%d", event.pFilePath, event.LineNumber);
 								ImGui::EndTooltip();
 							}
 						}
+					};
+
+					for (uint32 depth = visibleDepths.Begin; depth < visibleDepths.End; ++depth)
+					{
+						TimelineBlock block;
+						pIndex->VisitEvents(events, depth, visibleTicksBegin, visibleTicksEnd, mergeTicks, GpuToCpuTicks,
+							[&](uint32 eventIndex) { DrawBlock(block, depth); block = TimelineBlock(); DrawEvent(eventIndex); },
+							[&](uint64 ticksBegin, uint64 ticksEnd, uint64 busyTicks, uint32 numEvents) { AddToBlock(block, depth, ticksBegin, ticksEnd, busyTicks, numEvents); });
+						DrawBlock(block, depth);
 					}
 				}
 
@@ -374,48 +1592,99 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		pDraw->AddLine(ImVec2(timelineRect.Min.x, cursor.y), ImVec2(timelineRect.Max.x, cursor.y), ImColor(style.BGTextColor), 4);
 
 		// Draw each CPU thread track
-		Span<const CPUProfiler::ThreadData> threads = gCPUProfiler.GetThreads();
+		Span<const CPUProfiler::ThreadData> threads = source.GetThreads();
+		if (style.ShowCriticalPath)
+			context.CriticalPaths.Update(source, cpuRange);
+		else
+			context.CriticalPaths.Update(source, URange(0, 0));
+
 		for (uint32 threadIndex = 0; threadIndex < (uint32)threads.size(); ++threadIndex)
 		{
 			// Add thread name for track
 			const CPUProfiler::ThreadData& thread = threads[threadIndex];
 			const char* pHeaderText;
 			ImFormatStringToTempBuffer(&pHeaderText, nullptr, "%s [%d]", thread.Name, thread.ThreadID);
-			bool isOpen = TrackHeader(pHeaderText, ImGui::GetID(&thread));
+			ImGuiID trackID = ImGui::GetID(&thread);
+			bool isOpen = TrackHeader(pHeaderText, trackID);
 
 			uint32 maxDepth = isOpen ? style.MaxDepth : 1;
 			uint32 trackDepth = 1;
 			cursor.y += style.BarHeight;
 
-			// Add a bar in the right place for each event
+			// Add a bar in the right place for each event in view
 			/*
 				|[=============]			|
 				|	[======]				|
 			*/
+			URange visibleDepths = GetVisibleDepths(cursor.y, maxDepth);
+			auto CpuTicks = [](uint64 ticks) { return ticks; };
 			for (uint32 frameIndex = cpuRange.Begin; frameIndex < cpuRange.End; ++frameIndex)
 			{
-				Span<const CPUProfiler::EventData::Event> events = gCPUProfiler.GetEventsForThread(thread, frameIndex);
-				for (const CPUProfiler::EventData::Event& event : events)
-				{
-					// Skip events above the max depth
-					if (event.Depth >= maxDepth)
-						continue;
+				const TimelineTrackIndex* pIndex = context.TimelineIndex.FindCPUTrack(frameIndex, threadIndex);
+				if (!pIndex)
+					continue;
+				trackDepth = ImMax(trackDepth, ImMin(pIndex->GetNumDepths(), maxDepth));
+
+				const CriticalPathCache::Frame* pPath = style.ShowCriticalPath ? context.CriticalPaths.Find(frameIndex) : nullptr;
+				if (pPath && threadIndex >= pPath->FirstEvents.size())
+					pPath = nullptr;
 
-					trackDepth = ImMax(trackDepth, (uint32)event.Depth + 1);
+				Span<const CPUProfiler::EventData::Event> events = source.GetEventsForThread(thread, frameIndex);
+				auto DrawEvent = [&](uint32 eventIndex)
+				{
+					const CPUProfiler::EventData::Event& event = events[eventIndex];
 
+					const TimelineSiteCache::Site& site = context.TimelineSites.Get(event.SiteIndex, event.pName);
 					bool hovered;
-					DrawBar(ImGui::GetID(&event), event.TicksBegin, event.TicksEnd, event.Depth, event.pName, &hovered);
+					DrawBar(GetBarID(site.ID, trackID, frameIndex, eventIndex), event.TicksBegin, event.TicksEnd, event.SelfTicks, event.Depth, event.pName, site.Color, &hovered);
 					if (hovered)
 					{
 						if (ImGui::BeginTooltip())
 						{
-							ImGui::Text("%s | %.3f ms", event.pName, TicksToMs * (float)(event.TicksEnd - event.TicksBegin));
+							ImGui::Text("%s | %s", event.pName, FormatDuration(TicksToMs * (double)(event.TicksEnd - event.TicksBegin)).Text);
+							ImGui::Text("Self: %s", FormatDuration(TicksToMs * (double)event.SelfTicks).Text);
 							ImGui::Text("Frame %d", frameIndex);
+							if (pPath)
+							{
+								uint32 pathEventIndex = pPath->FirstEvents[threadIndex] + eventIndex;
+								if (IsWaitScopeName(event.pName))
+									ImGui::TextColored(style.BGTextColor, "Waiting for other threads");
+								else if (pPath->Path.IsOnPath(pathEventIndex))
+									ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.1f, 1.0f), "On the critical path");
+								else
+									ImGui::Text("Slack: %s", FormatDuration(TicksToMs * (double)pPath->Path.GetSlackTicks(pathEventIndex)).Text);
+							}
 							if (event.pFilePath)
 								ImGui::Text("%s:%d", event.pFilePath, event.LineNumber);
 							ImGui::EndTooltip();
 						}
 					}
+				};
+
+				for (uint32 depth = visibleDepths.Begin; depth < visibleDepths.End; ++depth)
+				{
+					TimelineBlock block;
+					pIndex->VisitEvents(events, depth, visibleTicksBegin, visibleTicksEnd, mergeTicks, CpuTicks,
+						[&](uint32 eventIndex) { DrawBlock(block, depth); block = TimelineBlock(); DrawEvent(eventIndex); },
+						[&](uint64 ticksBegin, uint64 ticksEnd, uint64 busyTicks, uint32 numEvents) { AddToBlock(block, depth, ticksBegin, ticksEnd, busyTicks, numEvents); });
+					DrawBlock(block, depth);
+				}
+
+				// Outline the parts of the critical path on this thread, on top of the bars
+				if (pPath)
+				{
+					for (const CriticalPath::Segment& segment : pPath->Path.GetSegments())
+					{
+						if (segment.TrackIndex != threadIndex || segment.TicksEnd <= ImMax(beginAnchor, visibleTicksBegin) || segment.TicksBegin >= visibleTicksEnd)
+							continue;
+						float startX = TicksToX(ImMax(segment.TicksBegin, beginAnchor));
+						float endX = TicksToX(segment.TicksEnd);
+						float y = cursor.y + ImMin(segment.Depth, maxDepth - 1) * style.BarHeight;
+						ImVec2 segmentMin = ImVec2(startX, y);
+						ImVec2 segmentMax = ImVec2(ImMax(endX, startX + 1), y + style.BarHeight);
+						pDraw->AddRectFilled(segmentMin, segmentMax, ImColor(1.0f, 0.6f, 0.1f, 0.35f));
+						pDraw->AddLine(ImVec2(segmentMin.x, segmentMax.y - 1), ImVec2(segmentMax.x, segmentMax.y - 1), ImColor(1.0f, 0.6f, 0.1f, 1.0f), 2.0f);
+					}
 				}
 			}
 
@@ -455,7 +1724,7 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					float opacity = ImClamp(distance / 30.0f, 0.0f, 1.0f);
 					if (opacity > 0.0f)
 					{
-						float time = (distance / TicksToPixels) * TicksToMs;
+						double time = (distance / TicksToPixels) * TicksToMs;
 
 						// Draw measure region
 						pDraw->AddRectFilled(ImVec2(context.RangeSelectionStart, timelineRect.Min.y), ImVec2(ImGui::GetMousePos().x, timelineRect.Max.y), ImColor(1.0f, 1.0f, 1.0f, 0.1f));
@@ -477,7 +1746,7 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 
 						// Add text in the middle
 						const char* pTimeText;
-						ImFormatStringToTempBuffer(&pTimeText, nullptr, "Time: %.3f ms", time);
+						ImFormatStringToTempBuffer(&pTimeText, nullptr, "Time: %s", FormatDuration(time).Text);
 						ImVec2 textSize = ImGui::CalcTextSize(pTimeText);
 						pDraw->AddText((lineEnd + lineStart) / 2 - ImVec2(textSize.x * 0.5f, textSize.y), measureColor, pTimeText);
 					}
@@ -492,14 +1761,14 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 			if (zoomDelta != 0)
 			{
 				// Logarithmic scale
-				float logScale = logf(context.TimelineScale);
+				double logScale = log(context.TimelineScale);
 				logScale += zoomDelta;
-				float newScale = ImClamp(expf(logScale), 1.0f, 100.0f);
+				double newScale = ImClamp(exp(logScale), 1.0, maxScale);
 
-				float scaleFactor = newScale / context.TimelineScale;
+				double scaleFactor = newScale / context.TimelineScale;
 				context.TimelineScale *= scaleFactor;
-				ImVec2 mousePos = ImGui::GetMousePos() - timelineRect.Min;
-				context.TimelineOffset.x = mousePos.x - (mousePos.x - context.TimelineOffset.x) * scaleFactor;
+				double mouseX = ImGui::GetMousePos().x - timelineRect.Min.x;
+				context.TimelineOffsetX = mouseX - (mouseX - context.TimelineOffsetX) * scaleFactor;
 			}
 		}
 
@@ -507,11 +1776,15 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		bool held;
 		ImGui::ButtonBehavior(timelineRect, timelineID, nullptr, &held, ImGuiButtonFlags_MouseButtonRight);
 		if (held)
-			context.TimelineOffset += ImGui::GetIO().MouseDelta;
+		{
+			context.TimelineOffsetX += ImGui::GetIO().MouseDelta.x;
+			context.TimelineOffsetY += ImGui::GetIO().MouseDelta.y;
+		}
 
 		// Compute the new timeline size to correctly clamp the offset
 		timelineWidth = timelineRect.GetWidth() * context.TimelineScale;
-		context.TimelineOffset = ImClamp(context.TimelineOffset, ImMin(ImVec2(0.0f, 0.0f), timelineRect.GetSize() - ImVec2(timelineWidth, timelineHeight)), ImVec2(0.0f, 0.0f));
+		context.TimelineOffsetX = ImClamp(context.TimelineOffsetX, ImMin(0.0, timelineRect.GetWidth() - timelineWidth), 0.0);
+		context.TimelineOffsetY = ImClamp(context.TimelineOffsetY, ImMin(0.0f, timelineRect.GetHeight() - timelineHeight), 0.0f);
 
 		ImGui::PopClipRect();
 		ImGui::PopClipRect();
@@ -520,20 +1793,521 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 		if (style.DebugMode)
 		{
 			pDraw->PushClipRectFullScreen();
-			pDraw->AddRect(cursorStart, cursorStart + ImVec2(timelineWidth, timelineHeight), ImColor(1.0f, 0.0f, 0.0f), 0.0f, ImDrawFlags_None, 3.0f);
+			ImVec2 timelineMin = ImVec2((float)(timelineRect.Min.x + context.TimelineOffsetX), cursorStart.y);
+			pDraw->AddRect(timelineMin, timelineMin + ImVec2((float)timelineWidth, timelineHeight), ImColor(1.0f, 0.0f, 0.0f), 0.0f, ImDrawFlags_None, 3.0f);
 			pDraw->AddRect(timelineRect.Min, timelineRect.Max, ImColor(0.0f, 1.0f, 0.0f), 0.0f, ImDrawFlags_None, 2.0f);
 			pDraw->PopClipRect();
 		}
 
-		// Horizontal scroll bar
-		ImS64 scrollH = -(ImS64)context.TimelineOffset.x;
+		// Horizontal scroll bar. Scrolls in whole pixels, so the offset is only replaced when the bar is dragged.
+		ImS64 scrollH = -(ImS64)context.TimelineOffsetX;
+		ImS64 oldScrollH = scrollH;
 		ImGui::ScrollbarEx(ImRect(ImVec2(timelineRect.Min.x, timelineRect.Max.y), ImVec2(timelineRect.Max.x + style.ScrollBarSize, timelineRect.Max.y + style.ScrollBarSize)), ImGui::GetID("ScrollH"), ImGuiAxis_X, &scrollH, (ImS64)timelineRect.GetSize().x, (ImS64)timelineWidth, ImDrawFlags_None);
-		context.TimelineOffset.x = -(float)scrollH;
+		if (scrollH != oldScrollH)
+			context.TimelineOffsetX = -(double)scrollH;
 
 		// Vertical scroll bar
-		ImS64 scrollV = -(ImS64)context.TimelineOffset.y;
+		ImS64 scrollV = -(ImS64)context.TimelineOffsetY;
 		ImGui::ScrollbarEx(ImRect(ImVec2(timelineRect.Max.x, timelineRect.Min.y), ImVec2(timelineRect.Max.x + style.ScrollBarSize, timelineRect.Max.y)), ImGui::GetID("ScrollV"), ImGuiAxis_Y, &scrollV, (ImS64)timelineRect.GetSize().y, (ImS64)timelineHeight, ImDrawFlags_None);
-		context.TimelineOffset.y = -(float)scrollV;
+		context.TimelineOffsetY = -(float)scrollV;
+	}
+}
+
+// Distribution of the call durations of a site. Buckets are log-linear, so the x axis is logarithmic.
+static void DrawHistogramPlot(const ProfilerHistogram& histogram, float ticksToMs, const ImVec2& size)
+{
+	constexpr uint32 MaxBars = 128;
+	uint32 firstBucket = histogram.GetFirstBucket();
+	uint32 numBuckets = histogram.GetEndBucket() - firstBucket;
+	uint32 bucketsPerBar = ImMax((numBuckets + MaxBars - 1) / MaxBars, 1u);
+	uint32 numBars = (numBuckets + bucketsPerBar - 1) / bucketsPerBar;
+
+	float bars[MaxBars]{};
+	for (uint32 i = 0; i < numBuckets; ++i)
+		bars[i / bucketsPerBar] += (float)histogram.GetBucketCount(firstBucket + i);
+
+	const double percentiles[] = { 50.0, 99.0, 99.9 };
+	char overlay[128];
+	ImFormatString(overlay, ARRAYSIZE(overlay), "p50 %.3f ms   p99 %.3f ms   p99.9 %.3f ms",
+		histogram.GetPercentile(percentiles[0]) * ticksToMs, histogram.GetPercentile(percentiles[1]) * ticksToMs, histogram.GetPercentile(percentiles[2]) * ticksToMs);
+	ImGui::PlotHistogram("##Distribution", bars, (int)numBars, 0, overlay, 0.0f, FLT_MAX, size);
+
+	// Mark the percentiles
+	ImRect rect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
+	ImDrawList* pDraw = ImGui::GetWindowDrawList();
+	for (double percentile : percentiles)
+	{
+		uint32 bucketIndex = ProfilerHistogram::GetBucketIndex(histogram.GetPercentile(percentile));
+		float x = rect.Min.x + rect.GetWidth() * ((float)(bucketIndex - firstBucket) + 0.5f) / (float)(numBars * bucketsPerBar);
+		pDraw->AddLine(ImVec2(x, rect.Min.y), ImVec2(x, rect.Max.y), ImColor(1.0f, 0.3f, 0.3f, 0.8f));
+	}
+
+	ImGui::Text("%.3f ms", histogram.GetMin() * ticksToMs);
+	ImGui::SameLine(ImMax(rect.GetWidth() - 80.0f, 0.0f));
+	ImGui::Text("%.3f ms", histogram.GetMax() * ticksToMs);
+}
+
+// Table of the statistics per site of the live CPU profiler
+static void DrawStatisticsTable()
+{
+	HUDContext& context = Context();
+	const ProfilerStatistics& statistics = gCPUProfiler.GetStatistics();
+	const ProfilerSiteTable& sites = gCPUProfiler.GetSiteTable();
+	Span<const uint32> windows = statistics.GetWindows();
+
+	// Select the range of frames
+	auto GetRangeName = [&](int range, char* pBuffer, int bufferSize) {
+		if (range == 0)
+			ImFormatString(pBuffer, bufferSize, "History");
+		else
+			ImFormatString(pBuffer, bufferSize, "Last %d frames", windows[range - 1]);
+	};
+	context.StatisticsRange = ImClamp(context.StatisticsRange, 0, (int)windows.size());
+	char rangeName[64];
+	GetRangeName(context.StatisticsRange, rangeName, ARRAYSIZE(rangeName));
+	ImGui::SetNextItemWidth(200);
+	if (ImGui::BeginCombo("Frames", rangeName))
+	{
+		for (int range = 0; range <= (int)windows.size(); ++range)
+		{
+			GetRangeName(range, rangeName, ARRAYSIZE(rangeName));
+			if (ImGui::Selectable(rangeName, range == context.StatisticsRange))
+				context.StatisticsRange = range;
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::SameLine();
+	ImGui::Text("%d frames", statistics.GetNumFrames());
+
+	// Histogram of the call durations in the selected range
+	static ProfilerHistogram windowHistogram;
+	auto GetHistogram = [&](uint32 siteIndex) -> const ProfilerHistogram* {
+		if (context.StatisticsRange == 0)
+			return statistics.GetHistoryHistogram(siteIndex);
+		return statistics.GetWindowHistogram(context.StatisticsRange - 1, siteIndex, windowHistogram) ? &windowHistogram : nullptr;
+	};
+
+	struct Row
+	{
+		uint32 SiteIndex;
+		ProfilerSiteStats Stats;
+		uint64 Percentiles[3];		// p50, p99 and p99.9 of the call duration
+	};
+	static std::vector<Row> rows;
+	rows.clear();
+	for (uint32 siteIndex = 0; siteIndex < statistics.GetNumSites(); ++siteIndex)
+	{
+		if (context.SearchString[0] != 0 && !strstr(sites.GetSite(siteIndex).pName, context.SearchString))
+			continue;
+
+		Row row;
+		row.SiteIndex = siteIndex;
+		bool isSeen = context.StatisticsRange == 0 ?
+			statistics.GetHistoryStats(siteIndex, row.Stats) :
+			statistics.GetWindowStats(context.StatisticsRange - 1, siteIndex, row.Stats);
+		if (!isSeen)
+			continue;
+
+		const ProfilerHistogram* pHistogram = GetHistogram(siteIndex);
+		row.Percentiles[0] = pHistogram ? pHistogram->GetPercentile(50.0) : 0;
+		row.Percentiles[1] = pHistogram ? pHistogram->GetPercentile(99.0) : 0;
+		row.Percentiles[2] = pHistogram ? pHistogram->GetPercentile(99.9) : 0;
+		rows.push_back(row);
+	}
+
+	enum Column
+	{
+		Column_Name,
+		Column_CallsPerFrame,
+		Column_Mean,
+		Column_SelfMean,
+		Column_Min,
+		Column_Max,
+		Column_StdDev,
+		Column_Total,
+		Column_P50,
+		Column_P99,
+		Column_P999,
+		Column_Count,
+	};
+
+	// Leave room for the distribution of the selected site
+	const ProfilerHistogram* pSelectedHistogram = context.StatisticsSite != ~0u ? GetHistogram(context.StatisticsSite) : nullptr;
+	float plotHeight = 100.0f;
+	float tableHeight = pSelectedHistogram ? -(plotHeight + ImGui::GetFrameHeightWithSpacing() * 2) : 0.0f;
+
+	ImGuiTableFlags tableFlags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersV;
+	if (!ImGui::BeginTable("Statistics", Column_Count, tableFlags, ImVec2(0, tableHeight)))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch, 0.0f, Column_Name);
+	ImGui::TableSetupColumn("Calls/frame", ImGuiTableColumnFlags_WidthFixed, 0.0f, Column_CallsPerFrame);
+	ImGui::TableSetupColumn("Mean (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_Mean);
+	ImGui::TableSetupColumn("Self mean (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_SelfMean);
+	ImGui::TableSetupColumn("Min (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_Min);
+	ImGui::TableSetupColumn("Max (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_Max);
+	ImGui::TableSetupColumn("Std dev (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_StdDev);
+	ImGui::TableSetupColumn("Total (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_Total);
+	ImGui::TableSetupColumn("Call p50 (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_P50);
+	ImGui::TableSetupColumn("Call p99 (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_P99);
+	ImGui::TableSetupColumn("Call p99.9 (ms)", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, Column_P999);
+	ImGui::TableHeadersRow();
+
+	// The statistics change every frame, so the rows are sorted every frame
+	if (ImGuiTableSortSpecs* pSortSpecs = ImGui::TableGetSortSpecs())
+	{
+		if (pSortSpecs->SpecsCount > 0)
+		{
+			const ImGuiTableColumnSortSpecs& spec = pSortSpecs->Specs[0];
+			auto GetKey = [&](const Row& row) -> double {
+				switch (spec.ColumnUserID)
+				{
+				case Column_CallsPerFrame:	return row.Stats.GetCallsPerFrame();
+				case Column_Mean:			return row.Stats.MeanTicks;
+				case Column_SelfMean:		return row.Stats.GetMeanSelfTicks();
+				case Column_Min:			return (double)row.Stats.MinTicks;
+				case Column_Max:			return (double)row.Stats.MaxTicks;
+				case Column_StdDev:			return row.Stats.VarianceTicks;
+				case Column_Total:			return (double)row.Stats.TotalTicks;
+				case Column_P50:			return (double)row.Percentiles[0];
+				case Column_P99:			return (double)row.Percentiles[1];
+				case Column_P999:			return (double)row.Percentiles[2];
+				default:					return 0.0;
+				}
+			};
+			std::sort(rows.begin(), rows.end(), [&](const Row& a, const Row& b) {
+				const Row& lhs = spec.SortDirection == ImGuiSortDirection_Ascending ? a : b;
+				const Row& rhs = spec.SortDirection == ImGuiSortDirection_Ascending ? b : a;
+				if (spec.ColumnUserID == Column_Name)
+					return strcmp(sites.GetSite(lhs.SiteIndex).pName, sites.GetSite(rhs.SiteIndex).pName) < 0;
+				return GetKey(lhs) < GetKey(rhs);
+			});
+		}
+		pSortSpecs->SpecsDirty = false;
+	}
+
+	float ticksToMs = 1000.0f / context.LiveSource.GetTicksPerSecond();
+	ImGuiListClipper clipper;
+	clipper.Begin((int)rows.size());
+	while (clipper.Step())
+	{
+		for (int rowIndex = clipper.DisplayStart; rowIndex < clipper.DisplayEnd; ++rowIndex)
+		{
+			const Row& row = rows[rowIndex];
+			const ProfilerSite& site = sites.GetSite(row.SiteIndex);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable(site.pName, row.SiteIndex == context.StatisticsSite, ImGuiSelectableFlags_SpanAllColumns))
+				context.StatisticsSite = row.SiteIndex == context.StatisticsSite ? ~0u : row.SiteIndex;
+			if (site.pFilePath && ImGui::IsItemHovered())
+				ImGui::SetTooltip("%s:%d", site.pFilePath, site.LineNumber);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", row.Stats.GetCallsPerFrame());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", row.Stats.MeanTicks * ticksToMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", row.Stats.GetMeanSelfTicks() * ticksToMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", row.Stats.MinTicks * ticksToMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", row.Stats.MaxTicks * ticksToMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", row.Stats.GetStdDevTicks() * ticksToMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", row.Stats.TotalTicks * ticksToMs);
+			for (uint64 percentile : row.Percentiles)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", percentile * ticksToMs);
+			}
+		}
+	}
+	ImGui::EndTable();
+
+	if (pSelectedHistogram && pSelectedHistogram->GetCount() > 0)
+	{
+		ImGui::Text("%s: %llu calls", sites.GetSite(context.StatisticsSite).pName, (unsigned long long)pSelectedHistogram->GetCount());
+		DrawHistogramPlot(*pSelectedHistogram, ticksToMs, ImVec2(ImGui::GetContentRegionAvail().x, plotHeight));
+	}
+}
+
+// The source drawn by the timeline
+static const TimelineSource& GetActiveSource()
+{
+	HUDContext& context = Context();
+	if (context.CaptureSource.IsOpen())
+		return context.CaptureSource;
+	if (context.RemoteSource.IsOpen())
+		return context.RemoteSource;
+	return context.LiveSource;
+}
+
+// Frame time graph of the frame summaries of the live CPU profiler.
+// Each column shows the worst frame of the frames it covers. Frames which still have their full events can be shown in the timeline.
+static void DrawFrameHistory()
+{
+	HUDContext& context = Context();
+	const ProfilerFrameSummaries& summaries = gCPUProfiler.GetFrameSummaries();
+	const ProfilerSiteTable& sites = gCPUProfiler.GetSiteTable();
+	URange summaryRange = summaries.GetFrameRange();
+	URange fullRange = gCPUProfiler.GetFrameRange();
+
+	// Select the range of frames
+	const uint32 rangeSizes[] = { 1000, 10000, 100000, 0 };
+	auto GetRangeName = [&](int range, char* pBuffer, size_t bufferSize) {
+		if (rangeSizes[range] == 0)
+			ImFormatString(pBuffer, bufferSize, "All frames");
+		else
+			ImFormatString(pBuffer, bufferSize, "Last %u frames", rangeSizes[range]);
+	};
+	char rangeName[64];
+	GetRangeName(context.FrameHistoryRange, rangeName, ARRAYSIZE(rangeName));
+	ImGui::SetNextItemWidth(200);
+	if (ImGui::BeginCombo("Range", rangeName))
+	{
+		for (int range = 0; range < (int)ARRAYSIZE(rangeSizes); ++range)
+		{
+			GetRangeName(range, rangeName, ARRAYSIZE(rangeName));
+			if (ImGui::Selectable(rangeName, range == context.FrameHistoryRange))
+				context.FrameHistoryRange = range;
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::SameLine();
+	ImGui::Text("%u frames summarized (%.1f MB), last %u with full events", summaryRange.End - summaryRange.Begin,
+		(float)summaries.GetMemorySize() / (1024 * 1024), fullRange.End - fullRange.Begin);
+
+	URange frames = summaryRange;
+	uint32 rangeSize = rangeSizes[context.FrameHistoryRange];
+	if (rangeSize != 0 && frames.End - frames.Begin > rangeSize)
+		frames.Begin = frames.End - rangeSize;
+
+	ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, ImMax(ImGui::GetContentRegionAvail().y, 50.0f));
+	ImRect rect(ImGui::GetCursorScreenPos(), ImGui::GetCursorScreenPos() + size);
+	ImGui::ItemSize(rect);
+	if (!ImGui::ItemAdd(rect, ImGui::GetID("FrameHistory")))
+		return;
+
+	ImDrawList* pDraw = ImGui::GetWindowDrawList();
+	pDraw->AddRectFilled(rect.Min, rect.Max, ImColor(0.0f, 0.0f, 0.0f, 0.3f));
+	uint32 numFrames = frames.End - frames.Begin;
+	if (numFrames == 0)
+		return;
+
+	// Each column shows the worst frame of the frames it covers
+	uint32 numColumns = ImMin(numFrames, (uint32)ImMax(rect.GetWidth(), 1.0f));
+	uint32 framesPerColumn = (numFrames + numColumns - 1) / numColumns;
+	numColumns = (numFrames + framesPerColumn - 1) / framesPerColumn;
+	static std::vector<uint32> worstFrames;
+	worstFrames.resize(numColumns);
+	uint64 maxTicks = 1;
+	for (uint32 column = 0; column < numColumns; ++column)
+	{
+		uint32 worstFrame = frames.Begin + column * framesPerColumn;
+		uint32 columnEnd = ImMin(worstFrame + framesPerColumn, frames.End);
+		for (uint32 frame = worstFrame + 1; frame < columnEnd; ++frame)
+		{
+			if (summaries.GetFrameTicks(frame) > summaries.GetFrameTicks(worstFrame))
+				worstFrame = frame;
+		}
+		worstFrames[column] = worstFrame;
+		maxTicks = ImMax(maxTicks, summaries.GetFrameTicks(worstFrame));
+	}
+
+	float ticksToMs = 1000.0f / context.LiveSource.GetTicksPerSecond();
+	float maxMs = maxTicks * ticksToMs * 1.1f;
+	float columnWidth = rect.GetWidth() / numColumns;
+	auto IsFullFrame = [&](uint32 frame) { return frame >= fullRange.Begin && frame < fullRange.End; };
+
+	// Mark the frame times of 60 and 30 fps
+	for (float targetMs : { 1000.0f / 60.0f, 1000.0f / 30.0f })
+	{
+		if (targetMs > maxMs)
+			continue;
+		float y = rect.Max.y - rect.GetHeight() * targetMs / maxMs;
+		pDraw->AddLine(ImVec2(rect.Min.x, y), ImVec2(rect.Max.x, y), ImColor(context.Style.BGTextColor));
+		const char* pText;
+		ImFormatStringToTempBuffer(&pText, nullptr, "%.1f ms", targetMs);
+		pDraw->AddText(ImVec2(rect.Min.x + 4, y - ImGui::GetTextLineHeight()), ImColor(context.Style.BGTextColor), pText);
+	}
+
+	int hoveredColumn = ImGui::IsItemHovered() ? (int)((ImGui::GetMousePos().x - rect.Min.x) / columnWidth) : -1;
+	for (uint32 column = 0; column < numColumns; ++column)
+	{
+		uint32 frame = worstFrames[column];
+		float ms = summaries.GetFrameTicks(frame) * ticksToMs;
+		float x = rect.Min.x + column * columnWidth;
+		ImColor color = IsFullFrame(frame) ? ImColor(0.3f, 0.7f, 1.0f) : ImColor(0.4f, 0.6f, 0.4f);
+		if ((int)column == hoveredColumn)
+			color.Value = color.Value * ImVec4(1.5f, 1.5f, 1.5f, 1.0f);
+		pDraw->AddRectFilled(ImVec2(x, rect.Max.y - rect.GetHeight() * ms / maxMs), ImVec2(x + ImMax(columnWidth - 1.0f, 1.0f), rect.Max.y), color);
+	}
+
+	// Mark the columns with outliers above their bar
+	const ProfilerOutlierDetector& outliers = gCPUProfiler.GetOutliers();
+	auto GetColumnFrames = [&](uint32 column) { return URange(frames.Begin + column * framesPerColumn, ImMin(frames.Begin + (column + 1) * framesPerColumn, frames.End)); };
+	for (uint32 column = 0; column < numColumns; ++column)
+	{
+		URange outlierRange = outliers.FindOutliers(GetColumnFrames(column));
+		if (outlierRange.Begin == outlierRange.End)
+			continue;
+		float ms = summaries.GetFrameTicks(worstFrames[column]) * ticksToMs;
+		ImVec2 tip(rect.Min.x + (column + 0.5f) * columnWidth, rect.Max.y - rect.GetHeight() * ms / maxMs - 2.0f);
+		pDraw->AddTriangleFilled(tip, tip + ImVec2(-4.0f, -6.0f), tip + ImVec2(4.0f, -6.0f), ImColor(1.0f, 0.3f, 0.2f));
+	}
+
+	if (hoveredColumn >= 0 && hoveredColumn < (int)numColumns)
+	{
+		uint32 frame = worstFrames[hoveredColumn];
+		bool isFullFrame = IsFullFrame(frame);
+		if (ImGui::BeginTooltip())
+		{
+			ImGui::Text("Frame %u | %.3f ms", frame, summaries.GetFrameTicks(frame) * ticksToMs);
+			if (framesPerColumn > 1)
+				ImGui::TextColored(context.Style.BGTextColor, "Worst of frames %u - %u", frames.Begin + hoveredColumn * framesPerColumn, ImMin(frames.Begin + (hoveredColumn + 1) * framesPerColumn, frames.End) - 1);
+			ImGui::Separator();
+
+			ProfilerFrameSummaries::SiteTime topSites[16];
+			uint32 numSites = summaries.GetTopSites(frame, topSites);
+			for (uint32 i = 0; i < numSites; ++i)
+				ImGui::Text("%.3f ms self | %s", topSites[i].Ticks * ticksToMs, topSites[i].SiteIndex < sites.GetNumSites() ? sites.GetSite(topSites[i].SiteIndex).pName : "???");
+
+			// Explain the outliers of all frames of the column
+			URange outlierRange = outliers.FindOutliers(GetColumnFrames(hoveredColumn));
+			if (outlierRange.Begin != outlierRange.End)
+			{
+				ImGui::Separator();
+				const uint32 maxOutliers = 8;
+				for (uint32 i = outlierRange.Begin; i < outlierRange.End && i < outlierRange.Begin + maxOutliers; ++i)
+				{
+					const ProfilerOutlier& outlier = outliers.GetOutliers()[i];
+					const char* pName = outlier.SiteIndex == ProfilerOutlier::FrameSite ? "Frame" : outlier.SiteIndex < sites.GetNumSites() ? sites.GetSite(outlier.SiteIndex).pName : "???";
+					ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "Frame %u: %s took %.3f ms vs. a %.3f ms baseline", outlier.FrameIndex, pName, outlier.Ticks * ticksToMs, outlier.BaselineTicks * ticksToMs);
+				}
+				if (outlierRange.End - outlierRange.Begin > maxOutliers)
+					ImGui::TextColored(context.Style.BGTextColor, "... %u more outliers", outlierRange.End - outlierRange.Begin - maxOutliers);
+			}
+
+			ImGui::Separator();
+			ImGui::TextColored(context.Style.BGTextColor, isFullFrame ? "Click to show the frame in the timeline" : "Only the summary of this frame is kept");
+			ImGui::EndTooltip();
+		}
+
+		// Pause so the frame stays in the history, and zoom the timeline to it once it is drawn
+		if (isFullFrame && ImGui::IsMouseClicked(ImGuiMouseButton_Left) && &GetActiveSource() == &context.LiveSource)
+		{
+			context.IsPaused = true;
+			context.ZoomToFrame = frame;
+		}
+	}
+}
+
+static void DrawCallTreeNode(const CallTree& tree, uint32 nodeIndex, float ticksToMs)
+{
+	const CallTree::Node& node = tree.GetNode(nodeIndex);
+	bool isLeaf = node.FirstChild == CallTree::InvalidNode;
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn();
+	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth;
+	if (isLeaf)
+		flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+	bool isOpen = ImGui::TreeNodeEx((void*)(uintptr_t)nodeIndex, flags, "%s", tree.GetSiteName(node.SiteIndex));
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%.3f", node.InclusiveTicks * ticksToMs);
+	ImGui::TableNextColumn();
+	ImGui::Text("%.3f", node.ExclusiveTicks * ticksToMs);
+	ImGui::TableNextColumn();
+	ImGui::Text("%.3f", tree.GetNumFrames() > 0 ? node.InclusiveTicks * ticksToMs / tree.GetNumFrames() : 0.0f);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", (unsigned long long)node.NumCalls);
+
+	if (isOpen && !isLeaf)
+	{
+		for (uint32 child = node.FirstChild; child != CallTree::InvalidNode; child = tree.GetNode(child).NextSibling)
+			DrawCallTreeNode(tree, child, ticksToMs);
+		ImGui::TreePop();
+	}
+}
+
+static void DrawCallTreeTable(const CallTree& tree, float ticksToMs)
+{
+	ImGuiTableFlags tableFlags = ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersV;
+	if (!ImGui::BeginTable("CallTree", 5, tableFlags))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+	ImGui::TableSetupColumn("Inclusive (ms)", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Exclusive (ms)", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Inclusive/frame (ms)", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableHeadersRow();
+
+	const CallTree::Node& root = tree.GetNode(CallTree::RootNode);
+	for (uint32 child = root.FirstChild; child != CallTree::InvalidNode; child = tree.GetNode(child).NextSibling)
+		DrawCallTreeNode(tree, child, ticksToMs);
+	ImGui::EndTable();
+}
+
+// Top-down and bottom-up call trees of a range of CPU frames of the active source
+static void DrawCallTreeWindow()
+{
+	HUDContext& context = Context();
+	const TimelineSource& source = GetActiveSource();
+
+	ImGui::SetNextItemWidth(200);
+	ImGui::SliderInt("Frames", &context.CallTreeNumFrames, 1, 1000, "%d frames", ImGuiSliderFlags_Logarithmic);
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_FA_REFRESH " Build"))
+	{
+		// A capture is built from the first frame of the view, the other sources from their last frames
+		URange frames;
+		uint32 numFrames = (uint32)ImMax(context.CallTreeNumFrames, 1);
+		if (context.CaptureSource.IsOpen())
+		{
+			frames.Begin = (uint32)context.CaptureFirstFrame;
+			frames.End = ImMin(frames.Begin + numFrames, context.CaptureSource.GetNumFrames());
+		}
+		else
+		{
+			frames = source.GetCPUFrameRange();
+			if (frames.End - frames.Begin > numFrames)
+				frames.Begin = frames.End - numFrames;
+		}
+		context.CallTrees.Start(source.CreateCallTreeTask(frames), frames.End - frames.Begin);
+	}
+	if (context.CallTrees.IsBusy())
+	{
+		ImGui::SameLine();
+		ImGui::ProgressBar(context.CallTrees.GetProgress(), ImVec2(200, 0));
+		ImGui::SameLine();
+		if (ImGui::Button(ICON_FA_TIMES "##cancelcalltree"))
+			context.CallTrees.Cancel();
+	}
+
+	if (!context.CallTrees.HasTrees())
+		return;
+
+	ImGui::SameLine();
+	ImGui::Text("%d frames", context.CallTrees.GetTopDown().GetNumFrames());
+
+	float ticksToMs = 1000.0f / source.GetTicksPerSecond();
+	if (ImGui::BeginTabBar("CallTreeTabs"))
+	{
+		if (ImGui::BeginTabItem("Top-down"))
+		{
+			DrawCallTreeTable(context.CallTrees.GetTopDown(), ticksToMs);
+			ImGui::EndTabItem();
+		}
+		if (ImGui::BeginTabItem("Bottom-up"))
+		{
+			DrawCallTreeTable(context.CallTrees.GetBottomUp(), ticksToMs);
+			ImGui::EndTabItem();
+		}
+		ImGui::EndTabBar();
 	}
 }
 
@@ -542,18 +2316,162 @@ void DrawProfilerHUD()
 	HUDContext& context = Context();
 	StyleOptions& style = context.Style;
 
-	if (gCPUProfiler.IsPaused())
+	if (context.CaptureSource.IsOpen())
+		ImGui::Text("Capture");
+	else if (context.RemoteSource.IsOpen() && context.RemoteSource.GetReader().IsWriterClosed())
+		ImGui::Text("Remote (closed)");
+	else if (context.RemoteSource.IsOpen())
+		ImGui::Text(context.IsPaused ? "Remote (paused)" : "Remote");
+	else if (gCPUProfiler.IsPaused())
 		ImGui::Text("Paused");
 	else
 		ImGui::Text("Press Space to pause");
 
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_FA_FLOPPY_O "##capture"))
+		ImGui::OpenPopup("Capture");
+	if (context.CaptureRecorder.IsOpen())
+	{
+		ImGui::SameLine();
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), ICON_FA_CIRCLE " %.1f MB", (float)context.CaptureRecorder.GetNumBytesWritten() / (1024 * 1024));
+	}
+
+	if (ImGui::BeginPopup("Capture"))
+	{
+		ImGui::SetNextItemWidth(300);
+		ImGui::InputText("Path", context.CapturePath, ARRAYSIZE(context.CapturePath));
+
+		if (!context.CaptureRecorder.IsOpen())
+		{
+			if (ImGui::Button(ICON_FA_CIRCLE " Record"))
+			{
+				if (context.CaptureRecorder.Open(context.CapturePath, context.LiveSource.GetTicksPerSecond()))
+				{
+					gCPUProfiler.SetCaptureWriter(&context.CaptureRecorder);
+					gGPUProfiler.SetCaptureWriter(&context.CaptureRecorder);
+				}
+			}
+		}
+		else
+		{
+			if (ImGui::Button(ICON_FA_STOP " Stop"))
+			{
+				gCPUProfiler.SetCaptureWriter(nullptr);
+				gGPUProfiler.SetCaptureWriter(nullptr);
+				context.CaptureRecorder.Close();
+			}
+			ImGui::SameLine();
+			ImGui::Text("%d frames (%d dropped)", context.CaptureRecorder.GetNumFrames(), context.CaptureRecorder.GetNumDroppedFrames());
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button(ICON_FA_FOLDER_OPEN " Open"))
+		{
+			// A call tree task may still be decoding the previous capture
+			context.CallTrees.Cancel();
+
+			// Traces of other tools (Chrome JSON, Perfetto) are converted to a capture next to them first
+			const char* pExtension = strrchr(context.CapturePath, '.');
+			if (pExtension && strcmp(pExtension, ".tlcap") != 0)
+			{
+				char importPath[ARRAYSIZE(context.CapturePath) + 8];
+				ImFormatString(importPath, ARRAYSIZE(importPath), "%s.tlcap", context.CapturePath);
+
+				TraceImportOptions options;
+				options.TicksPerSecond = context.LiveSource.GetTicksPerSecond();
+				options.AlignToStart = context.ImportAlignToStart;
+				if (ImportTrace(context.CapturePath, importPath, options))
+					context.CaptureSource.Open(importPath);
+			}
+			else
+			{
+				context.CaptureSource.Open(context.CapturePath);
+			}
+			context.TimelineSites.Clear();
+			context.TimelineLabels.Clear();
+			context.CaptureFirstFrame = 0;
+		}
+		if (context.CaptureSource.IsOpen())
+		{
+			ImGui::SameLine();
+			if (ImGui::Button(ICON_FA_TIMES " Close"))
+			{
+				context.CallTrees.Cancel();
+				context.CaptureSource.Close();
+				context.TimelineSites.Clear();
+				context.TimelineLabels.Clear();
+			}
+		}
+		ImGui::Checkbox("Align imported traces to start", &context.ImportAlignToStart);
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Move the first event of an imported trace to the start of the timeline.\nDisable if the trace uses the same clock as the profiler.");
+
+		// Show the frames another process publishes through its live transport
+		ImGui::Separator();
+		ImGui::SetNextItemWidth(300);
+		ImGui::InputText("Transport", context.RemoteName, ARRAYSIZE(context.RemoteName));
+		ImGui::SameLine();
+		if (!context.RemoteSource.IsOpen())
+		{
+			if (ImGui::Button(ICON_FA_LINK " Attach"))
+			{
+				context.RemoteSource.Open(context.RemoteName);
+				context.TimelineSites.Clear();
+				context.TimelineLabels.Clear();
+			}
+		}
+		else
+		{
+			if (ImGui::Button(ICON_FA_CHAIN_BROKEN " Detach"))
+			{
+				context.RemoteSource.Close();
+				context.TimelineSites.Clear();
+				context.TimelineLabels.Clear();
+			}
+			else
+			{
+				ImGui::SameLine();
+				ImGui::Text("%d dropped", context.RemoteSource.GetReader().GetNumDroppedFrames());
+			}
+		}
+		ImGui::EndPopup();
+	}
+
+	// Browse the capture by selecting a window of frames
+	if (context.CaptureSource.IsOpen())
+	{
+		int numFrames = (int)context.CaptureSource.GetNumFrames();
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(300);
+		ImGui::SliderInt("##CaptureFrame", &context.CaptureFirstFrame, 0, ImMax(numFrames - context.CaptureNumFrames, 0), "Frame %d");
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(100);
+		ImGui::SliderInt("##CaptureNumFrames", &context.CaptureNumFrames, 1, 32, "%d frames");
+		if (context.CaptureSource.GetReader().IsRecovered())
+		{
+			ImGui::SameLine();
+			ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), ICON_FA_EXCLAMATION_TRIANGLE);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("The capture was not closed properly. The index was rebuilt from the frames.");
+		}
+		context.CaptureSource.SetView((uint32)context.CaptureFirstFrame, (uint32)context.CaptureNumFrames);
+	}
+
 	ImGui::SameLine(ImGui::GetWindowWidth() - 620);
 
-	ImGui::Checkbox("Pause threshold", &Context().PauseThreshold);
+	// The threshold is evaluated by the profiler when a frame is finalized
+	bool thresholdChanged = ImGui::Checkbox("Pause threshold", &Context().PauseThreshold);
 	ImGui::SameLine();
 	ImGui::SetNextItemWidth(150);
-	ImGui::SliderFloat("##Treshold", &context.PauseThresholdTime, 0.0f, 16.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+	thresholdChanged |= ImGui::SliderFloat("##Treshold", &context.PauseThresholdTime, 0.0f, 16.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
 	ImGui::SameLine();
+	if (thresholdChanged)
+	{
+		HitchTriggerOptions options = gCPUProfiler.GetHitchTrigger();
+		options.FrameTimeMs = context.PauseThreshold ? context.PauseThresholdTime : 0.0f;
+		options.TriggerAction = HitchTriggerOptions::Action::Freeze;
+		gCPUProfiler.SetHitchTrigger(options);
+	}
 
 	ImGui::Dummy(ImVec2(30, 0));
 	ImGui::SameLine();
@@ -568,6 +2486,21 @@ void DrawProfilerHUD()
 	ImGui::SameLine();
 	if (ImGui::Button(ICON_FA_PAINT_BRUSH "##styleeditor"))
 		ImGui::OpenPopup("Style Editor");
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_FA_BAR_CHART "##statistics"))
+		context.ShowStatistics = !context.ShowStatistics;
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Statistics per site");
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_FA_SITEMAP "##calltree"))
+		context.ShowCallTree = !context.ShowCallTree;
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Call tree");
+	ImGui::SameLine();
+	if (ImGui::Button(ICON_FA_LINE_CHART "##framehistory"))
+		context.ShowFrameHistory = !context.ShowFrameHistory;
+	if (ImGui::IsItemHovered())
+		ImGui::SetTooltip("Frame history");
 
 	if (ImGui::BeginPopup("Style Editor"))
 	{
@@ -575,13 +2508,59 @@ void DrawProfilerHUD()
 		ImGui::EndPopup();
 	}
 
+	if (context.ShowStatistics)
+	{
+		ImGui::SetNextWindowSize(ImVec2(800, 400), ImGuiCond_FirstUseEver);
+		if (ImGui::Begin("Profiler Statistics", &context.ShowStatistics))
+			DrawStatisticsTable();
+		ImGui::End();
+	}
+
+	context.CallTrees.Update();
+	if (context.ShowCallTree)
+	{
+		ImGui::SetNextWindowSize(ImVec2(800, 500), ImGuiCond_FirstUseEver);
+		if (ImGui::Begin("Profiler Call Tree", &context.ShowCallTree))
+			DrawCallTreeWindow();
+		ImGui::End();
+	}
+
+	if (context.ShowFrameHistory)
+	{
+		ImGui::SetNextWindowSize(ImVec2(800, 250), ImGuiCond_FirstUseEver);
+		if (ImGui::Begin("Profiler Frame History", &context.ShowFrameHistory))
+			DrawFrameHistory();
+		ImGui::End();
+	}
+
 	if (ImGui::IsKeyPressed(ImGuiKey_Space))
 	{
 		context.IsPaused = !context.IsPaused;
 	}
 
+	// A frozen hitch pauses the profiler by itself. Keep it paused until it is resumed.
+	if (gCPUProfiler.GetNumHitches() != context.NumHitches)
+	{
+		context.NumHitches = gCPUProfiler.GetNumHitches();
+		if (gCPUProfiler.GetHitchTrigger().TriggerAction == HitchTriggerOptions::Action::Freeze)
+			context.IsPaused = true;
+	}
+
 	gCPUProfiler.SetPaused(context.IsPaused);
 	gGPUProfiler.SetPaused(context.IsPaused);
 
-	DrawProfilerTimeline(ImVec2(0, 0));
+	// While paused, the remote frames are not received. The publishing process drops frames instead of waiting.
+	if (context.RemoteSource.IsOpen() && !context.IsPaused)
+		context.RemoteSource.Update();
+
+	DrawProfilerTimeline(GetActiveSource(), ImVec2(0, 0));
+}
+
+bool AttachProfilerHUD(const char* pTransportName)
+{
+	HUDContext& context = Context();
+	ImStrncpy(context.RemoteName, pTransportName, ARRAYSIZE(context.RemoteName));
+	context.TimelineSites.Clear();
+	context.TimelineLabels.Clear();
+	return context.RemoteSource.Open(pTransportName);
 }
@@ -0,0 +1,125 @@
+// Measures how the analysis of captures scales with the number of threads.
+// Each capture is analyzed with 1, 2, 4... threads up to the number of cores, and the best of several runs is reported.
+//
+// Usage: AnalysisBench [options] <capture.tlcap>...
+//   --max-threads <count>	Highest number of threads. Default: a thread per core
+//   --repeat <count>		Runs per number of threads. Default 3
+//   --no-critical-path	Skip the critical path of the frames
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerAnalysis.h"
+#include "ProfilerCapture.h"
+#include "ProfilerTasks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void PrintUsage(const char* pExecutable)
+{
+	fprintf(stderr, "Usage: %s [--max-threads <count>] [--repeat <count>] [--no-critical-path] <capture.tlcap>...\n", pExecutable);
+}
+
+// 1, 2, 4... and the highest number of threads if it is not a power of 2
+static std::vector<uint32> GetThreadCounts(uint32 maxThreads)
+{
+	std::vector<uint32> counts;
+	for (uint32 count = 1; count < maxThreads; count *= 2)
+		counts.push_back(count);
+	counts.push_back(maxThreads);
+	return counts;
+}
+
+static bool Benchmark(const char* pPath, uint32 maxThreads, uint32 numRepeats, bool findCriticalPaths)
+{
+	CaptureReader capture;
+	if (!capture.Open(pPath))
+	{
+		fprintf(stderr, "Failed to open capture '%s'\n", pPath);
+		return false;
+	}
+
+	printf("%s\n", pPath);
+	printf("  %zu CPU frames, %.1f MB\n", capture.GetCPUFrames().size(), capture.GetFileSize() / (1024.0 * 1024.0));
+	printf("  %8s %10s %14s %10s %12s %8s\n", "Threads", "Seconds", "Events/s", "Speedup", "Efficiency", "Steals");
+
+	double baseSeconds = 0.0;
+	for (uint32 numThreads : GetThreadCounts(maxThreads))
+	{
+		// The scheduler is shared by the runs, so the time to start the threads is not measured
+		TaskScheduler scheduler(numThreads);
+		CaptureAnalysisOptions options;
+		options.pScheduler = &scheduler;
+		options.FindCriticalPaths = findCriticalPaths;
+
+		double bestSeconds = 0.0;
+		uint64 numEvents = 0;
+		for (uint32 run = 0; run < numRepeats; ++run)
+		{
+			CaptureAnalysis analysis;
+			Clock::time_point start = Clock::now();
+			if (!AnalyzeCapture(capture, options, analysis))
+			{
+				fprintf(stderr, "'%s' has no CPU frames\n", pPath);
+				return false;
+			}
+			double seconds = SecondsSince(start);
+			bestSeconds = run == 0 ? seconds : std::min(bestSeconds, seconds);
+			numEvents = analysis.NumEvents;
+		}
+
+		if (numThreads == 1)
+			baseSeconds = bestSeconds;
+		double speedup = baseSeconds / bestSeconds;
+		printf("  %8u %10.3f %13.1fM %9.2fx %11.0f%% %8u\n",
+			numThreads, bestSeconds, numEvents / bestSeconds / 1e6, speedup, 100.0 * speedup / numThreads, scheduler.GetNumSteals());
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	uint32 maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32 numRepeats = 3;
+	bool findCriticalPaths = true;
+	std::vector<const char*> capturePaths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(pArg, "--max-threads") == 0 && hasValue)
+			maxThreads = std::max((uint32)strtoul(argv[++i], nullptr, 10), 1u);
+		else if (strcmp(pArg, "--repeat") == 0 && hasValue)
+			numRepeats = std::max((uint32)strtoul(argv[++i], nullptr, 10), 1u);
+		else if (strcmp(pArg, "--no-critical-path") == 0)
+			findCriticalPaths = false;
+		else
+			capturePaths.push_back(pArg);
+	}
+
+	if (capturePaths.empty())
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	bool success = true;
+	for (const char* pPath : capturePaths)
+		success &= Benchmark(pPath, maxThreads, numRepeats, findCriticalPaths);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Summarizes a capture without the HUD: frame time percentiles, the sites with the most inclusive and self time,
+// the sites on the critical path of the frames, the utilization of each thread and the longest hitches.
+//
+// Usage: CaptureAnalyze [options] <capture.tlcap>
+//   --threads <count>		Number of threads decoding frames. Default: a thread per core
+//   --hitch <ms>			Frames longer than this are hitches. Default: twice the median frame time
+//   --hitch-factor <x>		Frames longer than x times the median frame time are hitches. Default 2
+//   --max-hitches <count>	Number of hitches listed, longest first. 0 for all. Default 100
+//   --top <count>			Number of sites in the text report. 0 for all. Default 30
+//   --no-critical-path	Skip the critical path of the frames, which takes about as long as the rest of the analysis
+//   --json <path>			Also write the full analysis as JSON. Use - for stdout instead of the text report
+//   --csv <prefix>		Also write <prefix>_frames.csv, <prefix>_sites.csv, <prefix>_threads.csv and <prefix>_hitches.csv
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerAnalysis.h"
+#include "ProfilerCapture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void PrintUsage(const char* pExecutable)
+{
+	fprintf(stderr, "Usage: %s [--threads <count>] [--hitch <ms>] [--hitch-factor <x>] [--max-hitches <count>] [--top <count>] [--no-critical-path] [--json <path|->] [--csv <prefix>] <capture.tlcap>\n", pExecutable);
+}
+
+static bool WriteCSVFile(const CaptureReader& capture, const CaptureAnalysis& analysis, const char* pPrefix, const char* pTableName, CaptureAnalysisTable table)
+{
+	std::string path = std::string(pPrefix) + "_" + pTableName + ".csv";
+	FILE* pFile = fopen(path.c_str(), "wb");
+	if (!pFile)
+	{
+		fprintf(stderr, "Failed to write '%s'\n", path.c_str());
+		return false;
+	}
+	WriteAnalysisCSV(capture, analysis, table, pFile);
+	fclose(pFile);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	CaptureAnalysisOptions options;
+	uint32 maxSites = 30;
+	const char* pJSONPath = nullptr;
+	const char* pCSVPrefix = nullptr;
+	const char* pCapturePath = nullptr;
+	bool isValid = true;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(pArg, "--threads") == 0 && hasValue)
+			options.NumThreads = (uint32)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--hitch") == 0 && hasValue)
+			options.HitchThresholdMs = strtod(argv[++i], nullptr);
+		else if (strcmp(pArg, "--hitch-factor") == 0 && hasValue)
+			options.HitchFactor = strtod(argv[++i], nullptr);
+		else if (strcmp(pArg, "--max-hitches") == 0 && hasValue)
+			options.MaxHitches = (uint32)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--top") == 0 && hasValue)
+			maxSites = (uint32)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--no-critical-path") == 0)
+			options.FindCriticalPaths = false;
+		else if (strcmp(pArg, "--json") == 0 && hasValue)
+			pJSONPath = argv[++i];
+		else if (strcmp(pArg, "--csv") == 0 && hasValue)
+			pCSVPrefix = argv[++i];
+		else if (!pCapturePath)
+			pCapturePath = pArg;
+		else
+			isValid = false;
+	}
+
+	if (!isValid || !pCapturePath)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	CaptureReader capture;
+	if (!capture.Open(pCapturePath))
+	{
+		fprintf(stderr, "Failed to open capture '%s'\n", pCapturePath);
+		return 1;
+	}
+	if (capture.IsRecovered())
+		fprintf(stderr, "Warning: '%s' was not closed properly. The index was rebuilt from the frames.\n", pCapturePath);
+
+	auto timeBegin = std::chrono::steady_clock::now();
+	CaptureAnalysis analysis;
+	if (!AnalyzeCapture(capture, options, analysis))
+	{
+		fprintf(stderr, "The capture has no CPU frames\n");
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeBegin).count();
+
+	bool isJSONToStdout = pJSONPath && strcmp(pJSONPath, "-") == 0;
+	if (isJSONToStdout)
+	{
+		WriteAnalysisJSON(capture, analysis, stdout);
+	}
+	else
+	{
+		printf("Capture: %s\n", pCapturePath);
+		WriteAnalysisText(capture, analysis, stdout, maxSites);
+	}
+
+	if (pJSONPath && !isJSONToStdout)
+	{
+		FILE* pFile = fopen(pJSONPath, "wb");
+		if (!pFile)
+		{
+			fprintf(stderr, "Failed to write '%s'\n", pJSONPath);
+			return 1;
+		}
+		WriteAnalysisJSON(capture, analysis, pFile);
+		fclose(pFile);
+	}
+
+	if (pCSVPrefix)
+	{
+		if (!WriteCSVFile(capture, analysis, pCSVPrefix, "frames", CaptureAnalysisTable::Frames) ||
+			!WriteCSVFile(capture, analysis, pCSVPrefix, "sites", CaptureAnalysisTable::Sites) ||
+			!WriteCSVFile(capture, analysis, pCSVPrefix, "threads", CaptureAnalysisTable::Threads) ||
+			!WriteCSVFile(capture, analysis, pCSVPrefix, "hitches", CaptureAnalysisTable::Hitches))
+			return 1;
+	}
+
+	fprintf(stderr, "Analyzed %.1f MB in %.3f s with %u threads (%.0f MB/s, %.1fM events/s)\n",
+		capture.GetFileSize() / (1024.0 * 1024.0), seconds, analysis.NumWorkerThreads,
+		capture.GetFileSize() / (1024.0 * 1024.0) / seconds, analysis.NumEvents / seconds / 1e6);
+	return 0;
+}
@@ -0,0 +1,189 @@
+
+// Measures the size and the decoding speed of the capture encodings on existing captures.
+// Each capture is re-encoded with every compression mode to a temporary file next to it.
+//
+// Usage: CaptureBench <capture.tlcap>...
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The size of an event in memory in the profiler. The reference for the compression ratio.
+static constexpr uint32 RAW_EVENT_SIZE = 40;
+
+struct EncodingResult
+{
+	uint64 FileSize = 0;
+	double EncodeSeconds = 0;
+	double DecodeSeconds = 0;
+	uint64 DecodedEvents = 0;
+};
+
+// Write all frames of the reader to a new capture, in their original order
+static bool Transcode(const CaptureReader& reader, const char* pPath, CaptureFormat::Compression compression)
+{
+	CaptureWriter writer;
+	if (!writer.Open(pPath, reader.GetTicksPerSecond(), compression))
+		return false;
+
+	for (const CaptureSite& site : reader.GetSites())
+		writer.AddSite(site.pName, site.pFilePath, site.LineNumber);
+	for (const CaptureThread& thread : reader.GetThreads())
+		writer.AddThread(thread.pName, thread.ThreadID);
+	for (const CaptureQueue& queue : reader.GetQueues())
+		writer.AddQueue(queue.pName, queue.GPUCalibrationTicks, queue.CPUCalibrationTicks, queue.GPUFrequency, queue.CPUFrequency);
+
+	Span<const CaptureFormat::FrameEntry> cpuFrames = reader.GetCPUFrames();
+	Span<const CaptureFormat::FrameEntry> gpuFrames = reader.GetGPUFrames();
+	std::vector<std::pair<uint64, uint32>> order;
+	for (uint32 i = 0; i < (uint32)cpuFrames.size(); ++i)
+		order.push_back({ cpuFrames[i].Offset, i });
+	for (uint32 i = 0; i < (uint32)gpuFrames.size(); ++i)
+		order.push_back({ gpuFrames[i].Offset, i | 0x80000000 });
+	std::sort(order.begin(), order.end());
+
+	CaptureFrame frame;
+	for (const std::pair<uint64, uint32>& entry : order)
+	{
+		bool isGPU = (entry.second & 0x80000000) != 0;
+		uint32 index = entry.second & 0x7FFFFFFF;
+		if (isGPU ? !reader.DecodeGPUFrame(index, frame) : !reader.DecodeCPUFrame(index, frame))
+			continue;
+
+		if (isGPU)
+			writer.BeginGPUFrame(frame.FrameIndex, frame.TicksBegin, frame.TicksEnd);
+		else
+			writer.BeginCPUFrame(frame.FrameIndex, frame.TicksBegin, frame.TicksEnd);
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			writer.BeginBlock(track.TrackIndex, track.NumEvents);
+			for (const CaptureEvent& event : frame.GetEvents(track))
+				writer.AddEvent(event.TicksBegin, event.TicksEnd, event.SiteIndex, event.Depth);
+		}
+		writer.EndFrame();
+	}
+
+	writer.Close();
+	return !writer.HasError() && writer.GetNumDroppedFrames() == 0;
+}
+
+// Decode every frame until at least minSeconds have passed
+static void MeasureDecode(const CaptureReader& reader, double minSeconds, EncodingResult& result)
+{
+	CaptureFrame frame;
+	Clock::time_point start = Clock::now();
+	do
+	{
+		for (uint32 i = 0; i < (uint32)reader.GetCPUFrames().size(); ++i)
+		{
+			reader.DecodeCPUFrame(i, frame);
+			result.DecodedEvents += frame.Events.size();
+		}
+		for (uint32 i = 0; i < (uint32)reader.GetGPUFrames().size(); ++i)
+		{
+			reader.DecodeGPUFrame(i, frame);
+			result.DecodedEvents += frame.Events.size();
+		}
+		result.DecodeSeconds = SecondsSince(start);
+	} while (result.DecodeSeconds < minSeconds);
+}
+
+static bool Benchmark(const char* pPath)
+{
+	CaptureReader input;
+	if (!input.Open(pPath))
+	{
+		fprintf(stderr, "Failed to open capture '%s'\n", pPath);
+		return false;
+	}
+
+	uint64 numEvents = 0;
+	CaptureFrame frame;
+	for (uint32 i = 0; i < (uint32)input.GetCPUFrames().size(); ++i)
+		numEvents += input.DecodeCPUFrame(i, frame) ? frame.Events.size() : 0;
+	for (uint32 i = 0; i < (uint32)input.GetGPUFrames().size(); ++i)
+		numEvents += input.DecodeGPUFrame(i, frame) ? frame.Events.size() : 0;
+
+	printf("%s\n", pPath);
+	printf("  %zu CPU frames, %zu GPU frames, %llu events, %zu sites\n", input.GetCPUFrames().size(), input.GetGPUFrames().size(), (unsigned long long)numEvents, input.GetSites().size());
+	if (numEvents == 0)
+		return true;
+
+	uint64 rawSize = numEvents * RAW_EVENT_SIZE;
+	printf("  %-10s %12s %10s %8s %12s %14s %12s\n", "Encoding", "Size", "B/event", "Ratio", "Encode MB/s", "Decode MEv/s", "Decode GB/s");
+	printf("  %-10s %12llu %10.2f %8.2f\n", "Raw", (unsigned long long)rawSize, (double)RAW_EVENT_SIZE, 1.0);
+
+	struct Mode
+	{
+		const char* pName;
+		CaptureFormat::Compression Compression;
+	};
+	const Mode modes[] = {
+		{ "Varint", CaptureFormat::Compression::None },
+		{ "Varint+LZ", CaptureFormat::Compression::LZ },
+	};
+
+	std::string tempPath = std::string(pPath) + ".bench";
+	for (const Mode& mode : modes)
+	{
+		EncodingResult result;
+		Clock::time_point start = Clock::now();
+		if (!Transcode(input, tempPath.c_str(), mode.Compression))
+		{
+			fprintf(stderr, "Failed to write '%s'\n", tempPath.c_str());
+			return false;
+		}
+		result.EncodeSeconds = SecondsSince(start);
+
+		CaptureReader output;
+		if (!output.Open(tempPath.c_str()))
+		{
+			fprintf(stderr, "Failed to read back '%s'\n", tempPath.c_str());
+			return false;
+		}
+		result.FileSize = output.GetFileSize();
+		MeasureDecode(output, 1.0, result);
+		output.Close();
+		remove(tempPath.c_str());
+
+		// Speeds are relative to the decoded events, so they can be compared between encodings
+		double decodedBytes = (double)result.DecodedEvents * sizeof(CaptureEvent);
+		printf("  %-10s %12llu %10.2f %8.2f %12.1f %14.1f %12.2f\n",
+			mode.pName,
+			(unsigned long long)result.FileSize,
+			(double)result.FileSize / numEvents,
+			(double)rawSize / result.FileSize,
+			(double)rawSize / result.EncodeSeconds / (1024 * 1024),
+			(double)result.DecodedEvents / result.DecodeSeconds / 1e6,
+			decodedBytes / result.DecodeSeconds / (1024 * 1024 * 1024));
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <capture.tlcap>...\n", argv[0]);
+		return 1;
+	}
+
+	bool success = true;
+	for (int i = 1; i < argc; ++i)
+		success &= Benchmark(argv[i]);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// Compares two captures and reports the sites that became slower or faster, to gate changes on performance.
+// Exits with 1 if there is a regression, and with 2 if the captures can not be compared.
+//
+// Usage: CaptureDiff [options] <base.tlcap> <test.tlcap>
+//   --threshold <percent>	Minimum increase of the mean time per frame of a regression. Default 5
+//   --threshold-ms <ms>	Minimum absolute increase of a regression. Default 0.01
+//   --alpha <p>			Significance level of the t-test. Default 0.01
+//   --match-lines			Match sites by line number too, instead of only by name and file name
+//   --top <count>			Number of sites in the text report. 0 for all. Default 30
+//   --threads <count>		Number of threads decoding frames. Default: a thread per core
+//   --json <path>			Also write the full report as JSON. Use - for stdout instead of the text report
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerCapture.h"
+#include "ProfilerDiff.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void PrintUsage(const char* pExecutable)
+{
+	fprintf(stderr, "Usage: %s [--threshold <percent>] [--threshold-ms <ms>] [--alpha <p>] [--match-lines] [--top <count>] [--threads <count>] [--json <path|->] <base.tlcap> <test.tlcap>\n", pExecutable);
+}
+
+static bool OpenCapture(CaptureReader& capture, const char* pPath)
+{
+	if (!capture.Open(pPath))
+	{
+		fprintf(stderr, "Failed to open capture '%s'\n", pPath);
+		return false;
+	}
+	if (capture.IsRecovered())
+		fprintf(stderr, "Warning: '%s' was not closed properly. The index was rebuilt from the frames.\n", pPath);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	CaptureDiffOptions options;
+	uint32 maxSites = 30;
+	const char* pJSONPath = nullptr;
+	const char* pBasePath = nullptr;
+	const char* pTestPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(pArg, "--threshold") == 0 && hasValue)
+			options.ThresholdPercent = strtod(argv[++i], nullptr);
+		else if (strcmp(pArg, "--threshold-ms") == 0 && hasValue)
+			options.ThresholdMs = strtod(argv[++i], nullptr);
+		else if (strcmp(pArg, "--alpha") == 0 && hasValue)
+			options.Alpha = strtod(argv[++i], nullptr);
+		else if (strcmp(pArg, "--match-lines") == 0)
+			options.MatchLineNumbers = true;
+		else if (strcmp(pArg, "--top") == 0 && hasValue)
+			maxSites = (uint32)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--threads") == 0 && hasValue)
+			options.NumThreads = (uint32)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--json") == 0 && hasValue)
+			pJSONPath = argv[++i];
+		else if (!pBasePath)
+			pBasePath = pArg;
+		else if (!pTestPath)
+			pTestPath = pArg;
+		else
+			pBasePath = nullptr;
+	}
+
+	if (!pBasePath || !pTestPath)
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	CaptureReader base, test;
+	if (!OpenCapture(base, pBasePath) || !OpenCapture(test, pTestPath))
+		return 2;
+
+	CaptureDiffReport report;
+	if (!DiffCaptures(base, test, options, report))
+	{
+		fprintf(stderr, "The captures have no CPU frames to compare\n");
+		return 2;
+	}
+
+	bool isJSONToStdout = pJSONPath && strcmp(pJSONPath, "-") == 0;
+	if (isJSONToStdout)
+	{
+		WriteDiffReportJSON(report, options, stdout);
+	}
+	else
+	{
+		printf("Base: %s\nTest: %s\n", pBasePath, pTestPath);
+		WriteDiffReportText(report, stdout, maxSites);
+	}
+
+	if (pJSONPath && !isJSONToStdout)
+	{
+		FILE* pFile = fopen(pJSONPath, "wb");
+		if (!pFile)
+		{
+			fprintf(stderr, "Failed to write '%s'\n", pJSONPath);
+			return 2;
+		}
+		WriteDiffReportJSON(report, options, pFile);
+		fclose(pFile);
+	}
+
+	return report.NumRegressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+
+// Converts captures to the formats of other trace viewers.
+// The format is selected by the extension of the output file.
+//
+// Usage: CaptureExport [options] <capture.tlcap> <output.json|output.pftrace>
+//   --derived-times		Add the self time and the slack on the critical path of each slice
+//   --critical-path		Add the critical path of each frame as a thread
+
+#include "ProfilerCapture.h"
+#include "ProfilerExport.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+static bool HasExtension(const char* pPath, const char* pExtension)
+{
+	size_t pathLength = strlen(pPath);
+	size_t extensionLength = strlen(pExtension);
+	return pathLength >= extensionLength && strcmp(pPath + pathLength - extensionLength, pExtension) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	TraceExportOptions options;
+	const char* pInputPath = nullptr;
+	const char* pOutputPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		if (strcmp(pArg, "--derived-times") == 0)
+			options.WriteDerivedTimes = true;
+		else if (strcmp(pArg, "--critical-path") == 0)
+			options.WriteCriticalPath = true;
+		else if (!pInputPath)
+			pInputPath = pArg;
+		else if (!pOutputPath)
+			pOutputPath = pArg;
+		else
+			pInputPath = nullptr;
+	}
+
+	if (!pInputPath || !pOutputPath)
+	{
+		fprintf(stderr, "Usage: %s [--derived-times] [--critical-path] <capture.tlcap> <output.json|output.pftrace>\n", argv[0]);
+		return 1;
+	}
+
+	CaptureReader capture;
+	if (!capture.Open(pInputPath))
+	{
+		fprintf(stderr, "Failed to open capture '%s'\n", pInputPath);
+		return 1;
+	}
+	if (capture.IsRecovered())
+		fprintf(stderr, "Warning: '%s' was not closed properly. The index was rebuilt from the frames.\n", pInputPath);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool success = false;
+	if (HasExtension(pOutputPath, ".json"))
+	{
+		success = ExportChromeTrace(capture, pOutputPath, options);
+	}
+	else if (HasExtension(pOutputPath, ".pftrace") || HasExtension(pOutputPath, ".perfetto-trace"))
+	{
+		success = ExportPerfettoTrace(capture, pOutputPath, options);
+	}
+	else
+	{
+		fprintf(stderr, "Unknown output format for '%s'. Supported: .json (Chrome trace), .pftrace (Perfetto)\n", pOutputPath);
+		return 1;
+	}
+
+	if (!success)
+	{
+		fprintf(stderr, "Failed to write '%s'\n", pOutputPath);
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Exported %zu CPU frames and %zu GPU frames to '%s' in %.2f s\n", capture.GetCPUFrames().size(), capture.GetGPUFrames().size(), pOutputPath, seconds);
+	return 0;
+}
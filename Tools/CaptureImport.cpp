@@ -0,0 +1,195 @@
+// Converts traces of other tools (Chrome trace JSON, Perfetto) to captures, which can be opened in the HUD.
+// The format is detected from the contents of the file.
+//
+// Usage: CaptureImport [options] <trace.json|trace.pftrace> <output.tlcap>
+//   --frequency <ticks>	Tick frequency of the capture. Use the frequency of the profiler to line up with its captures
+//   --frame <ms>			Minimum length of the frames, for traces which were not exported from a capture. 0 starts a frame at every top-level event which does not overlap another
+//   --start <ticks>		Move the first event to this tick
+//   --absolute				Keep the timestamps of the trace instead of moving the first event
+//   --offset <ns>			Add an offset to all timestamps
+//   --verify <capture>		Check the frames and the self time of each site against the capture the trace was exported from
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ProfilerImport.h"
+#include "ProfilerCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+static void PrintUsage(const char* pExecutable)
+{
+	fprintf(stderr, "Usage: %s [--frequency <ticks>] [--frame <ms>] [--start <ticks> | --absolute] [--offset <ns>] [--verify <capture.tlcap>] <trace.json|trace.pftrace> <output.tlcap>\n", pExecutable);
+}
+
+// Frame durations and the total self time of each site, in nanoseconds
+struct CaptureTimes
+{
+	struct Site
+	{
+		uint64 SelfNanoseconds = 0;
+		uint64 NumTerms = 0;		// Durations the self time is made of, each of which can be off by a tick after the round trip
+	};
+
+	uint64						TicksPerSecond = 1;
+	std::vector<uint64>			FrameNanoseconds;
+	std::map<std::string, Site>	Sites;		// Sites are matched by name, the importers do not know their file
+};
+
+static uint64 ToNanoseconds(uint64 ticks, uint64 ticksPerSecond)
+{
+	return ticks / ticksPerSecond * 1000000000ull + ticks % ticksPerSecond * 1000000000ull / ticksPerSecond;
+}
+
+static bool ReadTimes(const char* pPath, CaptureTimes& outTimes)
+{
+	CaptureReader reader;
+	if (!reader.Open(pPath))
+	{
+		fprintf(stderr, "Failed to open '%s'\n", pPath);
+		return false;
+	}
+
+	uint64 ticksPerSecond = reader.GetTicksPerSecond();
+	outTimes.TicksPerSecond = ticksPerSecond;
+	std::vector<CaptureTimes::Site*> sites;
+	for (const CaptureSite& site : reader.GetSites())
+		sites.push_back(&outTimes.Sites[site.pName]);
+
+	CaptureFrame frame;
+	std::vector<uint32> parentSites;
+	for (uint32 frameIndex = 0; frameIndex < (uint32)reader.GetCPUFrames().size(); ++frameIndex)
+	{
+		if (!reader.DecodeCPUFrame(frameIndex, frame))
+		{
+			fprintf(stderr, "Failed to decode frame %u of '%s'\n", frameIndex, pPath);
+			return false;
+		}
+		outTimes.FrameNanoseconds.push_back(ToNanoseconds(frame.TicksEnd - frame.TicksBegin, ticksPerSecond));
+
+		for (const CaptureFrame::Track& track : frame.Tracks)
+		{
+			for (const CaptureEvent& event : frame.GetEvents(track))
+			{
+				CaptureTimes::Site& site = *sites[event.SiteIndex];
+				site.SelfNanoseconds += ToNanoseconds(event.SelfTicks, ticksPerSecond);
+				++site.NumTerms;
+
+				// The duration of a child is also subtracted from the self time of its parent
+				parentSites.resize(event.Depth);
+				if (event.Depth > 0)
+					++sites[parentSites.back()]->NumTerms;
+				parentSites.push_back(event.SiteIndex);
+			}
+		}
+	}
+	return true;
+}
+
+// Compare the imported capture with the capture the trace was exported from.
+// Timestamps are rounded to whole ticks of either capture, so each duration can be off by two ticks of the coarser clock.
+static bool VerifyRoundTrip(const char* pSourcePath, const char* pImportedPath)
+{
+	CaptureTimes source, imported;
+	if (!ReadTimes(pSourcePath, source) || !ReadTimes(pImportedPath, imported))
+		return false;
+
+	uint64 tolerance = 2 * ToNanoseconds(1, std::min(source.TicksPerSecond, imported.TicksPerSecond)) + 2;
+	uint32 numErrors = 0;
+	auto Differs = [](uint64 a, uint64 b, uint64 maxDifference) { return (a > b ? a - b : b - a) > maxDifference; };
+
+	if (source.FrameNanoseconds.size() != imported.FrameNanoseconds.size())
+	{
+		printf("Frame count: %zu in the source, %zu imported\n", source.FrameNanoseconds.size(), imported.FrameNanoseconds.size());
+		++numErrors;
+	}
+
+	size_t numFrames = std::min(source.FrameNanoseconds.size(), imported.FrameNanoseconds.size());
+	for (size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+	{
+		if (Differs(source.FrameNanoseconds[frameIndex], imported.FrameNanoseconds[frameIndex], tolerance) && numErrors++ < 10)
+			printf("Frame %zu: %.3f ms in the source, %.3f ms imported\n", frameIndex, source.FrameNanoseconds[frameIndex] / 1e6, imported.FrameNanoseconds[frameIndex] / 1e6);
+	}
+
+	for (const auto& [name, site] : source.Sites)
+	{
+		auto it = imported.Sites.find(name);
+		uint64 importedSelf = it != imported.Sites.end() ? it->second.SelfNanoseconds : 0;
+		if (Differs(site.SelfNanoseconds, importedSelf, tolerance * std::max(site.NumTerms, (uint64)1)))
+		{
+			printf("Site '%s': %.3f ms self time in the source, %.3f ms imported\n", name.c_str(), site.SelfNanoseconds / 1e6, importedSelf / 1e6);
+			++numErrors;
+		}
+	}
+
+	if (numErrors > 0)
+	{
+		printf("'%s' does not match '%s': %u differences\n", pImportedPath, pSourcePath, numErrors);
+		return false;
+	}
+	printf("'%s' matches '%s': %zu frames, %zu sites\n", pImportedPath, pSourcePath, numFrames, source.Sites.size());
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	TraceImportOptions options;
+	const char* pInputPath = nullptr;
+	const char* pOutputPath = nullptr;
+	const char* pVerifyPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(pArg, "--frequency") == 0 && hasValue)
+			options.TicksPerSecond = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--frame") == 0 && hasValue)
+			options.FrameDuration = (uint64)(strtod(argv[++i], nullptr) * 1000000.0);
+		else if (strcmp(pArg, "--start") == 0 && hasValue)
+			options.StartTicks = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--absolute") == 0)
+			options.AlignToStart = false;
+		else if (strcmp(pArg, "--offset") == 0 && hasValue)
+			options.OffsetNanoseconds = strtoll(argv[++i], nullptr, 10);
+		else if (strcmp(pArg, "--verify") == 0 && hasValue)
+			pVerifyPath = argv[++i];
+		else if (!pInputPath)
+			pInputPath = pArg;
+		else if (!pOutputPath)
+			pOutputPath = pArg;
+		else
+			pInputPath = nullptr;
+	}
+
+	if (!pInputPath || !pOutputPath || options.TicksPerSecond == 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!ImportTrace(pInputPath, pOutputPath, options))
+	{
+		fprintf(stderr, "Failed to import '%s'\n", pInputPath);
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	struct stat info;
+	double megabytes = stat(pInputPath, &info) == 0 ? (double)info.st_size / (1024 * 1024) : 0.0;
+	printf("Imported '%s' (%.1f MB) to '%s' in %.2f s (%.0f MB/s)\n", pInputPath, megabytes, pOutputPath, seconds, megabytes / seconds);
+
+	if (pVerifyPath && !VerifyRoundTrip(pVerifyPath, pOutputPath))
+		return 1;
+	return 0;
+}
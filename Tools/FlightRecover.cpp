@@ -0,0 +1,125 @@
+
+// Reconstructs the last events of every thread from a flight record, for example after the process crashed.
+// Prints the events that were still open at the end of the record and optionally writes the events to a capture.
+//
+// Usage: FlightRecover [--last <ms>] <record.tlfr> [output.tlcap]
+//   --last <ms>			Only recover events which ended in the last <ms> milliseconds of the record (default 1000)
+
+#include "ProfilerCapture.h"
+#include "ProfilerFlightRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void PrintUsage(const char* pExecutable)
+{
+	fprintf(stderr, "Usage: %s [--last <ms>] <record.tlfr> [output.tlcap]\n", pExecutable);
+}
+
+static const char* GetSiteName(const FlightRecordReader& record, uint32 siteIndex)
+{
+	return siteIndex < record.GetSites().size() ? record.GetSites()[siteIndex].Name : "???";
+}
+
+int main(int argc, char** argv)
+{
+	double lastMs = 1000.0;
+	const char* pInputPath = nullptr;
+	const char* pOutputPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		if (strcmp(pArg, "--last") == 0 && i + 1 < argc)
+			lastMs = strtod(argv[++i], nullptr);
+		else if (!pInputPath)
+			pInputPath = pArg;
+		else if (!pOutputPath)
+			pOutputPath = pArg;
+		else
+			pInputPath = nullptr;
+	}
+
+	if (!pInputPath || lastMs <= 0.0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	FlightRecordReader record;
+	if (!record.Open(pInputPath))
+	{
+		fprintf(stderr, "Failed to open flight record '%s'\n", pInputPath);
+		return 1;
+	}
+
+	uint64 ticksPerSecond = record.GetTicksPerSecond();
+	uint64 ticksEnd = record.GetTicksEnd();
+	uint64 windowTicks = (uint64)(lastMs * 0.001 * (double)ticksPerSecond);
+	uint64 ticksMin = ticksEnd > windowTicks ? ticksEnd - windowTicks : 0;
+	double msPerTick = 1000.0 / (double)ticksPerSecond;
+
+	std::vector<std::vector<FlightRecordEvent>> threadEvents(record.GetThreads().size());
+	uint64 ticksBegin = ticksEnd;
+	for (uint32 threadIndex = 0; threadIndex < (uint32)threadEvents.size(); ++threadIndex)
+	{
+		const FlightRecordFormat::Thread& thread = record.GetThreads()[threadIndex];
+		std::vector<FlightRecordEvent>& events = threadEvents[threadIndex];
+		record.GetEvents(threadIndex, ticksMin, events);
+		if (!events.empty())
+			ticksBegin = std::min(ticksBegin, events.front().TicksBegin);
+
+		printf("Thread %u '%s' (ID %u): %zu events\n", threadIndex, thread.Name, thread.ThreadID, events.size());
+		for (const FlightRecordEvent& event : events)
+		{
+			if (!event.IsOpen)
+				continue;
+			const FlightRecordFormat::Site* pSite = event.SiteIndex < record.GetSites().size() ? &record.GetSites()[event.SiteIndex] : nullptr;
+			printf("  %*s%s", event.Depth * 2, "", GetSiteName(record, event.SiteIndex));
+			if (pSite && pSite->FilePath[0])
+				printf(" (%s:%u)", pSite->FilePath, pSite->LineNumber);
+			if (event.IsTruncated)
+				printf(" open for more than %.3f ms\n", (event.TicksEnd - event.TicksBegin) * msPerTick);
+			else
+				printf(" open for %.3f ms\n", (event.TicksEnd - event.TicksBegin) * msPerTick);
+		}
+	}
+
+	if (!pOutputPath)
+		return 0;
+
+	// The recovered events are written as a single frame, which must not be dropped
+	CaptureWriter writer;
+	if (!writer.Open(pOutputPath, ticksPerSecond, CaptureFormat::Compression::LZ, 1 << 18, ~0u))
+	{
+		fprintf(stderr, "Failed to create capture '%s'\n", pOutputPath);
+		return 1;
+	}
+
+	uint32 unknownSite = (uint32)record.GetSites().size();
+	for (const FlightRecordFormat::Site& site : record.GetSites())
+		writer.AddSite(site.Name, site.FilePath, site.LineNumber);
+	writer.AddSite("???", "", 0);
+
+	for (const FlightRecordFormat::Thread& thread : record.GetThreads())
+		writer.AddThread(thread.Name, thread.ThreadID);
+
+	writer.BeginCPUFrame(0, ticksBegin, ticksEnd);
+	for (uint32 threadIndex = 0; threadIndex < (uint32)threadEvents.size(); ++threadIndex)
+	{
+		const std::vector<FlightRecordEvent>& events = threadEvents[threadIndex];
+		if (events.empty())
+			continue;
+
+		writer.BeginBlock(threadIndex, (uint32)events.size());
+		for (const FlightRecordEvent& event : events)
+			writer.AddEvent(event.TicksBegin, event.TicksEnd, event.SiteIndex < unknownSite ? event.SiteIndex : unknownSite, event.Depth);
+	}
+	writer.EndFrame();
+	writer.Close();
+
+	printf("Recovered %.3f ms to '%s'\n", (ticksEnd - ticksBegin) * msPerTick, pOutputPath);
+	return 0;
+}
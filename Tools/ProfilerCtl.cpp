@@ -0,0 +1,49 @@
+
+// Sends commands to the control surface of a profiled process (see ProfilerControl.h).
+//
+// Usage: ProfilerCtl signal <pid>				Request a snapshot through the snapshot trigger (SIGUSR1)
+//        ProfilerCtl <socket> <command...>		Send a command to the control socket, eg. "snapshot crash.tlcap" or "enable 0x1"
+
+#include "ProfilerControl.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s signal <pid>\n       %s <socket> <snapshot [path] | start <path> | stop | enable <mask>>\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "signal") == 0)
+	{
+		uint32 processID = (uint32)strtoul(argv[2], nullptr, 10);
+		if (!SignalProfilerSnapshot(processID))
+		{
+			fprintf(stderr, "Failed to signal process %u\n", processID);
+			return 1;
+		}
+		return 0;
+	}
+
+	std::string command;
+	for (int i = 2; i < argc; ++i)
+	{
+		if (i > 2)
+			command += ' ';
+		command += argv[i];
+	}
+
+	std::string reply;
+	if (!SendProfilerCommand(argv[1], command.c_str(), reply))
+	{
+		fprintf(stderr, "Failed to send '%s' to '%s'\n", command.c_str(), argv[1]);
+		return 1;
+	}
+	printf("%s\n", reply.c_str());
+	return reply == "ok" ? 0 : 1;
+}
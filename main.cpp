@@ -12,8 +12,10 @@
 #include <d3d12.h>
 #include <dxgi1_4.h>
 #include <tchar.h>
+#include <cstring>
 
 #include "Profiler.h"
+#include "ProfilerTransport.h"
 #include "IconsFontAwesome4.h"
 
 #ifdef _DEBUG
@@ -60,8 +62,20 @@ FrameContext* WaitForNextFrameResources();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 // Main code
-int main(int, char**)
+//   --publish <name>		Publish the frames of this process through the live transport with the given name
+//   --attach <name>		Run as viewer of the process publishing the live transport with the given name
+int main(int argc, char** argv)
 {
+    const char* pPublishName = nullptr;
+    const char* pAttachName = nullptr;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], "--publish") == 0)
+            pPublishName = argv[++i];
+        else if (strcmp(argv[i], "--attach") == 0)
+            pAttachName = argv[++i];
+    }
+
     // Create application window
     //ImGui_ImplWin32_EnableDpiAwareness();
     WNDCLASSEXW wc = { sizeof(wc), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(nullptr), nullptr, nullptr, nullptr, nullptr, L"ImGui Example", nullptr };
@@ -142,8 +156,22 @@ int main(int, char**)
     Span<ID3D12CommandQueue*> queues(&g_pd3dCommandQueue, 1);
     gGPUProfiler.Initialize(g_pd3dDevice, queues, 5, 3, 1024, 128, 32);
 
+    LiveTransportWriter transport;
+    if (pPublishName)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        if (transport.Open(pPublishName, (uint64)frequency.QuadPart))
+        {
+            gCPUProfiler.SetLiveTransport(&transport);
+            gGPUProfiler.SetLiveTransport(&transport);
+        }
+    }
+    if (pAttachName)
+        AttachProfilerHUD(pAttachName);
+
     // Our state
-    bool show_demo_window = true;
+    bool show_demo_window = pAttachName == nullptr;
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
@@ -278,6 +306,10 @@ int main(int, char**)
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
 
+    gCPUProfiler.SetLiveTransport(nullptr);
+    gGPUProfiler.SetLiveTransport(nullptr);
+    transport.Close();
+
     gGPUProfiler.Shutdown();
     gCPUProfiler.Shutdown();
 